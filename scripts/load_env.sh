@@ -26,6 +26,15 @@ echo "- EMQX_USERNAME: ${EMQX_USERNAME}"
 echo "- EMQX_PASSWORD: [masqué]"
 echo "- EMQX_TOPIC: ${EMQX_TOPIC}"
 echo "- EMQX_UNAUTHORIZED_TOPIC: ${EMQX_UNAUTHORIZED_TOPIC}"
+echo "- EMQX_ENCODING: ${EMQX_ENCODING} / ${EMQX_UNAUTHORIZED_ENCODING}"
+echo "- EMQX_BATCH_WINDOW: ${EMQX_BATCH_WINDOW}"
+echo "- EMQX_STATE_TOPIC: ${EMQX_STATE_TOPIC}"
+echo "- EMQX_COMMAND_SECRET: [masqué]"
+echo "- EMQX_COMMAND_TOPIC: ${EMQX_COMMAND_TOPIC}"
+echo "- EMQX_COMMAND_REPLY_TOPIC: ${EMQX_COMMAND_REPLY_TOPIC}"
+echo "- AUTH_POLICY: ${AUTH_POLICY}"
+echo "- AUTH_POLICY_TZ: ${AUTH_POLICY_TZ}"
+echo "- GUEST_CODES: [masqué]"
 
 echo ""
 echo "Vous pouvez maintenant lancer : pio run"
\ No newline at end of file
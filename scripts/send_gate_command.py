@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Envoie une commande de porte signée à l'ESP32 via EMQX et attend les réponses.
+
+- Utilise les variables suivantes (chargées via scripts/load_env.sh):
+  EMQX_BROKER_HOST, EMQX_BROKER_PORT, EMQX_USERNAME, EMQX_PASSWORD,
+  EMQX_COMMAND_SECRET, EMQX_COMMAND_TOPIC, EMQX_COMMAND_REPLY_TOPIC
+
+- La signature est un HMAC-SHA256 (hex) de
+  "<device_id>\\n<gate>\\n<action>\\n<ts>\\n<nonce>" avec EMQX_COMMAND_SECRET.
+
+Dépendances: paho-mqtt (pip install paho-mqtt)
+"""
+
+import argparse
+import hashlib
+import hmac
+import json
+import os
+import secrets
+import sys
+import time
+
+try:
+    import paho.mqtt.client as mqtt
+except ImportError:
+    print("Ce script nécessite paho-mqtt. Installez-le: pip install paho-mqtt", file=sys.stderr)
+    sys.exit(2)
+
+
+def get_env(name, default=None, required=False):
+    val = os.getenv(name, default)
+    if required and not val:
+        print(f"❌ Variable d'environnement requise manquante: {name}", file=sys.stderr)
+        sys.exit(1)
+    return val
+
+
+def sign_command(secret, device_id, gate, action, ts, nonce):
+    message = f"{device_id}\n{gate}\n{action}\n{ts}\n{nonce}".encode("utf-8")
+    return hmac.new(secret.encode("utf-8"), message, hashlib.sha256).hexdigest()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Commande de porte signée via MQTT")
+    parser.add_argument("action", choices=["open", "close"], help="Action à effectuer")
+    parser.add_argument("--device", required=True, help="Client ID de la carte (ESP32_AABBCCDDEEFF)")
+    parser.add_argument("--gate", default="main", help="Identifiant ou index de la porte")
+    parser.add_argument("--timeout", type=float, default=30.0, help="Attente maximale des réponses (s)")
+    args = parser.parse_args()
+
+    host = get_env("EMQX_BROKER_HOST", required=True)
+    port = int(get_env("EMQX_BROKER_PORT", "1883") or "1883")
+    username = get_env("EMQX_USERNAME", "")
+    password = get_env("EMQX_PASSWORD", "")
+    secret = get_env("EMQX_COMMAND_SECRET", required=True)
+    command_topic = get_env("EMQX_COMMAND_TOPIC") or f"garage/{args.device}/command"
+    reply_topic = get_env("EMQX_COMMAND_REPLY_TOPIC") or f"garage/{args.device}/reply"
+
+    ts = int(time.time())
+    nonce = secrets.token_hex(16)
+    payload = json.dumps({
+        "action": args.action,
+        "gate": args.gate,
+        "ts": ts,
+        "nonce": nonce,
+        "sig": sign_command(secret, args.device, args.gate, args.action, ts, nonce),
+    })
+
+    finished = False
+
+    def on_connect(client, userdata, flags, rc):
+        if rc == 0:
+            print(f"✅ Connecté à EMQX {host}:{port}")
+            client.subscribe(reply_topic, qos=1)
+        else:
+            print(f"❌ Connexion EMQX échouée (rc={rc})")
+
+    def on_message(client, userdata, msg):
+        nonlocal finished
+        try:
+            reply = json.loads(msg.payload)
+        except ValueError:
+            return
+        if reply.get("nonce") != nonce:
+            return
+        print(f"📩 {reply.get('status')}: {json.dumps(reply)}")
+        finished = reply.get("status") in ("completed", "failed", "rejected")
+
+    client = mqtt.Client(client_id=f"garage-v2-command-{int(time.time())}", clean_session=True)
+    if username:
+        client.username_pw_set(username, password)
+    client.on_connect = on_connect
+    client.on_message = on_message
+
+    try:
+        client.connect(host, port, keepalive=20)
+    except Exception as e:
+        print(f"❌ Échec de connexion à EMQX: {e}")
+        return 1
+
+    client.loop_start()
+    time.sleep(0.5)
+
+    print(f"🚀 {args.action} {args.gate} sur {command_topic}")
+    client.publish(command_topic, payload, qos=1).wait_for_publish()
+
+    deadline = time.time() + args.timeout
+    while time.time() < deadline and not finished:
+        time.sleep(0.1)
+    client.loop_stop()
+    client.disconnect()
+
+    if not finished:
+        print("⚠️ Pas de réponse finale reçue")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
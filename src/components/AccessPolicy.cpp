@@ -0,0 +1,217 @@
+#include "AccessPolicy.h"
+
+#include <string.h>
+
+namespace {
+    const int MAX_FIELDS = 4;
+    const uint8_t ACTION_OPEN = 1;
+    const uint8_t ACTION_CLOSE = 2;
+
+    bool equals(const char* text, size_t length, const char* word) {
+        return strlen(word) == length && strncmp(text, word, length) == 0;
+    }
+}
+
+AccessPolicy::AccessPolicy() : _roleCount(0), _ruleCount(0), _minute(-1) {
+    memset(_roleNames, 0, sizeof(_roleNames));
+    memset(_rules, 0, sizeof(_rules));
+    load(nullptr);
+}
+
+int AccessPolicy::load(const char* spec) {
+    memset(_roleNames, 0, sizeof(_roleNames));
+    strcpy(_roleNames[0], "*");
+    _roleCount = 1;
+    _ruleCount = 0;
+
+    int position = 0;
+    const char* entry = spec;
+    while (entry && *entry != '\0') {
+        const char* end = strchr(entry, ';');
+        size_t length = end ? static_cast<size_t>(end - entry) : strlen(entry);
+        if (length > 0) {
+            position++;
+            if (_ruleCount >= POLICY_MAX_RULES) {
+                Serial.println("[Policy][Warning] More than " + String(POLICY_MAX_RULES) + " rules, the rest is ignored");
+                break;
+            }
+            if (parseRule(entry, length, _rules[_ruleCount])) {
+                _ruleCount++;
+            } else {
+                Serial.println("[Policy][Warning] Malformed rule skipped (#" + String(position) + ")");
+            }
+        }
+        entry = end ? end + 1 : nullptr;
+    }
+    compile();
+    return _ruleCount;
+}
+
+bool AccessPolicy::parseRule(const char* entry, size_t length, Rule& rule) {
+    const char* fields[MAX_FIELDS];
+    size_t lengths[MAX_FIELDS];
+    int fieldCount = 0;
+    const char* start = entry;
+    for (size_t i = 0; i <= length; i++) {
+        if (i == length || entry[i] == ':') {
+            if (fieldCount == MAX_FIELDS) {
+                return false;
+            }
+            fields[fieldCount] = start;
+            lengths[fieldCount] = entry + i - start;
+            fieldCount++;
+            start = entry + i + 1;
+        }
+    }
+    if (fieldCount < 3 || lengths[0] == 0 || lengths[0] > POLICY_ROLE_NAME_MAX) {
+        return false;
+    }
+
+    rule.from = -1;
+    rule.until = -1;
+    if (!parseGates(fields[1], lengths[1], rule.gates) || !parseActions(fields[2], lengths[2], rule.actions) ||
+        (fieldCount == 4 && !parseWindow(fields[3], lengths[3], rule.from, rule.until))) {
+        return false;
+    }
+
+    // Interned last: a rejected rule doesn't use up a bit
+    int bit = internRole(fields[0], lengths[0]);
+    if (bit < 0) {
+        Serial.println("[Policy][Warning] More than " + String(MAX_ROLES) + " roles in the policy");
+        return false;
+    }
+    rule.roles = static_cast<uint32_t>(1) << bit;
+    return true;
+}
+
+int AccessPolicy::internRole(const char* name, size_t length) {
+    for (int bit = 0; bit < _roleCount; bit++) {
+        if (equals(name, length, _roleNames[bit])) {
+            return bit;
+        }
+    }
+    if (_roleCount == MAX_ROLES) {
+        return -1;
+    }
+    memcpy(_roleNames[_roleCount], name, length);
+    _roleNames[_roleCount][length] = '\0';
+    return _roleCount++;
+}
+
+uint32_t AccessPolicy::roleBit(const char* name) const {
+    // Bit 0 ("*") is never granted by a claim
+    for (int bit = 1; bit < _roleCount; bit++) {
+        if (strcmp(name, _roleNames[bit]) == 0) {
+            return static_cast<uint32_t>(1) << bit;
+        }
+    }
+    return 0;
+}
+
+void AccessPolicy::setTimeOfDay(int minute) {
+    if (minute != _minute) {
+        _minute = minute;
+        compile();
+    }
+}
+
+void AccessPolicy::compile() {
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        // Without rules, a valid token is enough
+        uint32_t open = _ruleCount == 0 ? ROLE_AUTHENTICATED : 0;
+        uint32_t close = open;
+        for (int i = 0; i < _ruleCount; i++) {
+            const Rule& rule = _rules[i];
+            if (!(rule.gates & (1 << gate))) {
+                continue;
+            }
+            if (rule.from >= 0) {
+                bool inWindow = rule.from < rule.until ? _minute >= rule.from && _minute < rule.until
+                                                       : _minute >= rule.from || _minute < rule.until;
+                if (_minute < 0 || !inWindow) {
+                    continue;
+                }
+            }
+            if (rule.actions & ACTION_OPEN) {
+                open |= rule.roles;
+            }
+            if (rule.actions & ACTION_CLOSE) {
+                close |= rule.roles;
+            }
+        }
+        _allowed[gate][0] = open;
+        _allowed[gate][1] = close;
+    }
+}
+
+bool AccessPolicy::parseGates(const char* text, size_t length, uint8_t& gates) {
+    gates = 0;
+    if (equals(text, length, "*")) {
+        gates = (1 << GATE_COUNT) - 1;
+        return true;
+    }
+    const char* end = text + length;
+    while (text < end) {
+        const char* comma = static_cast<const char*>(memchr(text, ',', end - text));
+        const char* itemEnd = comma ? comma : end;
+        int gate = 0;
+        while (gate < GATE_COUNT && !equals(text, itemEnd - text, GATES[gate].id)) {
+            gate++;
+        }
+        if (gate == GATE_COUNT) {
+            return false;
+        }
+        gates |= 1 << gate;
+        text = comma ? comma + 1 : end;
+    }
+    return gates != 0;
+}
+
+bool AccessPolicy::parseActions(const char* text, size_t length, uint8_t& actions) {
+    actions = 0;
+    const char* end = text + length;
+    while (text < end) {
+        const char* comma = static_cast<const char*>(memchr(text, ',', end - text));
+        const char* itemEnd = comma ? comma : end;
+        if (equals(text, itemEnd - text, "open")) {
+            actions |= ACTION_OPEN;
+        } else if (equals(text, itemEnd - text, "close")) {
+            actions |= ACTION_CLOSE;
+        } else if (equals(text, itemEnd - text, "*")) {
+            actions |= ACTION_OPEN | ACTION_CLOSE;
+        } else {
+            return false;
+        }
+        text = comma ? comma + 1 : end;
+    }
+    return actions != 0;
+}
+
+bool AccessPolicy::parseWindow(const char* text, size_t length, int16_t& from, int16_t& until) {
+    // HHMM-HHMM
+    if (length != 9 || text[4] != '-') {
+        return false;
+    }
+    int16_t minutes[2];
+    for (int part = 0; part < 2; part++) {
+        const char* digits = text + part * 5;
+        for (int i = 0; i < 4; i++) {
+            if (digits[i] < '0' || digits[i] > '9') {
+                return false;
+            }
+        }
+        int hours = (digits[0] - '0') * 10 + (digits[1] - '0');
+        int mins = (digits[2] - '0') * 10 + (digits[3] - '0');
+        // 2400 closes a window at midnight
+        if (mins > 59 || hours > 24 || (hours == 24 && (mins != 0 || part == 0))) {
+            return false;
+        }
+        minutes[part] = static_cast<int16_t>(hours * 60 + mins);
+    }
+    if (minutes[0] == minutes[1]) {
+        return false;
+    }
+    from = minutes[0];
+    until = minutes[1];
+    return true;
+}
@@ -0,0 +1,72 @@
+#ifndef ACCESS_POLICY_H
+#define ACCESS_POLICY_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Config.h"
+#include "GateTypes.h"
+
+// Who may open or close which gate, and when. Rules are compiled at boot:
+//   role:gates:actions[:HHMM-HHMM]   separated by ';'
+// role is a realm/client role or group name as it appears in the token ("*": any valid
+// token), gates a ','-separated list of GATES ids ("*": all), actions "open", "close" or
+// "*", and the optional window is local time (may wrap past midnight). Every role name
+// gets a bit: a token's claims are mapped once to a mask cached with its validation, and
+// each (gate, action) holds the mask of roles allowed right now, so a decision is one AND.
+// No policy: any valid token may do anything. Not thread-safe, the owner serializes calls.
+class AccessPolicy {
+public:
+    static const int MAX_ROLES = 32;
+    static const uint32_t ROLE_AUTHENTICATED = 1;   // Bit 0, set for every valid token
+
+    AccessPolicy();
+
+    // Replaces the rules, returns how many were compiled (malformed ones are skipped)
+    int load(const char* spec);
+
+    // Bit of a role/group claim, 0 when no rule names it
+    uint32_t roleBit(const char* name) const;
+
+    // Local minute of the day (0-1439), -1 when the clock is unknown: windowed rules don't apply
+    void setTimeOfDay(int minute);
+
+    bool allows(uint32_t roles, int gate, OperationState action) const {
+        return (roles & _allowed[gate][action == OPENING ? 0 : 1]) != 0;
+    }
+
+    bool isRestricted() const { return _ruleCount > 0; }
+    int ruleCount() const { return _ruleCount; }
+    int roleCount() const { return _roleCount; }
+    const char* roleName(int bit) const { return _roleNames[bit]; }
+
+private:
+    struct Rule {
+        uint32_t roles;
+        uint8_t gates;              // Bit per GATES index
+        uint8_t actions;            // Bit 0: open, bit 1: close
+        int16_t from;               // Minutes, -1: all day
+        int16_t until;              // Exclusive
+    };
+
+    char _roleNames[MAX_ROLES][POLICY_ROLE_NAME_MAX + 1];
+    int _roleCount;
+    Rule _rules[POLICY_MAX_RULES];
+    int _ruleCount;
+    uint32_t _allowed[GATE_COUNT][2];   // Per gate and action, for the current minute
+    int _minute;
+
+    bool parseRule(const char* entry, size_t length, Rule& rule);
+    int internRole(const char* name, size_t length);
+    void compile();
+    static bool parseGates(const char* text, size_t length, uint8_t& gates);
+    static bool parseActions(const char* text, size_t length, uint8_t& actions);
+    static bool parseWindow(const char* text, size_t length, int16_t& from, int16_t& until);
+};
+
+#endif // ACCESS_POLICY_H
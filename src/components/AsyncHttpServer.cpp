@@ -0,0 +1,973 @@
+#include "AsyncHttpServer.h"
+#include "JsonWriter.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#ifdef UNIT_TEST
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#else
+#include <lwip/sockets.h>
+#include "LoopScheduler.h"
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Stop parsing pipelined requests while this much output is waiting for the client
+static const size_t HTTP_OUTPUT_BACKLOG = HTTP_REQUEST_BUFFER_SIZE;
+
+// Event stream subscriber that fell this far behind is dropped
+static const size_t HTTP_STREAM_BACKLOG = 2 * HTTP_REQUEST_BUFFER_SIZE;
+
+static bool sliceEquals(const char* data, size_t length, const char* text) {
+    return strlen(text) == length && strncasecmp(data, text, length) == 0;
+}
+
+static bool sliceContains(const char* data, size_t length, const char* token) {
+    size_t tokenLength = strlen(token);
+    for (size_t i = 0; i + tokenLength <= length; i++) {
+        if (strncasecmp(data + i, token, tokenLength) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void trim(const char*& data, size_t& length) {
+    while (length > 0 && (*data == ' ' || *data == '\t')) {
+        data++;
+        length--;
+    }
+    while (length > 0 && (data[length - 1] == ' ' || data[length - 1] == '\t')) {
+        length--;
+    }
+}
+
+AsyncHttpServer::AsyncHttpServer(uint16_t port)
+    : _port(port), _listenFd(-1), _routeCount(0), _collectedCount(0), _stats(),
+      _current(nullptr), _pathArgCount(0), _responded(false), _wakeFd(-1) {
+    _collected[_collectedCount++] = "Authorization"; // Always needed by the auth middleware
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        _connections[i].fd = -1;
+        _connections[i].generation = 0;
+        _connections[i].inputLength = 0;
+        _connections[i].outputSent = 0;
+        _connections[i].deferred = false;
+        _connections[i].pendingInput = false;
+        _connections[i].streaming = false;
+    }
+    for (int i = 0; i <= HTTP_MAX_CONNECTIONS; i++) {
+        _watchRead[i] = -1;
+    }
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        _watchWrite[i] = -1;
+    }
+#ifndef UNIT_TEST
+    _scheduler = nullptr;
+    _watcher = nullptr;
+#endif
+}
+
+AsyncHttpServer::~AsyncHttpServer() {
+#ifndef UNIT_TEST
+    if (_watcher) {
+        vTaskDelete(_watcher);
+    }
+#endif
+    stop();
+}
+
+bool AsyncHttpServer::begin() {
+    _listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (_listenFd < 0) {
+        Serial.println("[HTTP][Error] socket() failed: " + String(errno));
+        return false;
+    }
+
+    int enable = 1;
+    setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(_port);
+    if (bind(_listenFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(_listenFd, HTTP_MAX_CONNECTIONS) < 0) {
+        Serial.println("[HTTP][Error] Cannot listen on port " + String(static_cast<int>(_port)) + ": " + String(errno));
+        ::close(_listenFd);
+        _listenFd = -1;
+        return false;
+    }
+    fcntl(_listenFd, F_SETFL, fcntl(_listenFd, F_GETFL, 0) | O_NONBLOCK);
+
+    // Port 0: report the one picked by the stack
+    socklen_t length = sizeof(address);
+    if (getsockname(_listenFd, reinterpret_cast<struct sockaddr*>(&address), &length) == 0) {
+        _port = ntohs(address.sin_port);
+    }
+
+    if (!openWakeSocket()) {
+        // Still works: the watcher then picks up new sets within HTTP_WATCH_INTERVAL
+        Serial.println("[HTTP][Warning] No wake-up socket: " + String(errno));
+    }
+    publishWatchSet();
+    return true;
+}
+
+bool AsyncHttpServer::openWakeSocket() {
+    _wakeFd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (_wakeFd < 0) {
+        return false;
+    }
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+    socklen_t length = sizeof(address);
+    if (bind(_wakeFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 ||
+        getsockname(_wakeFd, reinterpret_cast<struct sockaddr*>(&address), &length) < 0 ||
+        connect(_wakeFd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(_wakeFd);
+        _wakeFd = -1;
+        return false;
+    }
+    fcntl(_wakeFd, F_SETFL, fcntl(_wakeFd, F_GETFL, 0) | O_NONBLOCK);
+    return true;
+}
+
+void AsyncHttpServer::stop() {
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (_connections[i].fd >= 0) {
+            close(_connections[i]);
+        }
+    }
+    if (_listenFd >= 0) {
+        ::close(_listenFd);
+        _listenFd = -1;
+    }
+    publishWatchSet();
+    if (_wakeFd >= 0) {
+        ::close(_wakeFd);
+        _wakeFd = -1;
+    }
+}
+
+void AsyncHttpServer::on(const char* pattern, Handler handler) {
+    if (_routeCount >= HTTP_MAX_ROUTES) {
+        Serial.println("[HTTP][Error] Route table full, " + String(pattern) + " ignored");
+        return;
+    }
+    _routes[_routeCount].pattern = pattern;
+    _routes[_routeCount].handler = handler;
+    _routeCount++;
+}
+
+void AsyncHttpServer::collectHeaders(const char* const names[], size_t count) {
+    for (size_t i = 0; i < count && _collectedCount < HTTP_MAX_COLLECTED_HEADERS; i++) {
+        _collected[_collectedCount++] = names[i];
+    }
+}
+
+void AsyncHttpServer::poll(unsigned long timeoutMs) {
+    fd_set readSet;
+    fd_set writeSet;
+    FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
+    int maxFd = -1;
+
+    if (_listenFd >= 0) {
+        FD_SET(_listenFd, &readSet);
+        maxFd = _listenFd;
+    }
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        const Connection& connection = _connections[i];
+        if (wantsRead(connection)) {
+            FD_SET(connection.fd, &readSet);
+        }
+        if (wantsWrite(connection)) {
+            FD_SET(connection.fd, &writeSet);
+        }
+        if (connection.fd > maxFd) {
+            maxFd = connection.fd;
+        }
+    }
+
+    int ready = 0;
+    if (maxFd >= 0) {
+        struct timeval timeout;
+        timeout.tv_sec = timeoutMs / 1000;
+        timeout.tv_usec = (timeoutMs % 1000) * 1000;
+        ready = select(maxFd + 1, &readSet, &writeSet, nullptr, &timeout);
+    }
+
+    unsigned long now = millis();
+    if (ready > 0 && _listenFd >= 0 && FD_ISSET(_listenFd, &readSet)) {
+        acceptClients(now);
+    }
+
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        Connection& connection = _connections[i];
+        if (connection.fd < 0) {
+            continue;
+        }
+        // Connections accepted above are not in the sets yet
+        if (ready > 0 && FD_ISSET(connection.fd, &writeSet)) {
+            flush(connection);
+        }
+        if (connection.fd >= 0 && ready > 0 && FD_ISSET(connection.fd, &readSet)) {
+            receive(connection, now);
+        }
+        if (connection.fd >= 0) {
+            process(connection, now);
+        }
+        if (connection.fd >= 0) {
+            expire(connection, now);
+        }
+    }
+
+    publishWatchSet();
+}
+
+unsigned long AsyncHttpServer::getNextDeadline(unsigned long now) const {
+    unsigned long next = ULONG_MAX;
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        const Connection& connection = _connections[i];
+        if (connection.fd < 0 || connection.streaming) {
+            continue; // Streams are kept alive by their own heartbeats
+        }
+
+        // Buffered requests released by sendDeferred(): no socket event will announce them
+        if (connection.pendingInput && !connection.deferred && !wantsWrite(connection)) {
+            return 0;
+        }
+
+        unsigned long since = connection.deferred ? connection.deferredAt : connection.lastActivity;
+        unsigned long timeout = connection.deferred ? HTTP_DEFERRED_TIMEOUT : HTTP_KEEPALIVE_TIMEOUT;
+        if (!connection.deferred && wantsWrite(connection)) {
+            since = connection.lastProgress;
+            timeout = HTTP_WRITE_STALL_TIMEOUT;
+        }
+        unsigned long elapsed = now - since;
+        unsigned long remaining = elapsed >= timeout ? 0 : timeout - elapsed;
+        if (remaining < next) {
+            next = remaining;
+        }
+    }
+    return next;
+}
+
+bool AsyncHttpServer::hasArg(const char* name) const {
+    Slice value;
+    return findArg(name, value);
+}
+
+String AsyncHttpServer::arg(const char* name) const {
+    Slice value;
+    if (!findArg(name, value)) {
+        return "";
+    }
+    return decode(value);
+}
+
+String AsyncHttpServer::pathArg(unsigned int index) const {
+    if (!_current || index >= static_cast<unsigned int>(_pathArgCount)) {
+        return "";
+    }
+    return decode(_pathArgs[index]);
+}
+
+bool AsyncHttpServer::hasHeader(const char* name) const {
+    Slice value;
+    return findHeader(name, value);
+}
+
+String AsyncHttpServer::header(const char* name) const {
+    Slice value;
+    if (!findHeader(name, value)) {
+        return "";
+    }
+    return String(value.data, value.length);
+}
+
+bool AsyncHttpServer::header(const char* name, const char*& value, size_t& length) const {
+    Slice slice;
+    if (!findHeader(name, slice)) {
+        return false;
+    }
+    value = slice.data;
+    length = slice.length;
+    return true;
+}
+
+String AsyncHttpServer::clientIP() const {
+    if (!_current) {
+        return "";
+    }
+    // s_addr is in network byte order: the bytes are already in dotted order
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&_current->remoteAddress);
+    char text[16];
+    snprintf(text, sizeof(text), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+    return text;
+}
+
+void AsyncHttpServer::sendHeader(const char* name, const char* value) {
+    _responseHeaders += name;
+    _responseHeaders += ": ";
+    _responseHeaders += value;
+    _responseHeaders += "\r\n";
+}
+
+void AsyncHttpServer::send(int code, const char* contentType, const char* body, size_t length) {
+    if (!_current || _responded || _current->deferred) {
+        return;
+    }
+    bool keepAlive = _request.keepAlive && _current->requests < HTTP_KEEPALIVE_MAX_REQUESTS;
+    queueResponse(*_current, code, contentType, body, length, _responseHeaders.c_str(), keepAlive);
+    _responseHeaders = "";
+    _responded = true;
+}
+
+HttpResponseHandle AsyncHttpServer::deferResponse() {
+    if (!_current || _responded) {
+        return 0;
+    }
+    Connection& connection = *_current;
+    connection.deferred = true;
+    connection.deferredAt = millis();
+    connection.deferredKeepAlive = _request.keepAlive && connection.requests < HTTP_KEEPALIVE_MAX_REQUESTS;
+    _responded = true;
+    return handleFor(connection);
+}
+
+bool AsyncHttpServer::sendDeferred(HttpResponseHandle handle, int code, const char* contentType, const char* body,
+                                   size_t length, const char* extraHeaders) {
+    Connection* target = connectionFor(handle);
+    if (!target || !target->deferred) {
+        return false; // Client gone, or already answered with a 504
+    }
+
+    Connection& connection = *target;
+    connection.deferred = false;
+    queueResponse(connection, code, contentType, body, length, extraHeaders, connection.deferredKeepAlive);
+
+    // Requests pipelined behind this one are dispatched by the next poll(); new ones are
+    // announced by the watcher, which must be reading this connection again
+    connection.pendingInput = connection.inputLength > 0;
+    publishWatchSet();
+    return true;
+}
+
+HttpResponseHandle AsyncHttpServer::beginStream(const char* contentType) {
+    if (!_current || _responded) {
+        return 0;
+    }
+    Connection& connection = *_current;
+    String& output = connection.output;
+    output += "HTTP/1.1 200 OK\r\nContent-Type: ";
+    output += contentType;
+    output += "\r\nCache-Control: no-cache\r\n";
+    output += _responseHeaders;
+    output += "\r\n";
+    _responseHeaders = "";
+    _responded = true;
+
+    // No Content-Length: the body ends when the connection does
+    connection.streaming = true;
+    _stats.streams++;
+    flush(connection);
+    return connection.fd >= 0 ? handleFor(connection) : 0;
+}
+
+bool AsyncHttpServer::sendStream(HttpResponseHandle handle, const char* data, size_t length) {
+    Connection* connection = connectionFor(handle);
+    if (!connection || !connection->streaming) {
+        return false;
+    }
+    if (connection->output.length() - connection->outputSent + length > HTTP_STREAM_BACKLOG) {
+        Serial.println("[HTTP][Warning] Event stream client not reading, dropped");
+        close(*connection);
+        return false;
+    }
+    connection->output.concat(data, length);
+    flush(*connection);
+    publishWatchSet();
+    return connection->fd >= 0;
+}
+
+bool AsyncHttpServer::isStreamOpen(HttpResponseHandle handle) const {
+    const Connection* connection = const_cast<AsyncHttpServer*>(this)->connectionFor(handle);
+    return connection && connection->streaming;
+}
+
+int AsyncHttpServer::activeConnections() const {
+    int count = 0;
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        if (_connections[i].fd >= 0) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void AsyncHttpServer::acceptClients(unsigned long now) {
+    for (;;) {
+        struct sockaddr_in address;
+        socklen_t length = sizeof(address);
+        int fd = accept(_listenFd, reinterpret_cast<struct sockaddr*>(&address), &length);
+        if (fd < 0) {
+            return;
+        }
+
+        Connection* connection = nullptr;
+        for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            if (_connections[i].fd < 0) {
+                connection = &_connections[i];
+                break;
+            }
+        }
+
+        if (!connection) {
+            // Leaving it in the backlog would keep the listening socket readable
+            static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 1\r\n"
+                                       "Content-Length: 0\r\nConnection: close\r\n\r\n";
+            ::send(fd, busy, sizeof(busy) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+            ::close(fd);
+            _stats.rejected++;
+            continue;
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable)); // Small responses, no Nagle delay
+
+        connection->fd = fd;
+        connection->remoteAddress = address.sin_addr.s_addr;
+        connection->inputLength = 0;
+        connection->output = "";
+        connection->outputSent = 0;
+        connection->lastActivity = now;
+        connection->lastProgress = now;
+        connection->requests = 0;
+        connection->deferred = false;
+        connection->closeAfterWrite = false;
+        connection->readSinceDispatch = false;
+        connection->pendingInput = false;
+        connection->streaming = false;
+        _stats.accepted++;
+    }
+}
+
+void AsyncHttpServer::receive(Connection& connection, unsigned long now) {
+    size_t space = sizeof(connection.input) - connection.inputLength;
+    if (space == 0) {
+        return;
+    }
+    ssize_t received = recv(connection.fd, connection.input + connection.inputLength, space, MSG_DONTWAIT);
+    if (received > 0) {
+        connection.inputLength += received;
+        connection.lastActivity = now;
+        connection.readSinceDispatch = true;
+        if (connection.streaming) {
+            connection.inputLength = 0; // Nothing is expected from a stream client, only its close
+        }
+    } else if (received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        close(connection); // Peer closed (or reset) the connection
+    }
+}
+
+void AsyncHttpServer::process(Connection& connection, unsigned long now) {
+    connection.pendingInput = false;
+    while (connection.fd >= 0 && !connection.deferred && !connection.closeAfterWrite && !connection.streaming &&
+           connection.inputLength > 0) {
+        if (connection.output.length() - connection.outputSent > HTTP_OUTPUT_BACKLOG) {
+            connection.pendingInput = true; // Resumed once the client reads its responses
+            return;
+        }
+
+        Request request;
+        ParseResult result = parse(connection, request);
+        if (result == PARSE_INCOMPLETE) {
+            return;
+        }
+        if (result != PARSE_OK) {
+            int code = result == PARSE_TOO_LARGE ? 431 : (result == PARSE_UNSUPPORTED ? 501 : 400);
+            sendError(connection, code, reasonPhrase(code));
+            return;
+        }
+
+        _request = request;
+        dispatch(connection);
+        connection.lastActivity = now;
+        if (connection.fd < 0 || connection.closeAfterWrite) {
+            return; // Last response on this connection, the rest of the input was dropped
+        }
+        if (connection.streaming) {
+            connection.inputLength = 0; // The request became an event stream
+            return;
+        }
+
+        // Drop the request, the next pipelined one (if any) moves to the front
+        size_t remaining = connection.inputLength - request.size;
+        memmove(connection.input, connection.input + request.size, remaining);
+        connection.inputLength = remaining;
+    }
+}
+
+void AsyncHttpServer::dispatch(Connection& connection) {
+    _stats.requests++;
+    if (connection.requests > 0) {
+        _stats.reused++;
+        if (!connection.readSinceDispatch) {
+            _stats.pipelined++;
+        }
+    }
+    connection.requests++;
+    connection.readSinceDispatch = false;
+
+    _current = &connection;
+    _responseHeaders = "";
+    _responded = false;
+
+    bool routed = false;
+    for (int i = 0; i < _routeCount && !routed; i++) {
+        if (matchRoute(_routes[i].pattern, _request.path)) {
+            _routes[i].handler();
+            routed = true;
+        }
+    }
+
+    if (!routed) {
+        send(404, "application/json", "{\"error\":\"Not found\"}");
+    } else if (!_responded) {
+        _stats.errors++;
+        send(500, "application/json", "{\"error\":\"No response\"}");
+    }
+    _current = nullptr;
+}
+
+void AsyncHttpServer::flush(Connection& connection) {
+    while (connection.outputSent < connection.output.length()) {
+        ssize_t sent = ::send(connection.fd, connection.output.c_str() + connection.outputSent,
+                              connection.output.length() - connection.outputSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection.outputSent += sent;
+            connection.lastProgress = millis();
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return; // Socket buffer full: the rest goes out when select() reports it writable
+        } else {
+            close(connection);
+            return;
+        }
+    }
+
+    connection.output = "";
+    connection.outputSent = 0;
+    if (connection.closeAfterWrite) {
+        close(connection);
+    }
+}
+
+void AsyncHttpServer::close(Connection& connection) {
+    ::close(connection.fd);
+    connection.fd = -1;
+    connection.generation++;
+    connection.inputLength = 0;
+    connection.output = "";
+    connection.outputSent = 0;
+    connection.deferred = false;
+    connection.pendingInput = false;
+    connection.streaming = false;
+}
+
+void AsyncHttpServer::expire(Connection& connection, unsigned long now) {
+    if (connection.streaming) {
+        return;
+    }
+    if (connection.deferred) {
+        if (now - connection.deferredAt >= HTTP_DEFERRED_TIMEOUT) {
+            connection.deferred = false;
+            sendError(connection, 504, "Gateway Timeout");
+        }
+        return;
+    }
+    // A client that stopped reading (zero window) would keep its slot forever
+    if (wantsWrite(connection)) {
+        if (now - connection.lastProgress >= HTTP_WRITE_STALL_TIMEOUT) {
+            _stats.stalled++;
+            close(connection);
+        }
+        return;
+    }
+    // Idle keep-alive connection, or a client that never finished its request
+    if (now - connection.lastActivity >= HTTP_KEEPALIVE_TIMEOUT) {
+        close(connection);
+    }
+}
+
+void AsyncHttpServer::queueResponse(Connection& connection, int code, const char* contentType, const char* body,
+                                    size_t length, const char* extraHeaders, bool keepAlive) {
+    // Formatted in place: the output buffer keeps its capacity, no temporary String
+    char line[48];
+    String& output = connection.output;
+    if (output.length() == 0) {
+        connection.lastProgress = millis(); // Stall timer starts with the first pending response
+    }
+    output.reserve(output.length() + 128 + strlen(extraHeaders) + length);
+    snprintf(line, sizeof(line), "HTTP/1.1 %d ", code);
+    output += line;
+    output += reasonPhrase(code);
+    output += "\r\n";
+    if (contentType) {
+        output += "Content-Type: ";
+        output += contentType;
+        output += "\r\n";
+    }
+    // A 304 has no body, and no Content-Length that a cache could take for the 200's
+    if (code != 304) {
+        snprintf(line, sizeof(line), "Content-Length: %lu\r\n", static_cast<unsigned long>(length));
+        output += line;
+    }
+    output += keepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    output += extraHeaders;
+    output += "\r\n";
+    output.concat(body, length);
+
+    if (!keepAlive) {
+        connection.closeAfterWrite = true;
+        connection.inputLength = 0; // Anything pipelined after this request is dropped
+    }
+    flush(connection);
+}
+
+void AsyncHttpServer::sendError(Connection& connection, int code, const char* message) {
+    _stats.errors++;
+    char buffer[96];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject().field("error", message).endObject();
+    queueResponse(connection, code, "application/json", json.c_str(), json.length(), "", false);
+}
+
+HttpResponseHandle AsyncHttpServer::handleFor(const Connection& connection) const {
+    int index = &connection - _connections;
+    return (static_cast<uint32_t>(connection.generation) << 8) | static_cast<uint32_t>(index + 1);
+}
+
+AsyncHttpServer::Connection* AsyncHttpServer::connectionFor(HttpResponseHandle handle) {
+    int index = static_cast<int>(handle & 0xFF) - 1;
+    if (index < 0 || index >= HTTP_MAX_CONNECTIONS) {
+        return nullptr;
+    }
+    Connection& connection = _connections[index];
+    if (connection.fd < 0 || connection.generation != ((handle >> 8) & 0xFF)) {
+        return nullptr;
+    }
+    return &connection;
+}
+
+bool AsyncHttpServer::wantsRead(const Connection& connection) const {
+    return connection.fd >= 0 && !connection.deferred && !connection.closeAfterWrite &&
+           connection.inputLength < sizeof(connection.input) &&
+           connection.output.length() - connection.outputSent <= HTTP_OUTPUT_BACKLOG;
+}
+
+AsyncHttpServer::ParseResult AsyncHttpServer::parse(Connection& connection, Request& request) {
+    const char* input = connection.input;
+    const size_t length = connection.inputLength;
+
+    // Headers end with an empty line
+    size_t headerEnd = 0;
+    for (size_t i = 3; i < length; i++) {
+        if (input[i] == '\n' && input[i - 1] == '\r' && input[i - 2] == '\n' && input[i - 3] == '\r') {
+            headerEnd = i + 1;
+            break;
+        }
+    }
+    if (headerEnd == 0) {
+        return length >= sizeof(connection.input) ? PARSE_TOO_LARGE : PARSE_INCOMPLETE;
+    }
+
+    // Request line: METHOD SP target SP HTTP/1.x
+    const char* lineEnd = static_cast<const char*>(memchr(input, '\r', headerEnd));
+    const char* methodEnd = static_cast<const char*>(memchr(input, ' ', lineEnd - input));
+    if (!methodEnd || methodEnd == input) {
+        return PARSE_BAD_REQUEST;
+    }
+    const char* target = methodEnd + 1;
+    const char* targetEnd = static_cast<const char*>(memchr(target, ' ', lineEnd - target));
+    if (!targetEnd || targetEnd == target || *target != '/') {
+        return PARSE_BAD_REQUEST;
+    }
+    const char* version = targetEnd + 1;
+    size_t versionLength = lineEnd - version;
+    if (versionLength != 8 || strncmp(version, "HTTP/1.", 7) != 0) {
+        return PARSE_BAD_REQUEST;
+    }
+
+    const char* queryStart = static_cast<const char*>(memchr(target, '?', targetEnd - target));
+    request.path.data = target;
+    request.path.length = (queryStart ? queryStart : targetEnd) - target;
+    request.query.data = queryStart ? queryStart + 1 : targetEnd;
+    request.query.length = queryStart ? targetEnd - queryStart - 1 : 0;
+    request.keepAlive = version[7] == '1'; // HTTP/1.1 defaults to keep-alive, 1.0 to close
+    request.contentLength = 0;
+    request.headerCount = 0;
+
+    // Header lines: only the collected ones and the framing headers are looked at
+    const char* line = lineEnd + 2;
+    const char* headersEnd = input + headerEnd - 2;
+    while (line < headersEnd) {
+        const char* end = static_cast<const char*>(memchr(line, '\r', headersEnd - line));
+        if (!end) {
+            return PARSE_BAD_REQUEST;
+        }
+        const char* colon = static_cast<const char*>(memchr(line, ':', end - line));
+        if (!colon || colon == line) {
+            return PARSE_BAD_REQUEST;
+        }
+        size_t nameLength = colon - line;
+        const char* value = colon + 1;
+        size_t valueLength = end - value;
+        trim(value, valueLength);
+
+        if (sliceEquals(line, nameLength, "Content-Length")) {
+            request.contentLength = strtoul(value, nullptr, 10);
+        } else if (sliceEquals(line, nameLength, "Transfer-Encoding")) {
+            return PARSE_UNSUPPORTED; // No chunked request bodies on this API
+        } else if (sliceEquals(line, nameLength, "Connection")) {
+            if (sliceContains(value, valueLength, "close")) {
+                request.keepAlive = false;
+            } else if (sliceContains(value, valueLength, "keep-alive")) {
+                request.keepAlive = true;
+            }
+        }
+
+        for (int i = 0; i < _collectedCount && request.headerCount < HTTP_MAX_COLLECTED_HEADERS; i++) {
+            if (sliceEquals(line, nameLength, _collected[i])) {
+                request.headerNames[request.headerCount] = {line, nameLength};
+                request.headerValues[request.headerCount] = {value, valueLength};
+                request.headerCount++;
+                break;
+            }
+        }
+        line = end + 2;
+    }
+
+    // The body is skipped, but it must be complete to find the next request
+    if (request.contentLength > sizeof(connection.input) - headerEnd) {
+        return PARSE_TOO_LARGE;
+    }
+    if (length < headerEnd + request.contentLength) {
+        return PARSE_INCOMPLETE;
+    }
+    request.size = headerEnd + request.contentLength;
+    return PARSE_OK;
+}
+
+bool AsyncHttpServer::matchRoute(const char* pattern, const Slice& path) {
+    _pathArgCount = 0;
+    size_t position = 0;
+    while (*pattern) {
+        if (pattern[0] == '{' && pattern[1] == '}') {
+            size_t start = position;
+            while (position < path.length && path.data[position] != '/') {
+                position++;
+            }
+            if (position == start || _pathArgCount >= 2) {
+                return false;
+            }
+            _pathArgs[_pathArgCount++] = {path.data + start, position - start};
+            pattern += 2;
+        } else {
+            if (position >= path.length || path.data[position] != *pattern) {
+                return false;
+            }
+            position++;
+            pattern++;
+        }
+    }
+    return position == path.length;
+}
+
+bool AsyncHttpServer::findHeader(const char* name, Slice& value) const {
+    if (!_current) {
+        return false;
+    }
+    for (int i = 0; i < _request.headerCount; i++) {
+        if (sliceEquals(_request.headerNames[i].data, _request.headerNames[i].length, name)) {
+            value = _request.headerValues[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool AsyncHttpServer::findArg(const char* name, Slice& value) const {
+    if (!_current) {
+        return false;
+    }
+    size_t nameLength = strlen(name);
+    const char* query = _request.query.data;
+    const char* queryEnd = query + _request.query.length;
+    while (query < queryEnd) {
+        const char* pairEnd = static_cast<const char*>(memchr(query, '&', queryEnd - query));
+        if (!pairEnd) {
+            pairEnd = queryEnd;
+        }
+        const char* equals = static_cast<const char*>(memchr(query, '=', pairEnd - query));
+        const char* keyEnd = equals ? equals : pairEnd;
+        if (static_cast<size_t>(keyEnd - query) == nameLength && strncmp(query, name, nameLength) == 0) {
+            value.data = equals ? equals + 1 : pairEnd;
+            value.length = equals ? pairEnd - equals - 1 : 0;
+            return true;
+        }
+        query = pairEnd + 1;
+    }
+    return false;
+}
+
+String AsyncHttpServer::decode(const Slice& slice) {
+    String result;
+    result.reserve(slice.length);
+    for (size_t i = 0; i < slice.length; i++) {
+        char c = slice.data[i];
+        if (c == '+') {
+            c = ' ';
+        } else if (c == '%' && i + 2 < slice.length) {
+            char hex[3] = {slice.data[i + 1], slice.data[i + 2], '\0'};
+            char* end;
+            long decoded = strtol(hex, &end, 16);
+            if (end == hex + 2) {
+                c = static_cast<char>(decoded);
+                i += 2;
+            }
+        }
+        result += c;
+    }
+    return result;
+}
+
+const char* AsyncHttpServer::reasonPhrase(int code) {
+    switch (code) {
+        case 200: return "OK";
+        case 202: return "Accepted";
+        case 304: return "Not Modified";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+    }
+    return "Unknown";
+}
+
+#ifndef UNIT_TEST
+void AsyncHttpServer::attachScheduler(LoopScheduler* scheduler) {
+    _scheduler = scheduler;
+    if (!_watcher) {
+        xTaskCreatePinnedToCore(watcherTaskEntry, "http_watch", 3072, this, NETWORK_TASK_PRIORITY, &_watcher,
+                                NETWORK_TASK_CORE);
+    }
+}
+
+void AsyncHttpServer::watcherTaskEntry(void* arg) {
+    AsyncHttpServer* server = static_cast<AsyncHttpServer*>(arg);
+    for (;;) {
+        int ready = server->waitForActivity(HTTP_WATCH_INTERVAL);
+        if (ready == 0) {
+            continue;
+        }
+        if (ready < 0) {
+            // A descriptor was closed under us (take the new set), or nothing is listening
+            vTaskDelay(server->_listenFd >= 0 ? 1 : pdMS_TO_TICKS(HTTP_WATCH_INTERVAL));
+            continue;
+        }
+
+        // The network task does the I/O; wait until it has, or select() would fire again
+        ulTaskNotifyTake(pdTRUE, 0);
+        if (server->_scheduler) {
+            server->_scheduler->wake();
+        }
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HTTP_WATCH_INTERVAL));
+    }
+}
+#endif
+
+void AsyncHttpServer::publishWatchSet() {
+    bool changed = _watchRead[HTTP_MAX_CONNECTIONS].exchange(_listenFd) != _listenFd;
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        const int readFd = wantsRead(_connections[i]) ? _connections[i].fd : -1;
+        const int writeFd = wantsWrite(_connections[i]) ? _connections[i].fd : -1;
+        changed |= _watchRead[i].exchange(readFd) != readFd;
+        changed |= _watchWrite[i].exchange(writeFd) != writeFd;
+    }
+    // Only on change: poll() publishes after every pass, the watcher would wake itself
+    if (changed && _wakeFd >= 0) {
+        ::send(_wakeFd, "w", 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+#ifndef UNIT_TEST
+    if (_watcher) {
+        xTaskNotifyGive(_watcher);
+    }
+#endif
+}
+
+int AsyncHttpServer::waitForActivity(unsigned long timeoutMs) {
+    fd_set readSet;
+    fd_set writeSet;
+    FD_ZERO(&readSet);
+    FD_ZERO(&writeSet);
+    int maxFd = -1;
+    for (int i = 0; i <= HTTP_MAX_CONNECTIONS; i++) {
+        int fd = _watchRead[i];
+        if (fd >= 0) {
+            FD_SET(fd, &readSet);
+            maxFd = fd > maxFd ? fd : maxFd;
+        }
+    }
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        int fd = _watchWrite[i];
+        if (fd >= 0) {
+            FD_SET(fd, &writeSet);
+            maxFd = fd > maxFd ? fd : maxFd;
+        }
+    }
+    if (maxFd < 0) {
+        return -1;
+    }
+    const int wakeFd = _wakeFd;
+    if (wakeFd >= 0) {
+        FD_SET(wakeFd, &readSet);
+        maxFd = wakeFd > maxFd ? wakeFd : maxFd;
+    }
+
+    // Bounded wait: without a wake-up socket, new sets are only seen when it runs out
+    struct timeval timeout;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
+    int ready = select(maxFd + 1, &readSet, &writeSet, nullptr, &timeout);
+    if (ready > 0 && wakeFd >= 0 && FD_ISSET(wakeFd, &readSet)) {
+        char drain[8];
+        while (recv(wakeFd, drain, sizeof(drain), MSG_DONTWAIT) > 0) {
+        }
+        ready--;   // The set changed: 0 unless a watched descriptor fired too
+    }
+    return ready;
+}
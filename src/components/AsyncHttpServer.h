@@ -0,0 +1,212 @@
+#ifndef ASYNC_HTTP_SERVER_H
+#define ASYNC_HTTP_SERVER_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+#include <atomic>
+#include <functional>
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "Config.h"
+
+#ifndef UNIT_TEST
+class LoopScheduler;
+#endif
+
+// Response parked with deferResponse(), 0 when there is none. Becomes stale when the
+// connection is closed, sendDeferred() then returns false.
+typedef uint32_t HttpResponseHandle;
+
+// Event-driven HTTP/1.1 server on non-blocking BSD sockets (lwIP on the ESP32, POSIX on
+// Linux for the native tests). Several connections are served from one task, with
+// keep-alive and pipelined requests. Requests are parsed in place in a fixed buffer per
+// connection; only the collected headers are kept, as views into that buffer.
+//
+// The request accessors (arg, header, pathArg, send...) follow the Arduino WebServer and
+// are only valid inside a route handler.
+class AsyncHttpServer {
+public:
+    typedef std::function<void()> Handler;
+
+    struct Stats {
+        uint32_t accepted;        // Connections accepted
+        uint32_t rejected;        // Connections refused with 503 (all slots busy)
+        uint32_t requests;
+        uint32_t reused;          // Requests served on an already used connection
+        uint32_t pipelined;       // Requests found behind another one in the same read
+        uint32_t errors;          // 4xx/5xx produced by the server itself (parse errors, timeouts)
+        uint32_t streams;         // Responses turned into event streams
+        uint32_t stalled;         // Connections closed because the client stopped reading
+    };
+
+    explicit AsyncHttpServer(uint16_t port);
+    ~AsyncHttpServer();
+
+    // Listen on the port given to the constructor (0 picks a free port, see port())
+    bool begin();
+    void stop();
+    uint16_t port() const { return _port; }
+
+    // "{}" matches one path segment, read back with pathArg()
+    void on(const char* pattern, Handler handler);
+    void collectHeaders(const char* const names[], size_t count);
+
+    // Accept, read, dispatch and write whatever is ready, waiting at most timeoutMs
+    void poll(unsigned long timeoutMs = 0);
+
+    // ms before poll() must run for keep-alive/deferred timeouts, ULONG_MAX when none
+    unsigned long getNextDeadline(unsigned long now) const;
+
+#ifndef UNIT_TEST
+    // Socket readiness wakes this scheduler (the task calling poll())
+    void attachScheduler(LoopScheduler* scheduler);
+#endif
+
+    // Watcher side (any task): blocks until a descriptor poll() would act on is ready.
+    // > 0 ready, 0 timeout or the set changed (call again), < 0 nothing to watch or select() error.
+    int waitForActivity(unsigned long timeoutMs);
+
+    // Current request
+    bool hasArg(const char* name) const;
+    String arg(const char* name) const;
+    String pathArg(unsigned int index) const;
+    bool hasHeader(const char* name) const;
+    String header(const char* name) const;
+    bool header(const char* name, const char*& value, size_t& length) const;  // View into the request, no copy
+    String clientIP() const;
+
+    // Current response. The body is copied into the connection's output buffer, whose
+    // capacity is kept between responses: a body built in a fixed buffer costs no allocation.
+    void sendHeader(const char* name, const char* value);
+    void sendHeader(const String& name, const String& value) { sendHeader(name.c_str(), value.c_str()); }
+    void send(int code, const char* contentType, const char* body, size_t length);
+    void send(int code, const char* contentType, const char* body) { send(code, contentType, body, strlen(body)); }
+    void send(int code, const char* contentType, const String& body) { send(code, contentType, body.c_str(), body.length()); }
+
+    // Answer later (from the same task): the connection holds its next pipelined requests.
+    // extraHeaders are complete "Name: value\r\n" lines.
+    HttpResponseHandle deferResponse();
+    bool sendDeferred(HttpResponseHandle handle, int code, const char* contentType, const char* body, size_t length,
+                      const char* extraHeaders = "");
+    bool sendDeferred(HttpResponseHandle handle, int code, const char* contentType, const String& body) {
+        return sendDeferred(handle, code, contentType, body.c_str(), body.length());
+    }
+
+    // Open-ended 200 response (text/event-stream): the body is written with sendStream()
+    // until the client goes away. A client that stops reading is dropped.
+    HttpResponseHandle beginStream(const char* contentType);
+    bool sendStream(HttpResponseHandle handle, const char* data, size_t length);
+    bool sendStream(HttpResponseHandle handle, const String& data) { return sendStream(handle, data.c_str(), data.length()); }
+    bool isStreamOpen(HttpResponseHandle handle) const;
+
+    int activeConnections() const;
+    const Stats& getStats() const { return _stats; }
+
+private:
+    struct Slice {
+        const char* data;
+        size_t length;
+    };
+
+    struct Request {
+        Slice path;
+        Slice query;
+        Slice headerNames[HTTP_MAX_COLLECTED_HEADERS];
+        Slice headerValues[HTTP_MAX_COLLECTED_HEADERS];
+        int headerCount;
+        size_t contentLength;
+        bool keepAlive;
+        size_t size;              // Request line + headers + body
+    };
+
+    struct Connection {
+        int fd;
+        uint8_t generation;       // Bumped on close, invalidates deferred handles
+        uint32_t remoteAddress;   // Network byte order
+        char input[HTTP_REQUEST_BUFFER_SIZE];
+        size_t inputLength;
+        String output;
+        size_t outputSent;
+        unsigned long lastActivity;
+        unsigned long lastProgress;   // Output pending: first queued or last bytes sent, whichever is later
+        unsigned long deferredAt;
+        int requests;
+        bool deferred;
+        bool deferredKeepAlive;
+        bool closeAfterWrite;
+        bool readSinceDispatch;
+        bool pendingInput;        // Complete requests buffered but not dispatched yet
+        bool streaming;           // beginStream() response, input is discarded
+    };
+
+    struct Route {
+        const char* pattern;
+        Handler handler;
+    };
+
+    enum ParseResult { PARSE_INCOMPLETE, PARSE_OK, PARSE_BAD_REQUEST, PARSE_TOO_LARGE, PARSE_UNSUPPORTED };
+
+    uint16_t _port;
+    int _listenFd;
+    Connection _connections[HTTP_MAX_CONNECTIONS];
+    Route _routes[HTTP_MAX_ROUTES];
+    int _routeCount;
+    const char* _collected[HTTP_MAX_COLLECTED_HEADERS];
+    int _collectedCount;
+    Stats _stats;
+
+    // Dispatch context
+    Connection* _current;
+    Request _request;
+    Slice _pathArgs[2];
+    int _pathArgCount;
+    String _responseHeaders;
+    bool _responded;
+
+    // Descriptors the watcher selects on (-1: none), republished whenever they may have changed.
+    // A change also writes to _wakeFd (loopback UDP socket to itself, always in the read set)
+    // so a select() already blocked on the old set returns at once.
+    std::atomic<int> _watchRead[HTTP_MAX_CONNECTIONS + 1];
+    std::atomic<int> _watchWrite[HTTP_MAX_CONNECTIONS];
+    int _wakeFd;
+    void publishWatchSet();
+    bool openWakeSocket();
+#ifndef UNIT_TEST
+    LoopScheduler* _scheduler;
+    TaskHandle_t _watcher;
+    static void watcherTaskEntry(void* arg);
+#endif
+
+    void acceptClients(unsigned long now);
+    void receive(Connection& connection, unsigned long now);
+    void process(Connection& connection, unsigned long now);
+    void dispatch(Connection& connection);
+    void flush(Connection& connection);
+    void close(Connection& connection);
+    void expire(Connection& connection, unsigned long now);
+    void queueResponse(Connection& connection, int code, const char* contentType, const char* body, size_t length,
+                       const char* extraHeaders, bool keepAlive);
+    void sendError(Connection& connection, int code, const char* message);
+    HttpResponseHandle handleFor(const Connection& connection) const;
+    Connection* connectionFor(HttpResponseHandle handle);
+
+    bool wantsRead(const Connection& connection) const;
+    bool wantsWrite(const Connection& connection) const { return connection.fd >= 0 && connection.outputSent < connection.output.length(); }
+    ParseResult parse(Connection& connection, Request& request);
+    bool matchRoute(const char* pattern, const Slice& path);
+    bool findHeader(const char* name, Slice& value) const;
+    bool findArg(const char* name, Slice& value) const;
+
+    static String decode(const Slice& slice);
+    static const char* reasonPhrase(int code);
+};
+
+#endif // ASYNC_HTTP_SERVER_H
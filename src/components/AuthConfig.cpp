@@ -33,6 +33,60 @@ void AuthConfig::loadFromEnvironment() {
         _keycloakClientSecret = "";
     #endif
     
+    #ifdef KEYCLOAK_VALIDATION_MODE
+        String mode = String(KEYCLOAK_VALIDATION_MODE);
+        if (mode == "introspection") {
+            _validationMode = VALIDATION_INTROSPECTION;
+        } else if (mode == "local") {
+            _validationMode = VALIDATION_LOCAL;
+        } else {
+            _validationMode = VALIDATION_HYBRID;
+        }
+    #else
+        _validationMode = VALIDATION_HYBRID;
+    #endif
+
+    // Expected "iss" claim. Defaults to <server>/realms/<realm>; override it when
+    // the device reaches Keycloak through a different URL than the one in the tokens.
+    #ifdef KEYCLOAK_ISSUER
+        _expectedIssuer = String(KEYCLOAK_ISSUER);
+    #else
+        _expectedIssuer = "";
+    #endif
+
+    // Optional "aud" / "azp" restrictions (empty = not checked)
+    #ifdef KEYCLOAK_AUDIENCE
+        _expectedAudience = String(KEYCLOAK_AUDIENCE);
+    #else
+        _expectedAudience = "";
+    #endif
+
+    #ifdef KEYCLOAK_AZP
+        _allowedAzp = String(KEYCLOAK_AZP);
+    #else
+        _allowedAzp = "";
+    #endif
+    
+    // Who may open/close which gate (AccessPolicy), checked after the token
+    #ifdef AUTH_POLICY
+        _authPolicy = String(AUTH_POLICY);
+    #else
+        _authPolicy = "";
+    #endif
+    
+    #ifdef AUTH_POLICY_TZ
+        _policyTimeZone = String(AUTH_POLICY_TZ);
+    #else
+        _policyTimeZone = "";
+    #endif
+    
+    // Guest access codes work with or without Keycloak
+    #ifdef GUEST_CODES
+        _guestCodes = String(GUEST_CODES);
+    #else
+        _guestCodes = "";
+    #endif
+    
     // Enable auth only if server URL is configured
     _authEnabled = !_keycloakServerUrl.isEmpty() && _keycloakServerUrl != "disabled";
     
@@ -41,6 +95,8 @@ void AuthConfig::loadFromEnvironment() {
         Serial.println("Realm: " + _keycloakRealm);
         Serial.println("Client ID: " + _keycloakClientId);
         Serial.println("Client Secret configured: " + String(_keycloakClientSecret.isEmpty() ? "no" : "yes"));
+        Serial.println("Token validation mode: " + String(getValidationModeName()));
+        Serial.println("Authorization policy: " + String(_authPolicy.isEmpty() ? "any valid token" : _authPolicy.c_str()));
 
         if (_keycloakClientSecret.isEmpty()) {
             Serial.println("Warning: KEYCLOAK_CLIENT_SECRET not set. Confidential clients will fail introspection.");
@@ -50,6 +106,15 @@ void AuthConfig::loadFromEnvironment() {
     }
 }
 
+const char* AuthConfig::getValidationModeName() const {
+    switch (_validationMode) {
+        case VALIDATION_INTROSPECTION: return "introspection";
+        case VALIDATION_LOCAL: return "local";
+        case VALIDATION_HYBRID: return "hybrid";
+    }
+    return "unknown";
+}
+
 void AuthConfig::loadEnvVar(const char* varName, String& target, const String& defaultValue) {
     // Cette méthode pourrait être étendue pour lire depuis EEPROM ou un fichier de config
     target = defaultValue;
@@ -8,6 +8,13 @@
 #include <WiFi.h>
 #endif
 
+// How bearer tokens are validated
+enum TokenValidationMode {
+  VALIDATION_INTROSPECTION,  // Keycloak /token/introspect on every request (revocation-sensitive)
+  VALIDATION_LOCAL,          // RS256 signature + claims checked on-device against the cached JWKS
+  VALIDATION_HYBRID          // Local check, introspection fallback for unknown kids / unsynced clock
+};
+
 class AuthConfig {
 public:
     static AuthConfig& getInstance();
@@ -20,6 +27,21 @@ public:
     const String& getKeycloakClientSecret() const { return _keycloakClientSecret; }
     bool hasKeycloakClientSecret() const { return !_keycloakClientSecret.isEmpty(); }
     
+    // Local JWT verification settings
+    TokenValidationMode getValidationMode() const { return _validationMode; }
+    const char* getValidationModeName() const;
+    const String& getExpectedIssuer() const { return _expectedIssuer; }
+    const String& getExpectedAudience() const { return _expectedAudience; }
+    const String& getAllowedAzp() const { return _allowedAzp; }
+    
+    // Authorization rules "role:gates:actions[:HHMM-HHMM];..." (empty: any valid token) and the
+    // POSIX time zone their windows are written in (empty: UTC)
+    const String& getAuthPolicy() const { return _authPolicy; }
+    const String& getPolicyTimeZone() const { return _policyTimeZone; }
+    
+    // Guest TOTP codes, "label:BASE32SECRET[:from:until:maxUses];..." (empty: route disabled)
+    const String& getGuestCodes() const { return _guestCodes; }
+    
     bool isAuthEnabled() const { return _authEnabled; }
     void setAuthEnabled(bool enabled) { _authEnabled = enabled; }
 
@@ -33,6 +55,13 @@ private:
     String _keycloakRealm;
     String _keycloakClientId;
     String _keycloakClientSecret;
+    String _expectedIssuer;
+    String _expectedAudience;
+    String _allowedAzp;
+    String _authPolicy;
+    String _policyTimeZone;
+    String _guestCodes;
+    TokenValidationMode _validationMode = VALIDATION_HYBRID;
     bool _authEnabled = false;
     
     void loadEnvVar(const char* varName, String& target, const String& defaultValue = "");
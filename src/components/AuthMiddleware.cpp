@@ -1,97 +1,248 @@
 #include "AuthMiddleware.h"
 
+#include <stdlib.h>
+#include <time.h>
+
 AuthMiddleware::AuthMiddleware(AuthConfig* authConfig) 
-    : _authConfig(authConfig), _jwtValidator(nullptr) {
+    : _authConfig(authConfig), _policyMinute(-1), _jwtValidator(nullptr), _mutex(xSemaphoreCreateMutex()),
+      _throttleMutex(xSemaphoreCreateMutex()) {
     
     if (_authConfig && _authConfig->isAuthEnabled()) {
-        _jwtValidator = new JwtValidator(_authConfig);
+        _policy.load(_authConfig->getAuthPolicy().c_str());
+        _jwtValidator = new JwtValidator(_authConfig, &_policy);
     }
 }
 
 AuthMiddleware::~AuthMiddleware() {
     delete _jwtValidator;
+    vSemaphoreDelete(_mutex);
+    vSemaphoreDelete(_throttleMutex);
+}
+
+void AuthMiddleware::begin() {
+    // Policy windows are local time; the clock itself stays UTC
+    if (_authConfig && !_authConfig->getPolicyTimeZone().isEmpty()) {
+        setenv("TZ", _authConfig->getPolicyTimeZone().c_str(), 1);
+        tzset();
+    }
+    if (_jwtValidator) {
+        _sessionTokens.begin();
+        _jwtValidator->begin();
+    }
+}
+
+void AuthMiddleware::maintain() {
+    if (_jwtValidator) {
+        _jwtValidator->maintain();
+    }
 }
 
-bool AuthMiddleware::authenticateRequest(WebServer* server) {
+void AuthMiddleware::onNetworkUp() {
+    if (_jwtValidator) {
+        _jwtValidator->onNetworkUp();
+    }
+}
+
+bool AuthMiddleware::authenticateRequest(AsyncHttpServer* server) {
     // Si l'authentification est désactivée, autoriser la requête
     if (!_authConfig || !_authConfig->isAuthEnabled()) {
-        _lastValidationResult = {true, "", "", "", ""};
+        _lastValidationResult = ValidationResult::valid();
         return true;
     }
     
-    String authHeader = extractAuthorizationHeader(server);
-    String clientIP = server->client().remoteIP().toString();
+    String clientIP = server->clientIP();
     
-    if (authHeader.isEmpty()) {
-        String error = "Missing Authorization header";
-        logAuthenticationAttempt(clientIP, false, error);
-        _lastValidationResult = {false, error, "", "", ""};
+    unsigned long retryAfter;
+    if (checkClient(clientIP, retryAfter) != ClientThrottle::CLIENT_ALLOWED) {
+        _lastValidationResult = ValidationResult::rejected("Too many failed attempts");
         return false;
     }
     
-    // Extraire le token Bearer
-    String token = "";
-    if (authHeader.startsWith("Bearer ")) {
-        token = authHeader.substring(7);
+    if (extractAuthorizationHeader(server).isEmpty()) {
+        _lastValidationResult = ValidationResult::rejected("Missing Authorization header");
+        logAuthenticationAttempt(clientIP, _lastValidationResult);
+        recordClientFailure(clientIP);
+        return false;
+    }
+    
+    _lastValidationResult = authenticateToken(extractBearerToken(server), clientIP);
+    return _lastValidationResult.isValid;
+}
+
+ValidationResult AuthMiddleware::authenticateToken(const String& token, const String& clientIP) {
+    if (!_authConfig || !_authConfig->isAuthEnabled()) {
+        return ValidationResult::valid();
     }
     
+    ValidationResult result;
+    
     if (token.isEmpty()) {
-        String error = "Invalid Authorization header format. Expected: Bearer <token>";
-        logAuthenticationAttempt(clientIP, false, error);
-        _lastValidationResult = {false, error, "", "", ""};
-        return false;
+        result.error = "Invalid Authorization header format. Expected: Bearer <token>";
+        logAuthenticationAttempt(clientIP, result);
+        recordClientFailure(clientIP);
+        return result;
     }
     
-    // Valider le token avec Keycloak
-    _lastValidationResult = _jwtValidator->validateToken(token);
+    if (SessionTokens::isSessionToken(token)) {
+        // Signed by this device: HMAC check only, no lock, no network
+        result = _sessionTokens.verify(token);
+    } else {
+        // Valider le token (localement ou avec Keycloak). Appelé depuis la loop et depuis le worker async.
+        // The wait for another validation counts against the same budget
+        const unsigned long deadline = millis() + AUTH_REQUEST_BUDGET;
+        if (xSemaphoreTake(_mutex, pdMS_TO_TICKS(AUTH_REQUEST_BUDGET)) != pdTRUE) {
+            result.error = "Authentication service busy";
+            result.unavailable = true;
+            logAuthenticationAttempt(clientIP, result);
+            return result;
+        }
+        result = _jwtValidator->validateToken(token, deadline);
+        xSemaphoreGive(_mutex);
+    }
     
-    logAuthenticationAttempt(clientIP, _lastValidationResult.isValid, _lastValidationResult.error);
+    logAuthenticationAttempt(clientIP, result);
     
-    return _lastValidationResult.isValid;
+    // Keycloak being down is not the client's fault
+    if (result.isValid) {
+        xSemaphoreTake(_throttleMutex, portMAX_DELAY);
+        _clientThrottle.recordSuccess(clientIP.c_str());
+        xSemaphoreGive(_throttleMutex);
+    } else if (!result.unavailable) {
+        recordClientFailure(clientIP);
+    }
+    
+    return result;
 }
 
-void AuthMiddleware::sendUnauthorizedResponse(WebServer* server, const String& error) {
-    String errorMessage = error.isEmpty() ? _lastValidationResult.error : error;
-    
-    if (errorMessage.isEmpty()) {
-        errorMessage = "Unauthorized";
+bool AuthMiddleware::authorize(const ValidationResult& result, int gate, OperationState action) {
+    if (!_jwtValidator || !_policy.isRestricted()) {
+        return true;
     }
     
-    // Créer une réponse JSON d'erreur
-    String jsonResponse = "{";
-    jsonResponse += "\"error\":\"Unauthorized\",";
-    jsonResponse += "\"message\":\"" + errorMessage + "\",";
-    jsonResponse += "\"code\":401";
-    jsonResponse += "}";
+    // Time-of-day rules are recompiled when the minute changes, not per request
+    const time_t now = time(nullptr);
+    if (now / 60 != _policyMinute) {
+        _policyMinute = now / 60;
+        struct tm local;
+        if (now >= CLOCK_SYNCED_MIN_EPOCH && localtime_r(&now, &local)) {
+            _policy.setTimeOfDay(local.tm_hour * 60 + local.tm_min);
+        } else {
+            _policy.setTimeOfDay(-1);
+        }
+    }
     
-    server->send(401, "application/json", jsonResponse);
+    if (!_policy.allows(result.roles, gate, action)) {
+        Serial.println("[Auth] Policy denies " + String(action == OPENING ? "open" : "close") + " " + GATES[gate].id +
+                       " to user: " + result.username);
+        return false;
+    }
+    return true;
 }
 
-String AuthMiddleware::extractAuthorizationHeader(WebServer* server) {
-    if (server->hasHeader("Authorization")) {
-        return server->header("Authorization");
+bool AuthMiddleware::issueSessionToken(const ValidationResult& identity, String& token, unsigned long& lifetime) {
+    if (!_jwtValidator || !_sessionTokens.issue(identity, token, lifetime)) {
+        return false;
     }
+    Serial.println("[Auth] Session token issued for user: " + identity.username + " (" + String(lifetime / 1000) + " s)");
+    return true;
+}
+
+ClientThrottle::Verdict AuthMiddleware::checkClient(const String& clientIP, unsigned long& retryAfter) {
+    xSemaphoreTake(_throttleMutex, portMAX_DELAY);
+    ClientThrottle::Verdict verdict = _clientThrottle.check(clientIP.c_str(), millis(), retryAfter);
+    xSemaphoreGive(_throttleMutex);
+    return verdict;
+}
+
+void AuthMiddleware::recordClientFailure(const String& clientIP) {
+    xSemaphoreTake(_throttleMutex, portMAX_DELAY);
+    const bool banned = _clientThrottle.recordFailure(clientIP.c_str(), millis());
+    xSemaphoreGive(_throttleMutex);
     
-    // Vérifier aussi les variantes courantes
-    if (server->hasHeader("authorization")) {
-        return server->header("authorization");
+    if (banned) {
+        Serial.println("[Auth][Warning] " + clientIP + " banned for " + String(CLIENT_BAN_DURATION / 1000) +
+                       " s after " + String(CLIENT_BAN_FAILURES) + " failed attempts");
     }
+}
+
+void AuthMiddleware::sendThrottledResponse(AsyncHttpServer* server, ClientThrottle::Verdict verdict,
+                                           unsigned long retryAfter) {
+    char buffer[160];
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.field("error", "Too Many Requests");
+    json.field("message", verdict == ClientThrottle::CLIENT_BANNED ? "Too many failed attempts, client banned"
+                                                                  : "Too many failed attempts, slow down");
+    json.field("code", 429);
+    json.endObject();
     
+    // Whole seconds, rounded up
+    server->sendHeader("Retry-After", String((retryAfter + 999) / 1000));
+    server->send(429, "application/json", json.c_str(), json.length());
+}
+
+String AuthMiddleware::extractBearerToken(AsyncHttpServer* server) {
+    String authHeader = extractAuthorizationHeader(server);
+    if (authHeader.startsWith("Bearer ")) {
+        return authHeader.substring(7);
+    }
     return "";
 }
 
-void AuthMiddleware::logAuthenticationAttempt(const String& clientIP, bool success, const String& error) {
+void AuthMiddleware::sendUnauthorizedResponse(AsyncHttpServer* server, const String& error) {
+    char buffer[256];
+    JsonWriter json(buffer, sizeof(buffer));
+    writeUnauthorizedJson(json, error.isEmpty() ? _lastValidationResult.error : error);
+    if (json.overflowed()) {
+        // Message too long for the buffer: drop it rather than send a truncated document
+        json.reset();
+        writeUnauthorizedJson(json, "");
+    }
+    server->send(401, "application/json", json.c_str(), json.length());
+}
+
+void AuthMiddleware::writeUnavailableJson(JsonWriter& json, const String& message) {
+    json.beginObject();
+    json.field("error", "Service Unavailable");
+    json.field("message", message.isEmpty() ? "Authentication service unavailable" : message.c_str());
+    json.field("code", 503);
+    json.endObject();
+}
+
+void AuthMiddleware::writeUnauthorizedJson(JsonWriter& json, const String& message) {
+    // Créer une réponse JSON d'erreur
+    json.beginObject();
+    json.field("error", "Unauthorized");
+    json.field("message", message.isEmpty() ? "Unauthorized" : message.c_str());
+    json.field("code", 401);
+    json.endObject();
+}
+
+void AuthMiddleware::writeForbiddenJson(JsonWriter& json, const String& message) {
+    json.beginObject();
+    json.field("error", "Forbidden");
+    json.field("message", message.isEmpty() ? "Forbidden" : message.c_str());
+    json.field("code", 403);
+    json.endObject();
+}
+
+String AuthMiddleware::extractAuthorizationHeader(AsyncHttpServer* server) {
+    // Les noms d'en-tête sont comparés sans tenir compte de la casse
+    return server->header("Authorization");
+}
+
+void AuthMiddleware::logAuthenticationAttempt(const String& clientIP, const ValidationResult& result) {
     String logMessage = "Auth attempt from " + clientIP + ": ";
     
-    if (success) {
+    if (result.isValid) {
         logMessage += "SUCCESS";
-        if (!_lastValidationResult.username.isEmpty()) {
-            logMessage += " (user: " + _lastValidationResult.username + ")";
+        if (!result.username.isEmpty()) {
+            logMessage += " (user: " + result.username + ")";
         }
     } else {
-        logMessage += "FAILED";
-        if (!error.isEmpty()) {
-            logMessage += " - " + error;
+        logMessage += result.unavailable ? "UNAVAILABLE" : "FAILED";
+        if (!result.error.isEmpty()) {
+            logMessage += " - " + result.error;
         }
     }
     
@@ -2,28 +2,79 @@
 #define AUTH_MIDDLEWARE_H
 
 #include <Arduino.h>
-#include <WebServer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include "AccessPolicy.h"
 #include "JwtValidator.h"
 #include "AuthConfig.h"
+#include "AsyncHttpServer.h"
+#include "ClientThrottle.h"
+#include "JsonWriter.h"
+#include "SessionTokens.h"
 
 class AuthMiddleware {
 public:
     explicit AuthMiddleware(AuthConfig* authConfig);
     ~AuthMiddleware();
     
-    bool authenticateRequest(WebServer* server);
-    void sendUnauthorizedResponse(WebServer* server, const String& error = "");
+    // Network initialization (JWKS prefetch), call once WiFi is up
+    void begin();
+    
+    // Keycloak connection upkeep: main loop tick and Wi-Fi link-up notification
+    void maintain();
+    void onNetworkUp();
+    
+    bool authenticateRequest(AsyncHttpServer* server);
+    
+    // Before any token validation (thread-safe): CLIENT_THROTTLED / CLIENT_BANNED after repeated
+    // failures from this address, retryAfter in ms. authenticateToken() records the outcomes.
+    ClientThrottle::Verdict checkClient(const String& clientIP, unsigned long& retryAfter);
+    void recordClientFailure(const String& clientIP);
+    static void sendThrottledResponse(AsyncHttpServer* server, ClientThrottle::Verdict verdict, unsigned long retryAfter);
+    
+    // Validate an already extracted bearer token (thread-safe, used by the async command worker).
+    // Never takes longer than AUTH_REQUEST_BUDGET, Keycloak calls and waiting for another validation included.
+    // Device session tokens are checked locally, without Keycloak.
+    ValidationResult authenticateToken(const String& token, const String& clientIP);
+    
+    // Access policy decision for a validated token: one AND of its cached role mask with the
+    // roles allowed on this gate/action at the current local time. Auth worker only.
+    bool authorize(const ValidationResult& result, int gate, OperationState action);
+    
+    // Session token for an identity validated by Keycloak (/auth/session), lifetime in ms
+    bool issueSessionToken(const ValidationResult& identity, String& token, unsigned long& lifetime);
+    String extractBearerToken(AsyncHttpServer* server);
+    
+    void sendUnauthorizedResponse(AsyncHttpServer* server, const String& error = "");
+    
+    // 401 body, also used for deferred responses (the message is escaped)
+    static void writeUnauthorizedJson(JsonWriter& json, const String& message);
+    
+    // 403 body: valid token, but the access policy doesn't grant the gate/action
+    static void writeForbiddenJson(JsonWriter& json, const String& message);
+    
+    // 503 body when the token could not be checked (result.unavailable)
+    static void writeUnavailableJson(JsonWriter& json, const String& message);
     
     // Getters for last validation result
     const ValidationResult& getLastValidationResult() const { return _lastValidationResult; }
+    const JwtValidator* getJwtValidator() const { return _jwtValidator; }
+    const ClientThrottle& getClientThrottle() const { return _clientThrottle; }
+    const AccessPolicy& getPolicy() const { return _policy; }
     
 private:
     AuthConfig* _authConfig;
+    AccessPolicy _policy;               // Compiled once, before the validator maps claims with it
+    int64_t _policyMinute;              // Epoch minute the policy's time of day was last set for
     JwtValidator* _jwtValidator;
     ValidationResult _lastValidationResult;
+    SemaphoreHandle_t _mutex;
+    SessionTokens _sessionTokens;
+    ClientThrottle _clientThrottle;
+    SemaphoreHandle_t _throttleMutex;   // Short hold, separate from the (slow) validation lock
     
-    String extractAuthorizationHeader(WebServer* server);
-    void logAuthenticationAttempt(const String& clientIP, bool success, const String& error = "");
+    String extractAuthorizationHeader(AsyncHttpServer* server);
+    void logAuthenticationAttempt(const String& clientIP, const ValidationResult& result);
 };
 
 #endif // AUTH_MIDDLEWARE_H
\ No newline at end of file
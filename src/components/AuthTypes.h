@@ -0,0 +1,37 @@
+#ifndef AUTH_TYPES_H
+#define AUTH_TYPES_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stdint.h>
+#include <time.h>
+
+// Outcome of a bearer token validation. Default: rejected without a reason, fields set by name
+struct ValidationResult {
+    bool isValid = false;
+    String error;
+    String userId;
+    String username;
+    String realm;
+    time_t expiresAt = 0;       // Token "exp" (epoch seconds), 0 when unknown
+    bool unavailable = false;   // Not validated: Keycloak down, slow or circuit open (503 rather than 401)
+    uint32_t roles = 0;         // AccessPolicy bits of the token's roles and groups, mapped once at validation
+
+    static ValidationResult valid() {
+        ValidationResult result;
+        result.isValid = true;
+        return result;
+    }
+
+    static ValidationResult rejected(const String& error) {
+        ValidationResult result;
+        result.error = error;
+        return result;
+    }
+};
+
+#endif // AUTH_TYPES_H
@@ -0,0 +1,55 @@
+#include "Base64Url.h"
+
+namespace {
+    const char BASE64URL[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+    int base64UrlValue(char c) {
+        if (c >= 'A' && c <= 'Z') return c - 'A';
+        if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+        if (c >= '0' && c <= '9') return c - '0' + 52;
+        if (c == '-' || c == '+') return 62;
+        if (c == '_' || c == '/') return 63;
+        return -1;
+    }
+}
+
+int base64UrlDecode(const char* input, size_t inputLen, uint8_t* output, size_t capacity) {
+    uint32_t buffer = 0;
+    int bitsCollected = 0;
+    size_t written = 0;
+
+    for (size_t i = 0; i < inputLen; i++) {
+        char c = input[i];
+        if (c == '=') break;
+
+        int value = base64UrlValue(c);
+        if (value < 0) {
+            return -1;
+        }
+
+        buffer = (buffer << 6) | static_cast<uint32_t>(value);
+        bitsCollected += 6;
+
+        if (bitsCollected >= 8) {
+            bitsCollected -= 8;
+            if (written >= capacity) {
+                return -1;
+            }
+            output[written++] = static_cast<uint8_t>((buffer >> bitsCollected) & 0xFF);
+        }
+    }
+
+    return static_cast<int>(written);
+}
+
+void base64UrlEncode(const uint8_t* input, size_t length, String& out) {
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t block = static_cast<uint32_t>(input[i]) << 16;
+        if (i + 1 < length) block |= static_cast<uint32_t>(input[i + 1]) << 8;
+        if (i + 2 < length) block |= input[i + 2];
+        out += BASE64URL[(block >> 18) & 0x3F];
+        out += BASE64URL[(block >> 12) & 0x3F];
+        if (i + 1 < length) out += BASE64URL[(block >> 6) & 0x3F];
+        if (i + 2 < length) out += BASE64URL[block & 0x3F];
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef BASE64_URL_H
+#define BASE64_URL_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Base64url (RFC 4648 §5) decoding into a byte buffer, padding optional ('+' and '/' accepted too).
+// Returns the decoded length, or -1 on invalid input / insufficient capacity.
+int base64UrlDecode(const char* input, size_t inputLen, uint8_t* output, size_t capacity);
+
+// Unpadded base64url, appended to out
+void base64UrlEncode(const uint8_t* input, size_t length, String& out);
+
+// Length of the unpadded encoding of length bytes
+constexpr int base64UrlLength(int length) {
+    return (length * 4 + 2) / 3;
+}
+
+#endif // BASE64_URL_H
@@ -0,0 +1,103 @@
+#include "CborWriter.h"
+
+#include <string.h>
+
+CborWriter::CborWriter(uint8_t* buffer, size_t capacity)
+    : _buffer(buffer), _capacity(capacity) {
+    reset();
+}
+
+void CborWriter::reset() {
+    _length = 0;
+    _overflowed = _capacity == 0;
+}
+
+CborWriter& CborWriter::beginObject(const char* name) {
+    key(name);
+    return appendByte(MAP | INDEFINITE);
+}
+
+CborWriter& CborWriter::beginArray(const char* name) {
+    key(name);
+    return appendByte(ARRAY | INDEFINITE);
+}
+
+CborWriter& CborWriter::field(const char* name, const char* value) {
+    key(name);
+    if (!value) {
+        return appendByte(NULL_VALUE);
+    }
+    appendText(value, strlen(value));
+    return *this;
+}
+
+CborWriter& CborWriter::field(const char* name, const String& value) {
+    key(name);
+    appendText(value.c_str(), value.length());
+    return *this;
+}
+
+CborWriter& CborWriter::field(const char* name, bool value) {
+    key(name);
+    return appendByte(value ? TRUE_VALUE : FALSE_VALUE);
+}
+
+CborWriter& CborWriter::field(const char* name, long value) {
+    key(name);
+    if (value < 0) {
+        // -1 - n is encoded as n
+        appendHead(NEGATIVE, static_cast<uint64_t>(-(value + 1)));
+    } else {
+        appendHead(UNSIGNED, static_cast<uint64_t>(value));
+    }
+    return *this;
+}
+
+CborWriter& CborWriter::field(const char* name, unsigned long value) {
+    key(name);
+    appendHead(UNSIGNED, value);
+    return *this;
+}
+
+void CborWriter::key(const char* name) {
+    if (name) {
+        appendText(name, strlen(name));
+    }
+}
+
+void CborWriter::appendHead(uint8_t majorType, uint64_t argument) {
+    // Shortest form: in the initial byte up to 23, then 1, 2, 4 or 8 big-endian bytes
+    uint8_t head[9];
+    size_t size;
+    if (argument < 24) {
+        head[0] = majorType | static_cast<uint8_t>(argument);
+        size = 1;
+    } else {
+        int bytes = argument <= 0xFF ? 1 : argument <= 0xFFFF ? 2 : argument <= 0xFFFFFFFFULL ? 4 : 8;
+        head[0] = majorType | static_cast<uint8_t>(bytes == 1 ? 24 : bytes == 2 ? 25 : bytes == 4 ? 26 : 27);
+        for (int i = 0; i < bytes; i++) {
+            head[bytes - i] = static_cast<uint8_t>(argument >> (8 * i));
+        }
+        size = bytes + 1;
+    }
+    append(head, size);
+}
+
+void CborWriter::appendText(const char* text, size_t length) {
+    appendHead(TEXT, length);
+    append(text, length);
+}
+
+CborWriter& CborWriter::appendByte(uint8_t byte) {
+    append(&byte, 1);
+    return *this;
+}
+
+void CborWriter::append(const void* data, size_t length) {
+    if (_length + length > _capacity) {
+        _overflowed = true;
+        return;
+    }
+    memcpy(_buffer + _length, data, length);
+    _length += length;
+}
@@ -0,0 +1,69 @@
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CBOR (RFC 8949) counterpart of JsonWriter, same calls: a document written with one can
+// be written with the other. Maps and arrays use the indefinite-length form so nothing
+// has to be counted in advance. No heap allocation; overflowed() as in JsonWriter.
+class CborWriter {
+public:
+    CborWriter(uint8_t* buffer, size_t capacity);
+
+    // key is nullptr at top level and inside arrays
+    CborWriter& beginObject(const char* key = nullptr);
+    CborWriter& endObject() { return appendByte(BREAK); }
+    CborWriter& beginArray(const char* key = nullptr);
+    CborWriter& endArray() { return appendByte(BREAK); }
+
+    // Map members
+    CborWriter& field(const char* key, const char* value);     // nullptr writes null
+    CborWriter& field(const char* key, const String& value);
+    CborWriter& field(const char* key, bool value);
+    CborWriter& field(const char* key, int value) { return field(key, static_cast<long>(value)); }
+    CborWriter& field(const char* key, unsigned int value) { return field(key, static_cast<unsigned long>(value)); }
+    CborWriter& field(const char* key, long value);
+    CborWriter& field(const char* key, unsigned long value);
+
+    // Array elements
+    CborWriter& value(const char* value) { return field(nullptr, value); }
+    CborWriter& value(const String& value) { return field(nullptr, value); }
+
+    const uint8_t* data() const { return _buffer; }
+    size_t length() const { return _length; }
+    bool overflowed() const { return _overflowed; }
+    void reset();
+
+private:
+    // Major types (high 3 bits of the initial byte)
+    static const uint8_t UNSIGNED = 0 << 5;
+    static const uint8_t NEGATIVE = 1 << 5;
+    static const uint8_t TEXT = 3 << 5;
+    static const uint8_t ARRAY = 4 << 5;
+    static const uint8_t MAP = 5 << 5;
+    static const uint8_t INDEFINITE = 31;
+    static const uint8_t FALSE_VALUE = 0xF4;
+    static const uint8_t TRUE_VALUE = 0xF5;
+    static const uint8_t NULL_VALUE = 0xF6;
+    static const uint8_t BREAK = 0xFF;
+
+    uint8_t* _buffer;
+    size_t _capacity;
+    size_t _length;
+    bool _overflowed;
+
+    void key(const char* key);
+    void appendHead(uint8_t majorType, uint64_t argument);
+    void appendText(const char* text, size_t length);
+    CborWriter& appendByte(uint8_t byte);
+    void append(const void* data, size_t length);
+};
+
+#endif // CBOR_WRITER_H
@@ -0,0 +1,90 @@
+#include "CircuitBreaker.h"
+
+static_assert(KEYCLOAK_BREAKER_WINDOW > 0 && KEYCLOAK_BREAKER_WINDOW <= 32, "Window must fit the failure bitmask");
+
+CircuitBreaker::CircuitBreaker(unsigned long slowCallThreshold, unsigned long openTime)
+    : _slowCallThreshold(slowCallThreshold), _openTime(openTime), _state(BREAKER_CLOSED), _openedAt(0),
+      _failures(0), _calls(0), _stats() {
+}
+
+bool CircuitBreaker::allowRequest() {
+    if (_state == BREAKER_CLOSED) {
+        return true;
+    }
+    _stats.rejected++;
+    return false;
+}
+
+bool CircuitBreaker::isProbeDue(unsigned long now) const {
+    return _state == BREAKER_OPEN && now - _openedAt >= _openTime;
+}
+
+bool CircuitBreaker::startProbe(unsigned long now) {
+    if (!isProbeDue(now)) {
+        return false;
+    }
+    _state = BREAKER_HALF_OPEN;
+    _stats.probes++;
+    return true;
+}
+
+void CircuitBreaker::cancelProbe() {
+    if (_state == BREAKER_HALF_OPEN) {
+        _state = BREAKER_OPEN;
+    }
+}
+
+void CircuitBreaker::recordSuccess(unsigned long latency, unsigned long now) {
+    record(latency > _slowCallThreshold, now);
+}
+
+void CircuitBreaker::recordFailure(unsigned long now) {
+    record(true, now);
+}
+
+int CircuitBreaker::failurePercent() const {
+    return _calls > 0 ? __builtin_popcount(_failures) * 100 / _calls : 0;
+}
+
+const char* CircuitBreaker::stateName(State state) {
+    switch (state) {
+        case BREAKER_CLOSED: return "closed";
+        case BREAKER_OPEN: return "open";
+        case BREAKER_HALF_OPEN: return "half_open";
+    }
+    return "unknown";
+}
+
+void CircuitBreaker::record(bool failed, unsigned long now) {
+    switch (_state) {
+        case BREAKER_OPEN:
+            return; // Call allowed before the trip, the window no longer matters
+        case BREAKER_HALF_OPEN:
+            if (failed) {
+                open(now);
+            } else {
+                // Start over: the failures that tripped the circuit are history
+                _state = BREAKER_CLOSED;
+                _failures = 0;
+                _calls = 0;
+            }
+            return;
+        case BREAKER_CLOSED:
+            break;
+    }
+
+    const uint32_t windowMask = KEYCLOAK_BREAKER_WINDOW == 32 ? 0xFFFFFFFFu : (1u << KEYCLOAK_BREAKER_WINDOW) - 1;
+    _failures = ((_failures << 1) | (failed ? 1u : 0u)) & windowMask;
+    if (_calls < KEYCLOAK_BREAKER_WINDOW) {
+        _calls++;
+    }
+    if (_calls >= KEYCLOAK_BREAKER_MIN_CALLS && failurePercent() >= KEYCLOAK_BREAKER_FAILURE_PERCENT) {
+        open(now);
+    }
+}
+
+void CircuitBreaker::open(unsigned long now) {
+    _state = BREAKER_OPEN;
+    _openedAt = now;
+    _stats.opened++;
+}
@@ -0,0 +1,63 @@
+#ifndef CIRCUIT_BREAKER_H
+#define CIRCUIT_BREAKER_H
+
+#include <stdint.h>
+#include "Config.h"
+
+// Circuit breaker around the calls to a remote service (Keycloak). Closed: calls go through
+// and their outcomes fill a sliding window; once enough of the recent calls failed or were
+// slow, the circuit opens and callers fail fast. After openTime a single probe is let
+// through (half-open): its success closes the circuit, its failure opens it again.
+// Not thread-safe, the owner serializes the calls.
+class CircuitBreaker {
+public:
+    enum State {
+        BREAKER_CLOSED,
+        BREAKER_OPEN,
+        BREAKER_HALF_OPEN
+    };
+
+    struct Stats {
+        uint32_t opened;      // Transitions to open (trips and failed probes)
+        uint32_t rejected;    // Calls refused while open or half-open
+        uint32_t probes;
+    };
+
+    explicit CircuitBreaker(unsigned long slowCallThreshold = KEYCLOAK_SLOW_CALL_THRESHOLD,
+                            unsigned long openTime = KEYCLOAK_BREAKER_OPEN_TIME);
+
+    // Regular call: only while closed, counted as rejected otherwise
+    bool allowRequest();
+
+    // Open for openTime: the next probe may run. startProbe() returns true once per probe,
+    // the caller then reports the outcome with recordSuccess() / recordFailure().
+    bool isProbeDue(unsigned long now) const;
+    bool startProbe(unsigned long now);
+
+    // The probe never reached the service: back to open, due again right away
+    void cancelProbe();
+
+    // A success slower than slowCallThreshold counts as a failure
+    void recordSuccess(unsigned long latency, unsigned long now);
+    void recordFailure(unsigned long now);
+
+    State getState() const { return _state; }
+    int failurePercent() const;    // Over the current window, 0 when empty
+    const Stats& getStats() const { return _stats; }
+
+    static const char* stateName(State state);
+
+private:
+    unsigned long _slowCallThreshold;
+    unsigned long _openTime;
+    State _state;
+    unsigned long _openedAt;
+    uint32_t _failures;    // Bit i set: the i-th most recent call failed
+    int _calls;            // Calls in the window, up to KEYCLOAK_BREAKER_WINDOW
+    Stats _stats;
+
+    void record(bool failed, unsigned long now);
+    void open(unsigned long now);
+};
+
+#endif // CIRCUIT_BREAKER_H
@@ -0,0 +1,158 @@
+#include "ClientThrottle.h"
+
+static_assert(CLIENT_THROTTLE_FAILURES < CLIENT_BAN_FAILURES, "Clients are throttled before being banned");
+
+ClientThrottle::ClientThrottle(int throttleFailures, unsigned long throttleInterval, int banFailures,
+                               unsigned long banDuration, unsigned long failureWindow)
+    : _throttleFailures(throttleFailures), _throttleInterval(throttleInterval), _banFailures(banFailures),
+      _banDuration(banDuration), _failureWindow(failureWindow), _stats() {
+    for (int i = 0; i < CLIENT_THROTTLE_SLOTS; i++) {
+        _entries[i].used = false;
+    }
+}
+
+ClientThrottle::Verdict ClientThrottle::check(const char* client, unsigned long now, unsigned long& retryAfter) {
+    Entry* entry = find(hash(client));
+    if (!entry) {
+        return CLIENT_ALLOWED;
+    }
+    expire(*entry, now);
+    if (!entry->used) {
+        return CLIENT_ALLOWED;
+    }
+
+    if (entry->banned) {
+        retryAfter = _banDuration - (now - entry->bannedAt);
+        _stats.blocked++;
+        return CLIENT_BANNED;
+    }
+
+    const unsigned long sinceFailure = now - entry->lastFailure;
+    if (entry->failures >= _throttleFailures && sinceFailure < _throttleInterval) {
+        retryAfter = _throttleInterval - sinceFailure;
+        _stats.throttled++;
+        return CLIENT_THROTTLED;
+    }
+    return CLIENT_ALLOWED;
+}
+
+bool ClientThrottle::recordFailure(const char* client, unsigned long now) {
+    const uint32_t key = hash(client);
+    Entry* entry = find(key);
+    if (entry) {
+        expire(*entry, now);
+    }
+    if (!entry || !entry->used) {
+        entry = allocate(key, now);
+    }
+
+    if (entry->failures < UINT16_MAX) {
+        entry->failures++;
+    }
+    entry->lastFailure = now;
+
+    if (!entry->banned && entry->failures >= _banFailures) {
+        entry->banned = true;
+        entry->bannedAt = now;
+        _stats.bans++;
+        return true;
+    }
+    return false;
+}
+
+void ClientThrottle::recordSuccess(const char* client) {
+    Entry* entry = find(hash(client));
+    if (entry) {
+        entry->used = false;
+    }
+}
+
+int ClientThrottle::trackedCount(unsigned long now) const {
+    int count = 0;
+    for (int i = 0; i < CLIENT_THROTTLE_SLOTS; i++) {
+        if (isLive(_entries[i], now)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+int ClientThrottle::bannedCount(unsigned long now) const {
+    int count = 0;
+    for (int i = 0; i < CLIENT_THROTTLE_SLOTS; i++) {
+        const Entry& entry = _entries[i];
+        if (entry.used && entry.banned && now - entry.bannedAt < _banDuration) {
+            count++;
+        }
+    }
+    return count;
+}
+
+uint32_t ClientThrottle::hash(const char* client) {
+    uint32_t value = 2166136261u;
+    for (const char* c = client; *c; c++) {
+        value = (value ^ static_cast<uint8_t>(*c)) * 16777619u;
+    }
+    return value;
+}
+
+ClientThrottle::Entry* ClientThrottle::find(uint32_t key) {
+    for (int i = 0; i < CLIENT_THROTTLE_SLOTS; i++) {
+        if (_entries[i].used && _entries[i].key == key) {
+            return &_entries[i];
+        }
+    }
+    return nullptr;
+}
+
+ClientThrottle::Entry* ClientThrottle::allocate(uint32_t key, unsigned long now) {
+    Entry* victim = nullptr;
+    for (int i = 0; i < CLIENT_THROTTLE_SLOTS; i++) {
+        Entry& entry = _entries[i];
+        if (entry.used) {
+            expire(entry, now);
+        }
+        if (!entry.used) {
+            victim = &entry;
+            break;
+        }
+        // Oldest failure first, a banned client only when every slot holds one
+        if (!victim || (victim->banned && !entry.banned) ||
+            (victim->banned == entry.banned && now - entry.lastFailure > now - victim->lastFailure)) {
+            victim = &entry;
+        }
+    }
+    if (victim->used) {
+        _stats.evictions++;
+    }
+
+    victim->key = key;
+    victim->failures = 0;
+    victim->lastFailure = now;
+    victim->banned = false;
+    victim->used = true;
+    return victim;
+}
+
+void ClientThrottle::expire(Entry& entry, unsigned long now) {
+    if (entry.banned && now - entry.bannedAt >= _banDuration) {
+        // Out of the ban but still throttled: the next failures count from there
+        entry.banned = false;
+        entry.failures = _throttleFailures;
+        entry.lastFailure = now - _throttleInterval;
+    }
+    if (!entry.banned && now - entry.lastFailure >= _failureWindow) {
+        entry.used = false;
+    }
+}
+
+bool ClientThrottle::isLive(const Entry& entry, unsigned long now) const {
+    if (!entry.used) {
+        return false;
+    }
+    if (entry.banned) {
+        // Past the ban, still watched until the failure window ends
+        return now - entry.bannedAt < _banDuration + _failureWindow;
+    }
+    return now - entry.lastFailure < _failureWindow;
+}
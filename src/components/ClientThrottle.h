@@ -0,0 +1,69 @@
+#ifndef CLIENT_THROTTLE_H
+#define CLIENT_THROTTLE_H
+
+#include <stdint.h>
+#include "Config.h"
+
+// Authentication failures per client address, checked before any token validation.
+// After throttleFailures recent failures a client gets one attempt per throttleInterval;
+// after banFailures it is banned for banDuration. Failures older than failureWindow are
+// forgotten. Defaults: the CLIENT_* bearer token limits.
+// Fixed table keyed by a hash of the address: when full, the client with the oldest
+// failure makes room (banned clients last). Not thread-safe, the owner serializes calls.
+class ClientThrottle {
+public:
+    enum Verdict {
+        CLIENT_ALLOWED,
+        CLIENT_THROTTLED,
+        CLIENT_BANNED
+    };
+
+    struct Stats {
+        uint32_t throttled;    // Requests refused while throttled
+        uint32_t blocked;      // Requests refused while banned
+        uint32_t bans;         // Bans issued
+        uint32_t evictions;    // Tracked clients dropped to make room
+    };
+
+    explicit ClientThrottle(int throttleFailures = CLIENT_THROTTLE_FAILURES,
+                            unsigned long throttleInterval = CLIENT_THROTTLE_INTERVAL,
+                            int banFailures = CLIENT_BAN_FAILURES, unsigned long banDuration = CLIENT_BAN_DURATION,
+                            unsigned long failureWindow = CLIENT_FAILURE_WINDOW);
+
+    // retryAfter (ms) is set when the client is refused
+    Verdict check(const char* client, unsigned long now, unsigned long& retryAfter);
+
+    // Returns true when this failure got the client banned
+    bool recordFailure(const char* client, unsigned long now);
+    void recordSuccess(const char* client);
+
+    int trackedCount(unsigned long now) const;
+    int bannedCount(unsigned long now) const;
+    const Stats& getStats() const { return _stats; }
+
+private:
+    struct Entry {
+        uint32_t key;                // FNV-1a of the address
+        uint16_t failures;
+        unsigned long lastFailure;
+        unsigned long bannedAt;
+        bool banned;
+        bool used;
+    };
+
+    int _throttleFailures;
+    unsigned long _throttleInterval;
+    int _banFailures;
+    unsigned long _banDuration;
+    unsigned long _failureWindow;
+    Entry _entries[CLIENT_THROTTLE_SLOTS];
+    Stats _stats;
+
+    static uint32_t hash(const char* client);
+    Entry* find(uint32_t key);
+    Entry* allocate(uint32_t key, unsigned long now);
+    void expire(Entry& entry, unsigned long now);
+    bool isLive(const Entry& entry, unsigned long now) const;
+};
+
+#endif // CLIENT_THROTTLE_H
@@ -1,23 +1,192 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
-// Hardware pins configuration
+#include <stdint.h>
+
+// Hardware pins configuration (first gate)
 #define RELAY_1_PIN 16
 #define SENSOR_CLOSED_PIN 18
 #define SENSOR_OPEN_PIN 19
 
+// Gates driven by this board. Sensors are active LOW with internal pull-up.
+// The id is used in /gate/{id}/... routes and in MQTT messages; the index also works.
+struct GatePins {
+    const char* id;
+    uint8_t relayPin;
+    uint8_t closedSensorPin;
+    uint8_t openSensorPin;
+};
+
+constexpr GatePins GATES[] = {
+    {"main", RELAY_1_PIN, SENSOR_CLOSED_PIN, SENSOR_OPEN_PIN},
+    // {"garage2", 17, 21, 22},
+};
+constexpr int GATE_COUNT = sizeof(GATES) / sizeof(GATES[0]);
+static_assert(GATE_COUNT >= 1 && GATE_COUNT <= 4, "GATES must list between 1 and 4 gates");
+
 // Timing configuration (in milliseconds)
 const unsigned long OPENING_TIMEOUT = 15000;   // 15 seconds to open
 const unsigned long CLOSING_TIMEOUT = 20000;   // 20 seconds to close
 const unsigned long AUTO_CLOSE_DELAY = 180000; // 3 minutes auto-close delay
+const unsigned long RELAY_PULSE_WIDTH = 1000;  // Relay held closed for 1 second per actuation
+const unsigned long RELAY_MIN_GAP = 1000;      // Minimum release time before the next pulse
+
+// Sensor edge capture (GPIO interrupts)
+const unsigned long SENSOR_DEBOUNCE_US = 30000; // A level must hold 30 ms to count as a state change
+const int SENSOR_EDGE_RING_SIZE = 32;           // Raw edges buffered between two loop iterations (power of two)
 
 // Serial communication
 const unsigned long SERIAL_BAUD_RATE = 115200;
 
+// Wall clock (NTP)
+const int64_t CLOCK_SYNCED_MIN_EPOCH = 1700000000;   // time() below this: NTP not synchronized yet
+
 // Server configuration
 const int SERVER_PORT = 80;
+const int HTTP_MAX_CONNECTIONS = 4;                   // Concurrent clients, further ones get a 503
+const int HTTP_REQUEST_BUFFER_SIZE = 2048;            // Per connection: request line + headers (bearer tokens are ~1.5 KB)
+const int HTTP_MAX_ROUTES = 16;
+const int HTTP_MAX_COLLECTED_HEADERS = 6;             // Authorization + collectHeaders()
+const unsigned long HTTP_KEEPALIVE_TIMEOUT = 5000;    // Idle keep-alive connections are closed after this
+const unsigned long HTTP_WRITE_STALL_TIMEOUT = 10000; // Responses the client doesn't read for this long close the connection
+const int HTTP_KEEPALIVE_MAX_REQUESTS = 100;          // Requests served on one connection before closing it
+const unsigned long HTTP_DEFERRED_TIMEOUT = 30000;    // Deferred responses (sync gate commands) give up with 504
+const unsigned long HTTP_WATCH_INTERVAL = 1000;       // Socket watcher refreshes its descriptor set at least this often
+const int HTTP_JSON_BUFFER_SIZE = 1536;               // JSON responses are serialized here (gate list, stats, auth info)
+
+// Server-Sent Events (/gate/events)
+const int GATE_EVENTS_MAX_SUBSCRIBERS = 2;            // Each stream holds one of the HTTP connections
+const int GATE_EVENTS_HISTORY = 16;                   // Frames kept for Last-Event-ID resumption
+const unsigned long GATE_EVENTS_HEARTBEAT_INTERVAL = 15000; // Comment line sent to idle streams (proxies, dead peers)
+const unsigned long GATE_EVENTS_RETRY = 3000;         // Reconnection delay advertised to EventSource clients
+const int GATE_EVENT_MAX_SIZE = 320;                  // Frame payload (one gate status), history is kept in place
+static_assert(GATE_EVENTS_MAX_SUBSCRIBERS < HTTP_MAX_CONNECTIONS, "Event streams must leave room for requests");
+
+// Status long polling (/gate/status?since=<version>)
+const unsigned long STATUS_LONG_POLL_TIMEOUT = 25000; // Answered unchanged after this
+const int STATUS_MAX_WAITERS = HTTP_MAX_CONNECTIONS - GATE_EVENTS_MAX_SUBSCRIBERS - 1; // Extra polls answered at once
+const int STATUS_JSON_CACHE_SIZE = 224;               // Per gate: serialized status without the countdowns
+static_assert(STATUS_JSON_CACHE_SIZE + 96 <= GATE_EVENT_MAX_SIZE, "A status with its countdowns must fit in an event frame");
+static_assert(STATUS_MAX_WAITERS >= 1, "Long polling needs at least one waiter slot");
+static_assert(STATUS_MAX_WAITERS + GATE_EVENTS_MAX_SUBSCRIBERS < HTTP_MAX_CONNECTIONS,
+              "Streams and long polls must leave a connection for gate commands");
+static_assert(STATUS_LONG_POLL_TIMEOUT < HTTP_DEFERRED_TIMEOUT, "Long polls must end before the server gives up with 504");
+
+// Main loop scheduling (the loop sleeps until the earliest deadline or a wake-up)
+const unsigned long LOOP_MAX_SLEEP = 1000;            // Upper bound on a single sleep
+const int LOOP_MAX_DEADLINE_SOURCES = 4;
+const unsigned long COMMAND_POLL_INTERVAL = 50;       // Network loop tick while gate commands are in flight
+const unsigned long SENSOR_POLL_INTERVAL = 100;       // readState() polling when edge capture is unavailable
+
+// Task layout: gate control on core 1 (real time), network on core 0 next to the Wi-Fi stack
+const int GATE_TASK_CORE = 1;
+const int GATE_TASK_PRIORITY = 3;                     // Above the network task
+const int NETWORK_TASK_CORE = 0;
+const int NETWORK_TASK_PRIORITY = 1;
+const int GATE_QUEUE_SIZE = 8;                        // Requests/events between the two (power of two)
+
+// Asynchronous gate commands (202 Accepted + /gate/operations/{id})
+const int GATE_COMMAND_SLOTS = 8;                     // Recent operations kept queryable
+const bool GATE_COMMANDS_ASYNC_BY_DEFAULT = false;    // Otherwise opt-in with ?async=1 or Prefer: respond-async
+
+// Local JWT verification (JWKS)
+const int JWKS_MAX_KEYS = 4;                          // Signing keys kept from the realm JWKS
+const unsigned long JWKS_MIN_REFRESH_INTERVAL = 60000; // Rate limit for refreshes on unknown kid
+const unsigned long JWKS_MAX_AGE = 86400000;          // Periodic refresh to follow key rotation (24 h)
+const long JWT_CLOCK_SKEW = 60;                       // Leeway for exp/nbf checks (seconds)
+
+// Keycloak HTTP connection
+const unsigned long KEYCLOAK_HTTP_TIMEOUT = 12000;     // Per-request read timeout
+const unsigned long KEYCLOAK_REWARM_INTERVAL = 60000;  // Min delay between background reconnects
+const int KEYCLOAK_KEEPALIVE_MAX_REFUSALS = 3;         // Closed-after-response count before one-shot mode
+const unsigned long KEYCLOAK_HANDSHAKE_TIMEOUT = 15000; // Background (pre-warm) TLS handshake
+const unsigned long AUTH_REQUEST_BUDGET = 5000;        // Whole auth step of a request, Keycloak calls included
+
+// Keycloak circuit breaker: fail fast (503) while Keycloak is down or slow
+const int KEYCLOAK_BREAKER_WINDOW = 10;                // Recent calls the failure rate is computed over
+const int KEYCLOAK_BREAKER_MIN_CALLS = 4;              // Don't trip on fewer calls than this
+const int KEYCLOAK_BREAKER_FAILURE_PERCENT = 50;       // Failed or slow calls that open the circuit
+const unsigned long KEYCLOAK_SLOW_CALL_THRESHOLD = 3000; // Slower calls count as failures
+const unsigned long KEYCLOAK_BREAKER_OPEN_TIME = 30000; // Open state before each background probe
+
+// Outbound host resolution cache (DNS / mDNS)
+const int HOST_RESOLVER_MAX_ENTRIES = 4;
+const unsigned long DNS_CACHE_TTL = 300000;            // Unicast DNS records (5 minutes)
+const unsigned long MDNS_CACHE_TTL = 120000;           // mDNS default record TTL (RFC 6762)
+const unsigned long MDNS_QUERY_TIMEOUT = 2000;
+const unsigned long HOST_RESOLVER_CHECK_INTERVAL = 10000;
+const int HOST_RESOLVER_REFRESH_PERCENT = 80;          // Refresh once 80% of the TTL has elapsed
+
+// Validated token cache (entries also expire at the token's own exp)
+const int TOKEN_CACHE_SIZE = 8;
+const unsigned long TOKEN_CACHE_MAX_AGE = 300000;     // 5 minutes
+
+// Recently rejected tokens: answered 401 again without introspection or signature check
+const int REJECTED_TOKEN_CACHE_SIZE = 16;
+const unsigned long REJECTED_TOKEN_CACHE_TTL = 60000;  // Keep short: "not yet valid" tokens become valid
+
+// Per-client auth failure tracking (429 before any token validation)
+const int CLIENT_THROTTLE_SLOTS = 16;                  // Clients tracked at once
+const int CLIENT_THROTTLE_FAILURES = 3;                // Failures before throttling
+const unsigned long CLIENT_THROTTLE_INTERVAL = 2000;   // Throttled: one attempt per interval
+const int CLIENT_BAN_FAILURES = 10;                    // Failures before a ban
+const unsigned long CLIENT_BAN_DURATION = 300000;      // 5 minutes
+const unsigned long CLIENT_FAILURE_WINDOW = 600000;    // Failures older than this are forgotten (10 minutes)
+
+// Device-issued session tokens (/auth/session), HMAC-signed with a per-boot key
+const unsigned long SESSION_TOKEN_TTL = 300000;        // 5 minutes, never beyond the Keycloak token's exp
+const int SESSION_TOKEN_MAX_LENGTH = 256;              // Longer bearer tokens are not session tokens
+const int SESSION_TOKEN_SUB_MAX = 64;                  // Bytes, fits federated subs (f:<provider>:<id>)
+const int SESSION_TOKEN_USERNAME_MAX = 56;             // Bytes; longer identities keep using the Keycloak token
+const int AUTH_SESSION_SLOTS = 2;                      // Exchanges waiting for the auth worker
+
+// Guest access codes (GUEST_CODES): TOTP, RFC 6238 defaults
+const int GUEST_SLOTS = 8;
+const int GUEST_LABEL_MAX = 24;
+const int GUEST_SECRET_MAX = 32;                       // Bytes (20 for the usual 32-character base32 secret)
+const int GUEST_CODE_DIGITS = 6;
+const int64_t GUEST_TOTP_STEP = 30;                    // Seconds
+const int GUEST_TOTP_DRIFT = 1;                        // Steps accepted on each side (clock drift, typing time)
+// Six digits are guessable: wrong codes are throttled much harder than bearer tokens
+const int GUEST_THROTTLE_FAILURES = 1;                 // Wrong codes before throttling
+const unsigned long GUEST_THROTTLE_INTERVAL = 5000;    // Throttled: one code per interval
+const int GUEST_BAN_FAILURES = 5;                      // Wrong codes before a ban
+const unsigned long GUEST_BAN_DURATION = 3600000;      // 1 hour
+const unsigned long GUEST_FAILURE_WINDOW = 3600000;    // Wrong codes older than this are forgotten
+static_assert(GUEST_THROTTLE_FAILURES < GUEST_BAN_FAILURES, "Guests are throttled before being banned");
+
+// Authorization policy (AUTH_POLICY): role/group rules compiled to bit masks at boot
+const int POLICY_MAX_RULES = 16;
+const int POLICY_ROLE_NAME_MAX = 40;                   // Keycloak role or group name, as found in the token
+
+// EMQX action log
+const int EMQX_MESSAGE_BUFFER_SIZE = 512;             // One serialized log message (the token is truncated)
+const int MQTT_BATCH_MAX_SIZE = 1024;                 // Records coalesced into one publish (EMQX_BATCH_WINDOW > 0)
+
+// MQTT connection (established from the network loop, never blocking it for the TCP handshake)
+const unsigned long MQTT_CONNECT_TIMEOUT = 5000;      // TCP handshake with the broker
+const unsigned long MQTT_CONNECT_POLL_INTERVAL = 50;  // Loop tick while the handshake is in progress
+const uint16_t MQTT_CONNACK_TIMEOUT = 2;              // Seconds to wait for CONNACK once TCP is up
+const unsigned long MQTT_RECONNECT_MIN_DELAY = 1000;  // Backoff after the first failure (ms, jittered)
+const unsigned long MQTT_RECONNECT_MAX_DELAY = 60000; // Backoff cap
+const uint16_t MQTT_CLIENT_BUFFER_SIZE = 256;         // PubSubClient buffer: CONNECT packet, PUBLISH header + topic
+const uint16_t MQTT_PUBLISH_HEADER_SIZE = 7;          // Fixed header (up to 5 bytes) + topic length field
+
+// MQTT store-and-forward (messages queued while the broker is unreachable)
+const int MQTT_OUTBOX_PAYLOAD_SIZE = MQTT_BATCH_MAX_SIZE;  // A single message or a batch
+const int MQTT_OUTBOX_RAM_ENTRIES = 8;                // Oldest pending messages, in RAM
+const unsigned long MQTT_OUTBOX_SPILL_MAX_SIZE = 65536; // Newer ones go to flash up to this size, then are dropped
+const int MQTT_OUTBOX_REPLAY_BATCH = 8;               // Messages published per loop() after a reconnect
+const char* const MQTT_OUTBOX_SPILL_PATH = "/littlefs/mqtt_outbox.bin"; // LittleFS is mounted on the VFS at /littlefs
+
+// MQTT gate state topic (deltas on change, retained snapshot)
+const unsigned long MQTT_STATE_SNAPSHOT_DELAY = 2000; // Retained snapshot refreshed this long after the last change
 
-// Main loop delay
-const unsigned long MAIN_LOOP_DELAY = 100;
+// MQTT gate commands (HMAC-SHA256 signed with EMQX_COMMAND_SECRET)
+const uint16_t MQTT_COMMAND_MAX_SIZE = 384;           // Inbound command payload, sizes PubSubClient's buffer
+const int MQTT_COMMAND_NONCE_MAX = 32;                // Characters
+const int MQTT_COMMAND_NONCE_SLOTS = 16;              // Nonces remembered for replay detection
+const long MQTT_COMMAND_MAX_SKEW = 30;                // Seconds between the command timestamp and the device clock
+const unsigned long MQTT_COMMAND_REFUSAL_INTERVAL = 1000; // At most one audited and answered refusal per interval
 
 #endif // CONFIG_H
\ No newline at end of file
@@ -30,7 +30,7 @@ namespace {
     }
 }
 
-EmqxConfig::EmqxConfig() : _brokerPort(1883), _enabled(false) {
+EmqxConfig::EmqxConfig() : _brokerPort(1883), _batchWindow(0), _enabled(false) {
 }
 
 void EmqxConfig::initialize() {
@@ -46,6 +46,12 @@ void EmqxConfig::initialize() {
     _topic = loadEnvVar("EMQX_TOPIC", "garage/authorized");
     _unauthorizedTopic = loadEnvVar("EMQX_UNAUTHORIZED_TOPIC", "garage/unauthorized");
     
+    // Format des messages par topic et fenêtre de regroupement
+    _encoding = loadEncoding("EMQX_ENCODING");
+    _unauthorizedEncoding = loadEncoding("EMQX_UNAUTHORIZED_ENCODING");
+    long batchWindow = loadEnvVar("EMQX_BATCH_WINDOW", "0").toInt();
+    _batchWindow = batchWindow > 0 ? static_cast<unsigned long>(batchWindow) : 0;
+    
     // Generate a unique client ID based on ESP32 MAC address
 #ifdef UNIT_TEST
     String mac = "00:00:00:00:TEST";
@@ -54,6 +60,14 @@ void EmqxConfig::initialize() {
 #endif
     _clientId = String("ESP32_") + sanitizeMac(mac);
     
+    // État des portes publié en continu, un topic par carte
+    _stateTopic = loadEnvVar("EMQX_STATE_TOPIC", String("garage/") + _clientId + "/state");
+    
+    // Canal de commandes : un topic par carte, désactivé sans secret partagé
+    _commandSecret = loadEnvVar("EMQX_COMMAND_SECRET");
+    _commandTopic = loadEnvVar("EMQX_COMMAND_TOPIC", String("garage/") + _clientId + "/command");
+    _commandReplyTopic = loadEnvVar("EMQX_COMMAND_REPLY_TOPIC", String("garage/") + _clientId + "/reply");
+    
     _enabled = _brokerHost.length() > 0;
     
     if (_enabled) {
@@ -70,6 +84,7 @@ bool EmqxConfig::isValid() const {
         _brokerPort > 0 &&
         _topic.length() > 0 && 
         _unauthorizedTopic.length() > 0 &&
+        _stateTopic.length() > 0 &&
         _clientId.length() > 0;
 }
 
@@ -92,8 +107,16 @@ void EmqxConfig::printConfig() const {
     Serial.println(_topic);
     Serial.print("  Unauthorized Topic: ");
     Serial.println(_unauthorizedTopic);
+    Serial.print("  Encoding: ");
+    Serial.println(_encoding + " / " + _unauthorizedEncoding);
+    Serial.print("  Batch Window: ");
+    Serial.println(_batchWindow == 0 ? String("(none)") : intToString(static_cast<int>(_batchWindow)) + " ms");
     Serial.print("  Client ID: ");
     Serial.println(_clientId);
+    Serial.print("  State Topic: ");
+    Serial.println(_stateTopic);
+    Serial.print("  Commands: ");
+    Serial.println(isCommandChannelEnabled() ? _commandTopic + " -> " + _commandReplyTopic : String("(disabled)"));
     Serial.print("  Status: ");
     Serial.println(_enabled ? String("Enabled") : String("Disabled"));
 }
@@ -137,7 +160,60 @@ String EmqxConfig::loadEnvVar(const String& varName, const String& defaultValue)
         #else
             return defaultValue.length() == 0 ? "garage/unauthorized" : defaultValue;
         #endif
+    } else if (varName == "EMQX_ENCODING") {
+        #ifdef EMQX_ENCODING
+            return String(EMQX_ENCODING);
+        #else
+            return defaultValue;
+        #endif
+    } else if (varName == "EMQX_UNAUTHORIZED_ENCODING") {
+        #ifdef EMQX_UNAUTHORIZED_ENCODING
+            return String(EMQX_UNAUTHORIZED_ENCODING);
+        #else
+            return defaultValue;
+        #endif
+    } else if (varName == "EMQX_BATCH_WINDOW") {
+        #ifdef EMQX_BATCH_WINDOW
+            return String(EMQX_BATCH_WINDOW);
+        #else
+            return defaultValue;
+        #endif
+    } else if (varName == "EMQX_STATE_TOPIC") {
+        #ifdef EMQX_STATE_TOPIC
+            return String(EMQX_STATE_TOPIC).length() == 0 ? defaultValue : String(EMQX_STATE_TOPIC);
+        #else
+            return defaultValue;
+        #endif
+    } else if (varName == "EMQX_COMMAND_SECRET") {
+        #ifdef EMQX_COMMAND_SECRET
+            return String(EMQX_COMMAND_SECRET);
+        #else
+            return defaultValue;
+        #endif
+    } else if (varName == "EMQX_COMMAND_TOPIC") {
+        #ifdef EMQX_COMMAND_TOPIC
+            return String(EMQX_COMMAND_TOPIC).length() == 0 ? defaultValue : String(EMQX_COMMAND_TOPIC);
+        #else
+            return defaultValue;
+        #endif
+    } else if (varName == "EMQX_COMMAND_REPLY_TOPIC") {
+        #ifdef EMQX_COMMAND_REPLY_TOPIC
+            return String(EMQX_COMMAND_REPLY_TOPIC).length() == 0 ? defaultValue : String(EMQX_COMMAND_REPLY_TOPIC);
+        #else
+            return defaultValue;
+        #endif
     }
     
     return defaultValue;
+}
+
+String EmqxConfig::loadEncoding(const String& varName) {
+    String encoding = loadEnvVar(varName, "json");
+    if (encoding == "cbor") {
+        return encoding;
+    }
+    if (encoding.length() > 0 && encoding != "json") {
+        Serial.println("[EMQX][Warning] " + varName + "=" + encoding + " not supported, using json");
+    }
+    return "json";
 }
\ No newline at end of file
@@ -22,6 +22,14 @@ public:
     String getTopic() const { return _topic; }
     String getUnauthorizedTopic() const { return _unauthorizedTopic; }
     String getClientId() const { return _clientId; }
+    String getEncoding() const { return _encoding; }                          // "json" ou "cbor"
+    String getUnauthorizedEncoding() const { return _unauthorizedEncoding; }
+    unsigned long getBatchWindow() const { return _batchWindow; }             // ms, 0 : un message par action
+    String getStateTopic() const { return _stateTopic; }                      // État des portes, retenu
+    String getCommandTopic() const { return _commandTopic; }
+    String getCommandReplyTopic() const { return _commandReplyTopic; }
+    String getCommandSecret() const { return _commandSecret; }
+    bool isCommandChannelEnabled() const { return _commandSecret.length() > 0; }  // Commandes MQTT signées
     bool isEmqxEnabled() const { return _enabled; }
     
     // Validation
@@ -36,10 +44,20 @@ private:
     String _topic;
     String _unauthorizedTopic;
     String _clientId;
+    String _encoding;
+    String _unauthorizedEncoding;
+    unsigned long _batchWindow;
+    String _stateTopic;
+    String _commandTopic;
+    String _commandReplyTopic;
+    String _commandSecret;
     bool _enabled;
     
     // Charge une variable d'environnement
     String loadEnvVar(const String& varName, const String& defaultValue = "");
+    
+    // "cbor" ou "json" (valeur par défaut, y compris pour une valeur inconnue)
+    String loadEncoding(const String& varName);
 };
 
 #endif // EMQX_CONFIG_H
\ No newline at end of file
@@ -1,7 +1,14 @@
 #ifndef UNIT_TEST
 
 #include "EmqxLogger.h"
+#include "CborWriter.h"
+#include "HostResolver.h"
+#include "JsonWriter.h"
 #include <WiFi.h>
+#include <LittleFS.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <lwip/sockets.h>
 
 namespace {
     // Truncate a potentially long token to first 20 + "..." + last 20 characters
@@ -15,167 +22,472 @@ namespace {
         String tail = token.substring(len - keep);
         return head + String("...") + tail;
     }
+    
+    MqttBatch::Encoding parseEncoding(const String& encoding) {
+        return encoding == "cbor" ? MqttBatch::ENCODING_CBOR : MqttBatch::ENCODING_JSON;
+    }
+    
+    // Same fields whatever the encoding: JsonWriter and CborWriter share their calls
+    template <typename Writer>
+    void writeLogRecord(Writer& writer, const GateActionLog& log, uint32_t sequence, uint32_t bootId,
+                        const String& deviceId) {
+        writer.beginObject();
+        writer.field("seq", sequence);
+        writer.field("boot_id", bootId);
+        writer.field("timestamp", millis());
+        writer.field("action", log.action);
+        writer.field("gate_id", log.gateId);
+        writer.field("authorized", log.authorized);
+        writer.field("device_id", deviceId);
+        
+        // Ajouter sub et name s'ils existent
+        if (!log.sub.isEmpty()) {
+            writer.field("sub", log.sub);
+        }
+        
+        if (!log.name.isEmpty()) {
+            writer.field("name", log.name);
+        }
+        
+        // Pour les actions non autorisées, inclure le token (tronqué)
+        if (!log.authorized && !log.token.isEmpty()) {
+            writer.field("token", log.token);
+        }
+        writer.endObject();
+    }
 }
 
 EmqxLogger::EmqxLogger(const String& brokerHost, int brokerPort, const String& username, const String& password,
                        const String& clientId, const String& topic, const String& unauthorizedTopic)
     : _brokerHost(brokerHost), _brokerPort(brokerPort), _username(username), _password(password),
       _clientId(clientId), _topic(topic), _unauthorizedTopic(unauthorizedTopic),
-      _mqttClient(_wifiClient), _lastReconnectAttempt(0) {
+      _mqttClient(_wifiClient), _state(CONNECTION_WAITING), _connectSocket(-1), _connectStartedAt(0), _nextAttemptAt(0),
+      _backoff(MQTT_RECONNECT_MIN_DELAY, MQTT_RECONNECT_MAX_DELAY), _connectAttempts(0),
+      _bootId(esp_random()), _replayPending(false), _inCallback(false), _connectionCount(0) {
     
     _mqttClient.setServer(_brokerHost.c_str(), _brokerPort);
-    _mqttClient.setCallback(mqttCallback);
+    _mqttClient.setCallback([this](char* topic, byte* payload, unsigned int length) {
+        onMqttMessage(topic, payload, length);
+    });
+    // Payloads are streamed: the buffer only holds CONNECT and a PUBLISH header with its topic
+    _mqttClient.setBufferSize(MQTT_CLIENT_BUFFER_SIZE);
+    reserveTopic(_topic);
+    reserveTopic(_unauthorizedTopic);
+    // Bounds the only blocking step left: waiting for CONNACK on an established connection
+    _mqttClient.setSocketTimeout(MQTT_CONNACK_TIMEOUT);
+}
+
+EmqxLogger::~EmqxLogger() {
+    if (_connectSocket >= 0) {
+        close(_connectSocket);
+    }
 }
 
 bool EmqxLogger::begin() {
     Serial.println("Initializing EMQX MQTT logger...");
-    return connectMqtt();
+    
+    // Messages that don't fit in RAM while the broker is unreachable are kept in flash
+    if (LittleFS.begin(true)) {
+        _outbox.begin(MQTT_OUTBOX_SPILL_PATH);
+    } else {
+        Serial.println("[MQTT][Warning] LittleFS mount failed");
+        _outbox.begin(nullptr);
+    }
+    
+    startConnect(millis());
+    return _state != CONNECTION_WAITING;
+}
+
+void EmqxLogger::setPublishFormat(const String& encoding, const String& unauthorizedEncoding,
+                                  unsigned long batchWindow) {
+    // Anything still batched was encoded the old way
+    flushBatch(TOPIC_AUTHORIZED);
+    flushBatch(TOPIC_UNAUTHORIZED);
+    _batches[TOPIC_AUTHORIZED].configure(parseEncoding(encoding), batchWindow);
+    _batches[TOPIC_UNAUTHORIZED].configure(parseEncoding(unauthorizedEncoding), batchWindow);
+}
+
+void EmqxLogger::setCommandChannel(const String& commandTopic, const String& replyTopic, MqttCommandHandler handler) {
+    _commandTopic = commandTopic;
+    _replyTopic = replyTopic;
+    _commandHandler = handler;
+    
+    // An inbound PUBLISH is read whole into PubSubClient's buffer (+2: QoS 1 packet identifier)
+    unsigned int inbound = MQTT_PUBLISH_HEADER_SIZE + 2 + _commandTopic.length() + MQTT_COMMAND_MAX_SIZE;
+    if (inbound > _mqttClient.getBufferSize()) {
+        _mqttClient.setBufferSize(inbound);
+    }
+    reserveTopic(_replyTopic);
+    if (isConnected()) {
+        _mqttClient.subscribe(_commandTopic.c_str(), 1);
+    }
+}
+
+void EmqxLogger::setStateTopic(const String& stateTopic) {
+    _stateTopic = stateTopic;
+    reserveTopic(_stateTopic);
+}
+
+void EmqxLogger::reserveTopic(const String& topic) {
+    // beginPublish() copies the topic into PubSubClient's buffer without a bounds check
+    unsigned int publishHeader = MQTT_PUBLISH_HEADER_SIZE + topic.length();
+    if (publishHeader > _mqttClient.getBufferSize()) {
+        _mqttClient.setBufferSize(publishHeader);
+    }
+}
+
+bool EmqxLogger::publishState(const char* payload, size_t length, bool retained) {
+    if (_stateTopic.isEmpty() || !isConnected()) {
+        return false;
+    }
+    return publishMessage(_stateTopic, payload, length, retained);
+}
+
+void EmqxLogger::publishReply(const char* payload, size_t length) {
+    // Same ordering and retry as the logs; not batched, the backend is waiting for it
+    uint32_t sequence = _outbox.nextSequence();
+    if (!_outbox.push(sequence, TOPIC_COMMAND_REPLY, payload, length)) {
+        Serial.println("[MQTT][Error] Outbox full, command reply dropped");
+        return;
+    }
+    flushOutbox();
 }
 
 void EmqxLogger::loop() {
-    if (!_mqttClient.connected()) {
-        unsigned long now = millis();
-        if (now - _lastReconnectAttempt > RECONNECT_INTERVAL) {
-            _lastReconnectAttempt = now;
-            if (connectMqtt()) {
-                _lastReconnectAttempt = 0;
+    unsigned long now = millis();
+    
+    // Closed batches join the outbox whatever the connection state
+    for (int topic = 0; topic < LOG_TOPIC_COUNT; topic++) {
+        if (_batches[topic].isDue(now)) {
+            flushBatch(static_cast<OutboxTopic>(topic));
+        }
+    }
+    
+    switch (_state) {
+        case CONNECTION_UP:
+            if (!_mqttClient.loop()) {
+                connectFailed(now, "connection lost");
+                return;
+            }
+            flushOutbox();
+            break;
+        case CONNECTION_TCP_PENDING:
+            pollConnect(now);
+            break;
+        case CONNECTION_WAITING:
+            if (static_cast<long>(now - _nextAttemptAt) >= 0) {
+                startConnect(now);
             }
+            break;
+    }
+}
+
+void EmqxLogger::onNetworkUp() {
+    _backoff.reset();
+    if (_state == CONNECTION_WAITING) {
+        _nextAttemptAt = millis();
+    }
+}
+
+unsigned long EmqxLogger::getNextDeadline(unsigned long now) {
+    unsigned long deadline;
+    switch (_state) {
+        case CONNECTION_UP:
+            // PubSubClient sends PINGREQ from loop(): run it twice per keepalive period
+            deadline = _replayPending ? 0 : MQTT_KEEPALIVE * 1000UL / 2;
+            break;
+        case CONNECTION_TCP_PENDING:
+            deadline = MQTT_CONNECT_POLL_INTERVAL;
+            break;
+        case CONNECTION_WAITING:
+        default: {
+            long remaining = static_cast<long>(_nextAttemptAt - now);
+            deadline = remaining > 0 ? static_cast<unsigned long>(remaining) : 0;
+            break;
+        }
+    }
+    for (int topic = 0; topic < LOG_TOPIC_COUNT; topic++) {
+        unsigned long due = _batches[topic].timeUntilDue(now);
+        if (due < deadline) {
+            deadline = due;
         }
-    } else {
-        _mqttClient.loop();
     }
+    return deadline;
 }
 
-bool EmqxLogger::connectMqtt() {
-    Serial.print("Attempting MQTT connection to ");
-    Serial.print(_brokerHost);
-    Serial.print(":");
-    Serial.print(_brokerPort);
-    Serial.print(" as ");
-    Serial.print(_clientId);
-    Serial.print("...");
+void EmqxLogger::startConnect(unsigned long now) {
+    _connectAttempts++;
+    Serial.println("[MQTT] Connecting to " + _brokerHost + ":" + String(_brokerPort) + " as " + _clientId);
     
-    bool connected;
-    if (_username.isEmpty()) {
-        // Connect without authentication
-        connected = _mqttClient.connect(_clientId.c_str());
-    } else {
-        // Connect with authentication
-        connected = _mqttClient.connect(_clientId.c_str(), _username.c_str(), _password.c_str());
+    // Cached address: reconnects don't pay a DNS / mDNS lookup each time
+    IPAddress brokerIp;
+    if (!HostResolver::getInstance().resolve(_brokerHost, brokerIp)) {
+        connectFailed(now, "broker address unknown");
+        return;
     }
     
-    if (connected) {
-        Serial.println(" connected!");
-        return true;
-    } else {
-        Serial.print(" failed, rc=");
-        Serial.print(_mqttClient.state());
-        Serial.println(" retrying in 5 seconds");
-        return false;
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0) {
+        connectFailed(now, "no socket available");
+        return;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(_brokerPort);
+    address.sin_addr.s_addr = static_cast<uint32_t>(brokerIp);
+    
+    // Returns at once: the handshake is watched by pollConnect() from the next loops
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        connectFailed(now, "connect refused");
+        return;
+    }
+    _connectSocket = fd;
+    _connectStartedAt = now;
+    _state = CONNECTION_TCP_PENDING;
+}
+
+void EmqxLogger::pollConnect(unsigned long now) {
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(_connectSocket, &writable);
+    struct timeval noWait = {0, 0};
+    int ready = select(_connectSocket + 1, nullptr, &writable, nullptr, &noWait);
+    
+    if (ready == 0) {
+        if (now - _connectStartedAt >= MQTT_CONNECT_TIMEOUT) {
+            close(_connectSocket);
+            _connectSocket = -1;
+            connectFailed(now, "TCP connect timeout");
+        }
+        return;
+    }
+    
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (ready < 0 || getsockopt(_connectSocket, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0) {
+        close(_connectSocket);
+        _connectSocket = -1;
+        connectFailed(now, "TCP connect failed");
+        return;
+    }
+    
+    // Established: WiFiClient takes the socket over (blocking again, as it expects)
+    fcntl(_connectSocket, F_SETFL, fcntl(_connectSocket, F_GETFL, 0) & ~O_NONBLOCK);
+    _wifiClient = WiFiClient(_connectSocket);
+    _connectSocket = -1;
+    
+    if (!completeMqttConnect()) {
+        _wifiClient.stop();
+        connectFailed(now, "MQTT CONNECT rejected");
+        return;
+    }
+    
+    Serial.println("[MQTT] Connected after " + String(_backoff.failures() + 1) + " attempt(s)");
+    _state = CONNECTION_UP;
+    _connectionCount++;
+    // Clean session: the subscription is renewed on every connection
+    if (!_commandTopic.isEmpty() && !_mqttClient.subscribe(_commandTopic.c_str(), 1)) {
+        Serial.println("[MQTT][Warning] Subscription to " + _commandTopic + " failed");
     }
+    _backoff.reset();
+    flushOutbox(); // Replay what was queued during the outage
+}
+
+bool EmqxLogger::completeMqttConnect() {
+    // PubSubClient skips its own (blocking) TCP connect when the client is already connected.
+    // Without authentication user/password stay null; the retained will marks the state topic offline.
+    static const char offline[] = "{\"online\":false}";
+    return _mqttClient.connect(_clientId.c_str(),
+                               _username.isEmpty() ? nullptr : _username.c_str(),
+                               _username.isEmpty() ? nullptr : _password.c_str(),
+                               _stateTopic.isEmpty() ? nullptr : _stateTopic.c_str(), 0, true, offline);
+}
+
+void EmqxLogger::connectFailed(unsigned long now, const char* reason) {
+    unsigned long wait = _backoff.nextDelay(esp_random());
+    _state = CONNECTION_WAITING;
+    _nextAttemptAt = now + wait;
+    _replayPending = false;
+    Serial.println("[MQTT] " + String(reason) + " (rc=" + String(_mqttClient.state()) + "), retrying in " +
+                   String(wait) + " ms");
 }
 
 bool EmqxLogger::isConnected() {
-    return _mqttClient.connected();
+    return _state == CONNECTION_UP && _mqttClient.connected();
 }
 
-void EmqxLogger::logAuthorizedAction(const String& action, const String& sub, const String& name) {
+void EmqxLogger::logAuthorizedAction(const String& action, const String& gateId, const String& sub, const String& name) {
+    const String noToken;
     GateActionLog log = {
         .action = action,
+        .gateId = gateId,
         .sub = sub,
         .name = name,
         .authorized = true,
-        .token = ""
+        .token = noToken
     };
     
-    String message = buildMessage(log);
-    
-    Serial.println("Logging authorized action: " + action + " by user: " + name + " (sub: " + sub + ")");
+    Serial.println("Logging authorized action: " + action + " on gate " + gateId + " by user: " + name + " (sub: " + sub + ")");
     
-    if (!publishMessage(_topic, message)) {
-        Serial.println("Failed to send authorized action log to EMQX");
-    }
+    enqueueMessage(log, TOPIC_AUTHORIZED);
 }
 
-void EmqxLogger::logUnauthorizedAction(const String& action, const String& sub, const String& name, const String& token) {
+void EmqxLogger::logUnauthorizedAction(const String& action, const String& gateId, const String& sub, const String& name,
+                                       const String& token) {
     // Masquer la majorité du token pour réduire la taille et améliorer la sécurité
     String maskedToken = truncateToken(token);
 
     GateActionLog log = {
         .action = action,
+        .gateId = gateId,
         .sub = sub,
         .name = name,
         .authorized = false,
         .token = maskedToken
     };
     
-    String message = buildMessage(log);
+    Serial.println("Logging unauthorized action: " + action + " on gate " + gateId + " - sub: " + sub + ", name: " + name);
     
-    Serial.println("Logging unauthorized action: " + action + " - sub: " + sub + ", name: " + name);
-    
-    if (!publishMessage(_unauthorizedTopic, message)) {
-        Serial.println("Failed to send unauthorized action log to EMQX");
-    }
+    enqueueMessage(log, TOPIC_UNAUTHORIZED);
 }
 
-bool EmqxLogger::publishMessage(const String& topic, const String& message) {
+bool EmqxLogger::publishMessage(const String& topic, const char* message, size_t length, bool retained) {
     if (!_mqttClient.connected()) {
         Serial.println("MQTT not connected, cannot publish message");
         return false;
     }
     
-    Serial.println("Publishing to topic: " + topic);
-    Serial.println("Message: " + message);
+    // Not dumped: CBOR payloads are binary
+    Serial.println("Publishing " + String(length) + " bytes to topic: " + topic);
     
-    bool success = _mqttClient.publish(topic.c_str(), message.c_str());
+    // Length known up front: header and topic go out first, then the payload straight from the outbox entry
+    bool success = _mqttClient.beginPublish(topic.c_str(), length, retained) &&
+                   _mqttClient.write(reinterpret_cast<const uint8_t*>(message), length) == length &&
+                   _mqttClient.endPublish();
     
     if (success) {
         Serial.println("Message published successfully to EMQX");
     } else {
+        // Part of the packet may have been sent: the MQTT stream can't be resumed, reconnect
         Serial.println("Failed to publish message to EMQX");
+        _wifiClient.stop();
     }
     
     return success;
 }
 
-String EmqxLogger::buildMessage(const GateActionLog& log) {
-    size_t capacity = 256 + log.action.length() + log.sub.length() + log.name.length() + log.token.length();
-    DynamicJsonDocument doc(capacity);
-    
-    doc["timestamp"] = millis();
-    doc["action"] = log.action;
-    doc["authorized"] = log.authorized;
-    doc["device_id"] = _clientId;
+void EmqxLogger::enqueueMessage(const GateActionLog& log, OutboxTopic topic) {
+    MqttBatch& batch = _batches[topic];
     
-    // Ajouter sub et name s'ils existent
-    if (!log.sub.isEmpty()) {
-        doc["sub"] = log.sub;
+    // Numbered even if dropped: the gap tells the consumer something was lost
+    uint32_t sequence = _outbox.nextSequence();
+    size_t length = buildMessage(log, sequence, batch.encoding());
+    if (!length) {
+        return;
     }
     
-    if (!log.name.isEmpty()) {
-        doc["name"] = log.name;
+    if (batch.window() > 0) {
+        // Published when the window closes (loop()), or now if this record doesn't fit
+        if (!batch.add(sequence, _messageBuffer, length, millis())) {
+            flushBatch(topic);
+            batch.add(sequence, _messageBuffer, length, millis());
+        }
+        return;
     }
     
-    // Pour les actions non autorisées, inclure le token complet
-    if (!log.authorized && !log.token.isEmpty()) {
-        doc["token"] = log.token;
+    if (!_outbox.push(sequence, topic, _messageBuffer, length)) {
+        Serial.println("[MQTT][Error] Outbox full, message " + String(sequence) + " dropped");
+        return;
+    }
+    if (!isConnected()) {
+        Serial.println("[MQTT] Broker unreachable, message " + String(sequence) + " queued (" +
+                       String(_outbox.depth()) + " pending)");
+        return;
+    }
+    flushOutbox();
+}
+
+void EmqxLogger::flushBatch(OutboxTopic topic) {
+    MqttBatch& batch = _batches[topic];
+    if (batch.isEmpty()) {
+        return;
+    }
+    // One outbox entry numbered after its newest record: replay and gap detection work as for single messages
+    size_t length = batch.finish();
+    if (!_outbox.push(batch.lastSequence(), topic, batch.payload(), length)) {
+        Serial.println("[MQTT][Error] Outbox full, batch of " + String(batch.count()) + " messages dropped");
+    }
+    batch.clear();
+}
+
+void EmqxLogger::flushOutbox() {
+    // Inside PubSubClient's callback the payload lives in the client buffer a publish reuses:
+    // loop() flushes once _mqttClient.loop() has returned
+    if (_inCallback) {
+        _replayPending = true;
+        return;
+    }
+    _replayPending = false;
+    for (int i = 0; i < MQTT_OUTBOX_REPLAY_BATCH && isConnected(); i++) {
+        const MqttOutbox::Entry* entry = _outbox.front();
+        if (!entry) {
+            return;
+        }
+        if (!publishMessage(topicName(entry->topic), entry->payload, entry->length)) {
+            return; // Stays first in line, retried on the next loop() or after reconnecting
+        }
+        _outbox.pop();
+    }
+    // Batch limit reached: let HTTP run, come back right away
+    _replayPending = isConnected() && !_outbox.isEmpty();
+}
+
+size_t EmqxLogger::buildMessage(const GateActionLog& log, uint32_t sequence, MqttBatch::Encoding encoding) {
+    size_t length;
+    bool overflowed;
+    if (encoding == MqttBatch::ENCODING_CBOR) {
+        CborWriter cbor(reinterpret_cast<uint8_t*>(_messageBuffer), sizeof(_messageBuffer));
+        writeLogRecord(cbor, log, sequence, _bootId, _clientId);
+        length = cbor.length();
+        overflowed = cbor.overflowed();
+    } else {
+        JsonWriter json(_messageBuffer, sizeof(_messageBuffer));
+        writeLogRecord(json, log, sequence, _bootId, _clientId);
+        length = json.length();
+        overflowed = json.overflowed();
     }
     
-    String message;
-    serializeJson(doc, message);
-    
-    return message;
+    if (overflowed) {
+        Serial.println("[EMQX][Error] Log message larger than EMQX_MESSAGE_BUFFER_SIZE");
+        return 0;
+    }
+    return length;
+}
+
+const String& EmqxLogger::topicName(uint8_t topic) const {
+    switch (topic) {
+        case TOPIC_UNAUTHORIZED:
+            return _unauthorizedTopic;
+        case TOPIC_COMMAND_REPLY:
+            return _replyTopic;
+        case TOPIC_AUTHORIZED:
+        default:
+            return _topic;
+    }
 }
 
-void EmqxLogger::mqttCallback(char* topic, byte* payload, unsigned int length) {
-    // Callback for received messages - not currently used but available for future features
-    Serial.print("Message arrived [");
-    Serial.print(topic);
-    Serial.print("] ");
-    for (unsigned int i = 0; i < length; i++) {
-        Serial.print((char)payload[i]);
+void EmqxLogger::onMqttMessage(char* topic, byte* payload, unsigned int length) {
+    if (_commandHandler && _commandTopic == topic) {
+        _inCallback = true;
+        _commandHandler(payload, length);
+        _inCallback = false;
+        return;
     }
-    Serial.println();
+    Serial.println("[MQTT][Warning] Message on unexpected topic " + String(topic) + " ignored");
 }
 
 #endif // UNIT_TEST
\ No newline at end of file
@@ -1,23 +1,34 @@
 #ifndef EMQX_LOGGER_H
 #define EMQX_LOGGER_H
 
+#include <functional>
+#include <limits.h>
+
 #ifdef UNIT_TEST
 #include "../../test/mocks/ArduinoMock.h"
 #else
 #include <Arduino.h>
 #include <WiFiClient.h>
 #include <PubSubClient.h>
-#include <ArduinoJson.h>
+#include "Config.h"
+#include "MqttBatch.h"
+#include "MqttOutbox.h"
+#include "ReconnectBackoff.h"
 #endif
 
+// Références vers les chaînes de l'appelant : rien n'est copié avant la sérialisation
 struct GateActionLog {
-    String action;      // "open" ou "close"
-    String sub;         // Subject du token JWT
-    String name;        // Nom de l'utilisateur
-    bool authorized;    // Si l'action était autorisée
-    String token;       // Token complet (seulement pour les actions non autorisées)
+    const String& action;      // "open" ou "close"
+    const String& gateId;      // Identifiant de la porte (GATES dans Config.h)
+    const String& sub;         // Subject du token JWT
+    const String& name;        // Nom de l'utilisateur
+    bool authorized;           // Si l'action était autorisée
+    const String& token;       // Token tronqué (seulement pour les actions non autorisées)
 };
 
+// Receives the raw payload of a message from the command topic (network loop)
+typedef std::function<void(const uint8_t* payload, unsigned int length)> MqttCommandHandler;
+
 #ifdef UNIT_TEST
 
 class EmqxLogger {
@@ -26,9 +37,17 @@ public:
                const String&, const String&, const String&) {}
 
     bool begin() { return true; }
+    void setPublishFormat(const String&, const String&, unsigned long) {}
+    void setCommandChannel(const String&, const String&, MqttCommandHandler) {}
+    void publishReply(const char*, size_t) {}
+    void setStateTopic(const String&) {}
+    bool publishState(const char*, size_t, bool) { return true; }
+    uint32_t getConnectionCount() const { return 1; }
     void loop() {}
-    void logAuthorizedAction(const String&, const String&, const String&) {}
-    void logUnauthorizedAction(const String&, const String&, const String&, const String&) {}
+    void onNetworkUp() {}
+    unsigned long getNextDeadline(unsigned long) { return ULONG_MAX; }
+    void logAuthorizedAction(const String&, const String&, const String&, const String&) {}
+    void logUnauthorizedAction(const String&, const String&, const String&, const String&, const String&) {}
     bool isConnected() { return true; }
 };
 
@@ -38,21 +57,50 @@ class EmqxLogger {
 public:
     EmqxLogger(const String& brokerHost, int brokerPort, const String& username, const String& password,
                const String& clientId, const String& topic, const String& unauthorizedTopic);
+    ~EmqxLogger();
     
-    // Initialize MQTT connection
+    // Mount the outbox storage and start connecting (returns before the broker answers)
     bool begin();
     
-    // Maintain MQTT connection
+    // Payload encoding per topic ("json" or "cbor") and batching window in ms (0: one publish per action)
+    void setPublishFormat(const String& encoding, const String& unauthorizedEncoding, unsigned long batchWindow);
+    
+    // Subscribe to commandTopic on every connection; replies go to replyTopic through the outbox
+    void setCommandChannel(const String& commandTopic, const String& replyTopic, MqttCommandHandler handler);
+    void publishReply(const char* payload, size_t length);
+    
+    // Retained live state: the broker publishes {"online":false} there if the connection drops.
+    // State messages skip the outbox (a fresh snapshot follows every reconnect): false when not connected.
+    void setStateTopic(const String& stateTopic);
+    bool publishState(const char* payload, size_t length, bool retained);
+    
+    // Incremented by every successful connection (a new session needs a full state snapshot)
+    uint32_t getConnectionCount() const { return _connectionCount; }
+    
+    // Maintain MQTT connection: drives the connection attempt, keepalive, batches and outbox replay
     void loop();
     
+    // Wi-Fi link came back: retry right away instead of waiting for the backoff (network task)
+    void onNetworkUp();
+    
+    // ms before loop() is needed again (keepalive, connection progress, next attempt or batch due)
+    unsigned long getNextDeadline(unsigned long now);
+    
     // Log une action de porte autorisée
-    void logAuthorizedAction(const String& action, const String& sub, const String& name);
+    void logAuthorizedAction(const String& action, const String& gateId, const String& sub, const String& name);
     
     // Log une action de porte non autorisée
-    void logUnauthorizedAction(const String& action, const String& sub, const String& name, const String& token);
+    void logUnauthorizedAction(const String& action, const String& gateId, const String& sub, const String& name,
+                               const String& token);
     
     // Check if connected
     bool isConnected();
+    
+    // Messages waiting for the broker (RAM + spill file) and counters
+    const MqttOutbox& getOutbox() const { return _outbox; }
+    
+    uint32_t getConnectAttempts() const { return _connectAttempts; }
+    uint32_t getConsecutiveFailures() const { return _backoff.failures(); }
 
 private:
     String _brokerHost;
@@ -66,20 +114,58 @@ private:
     WiFiClient _wifiClient;
     PubSubClient _mqttClient;
     
-    unsigned long _lastReconnectAttempt;
-    static const unsigned long RECONNECT_INTERVAL = 5000; // 5 seconds
+    // Connection state machine, driven by loop()
+    enum ConnectionState { CONNECTION_WAITING, CONNECTION_TCP_PENDING, CONNECTION_UP };
+    ConnectionState _state;
+    int _connectSocket;                // Non-blocking socket while CONNECTION_TCP_PENDING
+    unsigned long _connectStartedAt;
+    unsigned long _nextAttemptAt;      // CONNECTION_WAITING: when the next attempt starts
+    ReconnectBackoff _backoff;
+    uint32_t _connectAttempts;
+    char _messageBuffer[EMQX_MESSAGE_BUFFER_SIZE]; // Last serialized log message
+    
+    // Every message goes through the outbox, published in order once connected
+    MqttOutbox _outbox;
+    uint32_t _bootId;                  // With seq, identifies a message across reboots
+    bool _replayPending;               // Outbox not drained by the last loop() (batch limit)
+    bool _inCallback;                  // Running the command handler from _mqttClient.loop()
+    
+    enum OutboxTopic : uint8_t { TOPIC_AUTHORIZED = 0, TOPIC_UNAUTHORIZED = 1, TOPIC_COMMAND_REPLY = 2 };
+    static const int LOG_TOPIC_COUNT = 2;
+    
+    // Per log topic: encoding and records waiting for the batching window to close
+    MqttBatch _batches[LOG_TOPIC_COUNT];
+    
+    // Signed gate commands (empty topic: not subscribed)
+    String _commandTopic;
+    String _replyTopic;
+    MqttCommandHandler _commandHandler;
+    
+    String _stateTopic;                // Empty: no state topic, no last will
+    uint32_t _connectionCount;
+    
+    // Connection steps: non-blocking TCP connect, then the MQTT CONNECT/CONNACK exchange
+    void startConnect(unsigned long now);
+    void pollConnect(unsigned long now);
+    bool completeMqttConnect();
+    void connectFailed(unsigned long now, const char* reason);
+    
+    // Publish a message to a topic, streamed to the socket (not copied into PubSubClient's buffer)
+    bool publishMessage(const String& topic, const char* message, size_t length, bool retained = false);
     
-    // Connect to MQTT broker
-    bool connectMqtt();
+    // Queue a log message (or add it to the topic's batch), then publish what the outbox holds if connected
+    void enqueueMessage(const GateActionLog& log, OutboxTopic topic);
+    void flushBatch(OutboxTopic topic);
+    void flushOutbox();
     
-    // Publish a message to a topic
-    bool publishMessage(const String& topic, const String& message);
+    // Build the message into _messageBuffer (JSON or CBOR, same fields), returns its length (0 when it doesn't fit)
+    size_t buildMessage(const GateActionLog& log, uint32_t sequence, MqttBatch::Encoding encoding);
     
-    // Build JSON message
-    String buildMessage(const GateActionLog& log);
+    const String& topicName(uint8_t topic) const;
+    void reserveTopic(const String& topic);   // Grows the client buffer to fit a PUBLISH header on topic
     
-    // MQTT callback (if needed for future features)
-    static void mqttCallback(char* topic, byte* payload, unsigned int length);
+    // Inbound messages (from _mqttClient.loop())
+    void onMqttMessage(char* topic, byte* payload, unsigned int length);
 };
 
 #endif // UNIT_TEST
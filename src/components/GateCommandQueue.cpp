@@ -0,0 +1,107 @@
+#include "GateCommandQueue.h"
+
+#include <string.h>
+
+GateCommandQueue::GateCommandQueue() : _nextId(1) {
+    for (int i = 0; i < GATE_COMMAND_SLOTS; i++) {
+        _slots[i].id = 0;
+        _slots[i].status = COMMAND_COMPLETED;
+        _slots[i].pendingDispatch = false;
+        _slots[i].error[0] = '\0';
+        _slots[i].replyTo = 0;
+        _slots[i].mqttNonce[0] = '\0';
+    }
+}
+
+GateCommand* GateCommandQueue::create(OperationState action, unsigned long now, uint8_t gate) {
+    GateCommand* target = nullptr;
+
+    for (int i = 0; i < GATE_COMMAND_SLOTS; i++) {
+        GateCommand& candidate = _slots[i];
+        if (candidate.id == 0) {
+            target = &candidate;
+            break;
+        }
+        if (isFinished(candidate.status) && !candidate.pendingDispatch &&
+            (!target || candidate.updatedAt < target->updatedAt)) {
+            target = &candidate;
+        }
+    }
+
+    if (!target) {
+        return nullptr;
+    }
+
+    target->id = _nextId++;
+    if (_nextId == 0) {
+        _nextId = 1; // 0 marks a free slot
+    }
+    target->gate = gate;
+    target->action = action;
+    target->expectedState = (action == OPENING) ? OPEN : CLOSED;
+    target->status = COMMAND_QUEUED;
+    target->pendingDispatch = false;
+    target->createdAt = now;
+    target->updatedAt = now;
+    target->token = "";
+    target->clientIP = "";
+    target->userId = "";
+    target->username = "";
+    target->error[0] = '\0';
+    target->replyTo = 0;
+    target->mqttNonce[0] = '\0';
+    target->repliedStatus = COMMAND_QUEUED;
+    return target;
+}
+
+GateCommand* GateCommandQueue::find(uint32_t id) {
+    if (id == 0) {
+        return nullptr;
+    }
+    for (int i = 0; i < GATE_COMMAND_SLOTS; i++) {
+        if (_slots[i].id == id) {
+            return &_slots[i];
+        }
+    }
+    return nullptr;
+}
+
+void GateCommandQueue::setStatus(GateCommand& command, CommandStatus status, unsigned long now) {
+    command.status = status;
+    command.updatedAt = now;
+}
+
+void GateCommandQueue::fail(GateCommand& command, CommandStatus status, const char* error, unsigned long now) {
+    strncpy(command.error, error ? error : "", sizeof(command.error) - 1);
+    command.error[sizeof(command.error) - 1] = '\0';
+    setStatus(command, status, now);
+}
+
+int GateCommandQueue::inFlightCount() const {
+    int count = 0;
+    for (int i = 0; i < GATE_COMMAND_SLOTS; i++) {
+        if (_slots[i].id != 0 && !isFinished(_slots[i].status)) {
+            count++;
+        }
+    }
+    return count;
+}
+
+bool GateCommandQueue::isFinished(CommandStatus status) {
+    return status == COMMAND_COMPLETED || status == COMMAND_REJECTED || status == COMMAND_FORBIDDEN ||
+           status == COMMAND_FAILED;
+}
+
+const char* GateCommandQueue::statusName(CommandStatus status) {
+    switch (status) {
+        case COMMAND_QUEUED: return "queued";
+        case COMMAND_AUTHENTICATING: return "authenticating";
+        case COMMAND_AUTHORIZED: return "authorized";
+        case COMMAND_IN_PROGRESS: return "in_progress";
+        case COMMAND_COMPLETED: return "completed";
+        case COMMAND_REJECTED: return "rejected";
+        case COMMAND_FORBIDDEN: return "forbidden";
+        case COMMAND_FAILED: return "failed";
+    }
+    return "unknown";
+}
@@ -0,0 +1,70 @@
+#ifndef GATE_COMMAND_QUEUE_H
+#define GATE_COMMAND_QUEUE_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stdint.h>
+#include "GateTypes.h"
+#include "Config.h"
+
+// Lifecycle of an asynchronous /gate/{id}/open or /gate/{id}/close command
+enum CommandStatus {
+    COMMAND_QUEUED,          // Accepted (202), waiting for the auth worker
+    COMMAND_AUTHENTICATING,  // Token being validated on the worker
+    COMMAND_AUTHORIZED,      // Waiting for the main loop to actuate
+    COMMAND_IN_PROGRESS,     // Relay triggered, GateMonitor operation running
+    COMMAND_COMPLETED,       // Gate reached the expected state (or was already there)
+    COMMAND_REJECTED,        // Authentication failed
+    COMMAND_FORBIDDEN,       // Authenticated, but the access policy doesn't grant this gate/action
+    COMMAND_FAILED           // Operation timed out or was superseded
+};
+
+struct GateCommand {
+    uint32_t id;
+    uint8_t gate;                 // Index in GATES
+    OperationState action;        // OPENING or CLOSING
+    GateState expectedState;
+    CommandStatus status;
+    bool pendingDispatch;         // Auth finished, main loop must log/actuate
+    unsigned long createdAt;
+    unsigned long updatedAt;
+    String token;                 // Cleared once the command has been dispatched
+    String clientIP;
+    String userId;
+    String username;
+    char error[64];
+    uint32_t replyTo;             // Parked HTTP response of a synchronous request (0 for async)
+    char mqttNonce[MQTT_COMMAND_NONCE_MAX + 1]; // MQTT command: progress replied on the reply topic (empty for HTTP)
+    CommandStatus repliedStatus;  // Last status sent on the reply topic
+};
+
+// Fixed table of recent commands. Finished commands stay queryable until their slot
+// is recycled (oldest finished first); in-flight commands are never evicted.
+class GateCommandQueue {
+public:
+    GateCommandQueue();
+
+    // Returns nullptr when every slot holds an unfinished command
+    GateCommand* create(OperationState action, unsigned long now, uint8_t gate = 0);
+    GateCommand* find(uint32_t id);
+
+    void setStatus(GateCommand& command, CommandStatus status, unsigned long now);
+    void fail(GateCommand& command, CommandStatus status, const char* error, unsigned long now);
+
+    int inFlightCount() const;
+    GateCommand* slot(int index) { return _slots[index].id != 0 ? &_slots[index] : nullptr; }
+    int capacity() const { return GATE_COMMAND_SLOTS; }
+
+    static bool isFinished(CommandStatus status);
+    static const char* statusName(CommandStatus status);
+
+private:
+    GateCommand _slots[GATE_COMMAND_SLOTS];
+    uint32_t _nextId;
+};
+
+#endif // GATE_COMMAND_QUEUE_H
@@ -0,0 +1,111 @@
+#include "GateControlTask.h"
+#include "GpioInputs.h"
+
+GateControlTask::GateControlTask(GateController* gateController, GateMonitor* gateMonitor)
+    : _gateController(gateController), _gateMonitor(gateMonitor), _networkScheduler(nullptr), _task(nullptr) {
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        _publishedVersion[gate] = 0;
+    }
+}
+
+void GateControlTask::begin(LoopScheduler* networkScheduler) {
+    _networkScheduler = networkScheduler;
+
+    // Readers must never see an empty snapshot
+    publishSnapshot();
+
+    _scheduler.addDeadlineSource([](void* context, unsigned long now) {
+        return static_cast<GateMonitor*>(context)->getNextDeadline(now);
+    }, _gateMonitor);
+
+    // Above the network task priority, on the core that doesn't run the Wi-Fi stack
+    xTaskCreatePinnedToCore(taskEntry, "gate_ctrl", 4096, this, GATE_TASK_PRIORITY, &_task, GATE_TASK_CORE);
+}
+
+bool GateControlTask::submit(const GateRequest& request) {
+    if (!_requests.push(request)) {
+        return false;
+    }
+    _scheduler.wake();
+    return true;
+}
+
+bool GateControlTask::pollEvent(GateEvent& event) {
+    return _events.pop(event);
+}
+
+void GateControlTask::run() {
+    _scheduler.begin();
+
+    // Sensor edges and the relay timer now wake this task instead of the network loop
+    _gateController->attachScheduler(&_scheduler);
+
+    for (;;) {
+        GateRequest request;
+        while (_requests.pop(request)) {
+            handleRequest(request);
+        }
+
+        _gateMonitor->update();
+        publishSnapshot();
+
+        _scheduler.sleepUntilNextDeadline();
+    }
+}
+
+void GateControlTask::handleRequest(const GateRequest& request) {
+    GateState target = (request.action == OPENING) ? OPEN : CLOSED;
+    GateEvent event = {request.commandId, request.gate, request.action, GATE_REQUEST_STARTED};
+
+    if (_gateController->readState(request.gate) == target) {
+        event.result = GATE_REQUEST_ALREADY_DONE;
+    } else if (!_gateController->triggerRelay(request.gate)) {
+        event.result = GATE_REQUEST_RELAY_BUSY;
+    } else {
+        _gateMonitor->startOperation(request.action, target, request.gate);
+    }
+
+    // Readers of the event must find the operation in the snapshot
+    publishSnapshot();
+
+    if (!_events.push(event)) {
+        Serial.println("[Gate][Warning] Event queue full, result of request " + String(request.commandId) + " dropped");
+    }
+    if (_networkScheduler) {
+        _networkScheduler->wake();
+    }
+}
+
+void GateControlTask::publishSnapshot() {
+    GateSnapshot snapshot;
+    bool changed = false;
+
+    // Raw sensor levels of every gate from a single register read
+    uint64_t levels = readGpioInputs();
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        GateStatus& status = snapshot.gates[gate];
+        status.sensorClosed = gpioLevel(levels, GATES[gate].closedSensorPin) == LOW;
+        status.sensorOpen = gpioLevel(levels, GATES[gate].openSensorPin) == LOW;
+        status.state = gateStateFromSensors(status.sensorClosed, status.sensorOpen);
+        status.operation = _gateMonitor->getCurrentOperation(gate);
+        status.operationElapsed = _gateMonitor->getOperationElapsedTime(gate);
+        status.timeoutRemaining = _gateMonitor->getOperationRemainingTime(gate);
+        status.alertActive = _gateMonitor->isAlertActive(gate);
+        status.autoCloseEnabled = _gateMonitor->isAutoCloseEnabled(gate);
+        status.autoCloseRemaining = _gateMonitor->getAutoCloseRemainingTime(gate);
+        status.version = _gateMonitor->getVersion(gate);
+        changed = changed || status.version != _publishedVersion[gate];
+        _publishedVersion[gate] = status.version;
+    }
+    snapshot.publishedAt = millis();
+    _snapshot.write(snapshot);
+
+    // Event stream subscribers are pushed the change by the network task
+    if (changed && _networkScheduler) {
+        _networkScheduler->wake();
+    }
+}
+
+void GateControlTask::taskEntry(void* arg) {
+    static_cast<GateControlTask*>(arg)->run();
+}
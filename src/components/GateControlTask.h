@@ -0,0 +1,89 @@
+#ifndef GATE_CONTROL_TASK_H
+#define GATE_CONTROL_TASK_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "Config.h"
+#include "GateController.h"
+#include "GateMonitor.h"
+#include "LoopScheduler.h"
+#include "SpscQueue.h"
+
+// Actuation request from the network side. commandId identifies the
+// async command (0 for a synchronous HTTP request).
+struct GateRequest {
+    uint32_t commandId;
+    uint8_t gate;                      // Index in GATES
+    OperationState action;
+};
+
+enum GateRequestResult {
+    GATE_REQUEST_STARTED,        // Relay pulse scheduled, operation monitored
+    GATE_REQUEST_ALREADY_DONE,   // Gate already in the requested state
+    GATE_REQUEST_RELAY_BUSY      // A pulse is already waiting for its turn
+};
+
+struct GateEvent {
+    uint32_t commandId;
+    uint8_t gate;
+    OperationState action;
+    GateRequestResult result;
+};
+
+// State of one gate inside a GateSnapshot
+struct GateStatus {
+    GateState state;
+    bool sensorClosed;
+    bool sensorOpen;
+    OperationState operation;
+    unsigned long operationElapsed;    // ms, at publishedAt
+    unsigned long timeoutRemaining;    // ms, at publishedAt
+    bool alertActive;
+    bool autoCloseEnabled;
+    unsigned long autoCloseRemaining;  // ms, at publishedAt
+    uint32_t version;                  // GateMonitor::getVersion()
+};
+
+// Immutable copy of every gate state, published by the control task after each iteration
+struct GateSnapshot {
+    GateStatus gates[GATE_COUNT];
+    unsigned long publishedAt;         // millis()
+};
+
+// Real-time task pinned to GATE_TASK_CORE that owns GateController and GateMonitor.
+// Network code only talks to it through the request/event queues and the snapshot.
+class GateControlTask {
+public:
+    GateControlTask(GateController* gateController, GateMonitor* gateMonitor);
+
+    // Start the task; networkScheduler is woken whenever an event is queued or a gate version changes
+    void begin(LoopScheduler* networkScheduler);
+
+    // Network task only (single producer / single consumer)
+    bool submit(const GateRequest& request);
+    bool pollEvent(GateEvent& event);
+
+    // Any task
+    GateSnapshot getSnapshot() const { return _snapshot.read(); }
+    const LoopScheduler::Stats& getSchedulerStats() const { return _scheduler.getStats(); }
+
+private:
+    GateController* _gateController;
+    GateMonitor* _gateMonitor;
+    LoopScheduler _scheduler;
+    LoopScheduler* _networkScheduler;
+    TaskHandle_t _task;
+
+    SpscQueue<GateRequest, GATE_QUEUE_SIZE> _requests;
+    SpscQueue<GateEvent, GATE_QUEUE_SIZE> _events;
+    SeqLock<GateSnapshot> _snapshot;
+    uint32_t _publishedVersion[GATE_COUNT];
+
+    void run();
+    void handleRequest(const GateRequest& request);
+    void publishSnapshot();
+    static void taskEntry(void* arg);
+};
+
+#endif // GATE_CONTROL_TASK_H
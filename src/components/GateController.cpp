@@ -1,65 +1,281 @@
 #include "GateController.h"
-#include "Config.h"
+#include "GpioInputs.h"
 
 #ifdef UNIT_TEST
 #include "../../test/mocks/ArduinoMock.h"
 #else
 #include <Arduino.h>
+#include "LoopScheduler.h"
 #endif
 
-GateController::GateController() {
+// The pulse end runs in the esp_timer task, the rest in the main loop
+#ifdef UNIT_TEST
+#define RELAY_ENTER_CRITICAL()
+#define RELAY_EXIT_CRITICAL()
+#else
+static portMUX_TYPE relayMux = portMUX_INITIALIZER_UNLOCKED;
+#define RELAY_ENTER_CRITICAL() portENTER_CRITICAL(&relayMux)
+#define RELAY_EXIT_CRITICAL() portEXIT_CRITICAL(&relayMux)
+#endif
+
+GateController::GateController() : _eventHead(0), _eventCount(0) {
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        _pulseActive[gate] = false;
+        _pulseEndUnreported[gate] = false;
+        _pulseEndedAt[gate] = 0;
+        _pulseEndedAtMicros[gate] = 0;
+        _pulsePending[gate] = false;
+        _hasPulsed[gate] = false;
+        _pulseStartedAt[gate] = 0;
+#ifndef UNIT_TEST
+        _pulseTimers[gate] = nullptr;
+#endif
+    }
+#ifndef UNIT_TEST
+    _scheduler = nullptr;
+#endif
+}
+
+GateController::~GateController() {
+#ifndef UNIT_TEST
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        if (_pulseTimers[gate]) {
+            esp_timer_stop(_pulseTimers[gate]);
+            esp_timer_delete(_pulseTimers[gate]);
+        }
+    }
+#endif
 }
 
 void GateController::begin() {
     initializePins();
+    
+#ifndef UNIT_TEST
+    _sensorCapture.begin();
+    
+    // One-shot timers release the relays on time even if the loop is busy
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        _timerContexts[gate] = {this, static_cast<uint8_t>(gate)};
+        esp_timer_create_args_t timerArgs = {};
+        timerArgs.callback = pulseTimerCallback;
+        timerArgs.arg = &_timerContexts[gate];
+        timerArgs.name = "relay_pulse";
+        if (esp_timer_create(&timerArgs, &_pulseTimers[gate]) != ESP_OK) {
+            _pulseTimers[gate] = nullptr;
+            Serial.println("[Relay][Warning] esp_timer unavailable for gate " + String(GATES[gate].id) +
+                           ", pulse end driven by the main loop");
+        }
+    }
+#endif
+    
     printInitialState();
 }
 
-void GateController::triggerRelay() {
-    digitalWrite(RELAY_1_PIN, HIGH);
-    delay(1000);
-    digitalWrite(RELAY_1_PIN, LOW);
+void GateController::update() {
+    unsigned long now = millis();
+    
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        if (loopEndsPulse(gate) && _pulseActive[gate] && now - _pulseStartedAt[gate] >= RELAY_PULSE_WIDTH) {
+            endPulse(gate);
+        }
+        
+        RELAY_ENTER_CRITICAL();
+        bool ended = _pulseEndUnreported[gate];
+        unsigned long endedAt = _pulseEndedAtMicros[gate];
+        _pulseEndUnreported[gate] = false;
+        RELAY_EXIT_CRITICAL();
+        
+        if (ended) {
+            pushEvent(gate, RELAY_PULSE_ENDED, endedAt);
+        }
+        
+        if (_pulsePending[gate] && !_pulseActive[gate] && gapElapsed(gate, now)) {
+            _pulsePending[gate] = false;
+            startPulse(gate, now);
+        }
+    }
+}
+
+unsigned long GateController::getNextDeadline(unsigned long now) {
+    unsigned long next = ULONG_MAX;
+    
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        if (_pulseEndUnreported[gate]) {
+            return 0;
+        }
+        
+        // Otherwise the timer callback wakes the loop
+        if (_pulseActive[gate] && loopEndsPulse(gate)) {
+            unsigned long elapsed = now - _pulseStartedAt[gate];
+            unsigned long remaining = elapsed >= RELAY_PULSE_WIDTH ? 0 : RELAY_PULSE_WIDTH - elapsed;
+            if (remaining < next) {
+                next = remaining;
+            }
+        }
+        
+        if (_pulsePending[gate] && !_pulseActive[gate]) {
+            unsigned long sinceEnd = now - _pulseEndedAt[gate];
+            unsigned long gap = sinceEnd >= RELAY_MIN_GAP ? 0 : RELAY_MIN_GAP - sinceEnd;
+            if (gap < next) {
+                next = gap;
+            }
+        }
+    }
+    
+    if (_sensorCapture.isActive()) {
+        unsigned long settle = _sensorCapture.getSettleDelay(micros());
+        if (settle != ULONG_MAX && (settle + 999) / 1000 < next) {
+            next = (settle + 999) / 1000;
+        }
+    }
+    
+    return next;
 }
 
-GateState GateController::readState() {
-    // When gate is NEAR sensor: circuit closes -> digitalRead() = LOW -> sensor active = true
-    // When gate is FAR from sensor: circuit opens -> digitalRead() = HIGH (pull-up) -> sensor active = false
-    bool sensorClosed = isClosedSensorActive();
-    bool sensorOpen = isOpenSensorActive();
+bool GateController::triggerRelay(int gate) {
+    if (_pulsePending[gate]) {
+        return false;
+    }
     
-    if (sensorClosed && !sensorOpen) {
-        return CLOSED;
-    } else if (!sensorClosed && sensorOpen) {
-        return OPEN;
-    } else {
-        return UNKNOWN;  // None or both sensors activated
+    unsigned long now = millis();
+    if (_pulseActive[gate] || !gapElapsed(gate, now)) {
+        // Too close to the previous pulse: the relay would not register it
+        _pulsePending[gate] = true;
+        return true;
     }
+    
+    startPulse(gate, now);
+    return true;
 }
 
-bool GateController::isClosedSensorActive() {
-    return !digitalRead(SENSOR_CLOSED_PIN);  // true when gate is near "closed" sensor
+bool GateController::pollSensorChange(SensorChange& change) {
+    return _sensorCapture.isActive() && _sensorCapture.poll(micros(), change);
 }
 
-bool GateController::isOpenSensorActive() {
-    return !digitalRead(SENSOR_OPEN_PIN);    // true when gate is near "open" sensor
+bool GateController::pollRelayEvent(RelayEvent& event) {
+    if (_eventCount == 0) {
+        return false;
+    }
+    event = _events[_eventHead];
+    _eventHead = (_eventHead + 1) % RELAY_EVENT_QUEUE_SIZE;
+    _eventCount--;
+    return true;
 }
 
-void GateController::initializePins() {
-    // Relay configuration
-    pinMode(RELAY_1_PIN, OUTPUT);
-    digitalWrite(RELAY_1_PIN, LOW); // Relay off by default
+void GateController::startPulse(int gate, unsigned long now) {
+    digitalWrite(GATES[gate].relayPin, HIGH);
+    _pulseStartedAt[gate] = now;
+    _pulseActive[gate] = true;
+    pushEvent(gate, RELAY_PULSE_STARTED, micros());
+    
+#ifndef UNIT_TEST
+    if (_pulseTimers[gate]) {
+        esp_timer_start_once(_pulseTimers[gate], RELAY_PULSE_WIDTH * 1000ULL);
+    }
+#endif
+}
+
+void GateController::endPulse(int gate) {
+    RELAY_ENTER_CRITICAL();
+    if (_pulseActive[gate]) {
+        digitalWrite(GATES[gate].relayPin, LOW);
+        _pulseActive[gate] = false;
+        _pulseEndedAt[gate] = millis();
+        _pulseEndedAtMicros[gate] = micros();
+        _pulseEndUnreported[gate] = true;
+        _hasPulsed[gate] = true;
+    }
+    RELAY_EXIT_CRITICAL();
+}
+
+bool GateController::gapElapsed(int gate, unsigned long now) const {
+    return !_hasPulsed[gate] || now - _pulseEndedAt[gate] >= RELAY_MIN_GAP;
+}
+
+bool GateController::loopEndsPulse(int gate) const {
+#ifdef UNIT_TEST
+    (void)gate;
+    return true;
+#else
+    return _pulseTimers[gate] == nullptr;
+#endif
+}
+
+void GateController::pushEvent(int gate, RelayEventType type, unsigned long timestamp) {
+    // Nobody reading: drop the oldest event rather than the newest
+    if (_eventCount == RELAY_EVENT_QUEUE_SIZE) {
+        _eventHead = (_eventHead + 1) % RELAY_EVENT_QUEUE_SIZE;
+        _eventCount--;
+    }
+    int tail = (_eventHead + _eventCount) % RELAY_EVENT_QUEUE_SIZE;
+    _events[tail].gate = gate;
+    _events[tail].type = type;
+    _events[tail].timestamp = timestamp;
+    _eventCount++;
+}
+
+#ifndef UNIT_TEST
+void GateController::pulseTimerCallback(void* arg) {
+    PulseTimerContext* context = static_cast<PulseTimerContext*>(arg);
+    context->controller->endPulse(context->gate);
     
-    // Sensor configuration with internal pull-up
-    pinMode(SENSOR_CLOSED_PIN, INPUT_PULLUP);
-    pinMode(SENSOR_OPEN_PIN, INPUT_PULLUP);
+    // Report the pulse end without waiting for the next deadline
+    if (context->controller->_scheduler) {
+        context->controller->_scheduler->wake();
+    }
+}
+
+void GateController::attachScheduler(LoopScheduler* scheduler) {
+    _scheduler = scheduler;
+    _sensorCapture.attachScheduler(scheduler);
+}
+#endif
+
+void GateController::readStates(GateState states[GATE_COUNT]) {
+    // When gate is NEAR sensor: circuit closes -> level LOW -> sensor active = true
+    // When gate is FAR from sensor: circuit opens -> level HIGH (pull-up) -> sensor active = false
+    uint64_t levels = readGpioInputs();
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        states[gate] = gateStateFromSensors(gpioLevel(levels, GATES[gate].closedSensorPin) == LOW,
+                                            gpioLevel(levels, GATES[gate].openSensorPin) == LOW);
+    }
+}
+
+GateState GateController::readState(int gate) {
+    uint64_t levels = readGpioInputs();
+    return gateStateFromSensors(gpioLevel(levels, GATES[gate].closedSensorPin) == LOW,
+                                gpioLevel(levels, GATES[gate].openSensorPin) == LOW);
+}
+
+bool GateController::isClosedSensorActive(int gate) {
+    return gpioLevel(readGpioInputs(), GATES[gate].closedSensorPin) == LOW;  // true when gate is near "closed" sensor
+}
+
+bool GateController::isOpenSensorActive(int gate) {
+    return gpioLevel(readGpioInputs(), GATES[gate].openSensorPin) == LOW;    // true when gate is near "open" sensor
+}
+
+void GateController::initializePins() {
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        // Relay configuration
+        pinMode(GATES[gate].relayPin, OUTPUT);
+        digitalWrite(GATES[gate].relayPin, LOW); // Relay off by default
+        
+        // Sensor configuration with internal pull-up
+        pinMode(GATES[gate].closedSensorPin, INPUT_PULLUP);
+        pinMode(GATES[gate].openSensorPin, INPUT_PULLUP);
+    }
 }
 
 void GateController::printInitialState() {
-    Serial.print("Initial gate state: ");
-    GateState initialState = readState();
-    switch(initialState) {
-        case CLOSED: Serial.println("CLOSED"); break;
-        case OPEN: Serial.println("OPEN"); break;
-        case UNKNOWN: Serial.println("UNKNOWN"); break;
-    }
-}
\ No newline at end of file
+    GateState states[GATE_COUNT];
+    readStates(states);
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        Serial.print("Initial gate state (" + String(GATES[gate].id) + "): ");
+        switch(states[gate]) {
+            case CLOSED: Serial.println("CLOSED"); break;
+            case OPEN: Serial.println("OPEN"); break;
+            case UNKNOWN: Serial.println("UNKNOWN"); break;
+        }
+    }
+}
@@ -5,22 +5,99 @@
 #include "../../test/mocks/ArduinoMock.h"
 #else
 #include <Arduino.h>
+#include <esp_timer.h>
 #endif
 
 #include "GateTypes.h"
+#include "Config.h"
+#include "SensorEdgeCapture.h"
 
+// Relay pulse edges, timestamped with micros()
+enum RelayEventType {
+    RELAY_PULSE_STARTED,
+    RELAY_PULSE_ENDED
+};
+
+struct RelayEvent {
+    uint8_t gate;
+    RelayEventType type;
+    unsigned long timestamp;
+};
+
+// Relays and sensors of every gate listed in GATES (Config.h)
 class GateController {
 public:
     GateController();
+    ~GateController();
     void begin();
-    void triggerRelay();
-    GateState readState();
-    bool isClosedSensorActive();
-    bool isOpenSensorActive();
+    
+    // Pulse scheduler tick, call from the main loop
+    void update();
+    
+    // ms before update() has work to do (pulse end/gap, debounce), ULONG_MAX when idle
+    unsigned long getNextDeadline(unsigned long now);
+    
+    // Schedule a relay pulse (starts now, or once RELAY_MIN_GAP has elapsed).
+    // Returns false when a pulse is already waiting for its turn.
+    bool triggerRelay(int gate = 0);
+    bool isPulseActive(int gate = 0) const { return _pulseActive[gate]; }
+    bool isPulsePending(int gate = 0) const { return _pulsePending[gate]; }
+    
+    // Oldest unread pulse event (any gate), false when there is none
+    bool pollRelayEvent(RelayEvent& event);
+    
+    // Every gate from a single read of the GPIO input registers
+    void readStates(GateState states[GATE_COUNT]);
+    GateState readState(int gate = 0);
+    bool isClosedSensorActive(int gate = 0);
+    bool isOpenSensorActive(int gate = 0);
+    
+    // Interrupt-driven sensor edges (not started under UNIT_TEST: readStates() polling is used)
+    bool isEdgeCaptureActive() const { return _sensorCapture.isActive(); }
+    bool pollSensorChange(SensorChange& change);
+    SensorEdgeCapture& getSensorCapture() { return _sensorCapture; }
+    
+#ifndef UNIT_TEST
+    // Task woken by the relay timers and the sensor interrupts (the task calling update())
+    void attachScheduler(LoopScheduler* scheduler);
+#endif
 
 private:
+    static const int RELAY_EVENT_QUEUE_SIZE = 4 * GATE_COUNT;
+    
+    // Per-gate pulse state
+    volatile bool _pulseActive[GATE_COUNT];
+    volatile bool _pulseEndUnreported[GATE_COUNT];
+    volatile unsigned long _pulseEndedAt[GATE_COUNT];
+    volatile unsigned long _pulseEndedAtMicros[GATE_COUNT];
+    bool _pulsePending[GATE_COUNT];
+    bool _hasPulsed[GATE_COUNT];
+    unsigned long _pulseStartedAt[GATE_COUNT];
+    
+    RelayEvent _events[RELAY_EVENT_QUEUE_SIZE];
+    int _eventHead;
+    int _eventCount;
+    
+    SensorEdgeCapture _sensorCapture;
+    
+#ifndef UNIT_TEST
+    struct PulseTimerContext {
+        GateController* controller;
+        uint8_t gate;
+    };
+    PulseTimerContext _timerContexts[GATE_COUNT];
+    esp_timer_handle_t _pulseTimers[GATE_COUNT];
+    LoopScheduler* volatile _scheduler;
+    static void pulseTimerCallback(void* arg);
+#endif
+    
+    void startPulse(int gate, unsigned long now);
+    void endPulse(int gate);
+    bool gapElapsed(int gate, unsigned long now) const;
+    bool loopEndsPulse(int gate) const;
+    void pushEvent(int gate, RelayEventType type, unsigned long timestamp);
     void initializePins();
     void printInitialState();
 };
 
-#endif // GATE_CONTROLLER_H
\ No newline at end of file
+#endif // GATE_CONTROLLER_H
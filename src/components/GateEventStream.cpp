@@ -0,0 +1,146 @@
+#include "GateEventStream.h"
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
+GateEventStream::GateEventStream(AsyncHttpServer* server, uint32_t firstId)
+    : _server(server), _historyCount(0), _historyNext(0), _nextId(firstId), _lastSentAt(0) {
+    for (int i = 0; i < GATE_EVENTS_MAX_SUBSCRIBERS; i++) {
+        _subscribers[i] = 0;
+    }
+}
+
+HttpResponseHandle GateEventStream::subscribe() {
+    prune();
+
+    int slot = -1;
+    for (int i = 0; i < GATE_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (!_subscribers[i]) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        _server->sendHeader("Retry-After", String(GATE_EVENTS_RETRY / 1000));
+        _server->send(503, "application/json", "{\"error\":\"Too many event stream subscribers\"}");
+        return 0;
+    }
+
+    HttpResponseHandle subscriber = _server->beginStream("text/event-stream");
+    if (!subscriber) {
+        return 0;
+    }
+    char retry[32];
+    int length = snprintf(retry, sizeof(retry), "retry: %lu\n\n", GATE_EVENTS_RETRY);
+    _server->sendStream(subscriber, retry, length);
+    _subscribers[slot] = subscriber;
+    Serial.println("[SSE] Subscriber connected (" + String(subscriberCount()) + "/" +
+                   String(GATE_EVENTS_MAX_SUBSCRIBERS) + ")");
+    return subscriber;
+}
+
+bool GateEventStream::replay(HttpResponseHandle subscriber, uint32_t resumeFrom) {
+    // Unsigned distance: an id from the future (previous boot) is just very far behind
+    uint32_t missed = lastEventId() - resumeFrom;
+    if (missed > static_cast<uint32_t>(_historyCount)) {
+        return false;
+    }
+
+    // The missed frames are the newest ones of the history
+    int index = (_historyNext - static_cast<int>(missed) + GATE_EVENTS_HISTORY) % GATE_EVENTS_HISTORY;
+    for (uint32_t i = 0; i < missed; i++) {
+        const Frame& missedFrame = _history[index];
+        sendFrame(subscriber, missedFrame.id, missedFrame.data, missedFrame.length);
+        index = (index + 1) % GATE_EVENTS_HISTORY;
+    }
+    return true;
+}
+
+void GateEventStream::sendState(HttpResponseHandle subscriber, const char* data, size_t length) {
+    sendFrame(subscriber, lastEventId(), data, length);
+}
+
+uint32_t GateEventStream::publish(const char* data, size_t length) {
+    if (length > GATE_EVENT_MAX_SIZE) {
+        Serial.println("[SSE][Error] Event of " + String(static_cast<unsigned long>(length)) + " bytes dropped");
+        return 0;
+    }
+    uint32_t id = _nextId++;
+
+    Frame& stored = _history[_historyNext];
+    stored.id = id;
+    stored.length = length;
+    memcpy(stored.data, data, length);
+    _historyNext = (_historyNext + 1) % GATE_EVENTS_HISTORY;
+    if (_historyCount < GATE_EVENTS_HISTORY) {
+        _historyCount++;
+    }
+
+    for (int i = 0; i < GATE_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (_subscribers[i]) {
+            sendFrame(_subscribers[i], id, data, length);
+            if (!_server->isStreamOpen(_subscribers[i])) {
+                _subscribers[i] = 0; // Client gone
+            }
+        }
+    }
+    _lastSentAt = millis();
+    return id;
+}
+
+void GateEventStream::loop(unsigned long now) {
+    if (now - _lastSentAt < GATE_EVENTS_HEARTBEAT_INTERVAL) {
+        return;
+    }
+    _lastSentAt = now;
+
+    // Comment line: ignored by EventSource, detects dead peers and keeps proxies from timing out
+    for (int i = 0; i < GATE_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (_subscribers[i] && !_server->sendStream(_subscribers[i], ":\n\n", 3)) {
+            _subscribers[i] = 0;
+        }
+    }
+}
+
+unsigned long GateEventStream::getNextDeadline(unsigned long now) const {
+    bool subscribed = false;
+    for (int i = 0; i < GATE_EVENTS_MAX_SUBSCRIBERS; i++) {
+        subscribed = subscribed || _subscribers[i] != 0;
+    }
+    if (!subscribed) {
+        return ULONG_MAX;
+    }
+    unsigned long elapsed = now - _lastSentAt;
+    return elapsed >= GATE_EVENTS_HEARTBEAT_INTERVAL ? 0 : GATE_EVENTS_HEARTBEAT_INTERVAL - elapsed;
+}
+
+int GateEventStream::subscriberCount() {
+    prune();
+    int count = 0;
+    for (int i = 0; i < GATE_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (_subscribers[i]) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void GateEventStream::prune() {
+    // The server closes streams on its own (peer gone, client not reading)
+    for (int i = 0; i < GATE_EVENTS_MAX_SUBSCRIBERS; i++) {
+        if (_subscribers[i] && !_server->isStreamOpen(_subscribers[i])) {
+            _subscribers[i] = 0;
+        }
+    }
+}
+
+void GateEventStream::sendFrame(HttpResponseHandle subscriber, uint32_t id, const char* data, size_t length) {
+    // One write per frame (Nagle is off on HTTP sockets)
+    char text[GATE_EVENT_MAX_SIZE + 48];
+    int textLength = snprintf(text, sizeof(text), "id: %lu\nevent: status\ndata: %.*s\n\n",
+                              static_cast<unsigned long>(id), static_cast<int>(length), data);
+    if (textLength > 0 && static_cast<size_t>(textLength) < sizeof(text)) {
+        _server->sendStream(subscriber, text, textLength);
+    }
+}
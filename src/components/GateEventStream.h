@@ -0,0 +1,62 @@
+#ifndef GATE_EVENT_STREAM_H
+#define GATE_EVENT_STREAM_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stdint.h>
+#include "AsyncHttpServer.h"
+#include "Config.h"
+
+// Server-Sent Events fan-out for /gate/events. Frames are numbered; the last
+// GATE_EVENTS_HISTORY ones are kept so a client reconnecting with Last-Event-ID
+// only receives what it missed. Network task only.
+class GateEventStream {
+public:
+    // firstId should differ between boots, so a Last-Event-ID from before a reboot is not resumed
+    GateEventStream(AsyncHttpServer* server, uint32_t firstId = 1);
+
+    // From a route handler: answers with the stream headers, or 503 when every slot is taken (returns 0)
+    HttpResponseHandle subscribe();
+
+    // Frames published after resumeFrom (Last-Event-ID); false when the history doesn't go back that far
+    bool replay(HttpResponseHandle subscriber, uint32_t resumeFrom);
+
+    // Current state for a subscriber that could not be resumed, tagged with the latest id
+    void sendState(HttpResponseHandle subscriber, const char* data, size_t length);
+    void sendState(HttpResponseHandle subscriber, const String& data) { sendState(subscriber, data.c_str(), data.length()); }
+
+    // New frame for every subscriber, returns its id (0 when data exceeds GATE_EVENT_MAX_SIZE)
+    uint32_t publish(const char* data, size_t length);
+    uint32_t publish(const String& data) { return publish(data.c_str(), data.length()); }
+
+    // Heartbeats on idle streams
+    void loop(unsigned long now);
+    unsigned long getNextDeadline(unsigned long now) const;
+
+    int subscriberCount();
+    uint32_t lastEventId() const { return _nextId - 1; }
+
+private:
+    struct Frame {
+        uint32_t id;
+        size_t length;
+        char data[GATE_EVENT_MAX_SIZE];
+    };
+
+    AsyncHttpServer* _server;
+    HttpResponseHandle _subscribers[GATE_EVENTS_MAX_SUBSCRIBERS];
+    Frame _history[GATE_EVENTS_HISTORY];
+    int _historyCount;
+    int _historyNext;                  // Slot the next frame goes to
+    uint32_t _nextId;
+    unsigned long _lastSentAt;
+
+    void prune();
+    void sendFrame(HttpResponseHandle subscriber, uint32_t id, const char* data, size_t length);
+};
+
+#endif // GATE_EVENT_STREAM_H
@@ -8,157 +8,262 @@
 #endif
 
 GateMonitor::GateMonitor(GateController* gateController) 
-    : _gateController(gateController), _lastState(UNKNOWN), _currentOperation(IDLE),
-      _operationStartTime(0), _expectedState(UNKNOWN), _alertTriggered(false),
-      _gateOpenedTime(0), _autoCloseEnabled(false) {
+    : _gateController(gateController) {
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        _lastState[gate] = UNKNOWN;
+        _currentOperation[gate] = IDLE;
+        _operationStartTime[gate] = 0;
+        _expectedState[gate] = UNKNOWN;
+        _alertTriggered[gate] = false;
+        _gateOpenedTime[gate] = 0;
+        _autoCloseEnabled[gate] = false;
+        _lastPulseStartTime[gate] = 0;
+        _lastPulseEndTime[gate] = 0;
+        _version[gate] = 0;
+    }
 }
 
 void GateMonitor::begin() {
-    _lastState = _gateController->readState();
+    _gateController->readStates(_lastState);
 }
 
 void GateMonitor::update() {
-    GateState currentState = _gateController->readState();
+    // Advance the relay pulses and collect their events
+    _gateController->update();
+    handleRelayEvents();
     
-    // Monitor state changes
-    if (currentState != _lastState) {
-        handleStateChange(currentState);
-        _lastState = currentState;
+    // Monitor state changes: debounced interrupt edges when available, polling otherwise
+    if (_gateController->isEdgeCaptureActive()) {
+        SensorChange change;
+        while (_gateController->pollSensorChange(change)) {
+            if (change.state != _lastState[change.gate]) {
+                handleStateChange(change.gate, change.state, change.timestamp);
+                _lastState[change.gate] = change.state;
+            }
+        }
+    } else {
+        // One register read for every gate
+        GateState states[GATE_COUNT];
+        _gateController->readStates(states);
+        unsigned long now = micros();
+        for (int gate = 0; gate < GATE_COUNT; gate++) {
+            if (states[gate] != _lastState[gate]) {
+                handleStateChange(gate, states[gate], now);
+                _lastState[gate] = states[gate];
+            }
+        }
     }
     
-    // Check for timeout during operations
-    checkOperationTimeout();
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        // Check for timeout during operations
+        checkOperationTimeout(gate);
+        
+        // Check for auto-close
+        checkAutoClose(gate);
+    }
+}
+
+unsigned long GateMonitor::getNextDeadline(unsigned long now) {
+    unsigned long next = _gateController->getNextDeadline(now);
     
-    // Check for auto-close
-    checkAutoClose();
+    // Without interrupts, state changes are only seen by polling
+    if (!_gateController->isEdgeCaptureActive() && SENSOR_POLL_INTERVAL < next) {
+        next = SENSOR_POLL_INTERVAL;
+    }
+    
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        if (_currentOperation[gate] != IDLE && !_alertTriggered[gate]) {
+            unsigned long timeout = getOperationRemainingTime(gate);
+            if (timeout < next) {
+                next = timeout;
+            }
+        }
+        
+        if (_autoCloseEnabled[gate] && _lastState[gate] == OPEN && _currentOperation[gate] == IDLE) {
+            unsigned long autoClose = getAutoCloseRemainingTime(gate);
+            if (autoClose < next) {
+                next = autoClose;
+            }
+        }
+    }
+    
+    return next;
 }
 
-void GateMonitor::startOperation(OperationState operation, GateState expectedState) {
-    _currentOperation = operation;
-    _operationStartTime = millis();
-    _expectedState = expectedState;
-    _alertTriggered = false;
+void GateMonitor::startOperation(OperationState operation, GateState expectedState, int gate) {
+    _currentOperation[gate] = operation;
+    _operationStartTime[gate] = micros();
+    _expectedState[gate] = expectedState;
+    _alertTriggered[gate] = false;
+    _version[gate]++;
     
     String operationName = (operation == OPENING) ? "opening" : "closing";
-    Serial.println("Gate " + operationName + " initiated - timeout monitoring started");
+    Serial.println("Gate" + gateLabel(gate) + " " + operationName + " initiated - timeout monitoring started");
 }
 
-bool GateMonitor::isOperationInProgress() {
-    return _currentOperation != IDLE;
+bool GateMonitor::isOperationInProgress(int gate) {
+    return _currentOperation[gate] != IDLE;
 }
 
-OperationState GateMonitor::getCurrentOperation() {
-    return _currentOperation;
+OperationState GateMonitor::getCurrentOperation(int gate) {
+    return _currentOperation[gate];
 }
 
-void GateMonitor::enableAutoClose() {
-    _gateOpenedTime = millis();
-    _autoCloseEnabled = true;
-    Serial.println("Auto-close timer started - gate will close in " + String(AUTO_CLOSE_DELAY/1000) + " seconds");
+void GateMonitor::enableAutoClose(int gate) {
+    _gateOpenedTime[gate] = millis();
+    _autoCloseEnabled[gate] = true;
+    _version[gate]++;
+    Serial.println("Auto-close timer started - gate" + gateLabel(gate) + " will close in " +
+                   String(AUTO_CLOSE_DELAY/1000) + " seconds");
 }
 
-void GateMonitor::disableAutoClose() {
-    _autoCloseEnabled = false;
+void GateMonitor::disableAutoClose(int gate) {
+    if (_autoCloseEnabled[gate]) {
+        _autoCloseEnabled[gate] = false;
+        _version[gate]++;
+    }
 }
 
-bool GateMonitor::isAutoCloseEnabled() {
-    return _autoCloseEnabled;
+bool GateMonitor::isAutoCloseEnabled(int gate) {
+    return _autoCloseEnabled[gate];
 }
 
-unsigned long GateMonitor::getAutoCloseRemainingTime() {
-    if (!_autoCloseEnabled) {
+unsigned long GateMonitor::getAutoCloseRemainingTime(int gate) {
+    if (!_autoCloseEnabled[gate]) {
         return 0;
     }
-    unsigned long elapsed = millis() - _gateOpenedTime;
+    unsigned long elapsed = millis() - _gateOpenedTime[gate];
     return AUTO_CLOSE_DELAY > elapsed ? AUTO_CLOSE_DELAY - elapsed : 0;
 }
 
-bool GateMonitor::isAlertActive() {
-    return _alertTriggered;
+bool GateMonitor::isAlertActive(int gate) {
+    return _alertTriggered[gate];
 }
 
-void GateMonitor::clearAlert() {
-    _alertTriggered = false;
+void GateMonitor::clearAlert(int gate) {
+    if (_alertTriggered[gate]) {
+        _alertTriggered[gate] = false;
+        _version[gate]++;
+    }
 }
 
-unsigned long GateMonitor::getOperationElapsedTime() {
-    if (_currentOperation == IDLE) {
+unsigned long GateMonitor::getOperationElapsedTime(int gate) {
+    if (_currentOperation[gate] == IDLE) {
         return 0;
     }
-    return millis() - _operationStartTime;
+    return (micros() - _operationStartTime[gate]) / 1000;
 }
 
-unsigned long GateMonitor::getOperationRemainingTime() {
-    if (_currentOperation == IDLE) {
+unsigned long GateMonitor::getOperationRemainingTime(int gate) {
+    if (_currentOperation[gate] == IDLE) {
         return 0;
     }
-    unsigned long elapsed = getOperationElapsedTime();
-    unsigned long timeout = (_currentOperation == OPENING) ? OPENING_TIMEOUT : CLOSING_TIMEOUT;
+    unsigned long elapsed = getOperationElapsedTime(gate);
+    unsigned long timeout = (_currentOperation[gate] == OPENING) ? OPENING_TIMEOUT : CLOSING_TIMEOUT;
     return timeout > elapsed ? timeout - elapsed : 0;
 }
 
-void GateMonitor::handleStateChange(GateState currentState) {
-    printStateChange(currentState);
+unsigned long GateMonitor::getLastPulseStartTime(int gate) {
+    return _lastPulseStartTime[gate];
+}
+
+unsigned long GateMonitor::getLastPulseEndTime(int gate) {
+    return _lastPulseEndTime[gate];
+}
+
+void GateMonitor::handleRelayEvents() {
+    RelayEvent event;
+    while (_gateController->pollRelayEvent(event)) {
+        int gate = event.gate;
+        if (event.type == RELAY_PULSE_STARTED) {
+            _lastPulseStartTime[gate] = event.timestamp;
+            
+            // A pulse delayed by RELAY_MIN_GAP starts the motor late: time the operation from it
+            if (_currentOperation[gate] != IDLE && static_cast<long>(event.timestamp - _operationStartTime[gate]) > 0) {
+                _operationStartTime[gate] = event.timestamp;
+            }
+        } else {
+            _lastPulseEndTime[gate] = event.timestamp;
+        }
+    }
+}
+
+void GateMonitor::handleStateChange(int gate, GateState currentState, unsigned long changedAt) {
+    printStateChange(gate, currentState);
+    _version[gate]++;
     
     switch(currentState) {
         case CLOSED: 
             // Reset auto-close when gate is closed
-            disableAutoClose();
+            disableAutoClose(gate);
             break;
         case OPEN: 
             // Start auto-close timer when gate becomes open
-            enableAutoClose();
+            enableAutoClose(gate);
             break;
         case UNKNOWN: 
             break;
     }
     
     // Check if operation completed successfully
-    if (_currentOperation != IDLE && currentState == _expectedState) {
-        Serial.println("Operation completed successfully");
-        _currentOperation = IDLE;
-        _alertTriggered = false;
+    if (_currentOperation[gate] != IDLE && currentState == _expectedState[gate]) {
+        // Measured at the sensor edge, not when the loop got around to it
+        unsigned long duration = (changedAt - _operationStartTime[gate]) / 1000;
+        Serial.println("Operation completed successfully" + gateLabel(gate) + " in " + String(duration) + " ms");
+        _currentOperation[gate] = IDLE;
+        _alertTriggered[gate] = false;
     }
 }
 
-void GateMonitor::checkOperationTimeout() {
-    if (_currentOperation != IDLE) {
-        unsigned long elapsed = getOperationElapsedTime();
-        unsigned long timeout = (_currentOperation == OPENING) ? OPENING_TIMEOUT : CLOSING_TIMEOUT;
+void GateMonitor::checkOperationTimeout(int gate) {
+    if (_currentOperation[gate] != IDLE) {
+        unsigned long elapsed = getOperationElapsedTime(gate);
+        unsigned long timeout = (_currentOperation[gate] == OPENING) ? OPENING_TIMEOUT : CLOSING_TIMEOUT;
         
-        if (elapsed >= timeout && !_alertTriggered) {
-            String operationName = (_currentOperation == OPENING) ? "opening" : "closing";
-            String alertMessage = "Timeout: Gate " + operationName + " did not complete within " + String(timeout/1000) + " seconds";
-            triggerAlert(alertMessage);
+        if (elapsed >= timeout && !_alertTriggered[gate]) {
+            String operationName = (_currentOperation[gate] == OPENING) ? "opening" : "closing";
+            String alertMessage = "Timeout: Gate" + gateLabel(gate) + " " + operationName +
+                                  " did not complete within " + String(timeout/1000) + " seconds";
+            triggerAlert(gate, alertMessage);
         }
     }
 }
 
-void GateMonitor::checkAutoClose() {
-    if (_autoCloseEnabled && _gateController->readState() == OPEN && _currentOperation == IDLE) {
-        unsigned long elapsed = millis() - _gateOpenedTime;
+void GateMonitor::checkAutoClose(int gate) {
+    if (_autoCloseEnabled[gate] && _lastState[gate] == OPEN && _currentOperation[gate] == IDLE) {
+        unsigned long elapsed = millis() - _gateOpenedTime[gate];
         if (elapsed >= AUTO_CLOSE_DELAY) {
-            Serial.println("Auto-close triggered - closing gate after " + String(AUTO_CLOSE_DELAY/1000) + " seconds");
-            
-            // Initiate closing
-            _gateController->triggerRelay();
-            startOperation(CLOSING, CLOSED);
-            disableAutoClose();  // Disable auto-close to prevent repeated triggers
+            // Initiate closing (retried on the next update if a pulse is already queued, logged once accepted)
+            if (_gateController->triggerRelay(gate)) {
+                Serial.println("Auto-close triggered - closing gate" + gateLabel(gate) + " after " +
+                               String(AUTO_CLOSE_DELAY/1000) + " seconds");
+                startOperation(CLOSING, CLOSED, gate);
+                disableAutoClose(gate);  // Disable auto-close to prevent repeated triggers
+            }
         }
     }
 }
 
-void GateMonitor::triggerAlert(const String& message) {
+void GateMonitor::triggerAlert(int gate, const String& message) {
     Serial.println("ALERT: " + message);
-    _alertTriggered = true;
+    _alertTriggered[gate] = true;
+    _version[gate]++;
     // Here you could add other alert mechanisms (email, push notification, etc.)
 }
 
-void GateMonitor::printStateChange(GateState state) {
-    Serial.print("State change detected: ");
+void GateMonitor::printStateChange(int gate, GateState state) {
+    Serial.print("State change detected" + gateLabel(gate) + ": ");
     switch(state) {
         case CLOSED: Serial.println("CLOSED"); break;
         case OPEN: Serial.println("OPEN"); break;
         case UNKNOWN: Serial.println("UNKNOWN"); break;
     }
-}
\ No newline at end of file
+}
+
+String GateMonitor::gateLabel(int gate) {
+    // Single-gate boards keep the historical log lines
+    if (GATE_COUNT == 1) {
+        return "";
+    }
+    return " (" + String(GATES[gate].id) + ")";
+}
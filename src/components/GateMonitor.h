@@ -10,48 +10,71 @@
 #include "GateTypes.h"
 #include "GateController.h"
 
+// Supervises every gate of GATES. State is kept struct-of-arrays, indexed by gate.
 class GateMonitor {
 public:
     GateMonitor(GateController* gateController);
     void begin();
     void update();
     
+    // ms before update() must run again (sensor polling, timeouts, auto-close, relay)
+    unsigned long getNextDeadline(unsigned long now);
+    
     // Operation management
-    void startOperation(OperationState operation, GateState expectedState);
-    bool isOperationInProgress();
-    OperationState getCurrentOperation();
+    void startOperation(OperationState operation, GateState expectedState, int gate = 0);
+    bool isOperationInProgress(int gate = 0);
+    OperationState getCurrentOperation(int gate = 0);
+    
+    // Last known (debounced) state, no sensor read
+    GateState getState(int gate = 0) { return _lastState[gate]; }
+    
+    // Monotonic state version: bumped on every state change, operation start/end, alert and
+    // auto-close countdown change
+    uint32_t getVersion(int gate = 0) { return _version[gate]; }
     
     // Auto-close management
-    void enableAutoClose();
-    void disableAutoClose();
-    bool isAutoCloseEnabled();
-    unsigned long getAutoCloseRemainingTime();
+    void enableAutoClose(int gate = 0);
+    void disableAutoClose(int gate = 0);
+    bool isAutoCloseEnabled(int gate = 0);
+    unsigned long getAutoCloseRemainingTime(int gate = 0);
     
     // Alert management
-    bool isAlertActive();
-    void clearAlert();
+    bool isAlertActive(int gate = 0);
+    void clearAlert(int gate = 0);
     
     // Status information
-    unsigned long getOperationElapsedTime();
-    unsigned long getOperationRemainingTime();
+    unsigned long getOperationElapsedTime(int gate = 0);
+    unsigned long getOperationRemainingTime(int gate = 0);
+    
+    // Relay pulse timestamps (micros), 0 until the first pulse
+    unsigned long getLastPulseStartTime(int gate = 0);
+    unsigned long getLastPulseEndTime(int gate = 0);
 
 private:
     GateController* _gateController;
-    GateState _lastState;
-    OperationState _currentOperation;
-    unsigned long _operationStartTime;
-    GateState _expectedState;
-    bool _alertTriggered;
+    GateState _lastState[GATE_COUNT];
+    OperationState _currentOperation[GATE_COUNT];
+    unsigned long _operationStartTime[GATE_COUNT];   // micros(), edges are timestamped with the same clock
+    GateState _expectedState[GATE_COUNT];
+    bool _alertTriggered[GATE_COUNT];
     
     // Auto-close mechanism
-    unsigned long _gateOpenedTime;
-    bool _autoCloseEnabled;
-    
-    void handleStateChange(GateState currentState);
-    void checkOperationTimeout();
-    void checkAutoClose();
-    void triggerAlert(const String& message);
-    void printStateChange(GateState state);
+    unsigned long _gateOpenedTime[GATE_COUNT];
+    bool _autoCloseEnabled[GATE_COUNT];
+    
+    // Relay pulse tracking
+    unsigned long _lastPulseStartTime[GATE_COUNT];
+    unsigned long _lastPulseEndTime[GATE_COUNT];
+    
+    uint32_t _version[GATE_COUNT];
+    
+    void handleRelayEvents();
+    void handleStateChange(int gate, GateState currentState, unsigned long changedAt);
+    void checkOperationTimeout(int gate);
+    void checkAutoClose(int gate);
+    void triggerAlert(int gate, const String& message);
+    void printStateChange(int gate, GateState state);
+    static String gateLabel(int gate);
 };
 
 #endif // GATE_MONITOR_H
\ No newline at end of file
@@ -15,4 +15,14 @@ enum OperationState {
   CLOSING
 };
 
+// Gate position from its two sensors (true = gate near the sensor)
+inline GateState gateStateFromSensors(bool closedActive, bool openActive) {
+  if (closedActive && !openActive) {
+    return CLOSED;
+  } else if (!closedActive && openActive) {
+    return OPEN;
+  }
+  return UNKNOWN;  // None or both sensors activated
+}
+
 #endif // GATE_TYPES_H
\ No newline at end of file
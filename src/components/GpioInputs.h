@@ -0,0 +1,46 @@
+#ifndef GPIO_INPUTS_H
+#define GPIO_INPUTS_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#include <soc/gpio_reg.h>
+#endif
+
+#include <stdint.h>
+#include "Config.h"
+
+// True when a sensor sits on GPIO32-39 (second input register)
+constexpr bool gatesUseHighGpioBank(int index = 0) {
+    return index < GATE_COUNT &&
+           (GATES[index].closedSensorPin >= 32 || GATES[index].openSensorPin >= 32 || gatesUseHighGpioBank(index + 1));
+}
+
+// Levels of every GPIO in one go (bit n = GPIO n) instead of one digitalRead() per sensor
+inline uint64_t readGpioInputs() {
+#ifdef UNIT_TEST
+    uint64_t levels = 0;
+    for (int i = 0; i < GATE_COUNT; i++) {
+        if (digitalRead(GATES[i].closedSensorPin)) {
+            levels |= 1ULL << GATES[i].closedSensorPin;
+        }
+        if (digitalRead(GATES[i].openSensorPin)) {
+            levels |= 1ULL << GATES[i].openSensorPin;
+        }
+    }
+    return levels;
+#else
+    uint64_t levels = REG_READ(GPIO_IN_REG);
+    if (gatesUseHighGpioBank()) {
+        levels |= static_cast<uint64_t>(REG_READ(GPIO_IN1_REG) & 0xFF) << 32;
+    }
+    return levels;
+#endif
+}
+
+inline uint8_t gpioLevel(uint64_t levels, uint8_t pin) {
+    return (levels >> pin) & 1 ? HIGH : LOW;
+}
+
+#endif // GPIO_INPUTS_H
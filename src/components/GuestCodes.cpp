@@ -0,0 +1,329 @@
+#include "GuestCodes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef UNIT_TEST
+#include <Preferences.h>
+#include <mbedtls/md.h>
+#endif
+
+namespace {
+    const int WINDOW = 2 * GUEST_TOTP_DRIFT + 1;
+    const uint32_t NO_CODE = 0xFFFFFFFF;      // Never equal to a parsed code
+    const int MAX_FIELDS = 5;
+
+    uint32_t codeModulus() {
+        uint32_t modulus = 1;
+        for (int i = 0; i < GUEST_CODE_DIGITS; i++) {
+            modulus *= 10;
+        }
+        return modulus;
+    }
+}
+
+GuestCodes::GuestCodes() : _count(0), _unsaved(false) {
+    memset(_guests, 0, sizeof(_guests));
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+int GuestCodes::load(const char* spec) {
+    _count = 0;
+    _unsaved = false;
+    memset(_guests, 0, sizeof(_guests));
+    if (!spec) {
+        return 0;
+    }
+
+    const char* entry = spec;
+    while (*entry != '\0') {
+        const char* end = strchr(entry, ';');
+        size_t length = end ? static_cast<size_t>(end - entry) : strlen(entry);
+        if (length > 0) {
+            if (_count >= GUEST_SLOTS) {
+                Serial.println("[Guest][Warning] More than " + String(GUEST_SLOTS) + " guests, the rest is ignored");
+                break;
+            }
+            if (parseEntry(entry, length, _guests[_count])) {
+                _count++;
+            } else {
+                Serial.println("[Guest][Warning] Malformed guest entry skipped (#" + String(_count + 1) + ")");
+            }
+        }
+        if (!end) {
+            break;
+        }
+        entry = end + 1;
+    }
+    return _count;
+}
+
+bool GuestCodes::parseEntry(const char* entry, size_t length, Guest& guest) {
+    const char* fields[MAX_FIELDS];
+    size_t lengths[MAX_FIELDS];
+    int fieldCount = 0;
+    const char* start = entry;
+    for (size_t i = 0; i <= length; i++) {
+        if (i == length || entry[i] == ':') {
+            if (fieldCount == MAX_FIELDS) {
+                return false;
+            }
+            fields[fieldCount] = start;
+            lengths[fieldCount] = entry + i - start;
+            fieldCount++;
+            start = entry + i + 1;
+        }
+    }
+    if (fieldCount < 2 || lengths[0] == 0 || lengths[0] > GUEST_LABEL_MAX) {
+        return false;
+    }
+
+    memset(&guest, 0, sizeof(guest));
+    memcpy(guest.label, fields[0], lengths[0]);
+    int secretLength = base32Decode(fields[1], lengths[1], guest.secret, sizeof(guest.secret));
+    if (secretLength <= 0) {
+        return false;
+    }
+    guest.secretLength = static_cast<uint8_t>(secretLength);
+
+    int64_t maxUses = 0;
+    if ((fieldCount > 2 && !parseNumber(fields[2], lengths[2], guest.validFrom)) ||
+        (fieldCount > 3 && !parseNumber(fields[3], lengths[3], guest.validUntil)) ||
+        (fieldCount > 4 && !parseNumber(fields[4], lengths[4], maxUses)) || maxUses > 0xFFFFFFFF) {
+        return false;
+    }
+    guest.maxUses = static_cast<uint32_t>(maxUses);
+    guest.lastStep = -1;
+    guest.cachedStep = -1;
+    return true;
+}
+
+GuestCodes::Result GuestCodes::verify(const char* code, int64_t now, int& index) {
+    index = -1;
+    uint32_t value = 0;
+    size_t digits = code ? strlen(code) : 0;
+    if (digits != GUEST_CODE_DIGITS) {
+        _stats.rejected++;
+        return GUEST_INVALID_CODE;
+    }
+    for (size_t i = 0; i < digits; i++) {
+        if (code[i] < '0' || code[i] > '9') {
+            _stats.rejected++;
+            return GUEST_INVALID_CODE;
+        }
+        value = value * 10 + (code[i] - '0');
+    }
+
+    // A code can match more than one guest (1 in 10^6): the first one it is good for wins
+    const int64_t step = now / GUEST_TOTP_STEP;
+    Result refusal = GUEST_INVALID_CODE;
+    for (int i = 0; i < _count; i++) {
+        Guest& guest = _guests[i];
+        refreshCodes(guest, step);
+        for (int j = 0; j < WINDOW; j++) {
+            if (guest.codes[j] != value) {
+                continue;
+            }
+            const int64_t codeStep = step - GUEST_TOTP_DRIFT + j;
+            Result result = GUEST_ACCEPTED;
+            if (guest.validFrom > 0 && now < guest.validFrom) {
+                result = GUEST_NOT_YET_VALID;
+            } else if (guest.validUntil > 0 && now >= guest.validUntil) {
+                result = GUEST_EXPIRED;
+            } else if (guest.maxUses > 0 && guest.uses >= guest.maxUses) {
+                result = GUEST_USED_UP;
+            } else if (codeStep <= guest.lastStep) {
+                result = GUEST_REPLAYED;
+            }
+
+            if (result == GUEST_ACCEPTED) {
+                guest.uses++;
+                guest.lastStep = codeStep;
+                guest.unsaved = true;
+                _unsaved = true;
+                index = i;
+                _stats.accepted++;
+                return GUEST_ACCEPTED;
+            }
+            if (index < 0) {
+                index = i;
+                refusal = result;
+            }
+        }
+    }
+    _stats.rejected++;
+    return refusal;
+}
+
+void GuestCodes::refreshCodes(Guest& guest, int64_t step) {
+    if (guest.cachedStep == step) {
+        return;
+    }
+
+    // Usually one step later: keep the overlapping codes, compute the new ones only
+    int64_t shift = guest.cachedStep >= 0 ? step - guest.cachedStep : WINDOW;
+    int kept = 0;
+    if (shift > 0 && shift < WINDOW) {
+        kept = WINDOW - static_cast<int>(shift);
+        memmove(guest.codes, guest.codes + shift, kept * sizeof(guest.codes[0]));
+    }
+    for (int j = kept; j < WINDOW; j++) {
+        int64_t counter = step - GUEST_TOTP_DRIFT + j;
+        guest.codes[j] = counter >= 0 ? hotp(guest.secret, guest.secretLength, static_cast<uint64_t>(counter))
+                                      : NO_CODE;
+    }
+    guest.cachedStep = step;
+}
+
+void GuestCodes::restoreUsage(int index, uint32_t uses, int64_t lastStep) {
+    if (index < 0 || index >= _count) {
+        return;
+    }
+    _guests[index].uses = uses;
+    _guests[index].lastStep = lastStep;
+}
+
+const char* GuestCodes::describe(Result result) {
+    switch (result) {
+        case GUEST_ACCEPTED: return "Accepted";
+        case GUEST_INVALID_CODE: return "Invalid code";
+        case GUEST_NOT_YET_VALID: return "Guest access not valid yet";
+        case GUEST_EXPIRED: return "Guest access expired";
+        case GUEST_USED_UP: return "Guest access used up";
+        case GUEST_REPLAYED: return "Code already used";
+    }
+    return "Unknown";
+}
+
+uint32_t GuestCodes::hotp(const uint8_t* secret, size_t length, uint64_t counter) {
+    uint8_t message[8];
+    for (int i = 7; i >= 0; i--) {
+        message[i] = static_cast<uint8_t>(counter);
+        counter >>= 8;
+    }
+    uint8_t mac[20];
+    if (!hmacSha1(secret, length, message, sizeof(message), mac)) {
+        return NO_CODE;
+    }
+    // Dynamic truncation
+    int offset = mac[19] & 0x0F;
+    uint32_t binary = (static_cast<uint32_t>(mac[offset] & 0x7F) << 24) |
+                      (static_cast<uint32_t>(mac[offset + 1]) << 16) |
+                      (static_cast<uint32_t>(mac[offset + 2]) << 8) |
+                      static_cast<uint32_t>(mac[offset + 3]);
+    return binary % codeModulus();
+}
+
+int GuestCodes::base32Decode(const char* text, size_t length, uint8_t* out, size_t capacity) {
+    // RFC 4648 alphabet, case-insensitive; spaces and '=' padding are ignored
+    uint32_t buffer = 0;
+    int bits = 0;
+    size_t written = 0;
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        int value;
+        if (c >= 'A' && c <= 'Z') {
+            value = c - 'A';
+        } else if (c >= 'a' && c <= 'z') {
+            value = c - 'a';
+        } else if (c >= '2' && c <= '7') {
+            value = c - '2' + 26;
+        } else if (c == ' ' || c == '=') {
+            continue;
+        } else {
+            return -1;
+        }
+        buffer = (buffer << 5) | value;
+        bits += 5;
+        if (bits >= 8) {
+            if (written == capacity) {
+                return -1;
+            }
+            bits -= 8;
+            out[written++] = static_cast<uint8_t>(buffer >> bits);
+        }
+    }
+    return static_cast<int>(written);
+}
+
+bool GuestCodes::parseNumber(const char* text, size_t length, int64_t& value) {
+    value = 0;
+    if (length > 18) {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++) {
+        if (text[i] < '0' || text[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+#ifndef UNIT_TEST
+namespace {
+    const char* USAGE_NAMESPACE = "guests";
+
+    struct StoredUsage {
+        uint32_t uses;
+        int64_t lastStep;
+    };
+
+    void usageKey(const GuestCodes::Guest& guest, char* key, size_t size) {
+        // FNV-1a over label and secret
+        uint32_t hash = 2166136261u;
+        for (const char* c = guest.label; *c != '\0'; c++) {
+            hash = (hash ^ static_cast<uint8_t>(*c)) * 16777619u;
+        }
+        for (int i = 0; i < guest.secretLength; i++) {
+            hash = (hash ^ guest.secret[i]) * 16777619u;
+        }
+        snprintf(key, size, "g%08lx", static_cast<unsigned long>(hash));
+    }
+}
+
+bool GuestCodes::hmacSha1(const uint8_t* key, size_t keyLength, const uint8_t* message, size_t length,
+                          uint8_t* mac) {
+    return mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA1), key, keyLength, message, length, mac) == 0;
+}
+
+void GuestCodes::loadUsage() {
+    Preferences preferences;
+    if (!preferences.begin(USAGE_NAMESPACE, true)) {
+        return; // Nothing stored yet
+    }
+    for (int i = 0; i < _count; i++) {
+        char key[16];
+        usageKey(_guests[i], key, sizeof(key));
+        StoredUsage usage;
+        if (preferences.getBytes(key, &usage, sizeof(usage)) == sizeof(usage)) {
+            restoreUsage(i, usage.uses, usage.lastStep);
+        }
+    }
+    preferences.end();
+}
+
+void GuestCodes::saveUsage() {
+    if (!_unsaved) {
+        return;
+    }
+    Preferences preferences;
+    if (!preferences.begin(USAGE_NAMESPACE, false)) {
+        Serial.println("[Guest][Error] NVS unavailable, guest usage not saved");
+        return; // Still unsaved, retried on the next call
+    }
+    for (int i = 0; i < _count; i++) {
+        Guest& guest = _guests[i];
+        if (!guest.unsaved) {
+            continue;
+        }
+        char key[16];
+        usageKey(guest, key, sizeof(key));
+        StoredUsage usage = {guest.uses, guest.lastStep};
+        preferences.putBytes(key, &usage, sizeof(usage));
+        guest.unsaved = false;
+    }
+    preferences.end();
+    _unsaved = false;
+}
+#endif
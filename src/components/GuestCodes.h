@@ -0,0 +1,94 @@
+#ifndef GUEST_CODES_H
+#define GUEST_CODES_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Config.h"
+
+// Guest access codes: a small table of TOTP secrets (RFC 6238, HMAC-SHA1, 6 digits, 30 s),
+// each with an optional validity window and usage limit, checked on-device without Keycloak.
+// Configured as "label:BASE32SECRET[:validFrom:validUntil:maxUses]" entries separated by ';'
+// (epoch seconds, 0 or empty: no bound / unlimited). The codes of the steps around the
+// current one are cached per guest and only recomputed when the step changes, so a check
+// is a handful of integer compares. A code is accepted once: its step, and the older ones,
+// are refused afterwards. Network task only.
+class GuestCodes {
+public:
+    enum Result {
+        GUEST_ACCEPTED,
+        GUEST_INVALID_CODE,   // Malformed, or no guest has this code right now
+        GUEST_NOT_YET_VALID,
+        GUEST_EXPIRED,
+        GUEST_USED_UP,
+        GUEST_REPLAYED        // Code (or a newer one) already used
+    };
+
+    struct Guest {
+        char label[GUEST_LABEL_MAX + 1];
+        uint8_t secret[GUEST_SECRET_MAX];
+        uint8_t secretLength;
+        int64_t validFrom;          // Epoch seconds, 0: no bound
+        int64_t validUntil;         // Exclusive, 0: no bound
+        uint32_t maxUses;           // 0: unlimited
+        uint32_t uses;
+        int64_t lastStep;           // Step of the last accepted code, -1: none
+        int64_t cachedStep;         // Step codes[GUEST_TOTP_DRIFT] belongs to, -1: none
+        uint32_t codes[2 * GUEST_TOTP_DRIFT + 1];
+        bool unsaved;               // Accepted since the last saveUsage()
+    };
+
+    struct Stats {
+        uint32_t accepted;
+        uint32_t rejected;
+    };
+
+    GuestCodes();
+
+    // Replaces the table, returns the number of guests loaded (malformed entries are skipped)
+    int load(const char* spec);
+
+    // index is the guest the code belongs to, -1 when it matches none
+    Result verify(const char* code, int64_t now, int& index);
+
+    // Counters kept across reboots, so a used-up code stays used up
+    void restoreUsage(int index, uint32_t uses, int64_t lastStep);
+    bool hasUnsavedUsage() const { return _unsaved; }
+
+    int count() const { return _count; }
+    const Guest& guest(int index) const { return _guests[index]; }
+    const Stats& getStats() const { return _stats; }
+
+    // Reason sent back with a refused code
+    static const char* describe(Result result);
+
+    // RFC 4226 truncated HMAC-SHA1, GUEST_CODE_DIGITS digits
+    static uint32_t hotp(const uint8_t* secret, size_t length, uint64_t counter);
+
+#ifndef UNIT_TEST
+    // NVS: usage counters, keyed by a hash of label and secret (a new secret starts over).
+    // saveUsage() writes the guests accepted since the last call, off the request path
+    void loadUsage();
+    void saveUsage();
+#endif
+
+private:
+    Guest _guests[GUEST_SLOTS];
+    int _count;
+    bool _unsaved;
+    Stats _stats;
+
+    bool parseEntry(const char* entry, size_t length, Guest& guest);
+    void refreshCodes(Guest& guest, int64_t step);
+    static int base32Decode(const char* text, size_t length, uint8_t* out, size_t capacity);
+    // mbedtls on the board; false on failure
+    static bool hmacSha1(const uint8_t* key, size_t keyLength, const uint8_t* message, size_t length, uint8_t* mac);
+    static bool parseNumber(const char* text, size_t length, int64_t& value);
+};
+
+#endif // GUEST_CODES_H
@@ -0,0 +1,192 @@
+#include "HostResolver.h"
+
+#include <WiFi.h>
+#include <ESPmDNS.h>
+#include <string.h>
+
+HostResolver& HostResolver::getInstance() {
+    static HostResolver instance;
+    return instance;
+}
+
+HostResolver::HostResolver() : _mutex(nullptr), _refreshTask(nullptr), _stats() {
+    _mutex = xSemaphoreCreateMutex();
+    for (int i = 0; i < HOST_RESOLVER_MAX_ENTRIES; i++) {
+        _entries[i].used = false;
+    }
+}
+
+void HostResolver::begin() {
+    if (_refreshTask) {
+        return;
+    }
+    xTaskCreatePinnedToCore(refreshTaskEntry, "dns_refresh", 4096, this, 1, &_refreshTask, 0);
+}
+
+bool HostResolver::resolve(const String& host, IPAddress& ip) {
+    if (host.isEmpty() || host.length() >= sizeof(_entries[0].host)) {
+        return false;
+    }
+
+    // IP literals never hit the network
+    if (ip.fromString(host)) {
+        return true;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    Entry* entry = find(host.c_str());
+    if (entry) {
+        ip = entry->ip;
+        const unsigned long age = millis() - entry->resolvedAt;
+        if (age >= entry->ttl) {
+            // The background refresh failed or hasn't run yet: serve stale, try again later
+            _stats.staleServed++;
+            entry->refreshPending = true;
+        } else {
+            _stats.hits++;
+            if (isRefreshDue(*entry)) {
+                entry->refreshPending = true;
+            }
+        }
+        const bool wakeRefresh = entry->refreshPending;
+        xSemaphoreGive(_mutex);
+
+        if (wakeRefresh && _refreshTask) {
+            xTaskNotifyGive(_refreshTask);
+        }
+        return true;
+    }
+    _stats.misses++;
+    xSemaphoreGive(_mutex);
+
+    // First lookup for this host: nothing to serve, resolve in the foreground
+    unsigned long start = millis();
+    if (!lookup(host.c_str(), ip)) {
+        _stats.failures++;
+        Serial.println("[DNS][Error] Échec de résolution pour: " + host);
+        return false;
+    }
+
+    Serial.println("[DNS] " + host + " -> " + ip.toString() + " (" + String(millis() - start) + " ms)");
+    store(host.c_str(), ip);
+    return true;
+}
+
+void HostResolver::refreshAll() {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    for (int i = 0; i < HOST_RESOLVER_MAX_ENTRIES; i++) {
+        if (_entries[i].used) {
+            _entries[i].refreshPending = true;
+        }
+    }
+    xSemaphoreGive(_mutex);
+
+    if (_refreshTask) {
+        xTaskNotifyGive(_refreshTask);
+    }
+}
+
+HostResolver::Entry* HostResolver::find(const char* host) {
+    for (int i = 0; i < HOST_RESOLVER_MAX_ENTRIES; i++) {
+        if (_entries[i].used && strcasecmp(_entries[i].host, host) == 0) {
+            return &_entries[i];
+        }
+    }
+    return nullptr;
+}
+
+HostResolver::Entry* HostResolver::allocate(const char* host) {
+    Entry* oldest = &_entries[0];
+    for (int i = 0; i < HOST_RESOLVER_MAX_ENTRIES; i++) {
+        if (!_entries[i].used) {
+            return &_entries[i];
+        }
+        if (_entries[i].resolvedAt < oldest->resolvedAt) {
+            oldest = &_entries[i];
+        }
+    }
+    return oldest;
+}
+
+void HostResolver::store(const char* host, const IPAddress& ip) {
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    Entry* entry = find(host);
+    if (!entry) {
+        entry = allocate(host);
+        strncpy(entry->host, host, sizeof(entry->host) - 1);
+        entry->host[sizeof(entry->host) - 1] = '\0';
+    }
+    entry->ip = ip;
+    entry->resolvedAt = millis();
+    entry->ttl = ttlFor(host);
+    entry->used = true;
+    entry->refreshPending = false;
+    xSemaphoreGive(_mutex);
+}
+
+void HostResolver::refreshDue() {
+    for (int i = 0; i < HOST_RESOLVER_MAX_ENTRIES; i++) {
+        char host[sizeof(_entries[0].host)];
+
+        xSemaphoreTake(_mutex, portMAX_DELAY);
+        Entry& entry = _entries[i];
+        const bool due = entry.used && (entry.refreshPending || isRefreshDue(entry));
+        if (due) {
+            memcpy(host, entry.host, sizeof(host));
+        }
+        xSemaphoreGive(_mutex);
+
+        if (!due || WiFi.status() != WL_CONNECTED) {
+            continue;
+        }
+
+        // The lookup itself runs without the lock so that readers keep being served
+        IPAddress ip;
+        _stats.refreshes++;
+        if (lookup(host, ip)) {
+            store(host, ip);
+        } else {
+            _stats.failures++;
+            Serial.println("[DNS][Warning] Refresh failed for " + String(host) + ", keeping last known address");
+            xSemaphoreTake(_mutex, portMAX_DELAY);
+            entry.refreshPending = false; // Retried on the next periodic check or stale read
+            xSemaphoreGive(_mutex);
+        }
+    }
+}
+
+bool HostResolver::isRefreshDue(const Entry& entry) {
+    // Refresh ahead of expiry so that readers never wait on the network
+    return millis() - entry.resolvedAt >= entry.ttl / 100 * HOST_RESOLVER_REFRESH_PERCENT;
+}
+
+bool HostResolver::isMdnsHost(const char* host) {
+    size_t len = strlen(host);
+    return len > 6 && strcasecmp(host + len - 6, ".local") == 0;
+}
+
+unsigned long HostResolver::ttlFor(const char* host) {
+    return isMdnsHost(host) ? MDNS_CACHE_TTL : DNS_CACHE_TTL;
+}
+
+bool HostResolver::lookup(const char* host, IPAddress& ip) {
+    if (isMdnsHost(host)) {
+        // The mDNS responder expects the name without the ".local" suffix
+        char name[sizeof(_entries[0].host)];
+        size_t len = strlen(host) - 6;
+        memcpy(name, host, len);
+        name[len] = '\0';
+        ip = MDNS.queryHost(name, MDNS_QUERY_TIMEOUT);
+        return static_cast<uint32_t>(ip) != 0;
+    }
+    return WiFi.hostByName(host, ip) == 1;
+}
+
+void HostResolver::refreshTaskEntry(void* arg) {
+    HostResolver* resolver = static_cast<HostResolver*>(arg);
+    for (;;) {
+        // Woken by stale reads and reconnects, otherwise checks entries periodically
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HOST_RESOLVER_CHECK_INTERVAL));
+        resolver->refreshDue();
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef HOST_RESOLVER_H
+#define HOST_RESOLVER_H
+
+#include <Arduino.h>
+#include <IPAddress.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "Config.h"
+
+// Shared DNS / mDNS cache for the outbound hosts (Keycloak, EMQX).
+// Entries are refreshed in a background task before they expire; when a refresh
+// fails the last known address keeps being served.
+class HostResolver {
+public:
+    struct Stats {
+        uint32_t hits;
+        uint32_t misses;        // Foreground (blocking) lookups
+        uint32_t staleServed;   // Expired entries returned because the refresh failed
+        uint32_t refreshes;     // Background lookups
+        uint32_t failures;      // Failed lookups (foreground or background)
+    };
+
+    static HostResolver& getInstance();
+
+    // Start the background refresh task
+    void begin();
+
+    // Resolve host (IP literal, DNS name or *.local) to an address, from cache when possible
+    bool resolve(const String& host, IPAddress& ip);
+
+    // Re-resolve every entry in the background (e.g. after a Wi-Fi reconnect)
+    void refreshAll();
+
+    const Stats& getStats() const { return _stats; }
+
+private:
+    HostResolver();
+    HostResolver(const HostResolver&) = delete;
+    HostResolver& operator=(const HostResolver&) = delete;
+
+    struct Entry {
+        char host[64];
+        IPAddress ip;
+        unsigned long resolvedAt;
+        unsigned long ttl;
+        bool used;
+        bool refreshPending;
+    };
+
+    Entry _entries[HOST_RESOLVER_MAX_ENTRIES];
+    SemaphoreHandle_t _mutex;
+    TaskHandle_t _refreshTask;
+    Stats _stats;
+
+    Entry* find(const char* host);
+    Entry* allocate(const char* host);
+    void store(const char* host, const IPAddress& ip);
+    void refreshDue();
+
+    static bool isRefreshDue(const Entry& entry);
+    static bool isMdnsHost(const char* host);
+    static unsigned long ttlFor(const char* host);
+    static bool lookup(const char* host, IPAddress& ip);
+    static void refreshTaskEntry(void* arg);
+};
+
+#endif // HOST_RESOLVER_H
@@ -0,0 +1,195 @@
+#include "JsonWriter.h"
+
+#include <string.h>
+
+JsonWriter::JsonWriter(char* buffer, size_t capacity)
+    : _buffer(buffer), _capacity(capacity) {
+    reset();
+}
+
+void JsonWriter::reset() {
+    _length = 0;
+    _overflowed = _capacity == 0;
+    _depth = 0;
+    _hasMembers = 0;
+    if (_capacity > 0) {
+        _buffer[0] = '\0';
+    }
+}
+
+JsonWriter& JsonWriter::beginObject(const char* key) {
+    beginValue(key);
+    append('{');
+    if (_depth + 1 >= MAX_DEPTH) {
+        _overflowed = true;
+        return *this;
+    }
+    _depth++;
+    _hasMembers &= ~(1UL << _depth);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+    append('}');
+    if (_depth > 0) {
+        _depth--;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::beginArray(const char* key) {
+    beginValue(key);
+    append('[');
+    if (_depth + 1 >= MAX_DEPTH) {
+        _overflowed = true;
+        return *this;
+    }
+    _depth++;
+    _hasMembers &= ~(1UL << _depth);
+    return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+    append(']');
+    if (_depth > 0) {
+        _depth--;
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* key, const char* value) {
+    beginValue(key);
+    if (!value) {
+        append("null", 4);
+        return *this;
+    }
+    append('"');
+    appendEscaped(value, strlen(value));
+    append('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* key, const String& value) {
+    beginValue(key);
+    append('"');
+    appendEscaped(value.c_str(), value.length());
+    append('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* key, bool value) {
+    beginValue(key);
+    if (value) {
+        append("true", 4);
+    } else {
+        append("false", 5);
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* key, long value) {
+    beginValue(key);
+    if (value < 0) {
+        append('-');
+        appendNumber(0UL - static_cast<unsigned long>(value));
+    } else {
+        appendNumber(static_cast<unsigned long>(value));
+    }
+    return *this;
+}
+
+JsonWriter& JsonWriter::field(const char* key, unsigned long value) {
+    beginValue(key);
+    appendNumber(value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::rawField(const char* key, const char* json, size_t length) {
+    beginValue(key);
+    append(json, length);
+    return *this;
+}
+
+JsonWriter& JsonWriter::resumeObject(const char* key, const char* json, size_t length) {
+    beginValue(key);
+    append(json, length);
+    if (_depth + 1 >= MAX_DEPTH) {
+        _overflowed = true;
+        return *this;
+    }
+    _depth++;
+    _hasMembers |= 1UL << _depth; // The serialized part holds at least one member
+    return *this;
+}
+
+void JsonWriter::beginValue(const char* key) {
+    if (_hasMembers & (1UL << _depth)) {
+        append(',');
+    }
+    _hasMembers |= 1UL << _depth;
+
+    if (key) {
+        append('"');
+        appendEscaped(key, strlen(key));
+        append('"');
+        append(':');
+    }
+}
+
+void JsonWriter::append(char c) {
+    if (_length + 1 >= _capacity) {
+        _overflowed = true;
+        return;
+    }
+    _buffer[_length++] = c;
+    _buffer[_length] = '\0';
+}
+
+void JsonWriter::append(const char* text, size_t length) {
+    if (_length + length >= _capacity) {
+        _overflowed = true;
+        return;
+    }
+    memcpy(_buffer + _length, text, length);
+    _length += length;
+    _buffer[_length] = '\0';
+}
+
+void JsonWriter::appendNumber(unsigned long value) {
+    // Digits from the right, no printf
+    char digits[20];
+    size_t start = sizeof(digits);
+    do {
+        digits[--start] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    append(digits + start, sizeof(digits) - start);
+}
+
+void JsonWriter::appendEscaped(const char* text, size_t length) {
+    size_t plain = 0; // Start of the run copied as is
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue; // UTF-8 passes through
+        }
+        append(text + plain, i - plain);
+        plain = i + 1;
+        switch (c) {
+            case '"': append("\\\"", 2); break;
+            case '\\': append("\\\\", 2); break;
+            case '\n': append("\\n", 2); break;
+            case '\r': append("\\r", 2); break;
+            case '\t': append("\\t", 2); break;
+            case '\b': append("\\b", 2); break;
+            case '\f': append("\\f", 2); break;
+            default: {
+                static const char hex[] = "0123456789abcdef";
+                char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0f]};
+                append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+    append(text + plain, length - plain);
+}
@@ -0,0 +1,73 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming JSON serializer into a caller-owned buffer (stack, static or a connection's
+// output). No heap allocation; strings are escaped; commas are handled by nesting level.
+// When the buffer is too small the output is truncated and overflowed() turns true, the
+// document must then not be sent.
+//
+//   char buffer[128];
+//   JsonWriter json(buffer, sizeof(buffer));
+//   json.beginObject().field("status", "open").field("version", 12).endObject();
+//   server.send(200, "application/json", json.c_str(), json.length());
+class JsonWriter {
+public:
+    static const int MAX_DEPTH = 16;
+
+    JsonWriter(char* buffer, size_t capacity);
+
+    // key is nullptr at top level and inside arrays
+    JsonWriter& beginObject(const char* key = nullptr);
+    JsonWriter& endObject();
+    JsonWriter& beginArray(const char* key = nullptr);
+    JsonWriter& endArray();
+
+    // Object members
+    JsonWriter& field(const char* key, const char* value);     // nullptr writes null
+    JsonWriter& field(const char* key, const String& value);
+    JsonWriter& field(const char* key, bool value);
+    JsonWriter& field(const char* key, int value) { return field(key, static_cast<long>(value)); }
+    JsonWriter& field(const char* key, unsigned int value) { return field(key, static_cast<unsigned long>(value)); }
+    JsonWriter& field(const char* key, long value);
+    JsonWriter& field(const char* key, unsigned long value);
+
+    // Array elements
+    JsonWriter& value(const char* value) { return field(nullptr, value); }
+    JsonWriter& value(const String& value) { return field(nullptr, value); }
+
+    // Already serialized value (a cached document, a nested writer's output)
+    JsonWriter& rawField(const char* key, const char* json, size_t length);
+
+    // Object serialized elsewhere without its closing brace, members can still be added
+    JsonWriter& resumeObject(const char* key, const char* json, size_t length);
+
+    const char* c_str() const { return _buffer; }
+    size_t length() const { return _length; }
+    bool overflowed() const { return _overflowed; }
+    void reset();
+
+private:
+    char* _buffer;
+    size_t _capacity;
+    size_t _length;
+    bool _overflowed;
+    int _depth;
+    uint32_t _hasMembers;              // Bit per nesting level: a comma is due before the next value
+
+    void beginValue(const char* key);
+    void append(char c);
+    void append(const char* text, size_t length);
+    void appendNumber(unsigned long value);
+    void appendEscaped(const char* text, size_t length);
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,146 @@
+#include "JwksCache.h"
+
+#include <ArduinoJson.h>
+#include <mbedtls/md.h>
+#include <mbedtls/rsa.h>
+
+namespace {
+    // Largest supported modulus: RSA-4096
+    const size_t MAX_MODULUS_BYTES = 512;
+    const size_t MAX_EXPONENT_BYTES = 8;
+}
+
+JwksCache::JwksCache() : _keyCount(0), _loadedAt(0), _lastRefreshAttempt(0) {
+    for (int i = 0; i < JWKS_MAX_KEYS; i++) {
+        mbedtls_pk_init(&_keys[i].pk);
+        _keys[i].used = false;
+    }
+}
+
+JwksCache::~JwksCache() {
+    clear();
+}
+
+bool JwksCache::loadFromJson(const String& jwksJson) {
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, jwksJson);
+
+    if (error) {
+        Serial.println("[Auth] Failed to parse JWKS: " + String(error.c_str()));
+        return false;
+    }
+
+    JsonArray keys = doc["keys"].as<JsonArray>();
+    if (keys.isNull()) {
+        Serial.println("[Auth] JWKS document has no \"keys\" array");
+        return false;
+    }
+
+    clear();
+
+    for (JsonObject key : keys) {
+        if (_keyCount >= JWKS_MAX_KEYS) {
+            Serial.println("[Auth][Warning] JWKS has more signing keys than JWKS_MAX_KEYS, ignoring the rest");
+            break;
+        }
+
+        const char* kty = key["kty"] | "";
+        const char* use = key["use"] | "sig";
+        const char* alg = key["alg"] | "RS256";
+        const char* kid = key["kid"] | "";
+
+        // Keycloak also publishes encryption keys (use=enc, RSA-OAEP) in the same set
+        if (strcmp(kty, "RSA") != 0 || strcmp(use, "sig") != 0 || strcmp(alg, "RS256") != 0 || kid[0] == '\0') {
+            continue;
+        }
+
+        KeySlot& slot = _keys[_keyCount];
+        if (!importRsaKey(slot, key["n"] | "", key["e"] | "")) {
+            Serial.println("[Auth][Warning] Skipping invalid JWKS key: " + String(kid));
+            continue;
+        }
+
+        slot.kid = kid;
+        slot.used = true;
+        _keyCount++;
+        Serial.println("[Auth] JWKS key loaded: " + slot.kid);
+    }
+
+    _loadedAt = millis();
+    return _keyCount > 0;
+}
+
+bool JwksCache::verify(const String& kid, const uint8_t* hash, size_t hashLen,
+                       const uint8_t* signature, size_t signatureLen) {
+    KeySlot* slot = findSlot(kid);
+    if (!slot) {
+        return false;
+    }
+
+    int ret = mbedtls_pk_verify(&slot->pk, MBEDTLS_MD_SHA256, hash, hashLen, signature, signatureLen);
+    return ret == 0;
+}
+
+bool JwksCache::hasKey(const String& kid) const {
+    return findSlot(kid) != nullptr;
+}
+
+bool JwksCache::isStale() const {
+    return _keyCount == 0 || millis() - _loadedAt >= JWKS_MAX_AGE;
+}
+
+bool JwksCache::canRefresh() const {
+    return _lastRefreshAttempt == 0 || millis() - _lastRefreshAttempt >= JWKS_MIN_REFRESH_INTERVAL;
+}
+
+void JwksCache::clear() {
+    for (int i = 0; i < JWKS_MAX_KEYS; i++) {
+        if (_keys[i].used) {
+            mbedtls_pk_free(&_keys[i].pk);
+            mbedtls_pk_init(&_keys[i].pk);
+            _keys[i].kid = "";
+            _keys[i].used = false;
+        }
+    }
+    _keyCount = 0;
+}
+
+JwksCache::KeySlot* JwksCache::findSlot(const String& kid) {
+    for (int i = 0; i < _keyCount; i++) {
+        if (_keys[i].used && _keys[i].kid == kid) {
+            return &_keys[i];
+        }
+    }
+    return nullptr;
+}
+
+const JwksCache::KeySlot* JwksCache::findSlot(const String& kid) const {
+    return const_cast<JwksCache*>(this)->findSlot(kid);
+}
+
+bool JwksCache::importRsaKey(KeySlot& slot, const char* n, const char* e) {
+    uint8_t modulus[MAX_MODULUS_BYTES];
+    uint8_t exponent[MAX_EXPONENT_BYTES];
+
+    int modulusLen = base64UrlDecode(n, strlen(n), modulus, sizeof(modulus));
+    int exponentLen = base64UrlDecode(e, strlen(e), exponent, sizeof(exponent));
+    if (modulusLen <= 0 || exponentLen <= 0) {
+        return false;
+    }
+
+    if (mbedtls_pk_setup(&slot.pk, mbedtls_pk_info_from_type(MBEDTLS_PK_RSA)) != 0) {
+        return false;
+    }
+
+    mbedtls_rsa_context* rsa = mbedtls_pk_rsa(slot.pk);
+    if (mbedtls_rsa_import_raw(rsa, modulus, modulusLen, nullptr, 0, nullptr, 0, nullptr, 0,
+                               exponent, exponentLen) != 0 ||
+        mbedtls_rsa_complete(rsa) != 0 ||
+        mbedtls_rsa_check_pubkey(rsa) != 0) {
+        mbedtls_pk_free(&slot.pk);
+        mbedtls_pk_init(&slot.pk);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,48 @@
+#ifndef JWKS_CACHE_H
+#define JWKS_CACHE_H
+
+#include <Arduino.h>
+#include <mbedtls/pk.h>
+#include "Base64Url.h"
+#include "Config.h"
+
+// Realm signing keys (RS256) indexed by "kid", loaded from the Keycloak JWKS endpoint
+class JwksCache {
+public:
+    JwksCache();
+    ~JwksCache();
+
+    // Replace the cached keys with the RSA signing keys found in a JWKS document
+    bool loadFromJson(const String& jwksJson);
+
+    // Verify an RS256 signature over a SHA-256 digest with the key identified by kid
+    bool verify(const String& kid, const uint8_t* hash, size_t hashLen,
+                const uint8_t* signature, size_t signatureLen);
+
+    bool hasKey(const String& kid) const;
+    int getKeyCount() const { return _keyCount; }
+
+    // Refresh bookkeeping (millis based)
+    bool isStale() const;
+    bool canRefresh() const;
+    void markRefreshAttempt() { _lastRefreshAttempt = millis(); }
+
+private:
+    struct KeySlot {
+        String kid;
+        mbedtls_pk_context pk;
+        bool used;
+    };
+
+    KeySlot _keys[JWKS_MAX_KEYS];
+    int _keyCount;
+    unsigned long _loadedAt;
+    unsigned long _lastRefreshAttempt;
+
+    void clear();
+    KeySlot* findSlot(const String& kid);
+    const KeySlot* findSlot(const String& kid) const;
+    bool importRsaKey(KeySlot& slot, const char* n, const char* e);
+};
+
+#endif // JWKS_CACHE_H
@@ -1,17 +1,25 @@
 #include "JwtValidator.h"
 
 #include <cstdio>
+#include <cstring>
 #include <time.h>
-#if defined(ARDUINO) && !defined(UNIT_TEST)
-#include <WiFiClientSecure.h>
-#include <WiFi.h>
-#endif
+#include <mbedtls/md.h>
 
-JwtValidator::JwtValidator(AuthConfig* authConfig) : _authConfig(authConfig) {
+JwtValidator::JwtValidator(AuthConfig* authConfig, const AccessPolicy* policy)
+    : _authConfig(authConfig), _policy(policy), _connection(authConfig) {
 }
 
-ValidationResult JwtValidator::validateToken(const String& token) {
-    ValidationResult result = {false, "", "", "", ""};
+void JwtValidator::begin() {
+    _connection.setProbeUrl(buildRealmUrl());
+    _connection.begin();
+    
+    if (_authConfig && _authConfig->getValidationMode() != VALIDATION_INTROSPECTION) {
+        refreshJwks(millis() + KEYCLOAK_HTTP_TIMEOUT);
+    }
+}
+
+ValidationResult JwtValidator::validateToken(const String& token, unsigned long deadline) {
+    ValidationResult result;
     
     if (token.isEmpty()) {
         result.error = "Token is empty";
@@ -23,6 +31,56 @@ ValidationResult JwtValidator::validateToken(const String& token) {
         return result;
     }
     
+    TokenFingerprint fingerprint;
+    TokenCache::fingerprint(token, fingerprint);
+    if (_tokenCache.lookup(fingerprint, result)) {
+        Serial.println("[Auth] Token cache hit for user: " + result.username);
+        return result;
+    }
+    
+    // Replayed bad token: no introspection, no RSA verification
+    if (_rejectedCache.lookup(fingerprint, result.error)) {
+        Serial.println("[Auth] Token rejected again (cached): " + result.error);
+        return result;
+    }
+    
+    result = validateUncached(token, deadline);
+    if (result.isValid) {
+        _tokenCache.store(fingerprint, result, time(nullptr));
+    } else {
+        _rejectedCache.store(fingerprint, result);
+    }
+    return result;
+}
+
+ValidationResult JwtValidator::validateUncached(const String& token, unsigned long deadline) {
+    ValidationResult result;
+    
+    const TokenValidationMode mode = _authConfig->getValidationMode();
+    if (mode != VALIDATION_INTROSPECTION) {
+        LocalValidation outcome = validateLocally(token, result, deadline);
+        if (outcome != LOCAL_UNDECIDED) {
+            return result;
+        }
+        
+        if (mode == VALIDATION_LOCAL) {
+            // No JWKS key or no clock yet (Keycloak down, refresh rate-limited): not the token's fault,
+            // so neither cached as a rejection nor counted against the client
+            Serial.println("[Auth] Local verification inconclusive: " + result.error);
+            result.unavailable = true;
+            return result;
+        }
+        
+        Serial.println("[Auth] Local verification inconclusive (" + result.error + "), falling back to introspection");
+        result = ValidationResult();
+    }
+    
+    return introspectToken(token, deadline);
+}
+
+ValidationResult JwtValidator::introspectToken(const String& token, unsigned long deadline) {
+    ValidationResult result;
+    
     // Log current time for JWT timestamp comparison
     time_t now = time(nullptr);
     Serial.println("[Auth] Current ESP32 time: " + String(now) + " (" + String(ctime(&now)).substring(0, 24) + ")");
@@ -40,70 +98,9 @@ ValidationResult JwtValidator::validateToken(const String& token) {
         Serial.println("[Auth][Warning] KEYCLOAK_SERVER_URL semble invalide. Exemple: https://host:port");
     }
 
-    // Extract host/port for diagnostics
-    String host;
-    uint16_t port = 0;
-    bool isHttps = false;
-    {
-        int schemeSep = introspectionUrl.indexOf("://");
-        String rest = schemeSep > 0 ? introspectionUrl.substring(schemeSep + 3) : introspectionUrl;
-        isHttps = introspectionUrl.startsWith("https://");
-        int pathStart = rest.indexOf('/');
-        String hostPort = pathStart >= 0 ? rest.substring(0, pathStart) : rest;
-        int colon = hostPort.indexOf(':');
-        if (colon >= 0) {
-            host = hostPort.substring(0, colon);
-            port = hostPort.substring(colon + 1).toInt();
-        } else {
-            host = hostPort;
-            port = isHttps ? 443 : 80;
-        }
-    }
-#if defined(ARDUINO) && !defined(UNIT_TEST)
-    IPAddress ip;
-    if (WiFi.hostByName(host.c_str(), ip)) {
-        Serial.println("[Auth] Résolution DNS: " + host + " -> " + ip.toString() + ":" + String(port));
-    } else {
-        Serial.println("[Auth][Error] Échec de résolution DNS pour: " + host);
-    }
-#endif
-
-    // Initialize HTTP client with proper transport (HTTP or HTTPS)
-    if (introspectionUrl.startsWith("https://")) {
-#if defined(ARDUINO) && !defined(UNIT_TEST)
-#if KEYCLOAK_TLS_INSECURE
-    _secureClient.setInsecure(); // Dev mode: disable certificate validation
-#endif
-    // CRITICAL for Kubernetes ingress: SNI hostname is automatically sent by HTTPClient
-    // but we can verify TLS connectivity first
-    _secureClient.setHandshakeTimeout(15); // seconds
-    Serial.println("[Auth] Configuring TLS for SNI hostname: " + host);
-    
-    _httpClient.begin(_secureClient, introspectionUrl);
-#else
-    _httpClient.begin(introspectionUrl);
-#endif
-    } else {
-    _httpClient.begin(introspectionUrl);
-    }
-
-    // Harden HTTP behavior: avoid keep-alive reuse and use explicit timeouts
-    _httpClient.setReuse(false);
-    _httpClient.setTimeout(12000); // ms
-#ifdef HTTPC_STRICT_FOLLOW_REDIRECTS
-    _httpClient.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
-#endif
-    // Some proxies/servers behave better with HTTP/1.0 (no chunked encoding)
-    _httpClient.useHTTP10(true);
-
-    if (hasClientSecret) {
-        _httpClient.setAuthorization(clientId.c_str(), clientSecret.c_str());
-    } else {
+    if (!hasClientSecret) {
         Serial.println("[Auth][Warning] Aucun client_secret. L'introspection nécessite un client confidentiel.");
     }
-
-    _httpClient.addHeader("Content-Type", "application/x-www-form-urlencoded");
-    _httpClient.addHeader("Connection", "close");
     
     // Préparer la requête d'introspection
     String postData = "token=" + urlEncode(token);
@@ -118,28 +115,220 @@ ValidationResult JwtValidator::validateToken(const String& token) {
     
     Serial.println("[Auth] POST data length: " + String(postData.length()));
     
-    int httpCode = _httpClient.POST(postData);
+    String response;
+    unsigned long start = millis();
+    int httpCode = _connection.postForm(introspectionUrl, postData,
+                                        hasClientSecret ? clientId : String(""), clientSecret, response, deadline);
+    Serial.println("[Auth] Introspection took " + String(millis() - start) + " ms");
     
     if (httpCode == HTTP_CODE_OK) {
-        String response = _httpClient.getString();
         Serial.println("[Auth] Introspection response: " + response);
         if (!parseTokenResponse(response, result)) {
             result.error = "Failed to parse token response";
         }
     } else if (httpCode > 0) {
         result.error = "HTTP error: " + String(httpCode);
+        result.unavailable = httpCode >= 500;
         Serial.println("[Auth] Introspection failed, HTTP code: " + String(httpCode));
-        Serial.println("[Auth] Response: " + _httpClient.getString());
+        Serial.println("[Auth] Response: " + response);
+    } else if (httpCode == KeycloakConnection::ERROR_CIRCUIT_OPEN || httpCode == KeycloakConnection::ERROR_DEADLINE ||
+               httpCode == KeycloakConnection::ERROR_BUSY) {
+        result.error = KeycloakConnection::errorToString(httpCode);
+        result.unavailable = true;
+        Serial.println("[Auth] Introspection skipped: " + result.error);
     } else {
-        result.error = "Connection failed: " + String(_httpClient.errorToString(httpCode));
-        Serial.println("[Auth] Connection failed: " + _httpClient.errorToString(httpCode));
+        result.error = "Connection failed: " + KeycloakConnection::errorToString(httpCode);
+        result.unavailable = true;
+        Serial.println("[Auth] Connection failed: " + KeycloakConnection::errorToString(httpCode));
     }
     
-    _httpClient.end();
     return result;
 }
 
-String JwtValidator::buildIntrospectionUrl() const {
+JwtValidator::LocalValidation JwtValidator::validateLocally(const String& token, ValidationResult& result,
+                                                          unsigned long deadline) {
+    const int firstDot = token.indexOf('.');
+    const int secondDot = firstDot > 0 ? token.indexOf('.', firstDot + 1) : -1;
+    
+    if (firstDot <= 0 || secondDot < 0 || token.indexOf('.', secondDot + 1) >= 0) {
+        result.error = "Malformed JWT";
+        return LOCAL_REJECTED;
+    }
+    
+    // Header: only RS256 is accepted, never trust "alg":"none" or HMAC with the public key
+    JsonDocument header;
+    if (deserializeJson(header, base64Decode(token.substring(0, firstDot)))) {
+        result.error = "Malformed JWT header";
+        return LOCAL_REJECTED;
+    }
+    
+    const char* alg = header["alg"] | "";
+    const String kid = header["kid"] | "";
+    if (strcmp(alg, "RS256") != 0) {
+        result.error = "Unsupported JWT algorithm: " + String(alg);
+        return LOCAL_REJECTED;
+    }
+    
+    // Without NTP the exp/nbf checks are meaningless
+    const time_t now = time(nullptr);
+    if (now < CLOCK_SYNCED_MIN_EPOCH) {
+        result.error = "Clock not synchronized";
+        result.unavailable = true; // Temporary: not a rejection of the token
+        return LOCAL_UNDECIDED;
+    }
+    
+    if ((_jwksCache.isStale() || !_jwksCache.hasKey(kid)) && _jwksCache.canRefresh()) {
+        refreshJwks(deadline);
+    }
+    
+    if (!_jwksCache.hasKey(kid)) {
+        result.error = "Unknown signing key: " + kid;
+        return LOCAL_UNDECIDED;
+    }
+    
+    uint8_t signature[512];
+    const int signatureLen = base64UrlDecode(token.c_str() + secondDot + 1, token.length() - secondDot - 1,
+                                             signature, sizeof(signature));
+    if (signatureLen <= 0) {
+        result.error = "Malformed JWT signature";
+        return LOCAL_REJECTED;
+    }
+    
+    // The signing input is the ASCII "header.payload" prefix of the token
+    uint8_t hash[32];
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+               reinterpret_cast<const unsigned char*>(token.c_str()), secondDot, hash);
+    
+    if (!_jwksCache.verify(kid, hash, sizeof(hash), signature, signatureLen)) {
+        result.error = "Invalid token signature";
+        return LOCAL_REJECTED;
+    }
+    
+    JsonDocument claims;
+    if (deserializeJson(claims, base64Decode(token.substring(firstDot + 1, secondDot)))) {
+        result.error = "Malformed JWT claims";
+        return LOCAL_REJECTED;
+    }
+    
+    if (!checkClaims(claims, now, result)) {
+        Serial.println("[Auth] Local verification rejected token: " + result.error);
+        return LOCAL_REJECTED;
+    }
+    
+    result.isValid = true;
+    result.userId = claims["sub"] | "";
+    result.username = claims["preferred_username"] | "";
+    result.realm = claims["iss"] | "";
+    result.expiresAt = claims["exp"].as<long>();
+    result.roles = mapRoles(claims);
+    
+    Serial.println("[Auth] Token verified locally for user: " + result.username + " (kid: " + kid + ")");
+    return LOCAL_VERIFIED;
+}
+
+bool JwtValidator::checkClaims(JsonDocument& claims, time_t now, ValidationResult& result) {
+    if (!claims["exp"].is<long>()) {
+        result.error = "Token has no exp claim";
+        return false;
+    }
+    
+    if (claims["exp"].as<long>() + JWT_CLOCK_SKEW < now) {
+        result.error = "Token is expired";
+        return false;
+    }
+    
+    if (claims["nbf"].is<long>() && claims["nbf"].as<long>() - JWT_CLOCK_SKEW > now) {
+        result.error = "Token is not yet valid";
+        return false;
+    }
+    
+    // Refresh and ID tokens are signed with the same key, only access tokens open the gate
+    const char* typ = claims["typ"] | "Bearer";
+    if (strcmp(typ, "Bearer") != 0) {
+        result.error = "Not an access token (typ: " + String(typ) + ")";
+        return false;
+    }
+    
+    const String expectedIssuer = _authConfig->getExpectedIssuer().isEmpty()
+        ? buildRealmUrl()
+        : _authConfig->getExpectedIssuer();
+    const String issuer = claims["iss"] | "";
+    if (issuer != expectedIssuer) {
+        result.error = "Unexpected issuer: " + issuer;
+        return false;
+    }
+    
+    const String& audience = _authConfig->getExpectedAudience();
+    if (!audience.isEmpty()) {
+        bool audienceMatch = false;
+        if (claims["aud"].is<JsonArray>()) {
+            for (JsonVariant aud : claims["aud"].as<JsonArray>()) {
+                if (audience == (aud | "")) {
+                    audienceMatch = true;
+                    break;
+                }
+            }
+        } else {
+            audienceMatch = audience == (claims["aud"] | "");
+        }
+        
+        if (!audienceMatch) {
+            result.error = "Token audience does not include " + audience;
+            return false;
+        }
+    }
+    
+    const String& azp = _authConfig->getAllowedAzp();
+    if (!azp.isEmpty() && azp != (claims["azp"] | "")) {
+        result.error = "Unexpected authorized party (azp)";
+        return false;
+    }
+    
+    return true;
+}
+
+uint32_t JwtValidator::mapRoles(JsonDocument& claims) const {
+    // Once per validation, the mask is cached with the result: no string compare per request
+    uint32_t roles = AccessPolicy::ROLE_AUTHENTICATED;
+    if (!_policy || !_policy->isRestricted()) {
+        return roles;
+    }
+    for (JsonVariantConst role : claims["realm_access"]["roles"].as<JsonArrayConst>()) {
+        roles |= _policy->roleBit(role | "");
+    }
+    const char* clientId = _authConfig->getKeycloakClientId().c_str();
+    for (JsonVariantConst role : claims["resource_access"][clientId]["roles"].as<JsonArrayConst>()) {
+        roles |= _policy->roleBit(role | "");
+    }
+    for (JsonVariantConst group : claims["groups"].as<JsonArrayConst>()) {
+        roles |= _policy->roleBit(group | "");
+    }
+    return roles;
+}
+
+bool JwtValidator::refreshJwks(unsigned long deadline) {
+    _jwksCache.markRefreshAttempt();
+    
+    const String jwksUrl = buildRealmUrl() + "/protocol/openid-connect/certs";
+    Serial.println("[Auth] Fetching JWKS: " + jwksUrl);
+    
+    String response;
+    int httpCode = _connection.get(jwksUrl, response, deadline);
+    
+    bool loaded = false;
+    if (httpCode == HTTP_CODE_OK) {
+        loaded = _jwksCache.loadFromJson(response);
+        Serial.println("[Auth] JWKS refreshed, signing keys: " + String(_jwksCache.getKeyCount()));
+    } else if (httpCode > 0) {
+        Serial.println("[Auth] JWKS fetch failed, HTTP code: " + String(httpCode));
+    } else {
+        Serial.println("[Auth] JWKS fetch failed: " + KeycloakConnection::errorToString(httpCode));
+    }
+    
+    return loaded;
+}
+
+String JwtValidator::buildRealmUrl() const {
     String base = _authConfig->getKeycloakServerUrl();
     // If user provided full URL with scheme, keep it; otherwise default to http://
     if (!(base.startsWith("http://") || base.startsWith("https://"))) {
@@ -153,10 +342,13 @@ String JwtValidator::buildIntrospectionUrl() const {
     String url = base;
     url += "/realms/";
     url += _authConfig->getKeycloakRealm();
-    url += "/protocol/openid-connect/token/introspect";
     return url;
 }
 
+String JwtValidator::buildIntrospectionUrl() const {
+    return buildRealmUrl() + "/protocol/openid-connect/token/introspect";
+}
+
 bool JwtValidator::parseTokenResponse(const String& response, ValidationResult& result) {
     JsonDocument doc;
     DeserializationError error = deserializeJson(doc, response);
@@ -172,6 +364,8 @@ bool JwtValidator::parseTokenResponse(const String& response, ValidationResult&
         result.userId = doc["sub"] | "";
         result.username = doc["username"] | "";
         result.realm = doc["iss"] | "";
+        result.expiresAt = doc["exp"] | 0L;
+        result.roles = mapRoles(doc);
         
         Serial.println("Token validated successfully for user: " + result.username);
     } else {
@@ -297,46 +491,24 @@ void JwtValidator::decodeAndLogJwtClaims(const String& token) {
 }
 
 String JwtValidator::base64Decode(const String& input) {
-    // Add padding if needed
-    String padded = input;
-    while (padded.length() % 4 != 0) {
-        padded += '=';
-    }
-    
-    // Replace URL-safe characters with standard base64
-    for (size_t i = 0; i < padded.length(); i++) {
-        char c = padded.charAt(i);
-        if (c == '-') padded.setCharAt(i, '+');
-        else if (c == '_') padded.setCharAt(i, '/');
-    }
-    
-    // Base64 decode table
-    static const char b64chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
     String decoded;
-    decoded.reserve((padded.length() * 3) / 4);
-    
-    uint32_t buffer = 0;
-    int bitsCollected = 0;
+    decoded.reserve((input.length() * 3) / 4 + 1);
     
-    for (size_t i = 0; i < padded.length(); i++) {
-        char c = padded.charAt(i);
-        if (c == '=') break;
+    uint8_t bytes[36];
+    // Decode 48 characters (36 bytes) at a time so that the buffer stays on the stack
+    for (size_t offset = 0; offset < input.length(); offset += 48) {
+        size_t len = input.length() - offset;
+        if (len > 48) len = 48;
         
-        const char* pos = strchr(b64chars, c);
-        if (!pos) {
-            Serial.println("[Auth] Base64 decode: invalid character at position " + String(i));
-            continue;
+        int written = base64UrlDecode(input.c_str() + offset, len, bytes, sizeof(bytes));
+        if (written < 0) {
+            Serial.println("[Auth] Base64 decode: invalid input near position " + String(offset));
+            return "";
         }
-        
-        int value = pos - b64chars;
-        buffer = (buffer << 6) | value;
-        bitsCollected += 6;
-        
-        if (bitsCollected >= 8) {
-            bitsCollected -= 8;
-            decoded += (char)((buffer >> bitsCollected) & 0xFF);
+        for (int i = 0; i < written; i++) {
+            decoded += (char)bytes[i];
         }
     }
     
     return decoded;
-}
\ No newline at end of file
+}
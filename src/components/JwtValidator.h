@@ -2,35 +2,57 @@
 #define JWT_VALIDATOR_H
 
 #include <Arduino.h>
-#include <HTTPClient.h>
 #include <ArduinoJson.h>
+#include "AccessPolicy.h"
 #include "AuthConfig.h"
-
-#if defined(ARDUINO) && !defined(UNIT_TEST)
-#include <WiFiClientSecure.h>
-#endif
-
-struct ValidationResult {
-    bool isValid;
-    String error;
-    String userId;
-    String username;
-    String realm;
-};
+#include "AuthTypes.h"
+#include "JwksCache.h"
+#include "KeycloakConnection.h"
+#include "RejectedTokenCache.h"
+#include "TokenCache.h"
 
 class JwtValidator {
 public:
-    explicit JwtValidator(AuthConfig* authConfig);
+    // policy maps the token's roles and groups to ValidationResult::roles
+    JwtValidator(AuthConfig* authConfig, const AccessPolicy* policy);
+    
+    // Open the Keycloak connection and prefetch the realm JWKS when local verification is enabled
+    void begin();
     
-    ValidationResult validateToken(const String& token);
+    // Keep the Keycloak connection warm (main loop) / after Wi-Fi reconnects (any task)
+    void maintain() { _connection.maintain(); }
+    void onNetworkUp() { _connection.requestPrewarm(); }
+    
+    // Keycloak calls (introspection, JWKS refresh) must answer before deadline (millis())
+    ValidationResult validateToken(const String& token, unsigned long deadline);
+    
+    int getJwksKeyCount() const { return _jwksCache.getKeyCount(); }
+    const TokenCache& getTokenCache() const { return _tokenCache; }
+    const RejectedTokenCache& getRejectedCache() const { return _rejectedCache; }
+    const KeycloakConnection& getConnection() const { return _connection; }
     
 private:
+    enum LocalValidation {
+        LOCAL_VERIFIED,   // Signature and claims valid
+        LOCAL_REJECTED,   // Token is definitely invalid, no fallback
+        LOCAL_UNDECIDED   // Unknown kid, no JWKS or unsynced clock: introspection may decide
+    };
+    
     AuthConfig* _authConfig;
-    HTTPClient _httpClient;
-#if defined(ARDUINO) && !defined(UNIT_TEST)
-    WiFiClientSecure _secureClient;
-#endif
+    const AccessPolicy* _policy;
+    JwksCache _jwksCache;
+    TokenCache _tokenCache;
+    RejectedTokenCache _rejectedCache;
+    KeycloakConnection _connection;
+    
+    ValidationResult validateUncached(const String& token, unsigned long deadline);
+    ValidationResult introspectToken(const String& token, unsigned long deadline);
+    LocalValidation validateLocally(const String& token, ValidationResult& result, unsigned long deadline);
+    bool checkClaims(JsonDocument& claims, time_t now, ValidationResult& result);
+    uint32_t mapRoles(JsonDocument& claims) const;
+    bool refreshJwks(unsigned long deadline);
     
+    String buildRealmUrl() const;
     String buildIntrospectionUrl() const;
     bool parseTokenResponse(const String& response, ValidationResult& result);
     String extractBearerToken(const String& authHeader);
@@ -0,0 +1,344 @@
+#include "KeycloakConnection.h"
+#include "Config.h"
+#include "HostResolver.h"
+
+#include <WiFi.h>
+
+KeycloakConnection::KeycloakConnection(AuthConfig* authConfig)
+    : _authConfig(authConfig), _port(0), _https(false), _mutex(nullptr), _prewarmTask(nullptr),
+      _breakerMutex(nullptr), _keepAlive(true), _refusals(0), _lastWarmAttempt(0), _stats() {
+    _mutex = xSemaphoreCreateMutex();
+    _breakerMutex = xSemaphoreCreateMutex();
+    parseServerUrl();
+}
+
+KeycloakConnection::~KeycloakConnection() {
+    if (_prewarmTask) {
+        vTaskDelete(_prewarmTask);
+    }
+    transport().stop();
+    if (_mutex) {
+        vSemaphoreDelete(_mutex);
+    }
+    if (_breakerMutex) {
+        vSemaphoreDelete(_breakerMutex);
+    }
+}
+
+void KeycloakConnection::begin() {
+#if KEYCLOAK_TLS_INSECURE
+    _secureClient.setInsecure(); // Dev mode: disable certificate validation
+#endif
+
+    // TLS handshakes need a large stack; run next to the Wi-Fi stack on core 0
+    xTaskCreatePinnedToCore(prewarmTaskEntry, "kc_prewarm", 8192, this, 1, &_prewarmTask, 0);
+    requestPrewarm();
+}
+
+int KeycloakConnection::get(const String& url, String& response, unsigned long deadline) {
+    return perform("GET", url, nullptr, nullptr, nullptr, response, deadline);
+}
+
+int KeycloakConnection::postForm(const String& url, const String& body, const String& user,
+                                 const String& password, String& response, unsigned long deadline) {
+    return perform("POST", url, &body, user.isEmpty() ? nullptr : &user, &password, response, deadline);
+}
+
+String KeycloakConnection::errorToString(int code) {
+    switch (code) {
+        case ERROR_CIRCUIT_OPEN: return "Keycloak unavailable (circuit open)";
+        case ERROR_DEADLINE: return "Keycloak deadline exceeded";
+        case ERROR_BUSY: return "Keycloak connection busy";
+    }
+    return HTTPClient::errorToString(code);
+}
+
+void KeycloakConnection::requestPrewarm() {
+    if (_prewarmTask) {
+        xTaskNotifyGive(_prewarmTask);
+    }
+}
+
+void KeycloakConnection::maintain() {
+    // Read without the lock: a missed or duplicate wake-up is harmless, probe() re-checks
+    if (_breaker.isProbeDue(millis())) {
+        requestPrewarm();
+        return;
+    }
+
+    if (!_keepAlive || millis() - _lastWarmAttempt < KEYCLOAK_REWARM_INTERVAL) {
+        return;
+    }
+
+    // Never wait here: a request or a pre-warm may be holding the connection
+    if (xSemaphoreTake(_mutex, 0) != pdTRUE) {
+        return;
+    }
+    const bool connected = transport().connected();
+    xSemaphoreGive(_mutex);
+
+    if (!connected) {
+        _lastWarmAttempt = millis();
+        requestPrewarm();
+    }
+}
+
+bool KeycloakConnection::isConnected() {
+    if (xSemaphoreTake(_mutex, 0) != pdTRUE) {
+        return true; // Busy with a request
+    }
+    const bool connected = transport().connected();
+    xSemaphoreGive(_mutex);
+    return connected;
+}
+
+void KeycloakConnection::parseServerUrl() {
+    String url = _authConfig->getKeycloakServerUrl();
+    _https = url.startsWith("https://");
+
+    int schemeSep = url.indexOf("://");
+    String rest = schemeSep > 0 ? url.substring(schemeSep + 3) : url;
+    int pathStart = rest.indexOf('/');
+    String hostPort = pathStart >= 0 ? rest.substring(0, pathStart) : rest;
+    int colon = hostPort.indexOf(':');
+    if (colon >= 0) {
+        _host = hostPort.substring(0, colon);
+        _port = hostPort.substring(colon + 1).toInt();
+    } else {
+        _host = hostPort;
+        _port = _https ? 443 : 80;
+    }
+}
+
+WiFiClient& KeycloakConnection::transport() {
+    if (_https) {
+        return _secureClient;
+    }
+    return _plainClient;
+}
+
+bool KeycloakConnection::connectTransport(unsigned long timeout) {
+    unsigned long start = millis();
+
+    IPAddress ip;
+    if (!HostResolver::getInstance().resolve(_host, ip)) {
+        return false;
+    }
+
+    _stats.handshakes++;
+    bool connected;
+    if (_https) {
+        // Connect by cached IP, the hostname is still sent for SNI (no CA configured: see begin())
+        _secureClient.setHandshakeTimeout((timeout + 999) / 1000); // seconds
+        connected = _secureClient.connect(ip, _port, _host.c_str(), nullptr, nullptr, nullptr);
+    } else {
+        connected = _plainClient.connect(ip, _port, timeout);
+    }
+
+    if (connected) {
+        Serial.println("[Auth] Keycloak connection established in " + String(millis() - start) + " ms (" +
+                       _host + ":" + String(_port) + (_https ? ", TLS" : "") + ")");
+    } else {
+        Serial.println("[Auth][Error] Keycloak connection failed: " + _host + " (" + ip.toString() + "):" + String(_port));
+    }
+    return connected;
+}
+
+void KeycloakConnection::prewarm() {
+    if (WiFi.status() != WL_CONNECTED) {
+        return;
+    }
+    if (_breaker.isProbeDue(millis())) {
+        probe();
+        return;
+    }
+    if (!_keepAlive) {
+        return;
+    }
+
+    xSemaphoreTake(_mutex, portMAX_DELAY);
+    _lastWarmAttempt = millis();
+    if (!transport().connected()) {
+        Serial.println("[Auth] Pre-warming Keycloak connection...");
+        connectTransport(KEYCLOAK_HANDSHAKE_TIMEOUT);
+    }
+    xSemaphoreGive(_mutex);
+}
+
+void KeycloakConnection::probe() {
+    xSemaphoreTake(_breakerMutex, portMAX_DELAY);
+    const bool started = _breaker.startProbe(millis());
+    xSemaphoreGive(_breakerMutex);
+    if (!started) {
+        return;
+    }
+
+    // Same limits as a regular request: a probe slower than the slow-call threshold keeps the circuit open
+    Serial.println("[Auth] Circuit open, probing Keycloak...");
+    String response;
+    const unsigned long start = millis();
+    const int httpCode = execute("GET", _probeUrl, nullptr, nullptr, nullptr, response, start + KEYCLOAK_HTTP_TIMEOUT);
+    if (httpCode == ERROR_BUSY) {
+        xSemaphoreTake(_breakerMutex, portMAX_DELAY);
+        _breaker.cancelProbe();
+        xSemaphoreGive(_breakerMutex);
+        return;
+    }
+    recordOutcome(httpCode, millis() - start);
+}
+
+void KeycloakConnection::trackServerReuse() {
+    if (!_keepAlive) {
+        return;
+    }
+
+    if (transport().connected()) {
+        _refusals = 0;
+        return;
+    }
+
+    // The server (or a proxy) closed the connection right after the response
+    if (++_refusals >= KEYCLOAK_KEEPALIVE_MAX_REFUSALS) {
+        _keepAlive = false;
+        Serial.println("[Auth][Warning] Keycloak refuses keep-alive, falling back to one-shot connections");
+    }
+}
+
+int KeycloakConnection::perform(const char* method, const String& url, const String* body,
+                                const String* user, const String* password, String& response,
+                                unsigned long deadline) {
+    // Fail fast: don't even wait for the connection while the circuit is open
+    xSemaphoreTake(_breakerMutex, portMAX_DELAY);
+    const bool allowed = _breaker.allowRequest();
+    xSemaphoreGive(_breakerMutex);
+    if (!allowed) {
+        return ERROR_CIRCUIT_OPEN;
+    }
+
+    const unsigned long start = millis();
+    const int httpCode = execute(method, url, body, user, password, response, deadline);
+    // Waiting on our own lock says nothing about Keycloak: only what went on the wire counts
+    if (httpCode != ERROR_BUSY) {
+        recordOutcome(httpCode, millis() - start);
+    }
+    return httpCode;
+}
+
+int KeycloakConnection::execute(const char* method, const String& url, const String* body,
+                                const String* user, const String* password, String& response,
+                                unsigned long deadline) {
+    // A pre-warm handshake may hold the connection: wait for it within the deadline only
+    long remaining = static_cast<long>(deadline - millis());
+    if (remaining <= 0 || xSemaphoreTake(_mutex, pdMS_TO_TICKS(remaining)) != pdTRUE) {
+        return ERROR_BUSY;
+    }
+
+    int httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        remaining = static_cast<long>(deadline - millis());
+        if (remaining <= 0) {
+            httpCode = ERROR_DEADLINE;
+            break;
+        }
+
+        const bool reusing = transport().connected();
+        if (!reusing && !connectTransport(remaining)) {
+            httpCode = HTTPC_ERROR_CONNECTION_REFUSED;
+            break;
+        }
+
+        // The handshake took its share of the budget (the connection stays for the next request)
+        remaining = static_cast<long>(deadline - millis());
+        if (remaining <= 0) {
+            httpCode = ERROR_DEADLINE;
+            break;
+        }
+
+        _http.begin(transport(), url);
+        _http.setReuse(_keepAlive);
+        _http.setTimeout(static_cast<unsigned long>(remaining) < KEYCLOAK_HTTP_TIMEOUT ? remaining
+                                                                                      : KEYCLOAK_HTTP_TIMEOUT);
+#ifdef HTTPC_STRICT_FOLLOW_REDIRECTS
+        _http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS);
+#endif
+        // One-shot mode reproduces the original behavior for servers that refuse reuse
+        _http.useHTTP10(!_keepAlive);
+        if (!_keepAlive) {
+            _http.addHeader("Connection", "close");
+        }
+
+        if (user) {
+            _http.setAuthorization(user->c_str(), password->c_str());
+        }
+
+        if (body) {
+            _http.addHeader("Content-Type", "application/x-www-form-urlencoded");
+            httpCode = _http.sendRequest(method, reinterpret_cast<uint8_t*>(const_cast<char*>(body->c_str())),
+                                         body->length());
+        } else {
+            httpCode = _http.sendRequest(method);
+        }
+
+        if (httpCode > 0) {
+            response = _http.getString();
+        }
+
+        // end() keeps the socket open when both sides agreed on keep-alive
+        _http.end();
+
+        _stats.requests++;
+        if (reusing) {
+            _stats.reused++;
+        }
+
+        // A kept-alive socket may have been closed by the server while idle: retry once on a fresh one
+        const bool staleSocket = httpCode == HTTPC_ERROR_SEND_HEADER_FAILED ||
+                                 httpCode == HTTPC_ERROR_SEND_PAYLOAD_FAILED ||
+                                 httpCode == HTTPC_ERROR_CONNECTION_LOST;
+        if (reusing && staleSocket) {
+            Serial.println("[Auth] Kept-alive Keycloak connection was stale, reconnecting");
+            transport().stop();
+            _stats.retries++;
+            continue;
+        }
+        break;
+    }
+
+    if (httpCode > 0) {
+        trackServerReuse();
+    }
+
+    xSemaphoreGive(_mutex);
+    return httpCode;
+}
+
+void KeycloakConnection::recordOutcome(int httpCode, unsigned long latency) {
+    // 4xx is Keycloak answering (bad client credentials, unknown realm...), not an outage
+    const bool failed = httpCode <= 0 || httpCode >= 500;
+
+    xSemaphoreTake(_breakerMutex, portMAX_DELAY);
+    const CircuitBreaker::State before = _breaker.getState();
+    if (failed) {
+        _breaker.recordFailure(millis());
+    } else {
+        _breaker.recordSuccess(latency, millis());
+    }
+    const CircuitBreaker::State after = _breaker.getState();
+    xSemaphoreGive(_breakerMutex);
+
+    if (after == CircuitBreaker::BREAKER_OPEN && before != CircuitBreaker::BREAKER_OPEN) {
+        const String cause = httpCode > 0 ? "HTTP " + String(httpCode) : errorToString(httpCode);
+        Serial.println("[Auth][Warning] Keycloak circuit open (last call: " + cause + ", " + String(latency) +
+                       " ms), failing fast for " + String(KEYCLOAK_BREAKER_OPEN_TIME / 1000) + " s");
+    } else if (after == CircuitBreaker::BREAKER_CLOSED && before == CircuitBreaker::BREAKER_HALF_OPEN) {
+        Serial.println("[Auth] Keycloak answered the probe in " + String(latency) + " ms, circuit closed");
+    }
+}
+
+void KeycloakConnection::prewarmTaskEntry(void* arg) {
+    KeycloakConnection* connection = static_cast<KeycloakConnection*>(arg);
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        connection->prewarm();
+    }
+}
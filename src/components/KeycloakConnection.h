@@ -0,0 +1,99 @@
+#ifndef KEYCLOAK_CONNECTION_H
+#define KEYCLOAK_CONNECTION_H
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <WiFiClient.h>
+#include <WiFiClientSecure.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include "AuthConfig.h"
+#include "CircuitBreaker.h"
+
+// Persistent HTTP/1.1 keep-alive connection to the Keycloak host.
+// Shared by introspection and JWKS fetches; the TLS handshake is paid once and
+// redone in a background task after idle drops and Wi-Fi reconnects.
+// A circuit breaker fails requests fast while Keycloak is down or slow; the same
+// background task probes it until it answers again.
+class KeycloakConnection {
+public:
+    // Errors of our own, next to HTTPC_ERROR_*
+    static const int ERROR_CIRCUIT_OPEN = -100;   // Not sent: circuit breaker open
+    static const int ERROR_DEADLINE = -101;       // Deadline reached before or during the exchange
+    static const int ERROR_BUSY = -102;           // Not sent: connection held by another caller until the deadline
+
+    struct Stats {
+        uint32_t requests;
+        uint32_t reused;       // Requests sent on an already established connection
+        uint32_t handshakes;   // TCP/TLS connections opened (foreground and pre-warm)
+        uint32_t retries;      // Stale kept-alive sockets detected on send
+    };
+
+    explicit KeycloakConnection(AuthConfig* authConfig);
+    ~KeycloakConnection();
+
+    // Start the pre-warm task and open the first connection in the background
+    void begin();
+
+    // Blocking requests on the shared connection, return the HTTP code (or HTTPC_ERROR_*, ERROR_*).
+    // Connection wait, handshake and response read are all bounded by deadline (millis()).
+    int get(const String& url, String& response, unsigned long deadline);
+    int postForm(const String& url, const String& body, const String& user, const String& password,
+                 String& response, unsigned long deadline);
+
+    // Cheap GET used by the background task to probe Keycloak while the circuit is open
+    void setProbeUrl(const String& url) { _probeUrl = url; }
+
+    // Ask the background task to (re)open the connection, safe from any task
+    void requestPrewarm();
+
+    // Called from the main loop: re-warm after the server dropped an idle connection,
+    // probe Keycloak once the circuit has been open long enough
+    void maintain();
+
+    bool isKeepAliveEnabled() const { return _keepAlive; }
+    bool isConnected();
+    const Stats& getStats() const { return _stats; }
+    const CircuitBreaker& getBreaker() const { return _breaker; }
+
+    static String errorToString(int code);
+
+private:
+    AuthConfig* _authConfig;
+    String _host;
+    uint16_t _port;
+    bool _https;
+
+    WiFiClientSecure _secureClient;
+    WiFiClient _plainClient;
+    HTTPClient _http;
+
+    SemaphoreHandle_t _mutex;
+    TaskHandle_t _prewarmTask;
+
+    CircuitBreaker _breaker;
+    SemaphoreHandle_t _breakerMutex;    // Short hold: checked before waiting for _mutex
+    String _probeUrl;
+
+    bool _keepAlive;
+    uint8_t _refusals;
+    unsigned long _lastWarmAttempt;
+    Stats _stats;
+
+    void parseServerUrl();
+    WiFiClient& transport();
+    bool connectTransport(unsigned long timeout);
+    void prewarm();
+    void probe();
+    void trackServerReuse();
+    int perform(const char* method, const String& url, const String* body,
+                const String* user, const String* password, String& response, unsigned long deadline);
+    int execute(const char* method, const String& url, const String* body,
+                const String* user, const String* password, String& response, unsigned long deadline);
+    void recordOutcome(int httpCode, unsigned long latency);
+
+    static void prewarmTaskEntry(void* arg);
+};
+
+#endif // KEYCLOAK_CONNECTION_H
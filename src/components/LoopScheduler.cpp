@@ -0,0 +1,83 @@
+#include "LoopScheduler.h"
+
+LoopScheduler::LoopScheduler()
+    : _sourceCount(0), _loopTask(nullptr), _stats(), _windowStart(0), _windowIdle(0),
+      _windowWakeups(0), _windowMaxBusy(0), _lastWake(0) {
+}
+
+void LoopScheduler::begin() {
+    _loopTask = xTaskGetCurrentTaskHandle();
+    _windowStart = micros();
+    _lastWake = _windowStart;
+}
+
+bool LoopScheduler::addDeadlineSource(DeadlineSource source, void* context) {
+    if (_sourceCount >= LOOP_MAX_DEADLINE_SOURCES) {
+        return false;
+    }
+    _sources[_sourceCount++] = {source, context};
+    return true;
+}
+
+void LoopScheduler::wake() {
+    if (_loopTask) {
+        xTaskNotifyGive(_loopTask);
+    }
+}
+
+void IRAM_ATTR LoopScheduler::wakeFromISR() {
+    if (_loopTask) {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(_loopTask, &higherPriorityTaskWoken);
+        if (higherPriorityTaskWoken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+void LoopScheduler::sleepUntilNextDeadline() {
+    unsigned long now = millis();
+    unsigned long wait = LOOP_MAX_SLEEP;
+    for (int i = 0; i < _sourceCount; i++) {
+        unsigned long due = _sources[i].callback(_sources[i].context, now);
+        if (due < wait) {
+            wait = due;
+        }
+    }
+
+    // Always block at least one tick so the idle task (and its WFI) gets to run
+    TickType_t ticks = pdMS_TO_TICKS(wait);
+    if (ticks == 0) {
+        ticks = 1;
+    }
+
+    unsigned long sleptFrom = micros();
+    bool notified = ulTaskNotifyTake(pdTRUE, ticks) > 0;
+    account(sleptFrom, micros(), notified);
+}
+
+void LoopScheduler::account(unsigned long sleptFrom, unsigned long now, bool notified) {
+    unsigned long busy = sleptFrom - _lastWake;
+    if (busy > _windowMaxBusy) {
+        _windowMaxBusy = busy;
+    }
+    _windowIdle += now - sleptFrom;
+    _windowWakeups++;
+    _lastWake = now;
+
+    _stats.wakeups++;
+    if (notified) {
+        _stats.notifiedWakeups++;
+    }
+
+    unsigned long windowLength = now - _windowStart;
+    if (windowLength >= 1000000UL) {
+        _stats.wakeupsPerSecond = (uint32_t)((uint64_t)_windowWakeups * 1000000ULL / windowLength);
+        _stats.idlePercent = (uint8_t)((uint64_t)_windowIdle * 100ULL / windowLength);
+        _stats.maxBusyTime = _windowMaxBusy / 1000;
+        _windowStart = now;
+        _windowIdle = 0;
+        _windowWakeups = 0;
+        _windowMaxBusy = 0;
+    }
+}
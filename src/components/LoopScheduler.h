@@ -0,0 +1,64 @@
+#ifndef LOOP_SCHEDULER_H
+#define LOOP_SCHEDULER_H
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "Config.h"
+
+// Returns the number of ms before the source needs to be serviced again (0 = now)
+typedef unsigned long (*DeadlineSource)(void* context, unsigned long now);
+
+// Replaces the fixed loop() delay: the owning task blocks until the earliest
+// registered deadline, or until a wake source (ISR, timer, other task) notifies it.
+// One instance per event loop task (network, gate control).
+class LoopScheduler {
+public:
+    struct Stats {
+        uint32_t wakeups;               // Since boot
+        uint32_t notifiedWakeups;       // Woken by wake()/wakeFromISR() rather than a deadline
+        uint32_t wakeupsPerSecond;      // Over the last complete window
+        uint8_t idlePercent;            // Time spent blocked over the last window
+        unsigned long maxBusyTime;      // Longest loop iteration (ms) over the last window
+    };
+
+    LoopScheduler();
+
+    // Call from the task that runs the loop
+    void begin();
+    bool addDeadlineSource(DeadlineSource source, void* context);
+
+    // Wake the loop early; safe from any task / from an ISR respectively
+    void wake();
+    void IRAM_ATTR wakeFromISR();
+
+    // End of loop(): block until the earliest deadline or a wake-up
+    void sleepUntilNextDeadline();
+
+    const Stats& getStats() const { return _stats; }
+
+private:
+    LoopScheduler(const LoopScheduler&) = delete;
+    LoopScheduler& operator=(const LoopScheduler&) = delete;
+
+    struct Source {
+        DeadlineSource callback;
+        void* context;
+    };
+
+    Source _sources[LOOP_MAX_DEADLINE_SOURCES];
+    int _sourceCount;
+    TaskHandle_t _loopTask;
+    Stats _stats;
+
+    // Current measurement window
+    unsigned long _windowStart;         // micros()
+    unsigned long _windowIdle;          // micros() spent blocked
+    uint32_t _windowWakeups;
+    unsigned long _windowMaxBusy;
+    unsigned long _lastWake;            // micros()
+
+    void account(unsigned long sleptFrom, unsigned long now, bool notified);
+};
+
+#endif // LOOP_SCHEDULER_H
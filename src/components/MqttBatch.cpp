@@ -0,0 +1,68 @@
+#include "MqttBatch.h"
+
+#include <limits.h>
+#include <string.h>
+
+namespace {
+    const char CBOR_ARRAY_START = static_cast<char>(0x9F); // Indefinite-length array
+    const char CBOR_BREAK = static_cast<char>(0xFF);
+}
+
+MqttBatch::MqttBatch()
+    : _encoding(ENCODING_JSON), _window(0) {
+    clear();
+}
+
+void MqttBatch::configure(Encoding encoding, unsigned long window) {
+    _encoding = encoding;
+    _window = window;
+    clear();
+}
+
+bool MqttBatch::add(uint32_t sequence, const char* record, size_t length, unsigned long now) {
+    // Opening byte, separator (JSON) and closing byte
+    size_t needed = length + (_count == 0 ? 1 : 0) + (_encoding == ENCODING_JSON && _count > 0 ? 1 : 0) + 1;
+    if (_length + needed > sizeof(_buffer)) {
+        return false;
+    }
+
+    if (_count == 0) {
+        _buffer[_length++] = _encoding == ENCODING_JSON ? '[' : CBOR_ARRAY_START;
+        _openedAt = now;
+    } else if (_encoding == ENCODING_JSON) {
+        _buffer[_length++] = ',';
+    }
+    memcpy(_buffer + _length, record, length);
+    _length += length;
+    _count++;
+    _lastSequence = sequence;
+    return true;
+}
+
+bool MqttBatch::isDue(unsigned long now) const {
+    return _count > 0 && now - _openedAt >= _window;
+}
+
+unsigned long MqttBatch::timeUntilDue(unsigned long now) const {
+    if (_count == 0) {
+        return ULONG_MAX;
+    }
+    unsigned long elapsed = now - _openedAt;
+    return elapsed >= _window ? 0 : _window - elapsed;
+}
+
+size_t MqttBatch::finish() {
+    if (_count == 0) {
+        return 0;
+    }
+    // Room for it was reserved by add()
+    _buffer[_length++] = _encoding == ENCODING_JSON ? ']' : CBOR_BREAK;
+    return _length;
+}
+
+void MqttBatch::clear() {
+    _length = 0;
+    _count = 0;
+    _lastSequence = 0;
+    _openedAt = 0;
+}
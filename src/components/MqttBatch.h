@@ -0,0 +1,56 @@
+#ifndef MQTT_BATCH_H
+#define MQTT_BATCH_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Config.h"
+
+// Coalesces the log records of one topic into a single publish: a JSON array of the
+// records, or an indefinite-length CBOR array. The batch is due once the window has
+// elapsed since its first record. Network task only.
+class MqttBatch {
+public:
+    enum Encoding : uint8_t { ENCODING_JSON, ENCODING_CBOR };
+
+    MqttBatch();
+
+    // window 0: no batching, the owner publishes each record on its own
+    void configure(Encoding encoding, unsigned long window);
+    Encoding encoding() const { return _encoding; }
+    unsigned long window() const { return _window; }
+
+    // Appends an encoded record; false when it doesn't fit (finish() the batch first)
+    bool add(uint32_t sequence, const char* record, size_t length, unsigned long now);
+
+    bool isDue(unsigned long now) const;
+    // ms until isDue() (ULONG_MAX when empty)
+    unsigned long timeUntilDue(unsigned long now) const;
+
+    // Closes the array; the payload stays valid until clear()
+    size_t finish();
+    const char* payload() const { return _buffer; }
+
+    uint32_t lastSequence() const { return _lastSequence; }
+    int count() const { return _count; }
+    bool isEmpty() const { return _count == 0; }
+    void clear();
+
+private:
+    Encoding _encoding;
+    unsigned long _window;
+    char _buffer[MQTT_BATCH_MAX_SIZE];
+    size_t _length;
+    int _count;
+    uint32_t _lastSequence;       // Outbox entry sequence: the newest record of the batch
+    unsigned long _openedAt;
+};
+
+static_assert(MQTT_BATCH_MAX_SIZE >= EMQX_MESSAGE_BUFFER_SIZE + 2, "A batch must hold at least one record");
+
+#endif // MQTT_BATCH_H
@@ -0,0 +1,123 @@
+#include "MqttCommandVerifier.h"
+
+#include <ArduinoJson.h>
+#include <mbedtls/md.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+namespace {
+    const size_t SIGNATURE_SIZE = 32; // HMAC-SHA256
+
+    int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+}
+
+MqttCommandVerifier::MqttCommandVerifier(const String& secret, const String& deviceId)
+    : _secret(secret), _deviceId(deviceId) {
+}
+
+bool MqttCommandVerifier::verify(const uint8_t* payload, unsigned int length, MqttCommand& command,
+                                 const char*& error) {
+    command.nonce[0] = '\0';
+    command.gate = -1;
+    command.authenticated = false;
+    
+    JsonDocument doc;
+    if (length > MQTT_COMMAND_MAX_SIZE || deserializeJson(doc, reinterpret_cast<const char*>(payload), length)) {
+        error = "Malformed command";
+        return false;
+    }
+    
+    const char* nonce = doc["nonce"] | "";
+    if (strlen(nonce) <= MQTT_COMMAND_NONCE_MAX) {
+        strcpy(command.nonce, nonce);
+    }
+    
+    const char* action = doc["action"] | "";
+    const char* gate = doc["gate"] | "";
+    const char* signature = doc["sig"] | "";
+    if (!doc["ts"].is<int64_t>()) {
+        error = "Missing timestamp";
+        return false;
+    }
+    int64_t timestamp = doc["ts"].as<int64_t>();
+    
+    if (strcmp(action, "open") == 0) {
+        command.action = OPENING;
+    } else if (strcmp(action, "close") == 0) {
+        command.action = CLOSING;
+    } else {
+        error = "Unknown action";
+        return false;
+    }
+    command.gate = resolveGate(gate);
+    if (command.gate < 0) {
+        error = "Unknown gate";
+        return false;
+    }
+    
+    // Authenticate before touching the nonce table: forged commands can't fill it
+    char message[160];
+    int messageLength = snprintf(message, sizeof(message), "%s\n%s\n%s\n%lld\n%s", _deviceId.c_str(), gate, action,
+                                 static_cast<long long>(timestamp), nonce);
+    if (messageLength < 0 || messageLength >= static_cast<int>(sizeof(message)) ||
+        !signatureMatches(message, messageLength, signature)) {
+        error = "Invalid signature";
+        return false;
+    }
+    command.authenticated = true;
+    
+    int64_t now = time(nullptr);
+    if (now < CLOCK_SYNCED_MIN_EPOCH) {
+        error = "Device clock not synchronized";
+        return false;
+    }
+    NonceCache::Result result = _nonces.check(nonce, timestamp, now);
+    if (result != NonceCache::NONCE_ACCEPTED) {
+        error = NonceCache::describe(result);
+        return false;
+    }
+    return true;
+}
+
+bool MqttCommandVerifier::signatureMatches(const char* message, size_t length, const char* signature) const {
+    if (strlen(signature) != SIGNATURE_SIZE * 2) {
+        return false;
+    }
+    unsigned char expected[SIGNATURE_SIZE];
+    if (mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                        reinterpret_cast<const unsigned char*>(_secret.c_str()), _secret.length(),
+                        reinterpret_cast<const unsigned char*>(message), length, expected) != 0) {
+        return false;
+    }
+    
+    // Constant time: the comparison doesn't tell how many leading bytes were right
+    unsigned char difference = 0;
+    for (size_t i = 0; i < SIGNATURE_SIZE; i++) {
+        int high = hexValue(signature[2 * i]);
+        int low = hexValue(signature[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        difference |= expected[i] ^ static_cast<unsigned char>(high << 4 | low);
+    }
+    return difference == 0;
+}
+
+int MqttCommandVerifier::resolveGate(const char* id) {
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        if (strcmp(id, GATES[gate].id) == 0) {
+            return gate;
+        }
+    }
+    // Index also accepted, as in /gate/0/open
+    if (id[0] >= '0' && id[0] <= '9' && id[1] == '\0' && id[0] - '0' < GATE_COUNT) {
+        return id[0] - '0';
+    }
+    return -1;
+}
@@ -0,0 +1,38 @@
+#ifndef MQTT_COMMAND_VERIFIER_H
+#define MQTT_COMMAND_VERIFIER_H
+
+#include <Arduino.h>
+#include "Config.h"
+#include "GateTypes.h"
+#include "NonceCache.h"
+
+struct MqttCommand {
+    OperationState action;                      // OPENING or CLOSING
+    int gate;                                   // Index in GATES, -1 when unknown
+    char nonce[MQTT_COMMAND_NONCE_MAX + 1];     // Echoed in the reply, empty when unreadable
+    bool authenticated;                         // Signature checked: a refusal can be told to the sender
+};
+
+// Authenticates gate commands received on the MQTT command topic:
+//   {"action":"open","gate":"main","ts":1760695200,"nonce":"4f1c...","sig":"<hex>"}
+// sig is the HMAC-SHA256, keyed with the shared secret, of
+//   "<device_id>\n<gate>\n<action>\n<ts>\n<nonce>"
+// so a command signed for one device is refused by the others. Verified locally:
+// no Keycloak round trip.
+class MqttCommandVerifier {
+public:
+    MqttCommandVerifier(const String& secret, const String& deviceId);
+
+    // false with error set when the command must be refused
+    bool verify(const uint8_t* payload, unsigned int length, MqttCommand& command, const char*& error);
+
+private:
+    String _secret;
+    String _deviceId;
+    NonceCache _nonces;
+
+    bool signatureMatches(const char* message, size_t length, const char* signature) const;
+    static int resolveGate(const char* id);
+};
+
+#endif // MQTT_COMMAND_VERIFIER_H
@@ -0,0 +1,172 @@
+#include "MqttOutbox.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+MqttOutbox::MqttOutbox(size_t spillLimit)
+    : _ramHead(0), _ramCount(0), _spillLimit(spillLimit), _spillSize(0), _spillReadOffset(0),
+      _spillCount(0), _nextSequence(1) {
+    _spillPath[0] = '\0';
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+void MqttOutbox::begin(const char* spillPath) {
+    if (!spillPath || strlen(spillPath) >= sizeof(_spillPath)) {
+        Serial.println("[MQTT][Warning] No spill file, pending messages are kept in RAM only");
+        return;
+    }
+    strcpy(_spillPath, spillPath);
+    loadSpill();
+}
+
+bool MqttOutbox::push(uint32_t sequence, uint8_t topic, const char* payload, size_t length) {
+    if (length > MQTT_OUTBOX_PAYLOAD_SIZE) {
+        _stats.dropped++;
+        return false;
+    }
+
+    // Once something is spilled, newer messages go behind it to keep the order
+    if (_spillCount == 0 && _ramCount < MQTT_OUTBOX_RAM_ENTRIES) {
+        Entry& entry = _ring[(_ramHead + _ramCount) % MQTT_OUTBOX_RAM_ENTRIES];
+        entry.sequence = sequence;
+        entry.topic = topic;
+        entry.length = static_cast<uint16_t>(length);
+        memcpy(entry.payload, payload, length);
+        _ramCount++;
+    } else if (appendSpill(sequence, topic, payload, length)) {
+        _stats.spilled++;
+    } else {
+        _stats.dropped++;
+        return false;
+    }
+    _stats.queued++;
+    return true;
+}
+
+const MqttOutbox::Entry* MqttOutbox::front() {
+    if (_ramCount == 0 && _spillCount > 0) {
+        refillFromSpill();
+    }
+    return _ramCount > 0 ? &_ring[_ramHead] : nullptr;
+}
+
+void MqttOutbox::pop() {
+    if (_ramCount == 0) {
+        return;
+    }
+    _ramHead = (_ramHead + 1) % MQTT_OUTBOX_RAM_ENTRIES;
+    _ramCount--;
+    _stats.sent++;
+}
+
+bool MqttOutbox::appendSpill(uint32_t sequence, uint8_t topic, const char* payload, size_t length) {
+    if (_spillPath[0] == '\0' || _spillSize + sizeof(SpillHeader) + length > _spillLimit) {
+        return false;
+    }
+
+    FILE* file = fopen(_spillPath, "ab");
+    if (!file) {
+        _stats.spillErrors++;
+        return false;
+    }
+    SpillHeader header = {sequence, static_cast<uint16_t>(length), topic, 0};
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   (length == 0 || fwrite(payload, length, 1, file) == 1);
+    written = fclose(file) == 0 && written;
+
+    if (!written) {
+        // Don't leave half a record behind the last good one
+        _stats.spillErrors++;
+        truncate(_spillPath, _spillSize);
+        return false;
+    }
+    _spillSize += sizeof(header) + length;
+    _spillCount++;
+    return true;
+}
+
+void MqttOutbox::refillFromSpill() {
+    FILE* file = fopen(_spillPath, "rb");
+    if (!file || fseek(file, _spillReadOffset, SEEK_SET) != 0) {
+        if (file) {
+            fclose(file);
+        }
+        Serial.println("[MQTT][Error] Spill file unreadable, " + String(_spillCount) + " messages lost");
+        _stats.spillErrors++;
+        _stats.dropped += _spillCount;
+        clearSpill();
+        return;
+    }
+
+    while (_spillCount > 0 && _ramCount < MQTT_OUTBOX_RAM_ENTRIES) {
+        SpillHeader header;
+        Entry& entry = _ring[(_ramHead + _ramCount) % MQTT_OUTBOX_RAM_ENTRIES];
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.length > MQTT_OUTBOX_PAYLOAD_SIZE ||
+            (header.length > 0 && fread(entry.payload, header.length, 1, file) != 1)) {
+            Serial.println("[MQTT][Error] Spill file truncated, " + String(_spillCount) + " messages lost");
+            _stats.spillErrors++;
+            _stats.dropped += _spillCount;
+            _spillCount = 0;
+            break;
+        }
+        entry.sequence = header.sequence;
+        entry.topic = header.topic;
+        entry.length = header.length;
+        _ramCount++;
+        _spillReadOffset += sizeof(header) + header.length;
+        _spillCount--;
+    }
+    fclose(file);
+
+    if (_spillCount == 0) {
+        clearSpill();
+    }
+}
+
+void MqttOutbox::clearSpill() {
+    remove(_spillPath);
+    _spillSize = 0;
+    _spillReadOffset = 0;
+    _spillCount = 0;
+}
+
+void MqttOutbox::loadSpill() {
+    FILE* file = fopen(_spillPath, "rb");
+    if (!file) {
+        return; // Nothing left by the previous boot
+    }
+
+    fseek(file, 0, SEEK_END);
+    size_t fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    // Count the complete records; a power cut while appending leaves a partial one at the end
+    uint32_t lastSequence = 0;
+    for (;;) {
+        SpillHeader header;
+        if (fread(&header, sizeof(header), 1, file) != 1 || header.length > MQTT_OUTBOX_PAYLOAD_SIZE ||
+            _spillSize + sizeof(header) + header.length > fileSize ||
+            fseek(file, header.length, SEEK_CUR) != 0) {
+            break;
+        }
+        _spillSize += sizeof(header) + header.length;
+        _spillCount++;
+        lastSequence = header.sequence;
+    }
+    fclose(file);
+
+    if (fileSize != _spillSize && truncate(_spillPath, _spillSize) != 0) {
+        // Can't cut the partial record off: appending behind it would make the rest unreadable
+        _stats.spillErrors++;
+        _stats.dropped += _spillCount;
+        clearSpill();
+        return;
+    }
+    if (_spillCount > 0) {
+        _nextSequence = lastSequence + 1;
+        Serial.println("[MQTT] " + String(_spillCount) + " messages pending from the previous boot");
+    } else {
+        clearSpill();
+    }
+}
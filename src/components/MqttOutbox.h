@@ -0,0 +1,84 @@
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include "Config.h"
+
+// Store-and-forward queue of outbound MQTT messages. The oldest ones wait in a RAM ring;
+// once it is full, newer ones are appended to a spill file (LittleFS on the ESP32) and
+// read back in order as the ring drains. Messages are numbered so the consumer can detect
+// gaps (drops) and duplicates (replay after a reboot). Network task only.
+class MqttOutbox {
+public:
+    struct Entry {
+        uint32_t sequence;
+        uint8_t topic;                          // Index chosen by the owner (EmqxLogger: authorized / unauthorized)
+        uint16_t length;
+        char payload[MQTT_OUTBOX_PAYLOAD_SIZE];
+    };
+
+    struct Stats {
+        uint32_t queued;          // Accepted by push()
+        uint32_t sent;            // Removed by pop() once published
+        uint32_t spilled;         // Written to the spill file (RAM ring full)
+        uint32_t dropped;         // Rejected: spill file full or unavailable, or lost to a corrupt file
+        uint32_t spillErrors;     // Failed file reads/writes
+    };
+
+    explicit MqttOutbox(size_t spillLimit = MQTT_OUTBOX_SPILL_MAX_SIZE);
+
+    // spillPath nullptr: RAM only. Picks up what a previous boot left in the spill file,
+    // sequence numbers continue after it.
+    void begin(const char* spillPath);
+
+    // Number for the next message (embedded in its payload before push)
+    uint32_t nextSequence() { return _nextSequence++; }
+
+    // false when the message is dropped
+    bool push(uint32_t sequence, uint8_t topic, const char* payload, size_t length);
+
+    // Oldest pending message (nullptr when empty), stays queued until pop()
+    const Entry* front();
+    void pop();
+
+    uint32_t depth() const { return _ramCount + _spillCount; }
+    uint32_t spilledDepth() const { return _spillCount; }
+    bool isEmpty() const { return depth() == 0; }
+    const Stats& getStats() const { return _stats; }
+
+private:
+    // On-disk record header, followed by length payload bytes
+    struct SpillHeader {
+        uint32_t sequence;
+        uint16_t length;
+        uint8_t topic;
+        uint8_t reserved;
+    };
+
+    Entry _ring[MQTT_OUTBOX_RAM_ENTRIES];
+    int _ramHead;                 // Oldest entry
+    int _ramCount;
+
+    char _spillPath[48];          // Empty: no spill file
+    size_t _spillLimit;
+    size_t _spillSize;            // Bytes in the file
+    size_t _spillReadOffset;      // First record not yet moved back to RAM
+    uint32_t _spillCount;         // Records after _spillReadOffset
+
+    uint32_t _nextSequence;
+    Stats _stats;
+
+    bool appendSpill(uint32_t sequence, uint8_t topic, const char* payload, size_t length);
+    void refillFromSpill();
+    void clearSpill();
+    void loadSpill();
+};
+
+#endif // MQTT_OUTBOX_H
@@ -0,0 +1,60 @@
+#include "NonceCache.h"
+
+#include <string.h>
+
+NonceCache::NonceCache(long maxSkew) : _maxSkew(maxSkew) {
+    clear();
+}
+
+void NonceCache::clear() {
+    for (int i = 0; i < MQTT_COMMAND_NONCE_SLOTS; i++) {
+        _entries[i].used = false;
+    }
+}
+
+NonceCache::Result NonceCache::check(const char* nonce, int64_t timestamp, int64_t now) {
+    size_t length = nonce ? strlen(nonce) : 0;
+    if (length == 0 || length > MQTT_COMMAND_NONCE_MAX) {
+        return NONCE_INVALID;
+    }
+    if (timestamp < now - _maxSkew || timestamp > now + _maxSkew) {
+        return NONCE_EXPIRED;
+    }
+
+    Entry* free = nullptr;
+    for (int i = 0; i < MQTT_COMMAND_NONCE_SLOTS; i++) {
+        Entry& entry = _entries[i];
+        if (!isLive(entry, now)) {
+            if (!free) {
+                free = &entry;
+            }
+            continue;
+        }
+        if (strcmp(entry.nonce, nonce) == 0) {
+            return NONCE_REPLAYED;
+        }
+    }
+    if (!free) {
+        return NONCE_FULL;
+    }
+
+    free->used = true;
+    free->timestamp = timestamp;
+    memcpy(free->nonce, nonce, length + 1);
+    return NONCE_ACCEPTED;
+}
+
+bool NonceCache::isLive(const Entry& entry, int64_t now) const {
+    return entry.used && entry.timestamp >= now - _maxSkew;
+}
+
+const char* NonceCache::describe(Result result) {
+    switch (result) {
+        case NONCE_ACCEPTED: return "accepted";
+        case NONCE_REPLAYED: return "Nonce already used";
+        case NONCE_EXPIRED: return "Timestamp outside the accepted window";
+        case NONCE_INVALID: return "Invalid nonce";
+        case NONCE_FULL: return "Too many commands, retry later";
+    }
+    return "unknown";
+}
@@ -0,0 +1,49 @@
+#ifndef NONCE_CACHE_H
+#define NONCE_CACHE_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stdint.h>
+#include "Config.h"
+
+// Replay protection for signed commands: a command is accepted once, and only while its
+// timestamp is within maxSkew seconds of the device clock. A nonce is remembered until
+// its timestamp leaves that window (a replay would then be rejected as expired anyway),
+// so the table never has to evict a nonce that could still be replayed.
+class NonceCache {
+public:
+    enum Result {
+        NONCE_ACCEPTED,
+        NONCE_REPLAYED,       // Seen within the window
+        NONCE_EXPIRED,        // Timestamp too far from the device clock
+        NONCE_INVALID,        // Empty or longer than MQTT_COMMAND_NONCE_MAX
+        NONCE_FULL            // Every slot holds a live nonce: too many commands at once
+    };
+
+    explicit NonceCache(long maxSkew = MQTT_COMMAND_MAX_SKEW);
+
+    // Records the nonce when accepted. Times in seconds since the epoch.
+    Result check(const char* nonce, int64_t timestamp, int64_t now);
+    void clear();
+
+    // Reason sent back with a rejected command
+    static const char* describe(Result result);
+
+private:
+    struct Entry {
+        bool used;
+        int64_t timestamp;
+        char nonce[MQTT_COMMAND_NONCE_MAX + 1];
+    };
+
+    Entry _entries[MQTT_COMMAND_NONCE_SLOTS];
+    long _maxSkew;
+
+    bool isLive(const Entry& entry, int64_t now) const;
+};
+
+#endif // NONCE_CACHE_H
@@ -0,0 +1,20 @@
+#include "ReconnectBackoff.h"
+
+ReconnectBackoff::ReconnectBackoff(unsigned long baseDelay, unsigned long maxDelay)
+    : _baseDelay(baseDelay), _maxDelay(maxDelay < baseDelay ? baseDelay : maxDelay), _failures(0) {
+}
+
+unsigned long ReconnectBackoff::nextDelay(uint32_t random) {
+    // Doubling stops at the cap (and before the shift overflows)
+    unsigned long ceiling = _baseDelay;
+    for (uint32_t i = 0; i < _failures && ceiling < _maxDelay; i++) {
+        ceiling *= 2;
+    }
+    if (ceiling > _maxDelay) {
+        ceiling = _maxDelay;
+    }
+    _failures++;
+
+    unsigned long half = ceiling / 2;
+    return half + random % (ceiling - half + 1);
+}
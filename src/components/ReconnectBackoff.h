@@ -0,0 +1,27 @@
+#ifndef RECONNECT_BACKOFF_H
+#define RECONNECT_BACKOFF_H
+
+#include <stdint.h>
+
+// Exponential backoff with jitter between reconnection attempts. The ceiling doubles
+// with every consecutive failure up to maxDelay; the delay is drawn between half the
+// ceiling and the ceiling, so clients that lost the broker together spread out.
+class ReconnectBackoff {
+public:
+    ReconnectBackoff(unsigned long baseDelay, unsigned long maxDelay);
+
+    // Delay (ms) before the next attempt after a failure; random is any uniform 32-bit value
+    unsigned long nextDelay(uint32_t random);
+
+    // Connected, or the link came back: next failure starts over from baseDelay
+    void reset() { _failures = 0; }
+
+    uint32_t failures() const { return _failures; }
+
+private:
+    unsigned long _baseDelay;
+    unsigned long _maxDelay;
+    uint32_t _failures;
+};
+
+#endif // RECONNECT_BACKOFF_H
@@ -0,0 +1,65 @@
+#include "RejectedTokenCache.h"
+
+#include <string.h>
+
+RejectedTokenCache::RejectedTokenCache(unsigned long ttl) : _next(0), _ttl(ttl), _stats() {
+    clear();
+}
+
+bool RejectedTokenCache::lookup(const TokenFingerprint& fingerprint, String& error) {
+    Entry* entry = find(fingerprint);
+    if (!entry) {
+        return false;
+    }
+    if (millis() - entry->storedAt >= _ttl) {
+        entry->used = false;
+        return false;
+    }
+    _stats.hits++;
+    error = entry->error;
+    return true;
+}
+
+bool RejectedTokenCache::store(const TokenFingerprint& fingerprint, const ValidationResult& result) {
+    if (result.isValid || result.unavailable) {
+        return false;
+    }
+    Entry* entry = find(fingerprint);
+    if (!entry) {
+        entry = &_entries[_next];
+        _next = (_next + 1) % REJECTED_TOKEN_CACHE_SIZE;
+    }
+    entry->key = fingerprint;
+    strncpy(entry->error, result.error.c_str(), sizeof(entry->error) - 1);
+    entry->error[sizeof(entry->error) - 1] = '\0';
+    entry->storedAt = millis();
+    entry->used = true;
+    _stats.stored++;
+    return true;
+}
+
+void RejectedTokenCache::clear() {
+    for (int i = 0; i < REJECTED_TOKEN_CACHE_SIZE; i++) {
+        _entries[i].used = false;
+    }
+    _next = 0;
+}
+
+int RejectedTokenCache::size() const {
+    int count = 0;
+    for (int i = 0; i < REJECTED_TOKEN_CACHE_SIZE; i++) {
+        if (_entries[i].used && millis() - _entries[i].storedAt < _ttl) {
+            count++;
+        }
+    }
+    return count;
+}
+
+RejectedTokenCache::Entry* RejectedTokenCache::find(const TokenFingerprint& fingerprint) {
+    for (int i = 0; i < REJECTED_TOKEN_CACHE_SIZE; i++) {
+        if (_entries[i].used && memcmp(_entries[i].key.bytes, fingerprint.bytes, sizeof(fingerprint.bytes)) == 0) {
+            return &_entries[i];
+        }
+    }
+    return nullptr;
+}
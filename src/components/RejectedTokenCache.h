@@ -0,0 +1,52 @@
+#ifndef REJECTED_TOKEN_CACHE_H
+#define REJECTED_TOKEN_CACHE_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stdint.h>
+#include "Config.h"
+#include "TokenCache.h"
+
+// Fingerprints of recently rejected tokens (invalid signature, expired, inactive...), so
+// that a client replaying a bad token doesn't cost an introspection or an RSA verification
+// each time. Fixed ring: the oldest rejection makes room, entries expire after ttl.
+// Only definite rejections belong here, never "Keycloak unavailable".
+class RejectedTokenCache {
+public:
+    struct Stats {
+        uint32_t hits;
+        uint32_t stored;
+    };
+
+    explicit RejectedTokenCache(unsigned long ttl = REJECTED_TOKEN_CACHE_TTL);
+
+    // Fills error with the original reason and returns true for a live entry
+    bool lookup(const TokenFingerprint& fingerprint, String& error);
+    // Keeps a definite rejection; valid and unavailable results are ignored (false)
+    bool store(const TokenFingerprint& fingerprint, const ValidationResult& result);
+    void clear();
+
+    int size() const;
+    const Stats& getStats() const { return _stats; }
+
+private:
+    struct Entry {
+        TokenFingerprint key;
+        char error[48];          // Truncated reason
+        unsigned long storedAt;
+        bool used;
+    };
+
+    Entry _entries[REJECTED_TOKEN_CACHE_SIZE];
+    int _next;                   // Ring position of the next store
+    unsigned long _ttl;
+    Stats _stats;
+
+    Entry* find(const TokenFingerprint& fingerprint);
+};
+
+#endif // REJECTED_TOKEN_CACHE_H
@@ -0,0 +1,170 @@
+#include "SensorEdgeCapture.h"
+#include "GpioInputs.h"
+
+#ifndef UNIT_TEST
+#include "LoopScheduler.h"
+#endif
+
+// Ring indexes are free-running counters, the size must be a power of two
+static_assert((SENSOR_EDGE_RING_SIZE & (SENSOR_EDGE_RING_SIZE - 1)) == 0, "SENSOR_EDGE_RING_SIZE must be a power of two");
+
+SensorEdgeCapture::SensorEdgeCapture()
+    : _head(0), _tail(0), _dropped(0), _droppedSeen(0), _active(false) {
+#ifndef UNIT_TEST
+    _scheduler = nullptr;
+#endif
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        _debouncers[i].stableLevel = HIGH; // Pull-up: sensor inactive
+        _debouncers[i].level = HIGH;
+        _debouncers[i].settling = false;
+        _debouncers[i].firstEdgeAt = 0;
+        _debouncers[i].lastEdgeAt = 0;
+    }
+}
+
+void SensorEdgeCapture::begin() {
+    uint64_t levels = readGpioInputs();
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        _debouncers[i].stableLevel = gpioLevel(levels, sensorPin(i));
+        _debouncers[i].level = _debouncers[i].stableLevel;
+        _debouncers[i].settling = false;
+    }
+
+#ifndef UNIT_TEST
+    // All GPIO interrupts are dispatched by one handler on this core: the ring keeps a single producer
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        _isrContexts[i] = {this, static_cast<uint8_t>(i), sensorPin(i)};
+        attachInterruptArg(digitalPinToInterrupt(sensorPin(i)), sensorIsr, &_isrContexts[i], CHANGE);
+    }
+    Serial.println("Sensor edge capture enabled on " + String(GATE_COUNT) + " gate(s) (debounce " +
+                   String(SENSOR_DEBOUNCE_US / 1000) + " ms)");
+#endif
+    _active = true;
+}
+
+bool IRAM_ATTR SensorEdgeCapture::pushEdge(uint8_t sensor, uint8_t level, unsigned long timestamp) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    if (head - _tail.load(std::memory_order_acquire) >= SENSOR_EDGE_RING_SIZE) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Edge& edge = _ring[head & (SENSOR_EDGE_RING_SIZE - 1)];
+    edge.sensor = sensor;
+    edge.level = level;
+    edge.timestamp = timestamp;
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+bool SensorEdgeCapture::poll(unsigned long now, SensorChange& change) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    uint32_t head = _head.load(std::memory_order_acquire);
+    while (tail != head) {
+        feed(_ring[tail & (SENSOR_EDGE_RING_SIZE - 1)]);
+        tail++;
+        _tail.store(tail, std::memory_order_release);
+    }
+
+    // Edges were lost while the ring was full: trust the pins again
+    uint32_t dropped = _dropped.load(std::memory_order_relaxed);
+    if (dropped != _droppedSeen) {
+        _droppedSeen = dropped;
+        resync(now);
+    }
+
+    return settle(now, change);
+}
+
+unsigned long SensorEdgeCapture::getSettleDelay(unsigned long now) const {
+    // Raw edges not fed to the debouncers yet
+    if (_head.load(std::memory_order_acquire) != _tail.load(std::memory_order_relaxed)) {
+        return 0;
+    }
+
+    unsigned long delay = ULONG_MAX;
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        const Debouncer& debouncer = _debouncers[i];
+        if (!debouncer.settling) {
+            continue;
+        }
+        unsigned long quiet = now - debouncer.lastEdgeAt;
+        unsigned long remaining = quiet >= SENSOR_DEBOUNCE_US ? 0 : SENSOR_DEBOUNCE_US - quiet;
+        if (remaining < delay) {
+            delay = remaining;
+        }
+    }
+    return delay;
+}
+
+GateState SensorEdgeCapture::getStableState(int gate) const {
+    // Sensors are active LOW
+    return gateStateFromSensors(_debouncers[gate * 2 + SENSOR_CLOSED].stableLevel == LOW,
+                                _debouncers[gate * 2 + SENSOR_OPEN].stableLevel == LOW);
+}
+
+void SensorEdgeCapture::feed(const Edge& edge) {
+    Debouncer& debouncer = _debouncers[edge.sensor];
+    if (!debouncer.settling) {
+        debouncer.settling = true;
+        debouncer.firstEdgeAt = edge.timestamp;
+    }
+    debouncer.level = edge.level;
+    debouncer.lastEdgeAt = edge.timestamp;
+}
+
+bool SensorEdgeCapture::settle(unsigned long now, SensorChange& change) {
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        bool changed = false;
+        unsigned long changedAt = 0;
+
+        for (int i = gate * 2; i < gate * 2 + 2; i++) {
+            Debouncer& debouncer = _debouncers[i];
+            if (!debouncer.settling || now - debouncer.lastEdgeAt < SENSOR_DEBOUNCE_US) {
+                continue;
+            }
+
+            // Quiet for the debounce window: the level is real (or the bounce cancelled out)
+            debouncer.settling = false;
+            if (debouncer.level != debouncer.stableLevel) {
+                debouncer.stableLevel = debouncer.level;
+                if (!changed || static_cast<long>(debouncer.firstEdgeAt - changedAt) < 0) {
+                    changedAt = debouncer.firstEdgeAt;
+                }
+                changed = true;
+            }
+        }
+
+        // Other gates are reported by the next poll()
+        if (changed) {
+            change.gate = gate;
+            change.state = getStableState(gate);
+            change.timestamp = changedAt;
+            return true;
+        }
+    }
+    return false;
+}
+
+void SensorEdgeCapture::resync(unsigned long now) {
+    uint64_t levels = readGpioInputs();
+    for (int i = 0; i < SENSOR_COUNT; i++) {
+        Edge edge = {static_cast<uint8_t>(i), gpioLevel(levels, sensorPin(i)), now};
+        feed(edge);
+    }
+}
+
+uint8_t SensorEdgeCapture::sensorPin(int sensor) {
+    const GatePins& gate = GATES[sensor / 2];
+    return (sensor % 2 == SENSOR_CLOSED) ? gate.closedSensorPin : gate.openSensorPin;
+}
+
+#ifndef UNIT_TEST
+void IRAM_ATTR SensorEdgeCapture::sensorIsr(void* arg) {
+    IsrContext* context = static_cast<IsrContext*>(arg);
+    uint8_t level = gpioLevel(readGpioInputs(), context->pin);
+    context->capture->pushEdge(context->sensor, level, micros());
+    if (context->capture->_scheduler) {
+        context->capture->_scheduler->wakeFromISR();
+    }
+}
+#endif
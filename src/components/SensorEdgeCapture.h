@@ -0,0 +1,100 @@
+#ifndef SENSOR_EDGE_CAPTURE_H
+#define SENSOR_EDGE_CAPTURE_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <atomic>
+#include <limits.h>
+#include <stdint.h>
+#include "GateTypes.h"
+#include "Config.h"
+
+#ifndef UNIT_TEST
+class LoopScheduler;
+#endif
+
+// Debounced gate state change, timestamped with micros() of the first edge
+struct SensorChange {
+    uint8_t gate;
+    GateState state;
+    unsigned long timestamp;
+};
+
+// GPIO interrupts on every sensor pin (see GATES) push raw edges into a lock-free
+// ring (single producer: the ISRs, single consumer: the gate task). poll() drains
+// the ring through a per-pin debounce filter.
+class SensorEdgeCapture {
+public:
+    // Sensor index: gate * 2 + SENSOR_CLOSED / SENSOR_OPEN
+    enum { SENSOR_CLOSED = 0, SENSOR_OPEN = 1 };
+    static const int SENSOR_COUNT = GATE_COUNT * 2;
+
+    SensorEdgeCapture();
+
+    // Attach the interrupts; the current pin levels become the stable state
+    void begin();
+    bool isActive() const { return _active; }
+
+#ifndef UNIT_TEST
+    // Task woken by the ISRs so that edges are drained right away
+    void attachScheduler(LoopScheduler* scheduler) { _scheduler = scheduler; }
+#endif
+
+    // ISR side: record a raw edge, false when the ring is full (edge dropped)
+    bool pushEdge(uint8_t sensor, uint8_t level, unsigned long timestamp);
+
+    // Loop side: next confirmed state change (one gate at a time), false when nothing settled yet
+    bool poll(unsigned long now, SensorChange& change);
+
+    // micros() before poll() can confirm a pending change, ULONG_MAX when nothing is settling
+    unsigned long getSettleDelay(unsigned long now) const;
+
+    GateState getStableState(int gate = 0) const;
+    uint32_t getDroppedEdges() const { return _dropped.load(); }
+
+private:
+    struct Edge {
+        uint8_t sensor;
+        uint8_t level;
+        unsigned long timestamp;
+    };
+
+    struct Debouncer {
+        uint8_t stableLevel;
+        uint8_t level;
+        bool settling;
+        unsigned long firstEdgeAt;
+        unsigned long lastEdgeAt;
+    };
+
+#ifndef UNIT_TEST
+    struct IsrContext {
+        SensorEdgeCapture* capture;
+        uint8_t sensor;
+        uint8_t pin;
+    };
+    IsrContext _isrContexts[SENSOR_COUNT];
+    LoopScheduler* volatile _scheduler;
+    static void IRAM_ATTR sensorIsr(void* arg);
+#endif
+
+    Edge _ring[SENSOR_EDGE_RING_SIZE];
+    std::atomic<uint32_t> _head;     // Written by the ISRs
+    std::atomic<uint32_t> _tail;     // Written by the consumer
+    std::atomic<uint32_t> _dropped;
+    uint32_t _droppedSeen;
+
+    Debouncer _debouncers[SENSOR_COUNT];
+    bool _active;
+
+    void feed(const Edge& edge);
+    bool settle(unsigned long now, SensorChange& change);
+    void resync(unsigned long now);
+    static uint8_t sensorPin(int sensor);
+};
+
+#endif // SENSOR_EDGE_CAPTURE_H
@@ -0,0 +1,149 @@
+#include "SessionTokens.h"
+#include "Base64Url.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef UNIT_TEST
+#include <esp_timer.h>
+#include <mbedtls/md.h>
+#endif
+
+// gs1.<16 hex>.<8 hex>.<sub>.<username>.<32-byte mac>: the longest identity issue() accepts must verify
+static_assert(4 + 16 + 1 + 8 + 1 + base64UrlLength(SESSION_TOKEN_SUB_MAX) + 1 +
+                  base64UrlLength(SESSION_TOKEN_USERNAME_MAX) + 1 + base64UrlLength(32) <= SESSION_TOKEN_MAX_LENGTH,
+              "Session token field limits must fit SESSION_TOKEN_MAX_LENGTH");
+
+namespace {
+    // Decoded field into a NUL-terminated buffer, false when malformed or too long
+    bool decodeField(const char* start, const char* end, char* out, size_t capacity) {
+        int written = base64UrlDecode(start, end - start, reinterpret_cast<uint8_t*>(out), capacity - 1);
+        if (written < 0 || memchr(out, '\0', written) != nullptr) {
+            return false;
+        }
+        out[written] = '\0';
+        return true;
+    }
+}
+
+SessionTokens::SessionTokens() : _ready(false) {
+    memset(_key, 0, sizeof(_key));
+}
+
+SessionTokens::~SessionTokens() {
+    memset(_key, 0, sizeof(_key));
+}
+
+bool SessionTokens::issue(const ValidationResult& identity, String& token, unsigned long& lifetime) const {
+    if (!_ready || !identity.isValid || identity.userId.isEmpty() || static_cast<int>(identity.userId.length()) > SESSION_TOKEN_SUB_MAX ||
+        static_cast<int>(identity.username.length()) > SESSION_TOKEN_USERNAME_MAX) {
+        return false;
+    }
+
+    // Never outlive the Keycloak token it was exchanged for
+    lifetime = SESSION_TOKEN_TTL;
+    const time_t now = time(nullptr);
+    if (identity.expiresAt > 0 && now >= CLOCK_SYNCED_MIN_EPOCH) {
+        if (identity.expiresAt <= now) {
+            return false;
+        }
+        const unsigned long untilExp = static_cast<unsigned long>(identity.expiresAt - now) * 1000UL;
+        if (untilExp < lifetime) {
+            lifetime = untilExp;
+        }
+    }
+
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "gs1.%llx.%lx.", static_cast<unsigned long long>(uptimeMs() + lifetime),
+             static_cast<unsigned long>(identity.roles));
+    token = prefix;
+    base64UrlEncode(reinterpret_cast<const uint8_t*>(identity.userId.c_str()), identity.userId.length(), token);
+    token += '.';
+    base64UrlEncode(reinterpret_cast<const uint8_t*>(identity.username.c_str()), identity.username.length(), token);
+
+    uint8_t mac[MAC_SIZE];
+    if (!sign(token.c_str(), token.length(), mac)) {
+        return false;
+    }
+    token += '.';
+    base64UrlEncode(mac, sizeof(mac), token);
+    return static_cast<int>(token.length()) <= SESSION_TOKEN_MAX_LENGTH;
+}
+
+ValidationResult SessionTokens::verify(const String& token) const {
+    ValidationResult result;
+    if (!_ready || static_cast<int>(token.length()) > SESSION_TOKEN_MAX_LENGTH) {
+        result.error = "Invalid session token";
+        return result;
+    }
+
+    // Authenticate first: nothing of a forged token is parsed
+    const char* text = token.c_str();
+    const char* macStart = strrchr(text, '.');
+    uint8_t mac[MAC_SIZE + 1];
+    uint8_t expected[MAC_SIZE];
+    if (!macStart || base64UrlDecode(macStart + 1, strlen(macStart + 1), mac, sizeof(mac)) != static_cast<int>(MAC_SIZE) ||
+        !sign(text, macStart - text, expected)) {
+        result.error = "Invalid session token";
+        return result;
+    }
+    // Constant time: the comparison doesn't tell how many leading bytes were right
+    uint8_t difference = 0;
+    for (size_t i = 0; i < MAC_SIZE; i++) {
+        difference |= mac[i] ^ expected[i];
+    }
+    if (difference != 0) {
+        result.error = "Invalid session token";
+        return result;
+    }
+
+    // gs1.<expiry>.<roles>.<sub>.<username>
+    const char* expiryStart = text + 4;
+    const char* rolesStart = strchr(expiryStart, '.');
+    const char* subStart = rolesStart ? strchr(rolesStart + 1, '.') : nullptr;
+    const char* usernameStart = subStart ? strchr(subStart + 1, '.') : nullptr;
+    char userId[SESSION_TOKEN_SUB_MAX + 1];
+    char username[SESSION_TOKEN_USERNAME_MAX + 1];
+    if (!usernameStart || usernameStart >= macStart || strchr(usernameStart + 1, '.') != macStart ||
+        !decodeField(subStart + 1, usernameStart, userId, sizeof(userId)) ||
+        !decodeField(usernameStart + 1, macStart, username, sizeof(username))) {
+        result.error = "Malformed session token";
+        return result;
+    }
+
+    const uint64_t expiry = strtoull(expiryStart, nullptr, 16);
+    const uint64_t now = uptimeMs();
+    if (now >= expiry) {
+        result.error = "Session token expired";
+        return result;
+    }
+
+    result.isValid = true;
+    result.userId = userId;
+    result.username = username;
+    result.roles = static_cast<uint32_t>(strtoul(rolesStart + 1, nullptr, 16));
+    const time_t wallClock = time(nullptr);
+    result.expiresAt = wallClock >= CLOCK_SYNCED_MIN_EPOCH ? wallClock + static_cast<time_t>((expiry - now) / 1000) : 0;
+    return result;
+}
+
+#ifndef UNIT_TEST
+void SessionTokens::begin() {
+    for (size_t i = 0; i < KEY_SIZE; i += 4) {
+        uint32_t word = esp_random();
+        memcpy(_key + i, &word, 4);
+    }
+    _ready = true;
+}
+
+bool SessionTokens::sign(const char* data, size_t length, uint8_t* mac) const {
+    return mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), _key, sizeof(_key),
+                           reinterpret_cast<const unsigned char*>(data), length, mac) == 0;
+}
+
+uint64_t SessionTokens::uptimeMs() {
+    return static_cast<uint64_t>(esp_timer_get_time()) / 1000;
+}
+#endif
@@ -0,0 +1,48 @@
+#ifndef SESSION_TOKENS_H
+#define SESSION_TOKENS_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "AuthTypes.h"
+#include "Config.h"
+
+// Compact bearer tokens issued by the device in exchange for a validated Keycloak token:
+//   gs1.<expiry>.<roles>.<sub>.<username>.<mac>
+// expiry is the uptime (ms, hex) at which the token dies, roles the AccessPolicy mask (hex,
+// bits are only meaningful within this boot, like the key), sub and username are base64url,
+// mac is the base64url HMAC-SHA256 of everything before it. The key is drawn at boot and
+// never leaves RAM, so a reboot revokes every session. Verified locally in constant time:
+// follow-up requests skip Keycloak and keep the original identity.
+class SessionTokens {
+public:
+    SessionTokens();
+    ~SessionTokens();
+
+    // Draw the key (hardware RNG: call once the radio is up)
+    void begin();
+
+    static bool isSessionToken(const String& token) { return token.startsWith("gs1."); }
+
+    // lifetime (ms) is SESSION_TOKEN_TTL, shortened to the Keycloak token's exp when known.
+    // false when sub or username is longer than SESSION_TOKEN_SUB_MAX / SESSION_TOKEN_USERNAME_MAX
+    // or the Keycloak token is about to expire.
+    bool issue(const ValidationResult& identity, String& token, unsigned long& lifetime) const;
+
+    ValidationResult verify(const String& token) const;
+
+private:
+    static const size_t KEY_SIZE = 32;
+    static const size_t MAC_SIZE = 32;
+
+    uint8_t _key[KEY_SIZE];
+    bool _ready;
+
+    bool sign(const char* data, size_t length, uint8_t* mac) const;
+    static uint64_t uptimeMs();
+};
+
+#endif // SESSION_TOKENS_H
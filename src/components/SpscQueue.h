@@ -0,0 +1,90 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <atomic>
+#include <stdint.h>
+
+// Bounded lock-free queue for exactly one producer task and one consumer task.
+// Indexes are free-running counters, Capacity must be a power of two.
+template <typename T, uint32_t Capacity>
+class SpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue() : _head(0), _tail(0) {}
+
+    // Producer side, false when full
+    bool push(const T& item) {
+        uint32_t head = _head.load(std::memory_order_relaxed);
+        if (head - _tail.load(std::memory_order_acquire) >= Capacity) {
+            return false;
+        }
+        _items[head & (Capacity - 1)] = item;
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, false when empty
+    bool pop(T& item) {
+        uint32_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail == _head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = _items[tail & (Capacity - 1)];
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool isEmpty() const {
+        return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire);
+    }
+
+    uint32_t size() const {
+        return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+    }
+
+private:
+    T _items[Capacity];
+    std::atomic<uint32_t> _head;  // Written by the producer only
+    std::atomic<uint32_t> _tail;  // Written by the consumer only
+};
+
+// Single-writer snapshot cell: readers on any task get a consistent copy
+// without blocking the writer (sequence lock, readers retry on a torn read).
+template <typename T>
+class SeqLock {
+public:
+    SeqLock() : _sequence(0), _value() {}
+
+    void write(const T& value) {
+        uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+        _sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        _value = value;
+        std::atomic_thread_fence(std::memory_order_release);
+        _sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    T read() const {
+        for (;;) {
+            uint32_t before = _sequence.load(std::memory_order_acquire);
+            if (before & 1) {
+                continue; // Write in progress
+            }
+            T copy = _value;
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_sequence.load(std::memory_order_relaxed) == before) {
+                return copy;
+            }
+        }
+    }
+
+    // Number of completed writes
+    uint32_t version() const { return _sequence.load(std::memory_order_acquire) / 2; }
+
+private:
+    std::atomic<uint32_t> _sequence;
+    T _value;
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,141 @@
+#include "TokenCache.h"
+
+#include <string.h>
+
+#ifndef UNIT_TEST
+#include <mbedtls/md.h>
+#endif
+
+namespace {
+    bool copyField(char* dest, size_t capacity, const String& value) {
+        if (value.length() >= capacity) {
+            return false;
+        }
+        memcpy(dest, value.c_str(), value.length() + 1);
+        return true;
+    }
+}
+
+TokenCache::TokenCache(unsigned long maxAge) : _maxAge(maxAge), _useCounter(0), _stats() {
+    clear();
+}
+
+bool TokenCache::lookup(const TokenFingerprint& fingerprint, ValidationResult& result) {
+    Entry* entry = find(fingerprint);
+
+    if (entry && isExpired(*entry)) {
+        entry->used = false;
+        _stats.expirations++;
+        entry = nullptr;
+    }
+
+    if (!entry) {
+        _stats.misses++;
+        return false;
+    }
+
+    entry->lastUsed = ++_useCounter;
+    _stats.hits++;
+
+    result.isValid = true;
+    result.error = "";
+    result.userId = entry->userId;
+    result.username = entry->username;
+    result.realm = entry->realm;
+    result.expiresAt = entry->expiresAt;
+    result.roles = entry->roles;
+    return true;
+}
+
+bool TokenCache::store(const TokenFingerprint& fingerprint, const ValidationResult& result, time_t now) {
+    // Without a known exp (or a synchronized clock) the entry could outlive the token
+    if (!result.isValid || result.expiresAt == 0 || now < CLOCK_SYNCED_MIN_EPOCH || result.expiresAt <= now) {
+        return false;
+    }
+
+    unsigned long ttl = _maxAge;
+    const unsigned long untilExp = static_cast<unsigned long>(result.expiresAt - now) * 1000UL;
+    if (untilExp < ttl) {
+        ttl = untilExp;
+    }
+
+    Entry* entry = find(fingerprint);
+    if (!entry) {
+        entry = selectVictim();
+    }
+
+    if (!copyField(entry->userId, sizeof(entry->userId), result.userId) ||
+        !copyField(entry->username, sizeof(entry->username), result.username) ||
+        !copyField(entry->realm, sizeof(entry->realm), result.realm)) {
+        entry->used = false;
+        return false;
+    }
+
+    entry->key = fingerprint;
+    entry->expiresAt = result.expiresAt;
+    entry->roles = result.roles;
+    entry->storedAt = millis();
+    entry->ttl = ttl;
+    entry->lastUsed = ++_useCounter;
+    entry->used = true;
+    return true;
+}
+
+void TokenCache::clear() {
+    for (int i = 0; i < TOKEN_CACHE_SIZE; i++) {
+        _entries[i].used = false;
+    }
+}
+
+int TokenCache::size() const {
+    int count = 0;
+    for (int i = 0; i < TOKEN_CACHE_SIZE; i++) {
+        if (_entries[i].used && !isExpired(_entries[i])) {
+            count++;
+        }
+    }
+    return count;
+}
+
+#ifndef UNIT_TEST
+void TokenCache::fingerprint(const String& token, TokenFingerprint& out) {
+    mbedtls_md(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+               reinterpret_cast<const unsigned char*>(token.c_str()), token.length(), out.bytes);
+}
+#endif
+
+TokenCache::Entry* TokenCache::find(const TokenFingerprint& fingerprint) {
+    for (int i = 0; i < TOKEN_CACHE_SIZE; i++) {
+        if (_entries[i].used && memcmp(_entries[i].key.bytes, fingerprint.bytes, sizeof(fingerprint.bytes)) == 0) {
+            return &_entries[i];
+        }
+    }
+    return nullptr;
+}
+
+TokenCache::Entry* TokenCache::selectVictim() {
+    Entry* victim = nullptr;
+
+    for (int i = 0; i < TOKEN_CACHE_SIZE; i++) {
+        Entry& entry = _entries[i];
+        if (!entry.used) {
+            return &entry;
+        }
+        if (isExpired(entry)) {
+            entry.used = false;
+            _stats.expirations++;
+            return &entry;
+        }
+        if (!victim || entry.lastUsed < victim->lastUsed) {
+            victim = &entry;
+        }
+    }
+
+    victim->used = false;
+    _stats.evictions++;
+    return victim;
+}
+
+bool TokenCache::isExpired(const Entry& entry) const {
+    return millis() - entry.storedAt >= entry.ttl;
+}
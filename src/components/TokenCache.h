@@ -0,0 +1,74 @@
+#ifndef TOKEN_CACHE_H
+#define TOKEN_CACHE_H
+
+#ifdef UNIT_TEST
+#include "../../test/mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include <stdint.h>
+#include <time.h>
+#include "AuthTypes.h"
+#include "Config.h"
+
+// SHA-256 of the raw bearer token, the token itself is never stored
+struct TokenFingerprint {
+    uint8_t bytes[32];
+};
+
+// Fixed-size LRU cache of successful validations, keyed by token fingerprint.
+// Entries live in a static array: no heap allocation on lookup or insert.
+class TokenCache {
+public:
+    struct Stats {
+        uint32_t hits;
+        uint32_t misses;
+        uint32_t evictions;    // Live entries dropped to make room (cache too small)
+        uint32_t expirations;  // Entries dropped because their TTL elapsed
+    };
+
+    explicit TokenCache(unsigned long maxAge = TOKEN_CACHE_MAX_AGE);
+
+    // Fills result and returns true when a live entry exists for this fingerprint
+    bool lookup(const TokenFingerprint& fingerprint, ValidationResult& result);
+
+    // Caches a valid result until min(exp, now + maxAge). Returns false when not cacheable.
+    bool store(const TokenFingerprint& fingerprint, const ValidationResult& result, time_t now);
+
+    void clear();
+
+    int size() const;
+    int capacity() const { return TOKEN_CACHE_SIZE; }
+    const Stats& getStats() const { return _stats; }
+
+#ifndef UNIT_TEST
+    // SHA-256 through mbedTLS (uses the ESP32 SHA accelerator)
+    static void fingerprint(const String& token, TokenFingerprint& out);
+#endif
+
+private:
+    struct Entry {
+        TokenFingerprint key;
+        char userId[40];      // Keycloak subjects are UUIDs
+        char username[64];
+        char realm[128];
+        time_t expiresAt;
+        uint32_t roles;
+        unsigned long storedAt;
+        unsigned long ttl;
+        uint32_t lastUsed;
+        bool used;
+    };
+
+    Entry _entries[TOKEN_CACHE_SIZE];
+    unsigned long _maxAge;
+    uint32_t _useCounter;
+    Stats _stats;
+
+    Entry* find(const TokenFingerprint& fingerprint);
+    Entry* selectVictim();
+    bool isExpired(const Entry& entry) const;
+};
+
+#endif // TOKEN_CACHE_H
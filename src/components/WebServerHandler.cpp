@@ -1,32 +1,187 @@
 #include "WebServerHandler.h"
 #include "Config.h"
+#include "HostResolver.h"
+#include "LoopScheduler.h"
+#include <time.h>
 
-WebServerHandler::WebServerHandler(GateController* gateController, GateMonitor* gateMonitor) 
-    : _server(SERVER_PORT), _gateController(gateController), _gateMonitor(gateMonitor),
-      _authConfig(nullptr), _authMiddleware(nullptr), _emqxConfig(nullptr), _emqxLogger(nullptr) {
+static const char* actionName(OperationState action) {
+    return action == OPENING ? "open" : "close";
+}
+
+static const char* gateStatusName(const GateStatus& gate) {
+    // Priority: ongoing operations override physical state
+    if (gate.operation == OPENING) {
+        return "opening";
+    }
+    if (gate.operation == CLOSING) {
+        return "closing";
+    }
+    if (gate.state == CLOSED) {
+        return "closed";
+    }
+    return gate.state == OPEN ? "open" : "unknown";
+}
+
+WebServerHandler::WebServerHandler(GateControlTask* gateControl, LoopScheduler* scheduler) 
+    : _server(SERVER_PORT), _eventStream(&_server, esp_random()), _bootId(esp_random()),
+      _stateConnection(0), _stateSnapshotPending(false), _stateChangedAt(0), _networkUpPending(false),
+      _gateControl(gateControl), _scheduler(scheduler),
+      _authConfig(nullptr), _authMiddleware(nullptr), _emqxConfig(nullptr), _emqxLogger(nullptr),
+      _commandVerifier(nullptr), _mqttForged(0), _mqttForgedLoggedAt(0), _mqttRefused(0),
+      _mqttRefusedAt(0), _guestCodes(nullptr),
+      _guestThrottle(GUEST_THROTTLE_FAILURES, GUEST_THROTTLE_INTERVAL, GUEST_BAN_FAILURES, GUEST_BAN_DURATION,
+                     GUEST_FAILURE_WINDOW),
+      _commandsMutex(nullptr), _commandQueue(nullptr),
+      _commandWorker(nullptr) {
+    _commandsMutex = xSemaphoreCreateMutex();
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        _publishedVersion[gate] = 0;
+        _statusCache[gate].valid = false;
+        memset(&_stateGates[gate], 0, sizeof(GateStatus)); // Overwritten by the first snapshot
+    }
+    for (int i = 0; i < AUTH_SESSION_SLOTS; i++) {
+        _sessionExchanges[i].replyTo = 0;
+        _sessionExchanges[i].done = false;
+    }
+    for (int i = 0; i < STATUS_MAX_WAITERS; i++) {
+        _statusWaiters[i].response = 0;
+    }
 }
 
 WebServerHandler::~WebServerHandler() {
+    if (_commandWorker) {
+        vTaskDelete(_commandWorker);
+    }
+    if (_commandQueue) {
+        vQueueDelete(_commandQueue);
+    }
+    vSemaphoreDelete(_commandsMutex);
     delete _authMiddleware;
     delete _emqxLogger;
+    delete _commandVerifier;
+    delete _guestCodes;
     delete _emqxConfig;
 }
 
 void WebServerHandler::begin() {
+    HostResolver::getInstance().begin();
     initializeAuth();
     initializeEmqx();
     setupRoutes();
+    
+    // Only changes from now on are streamed
+    GateSnapshot snapshot = _gateControl->getSnapshot();
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        _publishedVersion[gate] = snapshot.gates[gate].version;
+    }
+    
+    // Every in-flight command holds a slot, so the ID queue can never overflow
+    _commandQueue = xQueueCreate(GATE_COMMAND_SLOTS + AUTH_SESSION_SLOTS, sizeof(AuthJob));
+    xTaskCreatePinnedToCore(commandWorkerEntry, "gate_cmd", 8192, this, 1, &_commandWorker, 0);
+    
     _server.begin();
+    _server.attachScheduler(_scheduler);
     Serial.println("HTTP server started");
 }
 
 void WebServerHandler::handleClient() {
-    _server.handleClient();
+    if (_networkUpPending.exchange(false)) {
+        handleNetworkUp();
+    }
+    
+    _server.poll();
+    
+    // Dispatch authenticated commands and track their progress
+    processCommands();
+    
+    // Flash write for accepted guest codes, once their command is on its way
+    if (_guestCodes && _guestCodes->hasUnsavedUsage()) {
+        _guestCodes->saveUsage();
+    }
+    
+    // Push gate changes to /gate/events subscribers, long polls and the MQTT state topic
+    publishGateChanges();
+    publishMqttState();
+    _eventStream.loop(millis());
     
     // Maintain EMQX connection
     if (_emqxLogger) {
         _emqxLogger->loop();
     }
+    
+    // Keep the Keycloak connection warm
+    if (_authMiddleware) {
+        _authMiddleware->maintain();
+    }
+}
+
+void WebServerHandler::onNetworkUp() {
+    // The resolver cache and the MQTT backoff belong to the network task
+    _networkUpPending = true;
+    _scheduler->wake();
+}
+
+void WebServerHandler::handleNetworkUp() {
+    // Addresses may have changed with the new network
+    HostResolver::getInstance().refreshAll();
+    
+    if (_authMiddleware) {
+        _authMiddleware->onNetworkUp();
+    }
+    
+    // Broker probably reachable again: don't wait for the backoff
+    if (_emqxLogger) {
+        _emqxLogger->onNetworkUp();
+    }
+}
+
+unsigned long WebServerHandler::getNextDeadline(unsigned long now) {
+    // Socket activity wakes the loop, only the HTTP timeouts need a deadline
+    unsigned long next = _server.getNextDeadline(now);
+    if (_networkUpPending) {
+        return 0;
+    }
+    
+    // Running commands follow the gate snapshot
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    bool commandsInFlight = _commands.inFlightCount() > 0;
+    xSemaphoreGive(_commandsMutex);
+    if (commandsInFlight && COMMAND_POLL_INTERVAL < next) {
+        next = COMMAND_POLL_INTERVAL;
+    }
+    
+    unsigned long heartbeat = _eventStream.getNextDeadline(now);
+    if (heartbeat < next) {
+        next = heartbeat;
+    }
+    
+    for (int i = 0; i < STATUS_MAX_WAITERS; i++) {
+        const StatusWaiter& waiter = _statusWaiters[i];
+        if (waiter.response) {
+            unsigned long elapsed = now - waiter.parkedAt;
+            unsigned long remaining = elapsed >= STATUS_LONG_POLL_TIMEOUT ? 0 : STATUS_LONG_POLL_TIMEOUT - elapsed;
+            if (remaining < next) {
+                next = remaining;
+            }
+        }
+    }
+    
+    if (_emqxLogger) {
+        unsigned long mqtt = _emqxLogger->getNextDeadline(now);
+        if (mqtt < next) {
+            next = mqtt;
+        }
+    }
+    
+    if (_stateSnapshotPending) {
+        unsigned long elapsed = now - _stateChangedAt;
+        unsigned long remaining = elapsed >= MQTT_STATE_SNAPSHOT_DELAY ? 0 : MQTT_STATE_SNAPSHOT_DELAY - elapsed;
+        if (remaining < next) {
+            next = remaining;
+        }
+    }
+    
+    return next;
 }
 
 void WebServerHandler::setupRoutes() {
@@ -34,9 +189,25 @@ void WebServerHandler::setupRoutes() {
     _server.on("/", [this]() { handleRoot(); });
     _server.on("/health", [this]() { handleHealth(); });
     _server.on("/auth/info", [this]() { handleAuthInfo(); });
-    _server.on("/gate/open", [this]() { handleGateOpen(); });
-    _server.on("/gate/close", [this]() { handleGateClose(); });
-    _server.on("/gate/status", [this]() { handleGateStatus(); });
+    _server.on("/auth/session", [this]() { handleSessionExchange(); });
+    _server.on("/gates", [this]() { handleGateList(); });
+    _server.on("/gate/operations/{}", [this]() { handleOperationStatus(); });
+    
+    // /gate/{id}/... with the id (or index) from GATES; the historical routes drive the first gate
+    _server.on("/gate/open", [this]() { handleGateCommand(OPENING, 0); });
+    _server.on("/gate/close", [this]() { handleGateCommand(CLOSING, 0); });
+    _server.on("/gate/status", [this]() { sendGateStatus(0); });
+    _server.on("/gate/{}/open", [this]() { handleGateCommandRoute(OPENING); });
+    _server.on("/gate/{}/close", [this]() { handleGateCommandRoute(CLOSING); });
+    _server.on("/gate/{}/status", [this]() { handleGateStatusRoute(); });
+    _server.on("/system/stats", [this]() { handleSystemStats(); });
+    _server.on("/gate/events", [this]() { handleGateEvents(); });
+    _server.on("/guest/open", [this]() { handleGuestOpen(); });
+    
+    // Authorization is always collected by the server, Prefer selects async mode,
+    // Last-Event-ID resumes an event stream, If-None-Match revalidates a status
+    const char* headers[] = {"Prefer", "Last-Event-ID", "If-None-Match"};
+    _server.collectHeaders(headers, 3);
 }
 
 void WebServerHandler::handleRoot() {
@@ -44,114 +215,1017 @@ void WebServerHandler::handleRoot() {
 }
 
 void WebServerHandler::handleHealth() {
-    _server.send(200, "text/plain", "OK");
+    // The device itself is fine: 200 even when Keycloak is unreachable
+    JsonWriter json = jsonWriter();
+    json.beginObject();
+    if (_authMiddleware && _authMiddleware->getJwtValidator()) {
+        CircuitBreaker::State breaker = _authMiddleware->getJwtValidator()->getConnection().getBreaker().getState();
+        json.field("status", breaker == CircuitBreaker::BREAKER_CLOSED ? "ok" : "degraded");
+        json.field("keycloak", CircuitBreaker::stateName(breaker));
+    } else {
+        json.field("status", "ok");
+    }
+    json.endObject();
+    sendJson(200, json);
 }
 
 void WebServerHandler::handleAuthInfo() {
-    String json = "{";
-    json += "\"auth_enabled\":" + String(_authConfig && _authConfig->isAuthEnabled() ? "true" : "false");
+    JsonWriter json = jsonWriter();
+    json.beginObject();
+    json.field("auth_enabled", _authConfig && _authConfig->isAuthEnabled());
     
     if (_authConfig && _authConfig->isAuthEnabled()) {
-        json += ",\"keycloak_server\":\"" + _authConfig->getKeycloakServerUrl() + "\"";
-        json += ",\"realm\":\"" + _authConfig->getKeycloakRealm() + "\"";
-        json += ",\"client_id\":\"" + _authConfig->getKeycloakClientId() + "\"";
-        json += ",\"protected_routes\":[\"/gate/open\",\"/gate/close\"]";
+        json.field("keycloak_server", _authConfig->getKeycloakServerUrl());
+        json.field("realm", _authConfig->getKeycloakRealm());
+        json.field("client_id", _authConfig->getKeycloakClientId());
+        json.field("validation_mode", _authConfig->getValidationModeName());
+        if (_authMiddleware && _authMiddleware->getJwtValidator()) {
+            const JwtValidator* validator = _authMiddleware->getJwtValidator();
+            const TokenCache& cache = validator->getTokenCache();
+            const TokenCache::Stats& stats = cache.getStats();
+            json.field("jwks_keys", validator->getJwksKeyCount());
+            json.beginObject("token_cache");
+            json.field("size", cache.size());
+            json.field("capacity", cache.capacity());
+            json.field("hits", stats.hits);
+            json.field("misses", stats.misses);
+            json.field("evictions", stats.evictions);
+            json.field("expirations", stats.expirations);
+            json.endObject();
+            
+            const RejectedTokenCache& rejected = validator->getRejectedCache();
+            json.beginObject("rejected_cache");
+            json.field("size", rejected.size());
+            json.field("hits", rejected.getStats().hits);
+            json.field("stored", rejected.getStats().stored);
+            json.endObject();
+            
+            const KeycloakConnection& connection = validator->getConnection();
+            const KeycloakConnection::Stats& connectionStats = connection.getStats();
+            json.beginObject("keycloak_connection");
+            json.field("keep_alive", connection.isKeepAliveEnabled());
+            json.field("requests", connectionStats.requests);
+            json.field("reused", connectionStats.reused);
+            json.field("handshakes", connectionStats.handshakes);
+            json.field("retries", connectionStats.retries);
+            json.endObject();
+            
+            const CircuitBreaker& breaker = connection.getBreaker();
+            json.beginObject("keycloak_breaker");
+            json.field("state", CircuitBreaker::stateName(breaker.getState()));
+            json.field("failure_percent", breaker.failurePercent());
+            json.field("opened", breaker.getStats().opened);
+            json.field("rejected", breaker.getStats().rejected);
+            json.field("probes", breaker.getStats().probes);
+            json.endObject();
+            json.field("request_budget_ms", AUTH_REQUEST_BUDGET);
+            
+            const ClientThrottle& throttle = _authMiddleware->getClientThrottle();
+            const ClientThrottle::Stats& throttleStats = throttle.getStats();
+            json.beginObject("client_throttle");
+            json.field("tracked", throttle.trackedCount(millis()));
+            json.field("banned", throttle.bannedCount(millis()));
+            json.field("throttled", throttleStats.throttled);
+            json.field("blocked", throttleStats.blocked);
+            json.field("bans", throttleStats.bans);
+            json.field("evictions", throttleStats.evictions);
+            json.endObject();
+        }
+        if (_authMiddleware) {
+            const AccessPolicy& policy = _authMiddleware->getPolicy();
+            json.beginObject("access_policy");
+            json.field("rules", policy.ruleCount());
+            json.field("roles", policy.roleCount() - 1); // Names stay in the build flags, the buffer is small
+            json.endObject();
+        }
+        json.beginArray("protected_routes");
+        json.value("/gate/open").value("/gate/close").value("/gate/{id}/open").value("/gate/{id}/close");
+        json.endArray();
     }
     
-    json += "}";
+    if (_guestCodes) {
+        json.beginObject("guest_codes");
+        json.field("guests", _guestCodes->count());
+        json.field("accepted", _guestCodes->getStats().accepted);
+        json.field("rejected", _guestCodes->getStats().rejected);
+        json.field("throttled", _guestThrottle.getStats().throttled + _guestThrottle.getStats().blocked);
+        json.endObject();
+    }
     
-    _server.send(200, "application/json", json);
+    json.endObject();
+    sendJson(200, json);
 }
 
-void WebServerHandler::handleGateOpen() {
-    bool authenticated = requireAuthentication();
+int WebServerHandler::resolveGate() {
+    return resolveGate(_server.pathArg(0));
+}
+
+int WebServerHandler::resolveGate(const String& id) {
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        if (id == GATES[gate].id) {
+            return gate;
+        }
+    }
     
-    // Log l'action (autorisée ou non)
-    logGateAction("open", authenticated);
+    // Index also accepted: /gate/0/open
+    if (id.length() > 0 && isDigit(id[0])) {
+        int index = id.toInt();
+        if (index >= 0 && index < GATE_COUNT && id == String(index)) {
+            return index;
+        }
+    }
+    
+    _server.send(404, "application/json", "{\"error\":\"Unknown gate\"}");
+    return -1;
+}
+
+void WebServerHandler::handleGateCommandRoute(OperationState action) {
+    int gate = resolveGate();
+    if (gate >= 0) {
+        handleGateCommand(action, gate);
+    }
+}
+
+void WebServerHandler::handleGateStatusRoute() {
+    int gate = resolveGate();
+    if (gate >= 0) {
+        sendGateStatus(gate);
+    }
+}
+
+void WebServerHandler::sendGateStatus(int gate) {
+    GateSnapshot snapshot = _gateControl->getSnapshot();
+    uint32_t version = snapshot.gates[gate].version;
     
-    if (!authenticated) {
+    // Long poll: held until the version moves on (answered right away when every slot is taken)
+    if (_server.hasArg("since") && strtoul(_server.arg("since").c_str(), nullptr, 10) == version &&
+        parkStatusRequest(gate, version)) {
         return;
     }
     
-    GateState currentState = _gateController->readState();
+    // Countdowns may differ, hence a weak validator
+    char etag[32];
+    formatStatusETag(etag, sizeof(etag), version);
+    _server.sendHeader("ETag", etag);
+    _server.sendHeader("Cache-Control", "no-cache");
     
-    if (currentState != OPEN) {
-        _gateController->triggerRelay();
-        _gateMonitor->startOperation(OPENING, OPEN);
+    // Weak comparison: the opaque part, with or without W/, or *
+    const char* ifNoneMatch;
+    size_t length;
+    if (_server.header("If-None-Match", ifNoneMatch, length)) {
+        const char* opaque = etag + 2;
+        size_t opaqueLength = strlen(opaque);
+        bool matched = length == 1 && ifNoneMatch[0] == '*';
+        for (size_t i = 0; !matched && i + opaqueLength <= length; i++) {
+            matched = strncmp(ifNoneMatch + i, opaque, opaqueLength) == 0;
+        }
+        if (matched) {
+            _server.send(304, nullptr, "");
+            return;
+        }
     }
     
-    // Return current status in JSON format
-    handleGateStatus();
+    JsonWriter json = jsonWriter();
+    writeStatusJson(json, nullptr, gate, snapshot);
+    sendJson(200, json);
+}
+
+bool WebServerHandler::parkStatusRequest(int gate, uint32_t since) {
+    for (int i = 0; i < STATUS_MAX_WAITERS; i++) {
+        StatusWaiter& waiter = _statusWaiters[i];
+        if (!waiter.response) {
+            waiter.response = _server.deferResponse();
+            waiter.gate = gate;
+            waiter.since = since;
+            waiter.parkedAt = millis();
+            return waiter.response != 0;
+        }
+    }
+    return false;
+}
+
+void WebServerHandler::formatStatusETag(char* etag, size_t size, uint32_t version) {
+    snprintf(etag, size, "W/\"%08lx-%lu\"", static_cast<unsigned long>(_bootId), static_cast<unsigned long>(version));
 }
 
-void WebServerHandler::handleGateClose() {
-    bool authenticated = requireAuthentication();
+void WebServerHandler::handleGateList() {
+    GateSnapshot snapshot = _gateControl->getSnapshot();
+    JsonWriter json = jsonWriter();
+    json.beginObject().beginArray("gates");
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        writeStatusJson(json, nullptr, gate, snapshot);
+    }
+    json.endArray().endObject();
+    sendJson(200, json);
+}
+
+void WebServerHandler::handleGateCommand(OperationState action, int gate) {
+    // A synchronous request goes through the same pipeline, its connection waits for the
+    // gate task's answer while the other clients keep being served
+    enqueueGateCommand(action, gate, !wantsAsyncCommand());
+}
+
+bool WebServerHandler::wantsAsyncCommand() {
+    if (_server.hasArg("async")) {
+        return _server.arg("async") != "0";
+    }
+    if (_server.header("Prefer").indexOf("respond-async") >= 0) {
+        return true;
+    }
+    return GATE_COMMANDS_ASYNC_BY_DEFAULT;
+}
+
+void WebServerHandler::enqueueGateCommand(OperationState action, int gate, bool replyWhenDone) {
+    String token = "";
+    if (_authConfig && _authConfig->isAuthEnabled()) {
+        if (!_authMiddleware) {
+            Serial.println("Auth middleware not initialized");
+            _server.send(500, "application/json", "{\"error\":\"Internal server error\"}");
+            return;
+        }
+        
+        // Repeat offenders are turned away before their token costs anything
+        unsigned long retryAfter;
+        ClientThrottle::Verdict verdict = _authMiddleware->checkClient(_server.clientIP(), retryAfter);
+        if (verdict != ClientThrottle::CLIENT_ALLOWED) {
+            _authMiddleware->sendThrottledResponse(&_server, verdict, retryAfter);
+            return;
+        }
+        
+        // No network needed to reject a request without a bearer token
+        token = _authMiddleware->extractBearerToken(&_server);
+        if (token.isEmpty()) {
+            ValidationResult result = ValidationResult::rejected("Missing or malformed Authorization header");
+            logGateAction(actionName(action), gate, false, result, "");
+            _authMiddleware->recordClientFailure(_server.clientIP());
+            _authMiddleware->sendUnauthorizedResponse(&_server, result.error);
+            return;
+        }
+    }
+    
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    GateCommand* command = _commands.create(action, millis(), gate);
+    if (!command) {
+        xSemaphoreGive(_commandsMutex);
+        Serial.println("[Gate][Warning] Command table full, rejecting " + String(actionName(action)));
+        _server.sendHeader("Retry-After", "1");
+        _server.send(503, "application/json", "{\"error\":\"Too many pending operations\"}");
+        return;
+    }
+    command->token = token;
+    command->clientIP = _server.clientIP();
+    if (replyWhenDone) {
+        command->replyTo = _server.deferResponse();
+    }
+    const uint32_t id = command->id;
+    JsonWriter json = jsonWriter();
+    if (!replyWhenDone) {
+        writeOperationJson(json, *command);
+    }
+    xSemaphoreGive(_commandsMutex);
+    
+    AuthJob job = {AUTH_JOB_COMMAND, id};
+    xQueueSend(_commandQueue, &job, 0);
+    
+    if (!replyWhenDone) {
+        char location[40];
+        snprintf(location, sizeof(location), "/gate/operations/%lu", static_cast<unsigned long>(id));
+        _server.sendHeader("Location", location);
+        sendJson(202, json);
+    }
+}
+
+bool WebServerHandler::submitGateRequest(OperationState action, int gate, uint32_t commandId) {
+    // The relay and the monitor belong to the gate control task
+    GateRequest request = {commandId, static_cast<uint8_t>(gate), action};
+    if (!_gateControl->submit(request)) {
+        Serial.println("[Gate][Warning] Gate control queue full, " + String(actionName(action)) + " rejected");
+        return false;
+    }
+    return true;
+}
+
+void WebServerHandler::handleGateEvent(const GateEvent& event) {
+    if (event.result == GATE_REQUEST_RELAY_BUSY) {
+        Serial.println("[Gate][Warning] Relay pulse already scheduled, " + String(actionName(event.action)) + " ignored");
+    }
+    
+    unsigned long now = millis();
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    GateCommand* command = _commands.find(event.commandId);
+    if (command) {
+        switch (event.result) {
+            case GATE_REQUEST_STARTED:
+                _commands.setStatus(*command, COMMAND_IN_PROGRESS, now);
+                break;
+            case GATE_REQUEST_ALREADY_DONE:
+                _commands.setStatus(*command, COMMAND_COMPLETED, now);
+                break;
+            case GATE_REQUEST_RELAY_BUSY:
+                _commands.fail(*command, COMMAND_FAILED, "Relay busy", now);
+                break;
+        }
+        
+        // Synchronous request: a refused pulse is an error, otherwise the snapshot now includes the operation
+        if (command->replyTo && event.result == GATE_REQUEST_RELAY_BUSY) {
+            static const char busy[] = "{\"error\":\"Relay busy\"}";
+            _server.sendDeferred(command->replyTo, 503, "application/json", busy, sizeof(busy) - 1,
+                                 "Retry-After: 1\r\n");
+            command->replyTo = 0;
+        } else if (command->replyTo) {
+            JsonWriter json = jsonWriter();
+            writeStatusJson(json, nullptr, command->gate, _gateControl->getSnapshot());
+            _server.sendDeferred(command->replyTo, 200, "application/json", json.c_str(), json.length());
+            command->replyTo = 0;
+        }
+    }
+    xSemaphoreGive(_commandsMutex);
+}
+
+void WebServerHandler::authorizeCommand(uint32_t id) {
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    GateCommand* command = _commands.find(id);
+    if (!command || command->status != COMMAND_QUEUED) {
+        xSemaphoreGive(_commandsMutex);
+        return;
+    }
+    String token = command->token;
+    String clientIP = command->clientIP;
+    const int gate = command->gate;
+    const OperationState action = command->action;
+    _commands.setStatus(*command, COMMAND_AUTHENTICATING, millis());
+    xSemaphoreGive(_commandsMutex);
+    
+    // May block on Keycloak: this is the whole point of running here
+    ValidationResult result = ValidationResult::valid();
+    bool allowed = true;
+    if (_authMiddleware) {
+        result = _authMiddleware->authenticateToken(token, clientIP);
+        allowed = result.isValid && _authMiddleware->authorize(result, gate, action);
+    }
     
-    // Log l'action (autorisée ou non)
-    logGateAction("close", authenticated);
+    // Unfinished commands are never recycled, the slot is still ours
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    if (result.isValid) {
+        command->userId = result.userId;
+        command->username = result.username;
+    }
+    if (result.isValid && allowed) {
+        _commands.setStatus(*command, COMMAND_AUTHORIZED, millis());
+    } else if (result.isValid) {
+        _commands.fail(*command, COMMAND_FORBIDDEN, "Not allowed by the access policy", millis());
+    } else {
+        // Keycloak down or too slow: the token was not rejected, it could not be checked
+        _commands.fail(*command, result.unavailable ? COMMAND_FAILED : COMMAND_REJECTED, result.error.c_str(), millis());
+    }
+    command->pendingDispatch = true;
+    xSemaphoreGive(_commandsMutex);
     
-    if (!authenticated) {
+    // Dispatch from the main loop now rather than at its next deadline
+    _scheduler->wake();
+}
+
+void WebServerHandler::handleSessionExchange() {
+    if (!_authConfig || !_authConfig->isAuthEnabled() || !_authMiddleware) {
+        _server.send(404, "application/json", "{\"error\":\"Authentication is disabled\"}");
         return;
     }
     
-    GateState currentState = _gateController->readState();
+    unsigned long retryAfter;
+    ClientThrottle::Verdict verdict = _authMiddleware->checkClient(_server.clientIP(), retryAfter);
+    if (verdict != ClientThrottle::CLIENT_ALLOWED) {
+        _authMiddleware->sendThrottledResponse(&_server, verdict, retryAfter);
+        return;
+    }
     
-    if (currentState != CLOSED) {
-        _gateController->triggerRelay();
-        _gateMonitor->startOperation(CLOSING, CLOSED);
+    // A session is only ever opened with a Keycloak token: no endless renewal
+    String token = _authMiddleware->extractBearerToken(&_server);
+    if (token.isEmpty() || SessionTokens::isSessionToken(token)) {
+        _authMiddleware->recordClientFailure(_server.clientIP());
+        _authMiddleware->sendUnauthorizedResponse(&_server, "Keycloak bearer token required");
+        return;
     }
     
-    // Return current status in JSON format
-    handleGateStatus();
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    int index = -1;
+    for (int i = 0; i < AUTH_SESSION_SLOTS; i++) {
+        if (!_sessionExchanges[i].replyTo) {
+            index = i;
+            break;
+        }
+    }
+    HttpResponseHandle replyTo = index >= 0 ? _server.deferResponse() : 0;
+    if (replyTo) {
+        SessionExchange& exchange = _sessionExchanges[index];
+        exchange.replyTo = replyTo;
+        exchange.token = token;
+        exchange.clientIP = _server.clientIP();
+        exchange.done = false;
+    }
+    xSemaphoreGive(_commandsMutex);
+    
+    if (!replyTo) {
+        _server.sendHeader("Retry-After", "1");
+        _server.send(503, "application/json", "{\"error\":\"Too many pending session requests\"}");
+        return;
+    }
+    AuthJob job = {AUTH_JOB_SESSION, static_cast<uint32_t>(index)};
+    xQueueSend(_commandQueue, &job, 0);
 }
 
-void WebServerHandler::handleGateStatus() {
-    String json = buildStatusJson();
-    _server.send(200, "application/json", json);
+void WebServerHandler::authorizeSessionExchange(uint32_t index) {
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    String token = _sessionExchanges[index].token;
+    String clientIP = _sessionExchanges[index].clientIP;
+    _sessionExchanges[index].token = "";
+    xSemaphoreGive(_commandsMutex);
+    
+    ValidationResult result = _authMiddleware->authenticateToken(token, clientIP);
+    
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    _sessionExchanges[index].result = result;
+    _sessionExchanges[index].done = true;
+    xSemaphoreGive(_commandsMutex);
+    
+    _scheduler->wake();
 }
 
-String WebServerHandler::buildStatusJson() {
-    bool sensorClosed = _gateController->isClosedSensorActive();
-    bool sensorOpen = _gateController->isOpenSensorActive();
-    GateState state = _gateController->readState();
-    OperationState currentOperation = _gateMonitor->getCurrentOperation();
+void WebServerHandler::replySessionExchanges() {
+    for (int i = 0; i < AUTH_SESSION_SLOTS; i++) {
+        xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+        SessionExchange& exchange = _sessionExchanges[i];
+        if (!exchange.replyTo || !exchange.done) {
+            xSemaphoreGive(_commandsMutex);
+            continue;
+        }
+        HttpResponseHandle replyTo = exchange.replyTo;
+        ValidationResult result = exchange.result;
+        exchange.replyTo = 0;
+        exchange.done = false;
+        exchange.result = ValidationResult();
+        xSemaphoreGive(_commandsMutex);
+        
+        JsonWriter json = jsonWriter();
+        String session;
+        unsigned long lifetime;
+        if (result.isValid && _authMiddleware->issueSessionToken(result, session, lifetime)) {
+            json.beginObject();
+            json.field("access_token", session);
+            json.field("token_type", "Bearer");
+            json.field("expires_in", lifetime / 1000);
+            json.field("username", result.username);
+            json.endObject();
+            _server.sendDeferred(replyTo, 200, "application/json", json.c_str(), json.length(),
+                                 "Cache-Control: no-store\r\n");
+        } else if (result.unavailable) {
+            AuthMiddleware::writeUnavailableJson(json, result.error);
+            _server.sendDeferred(replyTo, 503, "application/json", json.c_str(), json.length());
+        } else {
+            AuthMiddleware::writeUnauthorizedJson(json, result.isValid ? "No session for this token (about to expire or identity too long)" : result.error);
+            _server.sendDeferred(replyTo, 401, "application/json", json.c_str(), json.length());
+        }
+    }
+}
+
+void WebServerHandler::handleGuestOpen() {
+    if (!_guestCodes) {
+        _server.send(404, "application/json", "{\"error\":\"Guest codes are disabled\"}");
+        return;
+    }
+    
+    // Six digits: guessing is slowed down harder than a bearer token (GUEST_* limits)
+    String clientIP = _server.clientIP();
+    unsigned long retryAfter;
+    ClientThrottle::Verdict verdict = _guestThrottle.check(clientIP.c_str(), millis(), retryAfter);
+    if (verdict != ClientThrottle::CLIENT_ALLOWED) {
+        AuthMiddleware::sendThrottledResponse(&_server, verdict, retryAfter);
+        return;
+    }
     
-    String json = "{";
-    json += "\"status\":\"";
+    int gate = 0;
+    if (_server.hasArg("gate")) {
+        gate = resolveGate(_server.arg("gate"));
+        if (gate < 0) {
+            return;
+        }
+    }
     
-    // Priority: ongoing operations override physical state
-    if (currentOperation == OPENING) {
-        json += "opening";
-    } else if (currentOperation == CLOSING) {
-        json += "closing";
-    } else {
-        // No operation, return physical state
-        switch(state) {
-            case CLOSED: json += "closed"; break;
-            case OPEN: json += "open"; break;
-            case UNKNOWN: json += "unknown"; break;
+    int64_t now = time(nullptr);
+    if (now < CLOCK_SYNCED_MIN_EPOCH) {
+        _server.sendHeader("Retry-After", "5");
+        _server.send(503, "application/json", "{\"error\":\"Device clock not synchronized\"}");
+        return;
+    }
+    
+    // Cached codes: no HMAC on this path unless the time step just changed
+    int index;
+    GuestCodes::Result result = _guestCodes->verify(_server.arg("code").c_str(), now, index);
+    if (result != GuestCodes::GUEST_ACCEPTED) {
+        const char* error = GuestCodes::describe(result);
+        Serial.println("[Guest][Warning] Code refused for " + clientIP + ": " + error);
+        ValidationResult refusal = ValidationResult::rejected(error);
+        if (index >= 0) {
+            refusal.userId = "guest:" + String(_guestCodes->guest(index).label);
+            refusal.username = _guestCodes->guest(index).label;
+        }
+        logGateAction(actionName(OPENING), gate, false, refusal, "");
+        _guestThrottle.recordFailure(clientIP.c_str(), millis());
+        
+        JsonWriter json = jsonWriter();
+        AuthMiddleware::writeUnauthorizedJson(json, error);
+        sendJson(401, json);
+        return;
+    }
+    _guestThrottle.recordSuccess(clientIP.c_str());
+    const char* label = _guestCodes->guest(index).label;
+    Serial.println("[Guest] Code accepted for " + String(label) + " (" + GATES[gate].id + ")");
+    
+    // Same pipeline as a bearer-authorized HTTP command, without the auth worker
+    bool replyWhenDone = !wantsAsyncCommand();
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    GateCommand* command = _commands.create(OPENING, millis(), gate);
+    if (!command) {
+        xSemaphoreGive(_commandsMutex);
+        _server.sendHeader("Retry-After", "1");
+        _server.send(503, "application/json", "{\"error\":\"Too many pending operations\"}");
+        return;
+    }
+    command->userId = "guest:" + String(label);
+    command->username = label;
+    command->clientIP = clientIP;
+    _commands.setStatus(*command, COMMAND_AUTHORIZED, millis());
+    command->pendingDispatch = true;
+    if (replyWhenDone) {
+        command->replyTo = _server.deferResponse();
+    }
+    const uint32_t id = command->id;
+    JsonWriter json = jsonWriter();
+    if (!replyWhenDone) {
+        writeOperationJson(json, *command);
+    }
+    xSemaphoreGive(_commandsMutex);
+    
+    if (!replyWhenDone) {
+        char location[40];
+        snprintf(location, sizeof(location), "/gate/operations/%lu", static_cast<unsigned long>(id));
+        _server.sendHeader("Location", location);
+        sendJson(202, json);
+    }
+    _scheduler->wake();
+}
+
+void WebServerHandler::processCommands() {
+    for (int i = 0; i < _commands.capacity(); i++) {
+        xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+        GateCommand* command = _commands.slot(i);
+        if (!command || !command->pendingDispatch) {
+            xSemaphoreGive(_commandsMutex);
+            continue;
+        }
+        const uint32_t id = command->id;
+        const OperationState action = command->action;
+        const int gate = command->gate;
+        const bool authorized = command->status == COMMAND_AUTHORIZED;
+        const bool unavailable = command->status == COMMAND_FAILED;
+        const bool forbidden = command->status == COMMAND_FORBIDDEN;
+        ValidationResult result;
+        result.isValid = authorized;
+        result.error = command->error;
+        result.userId = command->userId;
+        result.username = command->username;
+        String token = authorized ? "" : command->token;
+        HttpResponseHandle replyTo = command->replyTo;
+        command->token = "";
+        command->pendingDispatch = false;
+        if (!authorized) {
+            command->replyTo = 0;
+        }
+        xSemaphoreGive(_commandsMutex);
+        
+        // EMQX and the relay are only driven from the main loop
+        logGateAction(actionName(action), gate, authorized, result, token);
+        if (!authorized) {
+            if (replyTo && unavailable) {
+                JsonWriter json = jsonWriter();
+                AuthMiddleware::writeUnavailableJson(json, result.error);
+                char retryAfter[32];
+                snprintf(retryAfter, sizeof(retryAfter), "Retry-After: %lu\r\n", KEYCLOAK_BREAKER_OPEN_TIME / 1000);
+                _server.sendDeferred(replyTo, 503, "application/json", json.c_str(), json.length(), retryAfter);
+            } else if (replyTo && forbidden) {
+                JsonWriter json = jsonWriter();
+                AuthMiddleware::writeForbiddenJson(json, result.error);
+                _server.sendDeferred(replyTo, 403, "application/json", json.c_str(), json.length());
+            } else if (replyTo) {
+                JsonWriter json = jsonWriter();
+                AuthMiddleware::writeUnauthorizedJson(json, result.error);
+                _server.sendDeferred(replyTo, 401, "application/json", json.c_str(), json.length());
+            }
+            continue;
+        }
+        
+        if (!submitGateRequest(action, gate, id)) {
+            xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+            command = _commands.find(id);
+            if (command) {
+                _commands.fail(*command, COMMAND_FAILED, "Gate control busy", millis());
+                command->replyTo = 0;
+            }
+            xSemaphoreGive(_commandsMutex);
+            if (replyTo) {
+                static const char busy[] = "{\"error\":\"Gate control busy\"}";
+                _server.sendDeferred(replyTo, 503, "application/json", busy, sizeof(busy) - 1);
+            }
         }
     }
     
-    json += "\",";
-    json += "\"sensor_closed\":" + String(sensorClosed ? "true" : "false") + ",";
-    json += "\"sensor_open\":" + String(sensorOpen ? "true" : "false") + ",";
+    // Actuation results from the gate control task
+    GateEvent event;
+    while (_gateControl->pollEvent(event)) {
+        handleGateEvent(event);
+    }
+    
+    updateCommands();
+    replyMqttCommands();
+    replySessionExchanges();
+}
+
+void WebServerHandler::updateCommands() {
+    GateSnapshot snapshot = _gateControl->getSnapshot();
+    unsigned long now = millis();
     
-    if (_gateMonitor->isOperationInProgress()) {
-        json += "\"operation_time\":" + String(_gateMonitor->getOperationElapsedTime()) + ",";
-        json += "\"timeout_remaining\":" + String(_gateMonitor->getOperationRemainingTime()) + ",";
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    for (int i = 0; i < _commands.capacity(); i++) {
+        GateCommand* command = _commands.slot(i);
+        if (!command || command->status != COMMAND_IN_PROGRESS) {
+            continue;
+        }
+        
+        const GateStatus& status = snapshot.gates[command->gate];
+        OperationState currentOperation = status.operation;
+        GateState state = status.state;
+        bool alert = status.alertActive;
+        
+        // Follow the GateMonitor operation started for this command
+        if (currentOperation == IDLE) {
+            if (state == command->expectedState) {
+                _commands.setStatus(*command, COMMAND_COMPLETED, now);
+            } else {
+                _commands.fail(*command, COMMAND_FAILED, "Operation ended in an unexpected state", now);
+            }
+        } else if (currentOperation != command->action) {
+            _commands.fail(*command, COMMAND_FAILED, "Superseded by another operation", now);
+        } else if (alert) {
+            _commands.fail(*command, COMMAND_FAILED, "Timeout: gate did not reach the expected state", now);
+        }
+    }
+    xSemaphoreGive(_commandsMutex);
+}
+
+void WebServerHandler::replyMqttCommands() {
+    for (int i = 0; i < _commands.capacity(); i++) {
+        xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+        GateCommand* command = _commands.slot(i);
+        // Progress worth telling the backend: started, then the outcome
+        if (!command || command->mqttNonce[0] == '\0' || command->status == command->repliedStatus ||
+            command->status == COMMAND_QUEUED || command->status == COMMAND_AUTHENTICATING ||
+            command->status == COMMAND_AUTHORIZED) {
+            xSemaphoreGive(_commandsMutex);
+            continue;
+        }
+        GateCommand snapshot = *command;
+        command->repliedStatus = command->status;
+        if (GateCommandQueue::isFinished(command->status)) {
+            command->mqttNonce[0] = '\0';
+        }
+        xSemaphoreGive(_commandsMutex);
+        
+        sendCommandReply(snapshot.mqttNonce, &snapshot, GateCommandQueue::statusName(snapshot.status), snapshot.error);
+    }
+}
+
+void WebServerHandler::publishGateChanges() {
+    // The gate task wakes this loop whenever a version changes
+    GateSnapshot snapshot = _gateControl->getSnapshot();
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        uint32_t version = snapshot.gates[gate].version;
+        if (version != _publishedVersion[gate]) {
+            _publishedVersion[gate] = version;
+            JsonWriter json = jsonWriter();
+            writeStatusJson(json, nullptr, gate, snapshot);
+            _eventStream.publish(json.c_str(), json.length());
+        }
     }
     
-    json += "\"alert_active\":" + String(_gateMonitor->isAlertActive() ? "true" : "false") + ",";
-    json += "\"auto_close_enabled\":" + String(_gateMonitor->isAutoCloseEnabled() ? "true" : "false");
+    unsigned long now = millis();
+    for (int i = 0; i < STATUS_MAX_WAITERS; i++) {
+        StatusWaiter& waiter = _statusWaiters[i];
+        if (!waiter.response) {
+            continue;
+        }
+        uint32_t version = snapshot.gates[waiter.gate].version;
+        if (version == waiter.since && now - waiter.parkedAt < STATUS_LONG_POLL_TIMEOUT) {
+            continue;
+        }
+        // Unchanged after the timeout: same answer as a plain GET, the client polls again
+        char etag[32];
+        char headers[80];
+        formatStatusETag(etag, sizeof(etag), version);
+        snprintf(headers, sizeof(headers), "ETag: %s\r\nCache-Control: no-cache\r\n", etag);
+        JsonWriter json = jsonWriter();
+        writeStatusJson(json, nullptr, waiter.gate, snapshot);
+        _server.sendDeferred(waiter.response, 200, "application/json", json.c_str(), json.length(), headers);
+        waiter.response = 0;
+    }
+}
+
+void WebServerHandler::publishMqttState() {
+    if (!_emqxLogger || !_emqxLogger->isConnected()) {
+        return; // Resynchronized by the snapshot of the next connection
+    }
+    GateSnapshot snapshot = _gateControl->getSnapshot();
     
-    if (_gateMonitor->isAutoCloseEnabled() && state == OPEN && currentOperation == IDLE) {
-        json += ",\"auto_close_remaining\":" + String(_gateMonitor->getAutoCloseRemainingTime());
+    // New session (or the will replaced the retained state): start over from a full snapshot
+    if (_emqxLogger->getConnectionCount() != _stateConnection) {
+        if (publishStateSnapshot(snapshot)) {
+            _stateConnection = _emqxLogger->getConnectionCount();
+        }
+        return;
     }
     
-    json += "}";
+    // Live subscribers get only what changed, not retained
+    unsigned long now = millis();
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        if (snapshot.gates[gate].version == _stateGates[gate].version) {
+            continue;
+        }
+        JsonWriter json = jsonWriter();
+        json.beginObject();
+        writeStateFields(json, gate, snapshot, &_stateGates[gate]);
+        json.endObject();
+        if (json.overflowed() || !_emqxLogger->publishState(json.c_str(), json.length(), false)) {
+            return; // Retried on the next loop
+        }
+        _stateGates[gate] = snapshot.gates[gate];
+        _stateSnapshotPending = true;
+        _stateChangedAt = now;
+    }
     
-    return json;
+    // Once things settle, the retained message catches up for future subscribers
+    if (_stateSnapshotPending && now - _stateChangedAt >= MQTT_STATE_SNAPSHOT_DELAY) {
+        publishStateSnapshot(snapshot);
+    }
+}
+
+bool WebServerHandler::publishStateSnapshot(const GateSnapshot& snapshot) {
+    JsonWriter json = jsonWriter();
+    json.beginObject();
+    json.field("online", true);
+    json.field("snapshot", true);
+    json.beginArray("gates");
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        json.beginObject();
+        writeStateFields(json, gate, snapshot, nullptr);
+        json.endObject();
+    }
+    json.endArray().endObject();
+    if (json.overflowed() || !_emqxLogger->publishState(json.c_str(), json.length(), true)) {
+        return false;
+    }
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        _stateGates[gate] = snapshot.gates[gate];
+    }
+    _stateSnapshotPending = false;
+    return true;
+}
+
+void WebServerHandler::writeStateFields(JsonWriter& json, int gate, const GateSnapshot& gates,
+                                        const GateStatus* previous) {
+    const GateStatus& current = gates.gates[gate];
+    json.field("gate_id", GATES[gate].id);
+    json.field("version", current.version);
+    
+    // previous nullptr: every field
+    const char* status = gateStatusName(current);
+    if (!previous || strcmp(status, gateStatusName(*previous)) != 0) {
+        json.field("status", status);
+    }
+    if (!previous || current.sensorClosed != previous->sensorClosed) {
+        json.field("sensor_closed", current.sensorClosed);
+    }
+    if (!previous || current.sensorOpen != previous->sensorOpen) {
+        json.field("sensor_open", current.sensorOpen);
+    }
+    if (!previous || current.alertActive != previous->alertActive) {
+        json.field("alert_active", current.alertActive);
+    }
+    if (!previous || current.autoCloseEnabled != previous->autoCloseEnabled) {
+        json.field("auto_close_enabled", current.autoCloseEnabled);
+    }
+    
+    // Countdowns as of now; subscribers run them down locally
+    unsigned long age = millis() - gates.publishedAt;
+    if (current.operation != IDLE) {
+        json.field("timeout_remaining", current.timeoutRemaining > age ? current.timeoutRemaining - age : 0);
+    } else if (current.autoCloseEnabled && current.state == OPEN) {
+        json.field("auto_close_remaining", current.autoCloseRemaining > age ? current.autoCloseRemaining - age : 0);
+    }
+}
+
+void WebServerHandler::handleGateEvents() {
+    HttpResponseHandle subscriber = _eventStream.subscribe();
+    if (!subscriber) {
+        return; // 503 already sent
+    }
+    
+    // EventSource sends Last-Event-ID when reconnecting, polyfills often use the query string
+    String lastEventId = _server.header("Last-Event-ID");
+    if (lastEventId.isEmpty()) {
+        lastEventId = _server.arg("lastEventId");
+    }
+    if (!lastEventId.isEmpty() && _eventStream.replay(subscriber, strtoul(lastEventId.c_str(), nullptr, 10))) {
+        return;
+    }
+    
+    // New subscriber (or too far behind): current state of every gate
+    GateSnapshot snapshot = _gateControl->getSnapshot();
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        JsonWriter json = jsonWriter();
+        writeStatusJson(json, nullptr, gate, snapshot);
+        _eventStream.sendState(subscriber, json.c_str(), json.length());
+    }
+}
+
+void WebServerHandler::commandWorkerEntry(void* arg) {
+    WebServerHandler* handler = static_cast<WebServerHandler*>(arg);
+    AuthJob job;
+    for (;;) {
+        if (xQueueReceive(handler->_commandQueue, &job, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        if (job.kind == AUTH_JOB_SESSION) {
+            handler->authorizeSessionExchange(job.id);
+        } else {
+            handler->authorizeCommand(job.id);
+        }
+    }
+}
+
+void WebServerHandler::handleOperationStatus() {
+    uint32_t id = strtoul(_server.pathArg(0).c_str(), nullptr, 10);
+    
+    JsonWriter json = jsonWriter();
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    GateCommand* command = _commands.find(id);
+    if (command) {
+        writeOperationJson(json, *command);
+    }
+    xSemaphoreGive(_commandsMutex);
+    
+    if (!command) {
+        _server.send(404, "application/json", "{\"error\":\"Unknown operation\"}");
+        return;
+    }
+    sendJson(200, json);
+}
+
+static void writeSchedulerStats(JsonWriter& json, const char* key, const LoopScheduler::Stats& stats) {
+    json.beginObject(key);
+    json.field("wakeups_per_second", stats.wakeupsPerSecond);
+    json.field("idle_percent", stats.idlePercent);
+    json.field("max_busy_ms", stats.maxBusyTime);
+    json.field("wakeups", stats.wakeups);
+    json.field("notified_wakeups", stats.notifiedWakeups);
+    json.endObject();
+}
+
+void WebServerHandler::handleSystemStats() {
+    JsonWriter json = jsonWriter();
+    json.beginObject();
+    json.field("uptime", millis());
+    json.field("free_heap", ESP.getFreeHeap());
+    json.beginObject("loops");
+    writeSchedulerStats(json, "network", _scheduler->getStats());
+    writeSchedulerStats(json, "gate", _gateControl->getSchedulerStats());
+    json.endObject();
+    
+    const AsyncHttpServer::Stats& http = _server.getStats();
+    json.beginObject("http");
+    json.field("connections", _server.activeConnections());
+    json.field("accepted", http.accepted);
+    json.field("rejected", http.rejected);
+    json.field("requests", http.requests);
+    json.field("reused", http.reused);
+    json.field("pipelined", http.pipelined);
+    json.field("errors", http.errors);
+    json.field("stalled", http.stalled);
+    json.field("event_subscribers", _eventStream.subscriberCount());
+    json.endObject();
+    
+    if (_emqxLogger) {
+        const MqttOutbox& outbox = _emqxLogger->getOutbox();
+        const MqttOutbox::Stats& mqtt = outbox.getStats();
+        json.beginObject("mqtt");
+        json.field("connected", _emqxLogger->isConnected());
+        json.field("connect_attempts", _emqxLogger->getConnectAttempts());
+        json.field("consecutive_failures", _emqxLogger->getConsecutiveFailures());
+        json.field("pending", outbox.depth());
+        json.field("pending_in_flash", outbox.spilledDepth());
+        json.field("queued", mqtt.queued);
+        json.field("sent", mqtt.sent);
+        json.field("spilled", mqtt.spilled);
+        json.field("dropped", mqtt.dropped);
+        json.field("spill_errors", mqtt.spillErrors);
+        if (_commandVerifier) {
+            json.field("commands_forged", _mqttForged);
+            json.field("commands_refused", _mqttRefused);
+        }
+        json.endObject();
+    }
+    json.endObject();
+    
+    sendJson(200, json);
+}
+
+void WebServerHandler::writeOperationJson(JsonWriter& json, const GateCommand& command) {
+    char location[40];
+    snprintf(location, sizeof(location), "/gate/operations/%lu", static_cast<unsigned long>(command.id));
+    
+    json.beginObject();
+    json.field("operation_id", command.id);
+    json.field("gate_id", GATES[command.gate].id);
+    json.field("action", actionName(command.action));
+    json.field("status", GateCommandQueue::statusName(command.status));
+    json.field("location", location);
+    json.field("age", millis() - command.createdAt);
+    if (command.error[0] != '\0') {
+        json.field("error", command.error);
+    }
+    // Gate progress (opening/closing, timeout) while the command is running
+    if (command.status == COMMAND_IN_PROGRESS) {
+        writeStatusJson(json, "gate", command.gate, _gateControl->getSnapshot());
+    }
+    json.endObject();
+}
+
+
+
+void WebServerHandler::writeStatusJson(JsonWriter& json, const char* key, int gate, const GateSnapshot& gates) {
+    const GateStatus& snapshot = gates.gates[gate];
+    GateState state = snapshot.state;
+    OperationState currentOperation = snapshot.operation;
+    StatusCache& cache = _statusCache[gate];
+    
+    // Everything but the countdowns only changes with the version (or a raw sensor level)
+    if (!cache.valid || cache.version != snapshot.version ||
+        cache.sensorClosed != snapshot.sensorClosed || cache.sensorOpen != snapshot.sensorOpen) {
+        // Left open: the countdowns are appended on every request
+        JsonWriter cached(cache.json, sizeof(cache.json));
+        cached.beginObject();
+        cached.field("gate_id", GATES[gate].id);
+        cached.field("version", snapshot.version);
+        cached.field("status", gateStatusName(snapshot));
+        cached.field("sensor_closed", snapshot.sensorClosed);
+        cached.field("sensor_open", snapshot.sensorOpen);
+        cached.field("alert_active", snapshot.alertActive);
+        cached.field("auto_close_enabled", snapshot.autoCloseEnabled);
+        
+        cache.length = cached.length();
+        cache.version = snapshot.version;
+        cache.sensorClosed = snapshot.sensorClosed;
+        cache.sensorOpen = snapshot.sensorOpen;
+        cache.valid = !cached.overflowed();
+    }
+    
+    // Timers keep running between two snapshots
+    unsigned long age = millis() - gates.publishedAt;
+    
+    json.resumeObject(key, cache.json, cache.length);
+    
+    if (currentOperation != IDLE) {
+        unsigned long remaining = snapshot.timeoutRemaining > age ? snapshot.timeoutRemaining - age : 0;
+        json.field("operation_time", snapshot.operationElapsed + age);
+        json.field("timeout_remaining", remaining);
+    }
+    
+    if (snapshot.autoCloseEnabled && state == OPEN && currentOperation == IDLE) {
+        unsigned long remaining = snapshot.autoCloseRemaining > age ? snapshot.autoCloseRemaining - age : 0;
+        json.field("auto_close_remaining", remaining);
+    }
+    
+    json.endObject();
+}
+
+JsonWriter WebServerHandler::jsonWriter() {
+    return JsonWriter(_jsonBuffer, sizeof(_jsonBuffer));
+}
+
+void WebServerHandler::sendJson(int code, const JsonWriter& json) {
+    if (json.overflowed()) {
+        Serial.println("[HTTP][Error] JSON response larger than HTTP_JSON_BUFFER_SIZE");
+        _server.send(500, "application/json", "{\"error\":\"Response too large\"}");
+        return;
+    }
+    _server.send(code, "application/json", json.c_str(), json.length());
 }
 
 void WebServerHandler::initializeAuth() {
@@ -160,29 +1234,18 @@ void WebServerHandler::initializeAuth() {
     
     if (_authConfig->isAuthEnabled()) {
         _authMiddleware = new AuthMiddleware(_authConfig);
+        _authMiddleware->begin();
         Serial.println("Authentication middleware initialized");
     } else {
         Serial.println("Authentication is disabled");
     }
-}
-
-bool WebServerHandler::requireAuthentication() {
-    if (!_authConfig || !_authConfig->isAuthEnabled()) {
-        return true; // Pas d'auth requise
-    }
     
-    if (!_authMiddleware) {
-        Serial.println("Auth middleware not initialized");
-        _server.send(500, "application/json", "{\"error\":\"Internal server error\"}");
-        return false;
+    if (!_authConfig->getGuestCodes().isEmpty()) {
+        _guestCodes = new GuestCodes();
+        int count = _guestCodes->load(_authConfig->getGuestCodes().c_str());
+        _guestCodes->loadUsage();
+        Serial.println("Guest codes enabled: " + String(count) + " guests");
     }
-    
-    if (!_authMiddleware->authenticateRequest(&_server)) {
-        _authMiddleware->sendUnauthorizedResponse(&_server);
-        return false;
-    }
-    
-    return true;
 }
 
 void WebServerHandler::initializeEmqx() {
@@ -199,44 +1262,117 @@ void WebServerHandler::initializeEmqx() {
             _emqxConfig->getTopic(),
             _emqxConfig->getUnauthorizedTopic()
         );
+        _emqxLogger->setPublishFormat(_emqxConfig->getEncoding(), _emqxConfig->getUnauthorizedEncoding(),
+                                      _emqxConfig->getBatchWindow());
+        _emqxLogger->setStateTopic(_emqxConfig->getStateTopic());
+        
+        // Gate commands over the broker connection, verified here without Keycloak
+        if (_emqxConfig->isCommandChannelEnabled()) {
+            _commandVerifier = new MqttCommandVerifier(_emqxConfig->getCommandSecret(), _emqxConfig->getClientId());
+            _emqxLogger->setCommandChannel(_emqxConfig->getCommandTopic(), _emqxConfig->getCommandReplyTopic(),
+                                           [this](const uint8_t* payload, unsigned int length) {
+                                               handleMqttCommand(payload, length);
+                                           });
+        }
         
         if (_emqxLogger->begin()) {
-            Serial.println("EMQX logger initialized and connected");
+            Serial.println("EMQX logger initialized, connecting in the background");
         } else {
-            Serial.println("EMQX logger initialized but connection failed");
+            Serial.println("EMQX logger initialized, broker unreachable for now (retrying with backoff)");
         }
     } else {
         Serial.println("EMQX logging is disabled");
     }
 }
 
-void WebServerHandler::logGateAction(const String& action, bool authorized) {
-    if (!_emqxLogger || !_emqxConfig || !_emqxConfig->isEmqxEnabled()) {
-        return; // EMQX non configuré
+void WebServerHandler::handleMqttCommand(const uint8_t* payload, unsigned int length) {
+    MqttCommand request;
+    const char* error = "";
+    if (!_commandVerifier->verify(payload, length, request, error)) {
+        refuseMqttCommand(request, error);
+        return;
     }
     
-    String sub = "";
-    String name = "";
-    String token = "";
+    xSemaphoreTake(_commandsMutex, portMAX_DELAY);
+    GateCommand* command = _commands.create(request.action, millis(), request.gate);
+    if (!command) {
+        xSemaphoreGive(_commandsMutex);
+        sendCommandReply(request.nonce, nullptr, "rejected", "Too many pending operations");
+        return;
+    }
+    // The signature stands for the bearer token: dispatched like an HTTP command leaving the auth worker
+    command->userId = "mqtt";
+    command->username = "MQTT command";
+    strcpy(command->mqttNonce, request.nonce);
+    _commands.setStatus(*command, COMMAND_AUTHORIZED, millis());
+    command->pendingDispatch = true;
+    xSemaphoreGive(_commandsMutex);
     
-    // Récupérer les informations du token si l'authentification est activée
-    if (_authMiddleware && _authConfig && _authConfig->isAuthEnabled()) {
-        ValidationResult result = _authMiddleware->getLastValidationResult();
-        sub = result.userId;
-        name = result.username;
-        
-        // Pour les actions non autorisées, récupérer le token complet
-        if (!authorized) {
-            String authHeader = _server.header("Authorization");
-            if (authHeader.startsWith("Bearer ")) {
-                token = authHeader.substring(7);
-            }
+    Serial.println("[MQTT] Gate command accepted: " + String(actionName(request.action)) + " " +
+                   GATES[request.gate].id);
+    _scheduler->wake();
+}
+
+void WebServerHandler::refuseMqttCommand(const MqttCommand& request, const char* error) {
+    unsigned long now = millis();
+    
+    // Anyone who can publish on the topic gets here: no audit entry nor reply (outbox, then flash), a count
+    if (!request.authenticated) {
+        _mqttForged++;
+        if (_mqttForged == 1 || now - _mqttForgedLoggedAt >= MQTT_COMMAND_REFUSAL_INTERVAL) {
+            _mqttForgedLoggedAt = now;
+            Serial.println("[MQTT][Warning] Unauthenticated gate command dropped: " + String(error) + " (" +
+                           String(_mqttForged) + " so far)");
         }
+        return;
+    }
+    
+    // Signed but refused (replayed capture, clock not synchronized): the sender is told, at a bounded rate
+    _mqttRefused++;
+    if (_mqttRefused > 1 && now - _mqttRefusedAt < MQTT_COMMAND_REFUSAL_INTERVAL) {
+        return;
+    }
+    _mqttRefusedAt = now;
+    Serial.println("[MQTT][Warning] Gate command refused: " + String(error));
+    ValidationResult result = ValidationResult::rejected(error);
+    logGateAction(actionName(request.action), request.gate, false, result, "");
+    sendCommandReply(request.nonce, nullptr, "rejected", error);
+}
+
+void WebServerHandler::sendCommandReply(const char* nonce, const GateCommand* command, const char* status,
+                                        const char* error) {
+    JsonWriter json = jsonWriter();
+    json.beginObject();
+    json.field("nonce", nonce);
+    if (command) {
+        json.field("operation_id", command->id);
+        json.field("gate_id", GATES[command->gate].id);
+        json.field("action", actionName(command->action));
+    }
+    json.field("status", status);
+    if (error && error[0] != '\0') {
+        json.field("error", error);
+    }
+    json.endObject();
+    if (!json.overflowed()) {
+        _emqxLogger->publishReply(json.c_str(), json.length());
+    }
+}
+
+void WebServerHandler::logGateAction(const String& action, int gate, bool authorized, const ValidationResult& result,
+                                     const String& token) {
+    if (!_emqxLogger || !_emqxConfig || !_emqxConfig->isEmqxEnabled()) {
+        return; // EMQX non configuré
     }
     
+    // Identité issue du token, de la commande MQTT ou du code invité (vide sans authentification)
+    String sub = result.userId;
+    String name = result.username;
+    
     if (authorized) {
-        _emqxLogger->logAuthorizedAction(action, sub, name);
+        _emqxLogger->logAuthorizedAction(action, GATES[gate].id, sub, name);
     } else {
-        _emqxLogger->logUnauthorizedAction(action, sub, name, token);
+        // Pour les actions non autorisées, le token complet est journalisé
+        _emqxLogger->logUnauthorizedAction(action, GATES[gate].id, sub, name, token);
     }
-}
\ No newline at end of file
+}
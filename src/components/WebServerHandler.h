@@ -1,49 +1,167 @@
 #ifndef WEB_SERVER_HANDLER_H
 #define WEB_SERVER_HANDLER_H
 
-#include <WebServer.h>
-#include "GateController.h"
-#include "GateMonitor.h"
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+#include <atomic>
+#include "AsyncHttpServer.h"
+#include "GateControlTask.h"
+#include "LoopScheduler.h"
 #include "AuthConfig.h"
 #include "AuthMiddleware.h"
 #include "EmqxConfig.h"
 #include "EmqxLogger.h"
+#include "GateCommandQueue.h"
+#include "GateEventStream.h"
+#include "GuestCodes.h"
+#include "JsonWriter.h"
+#include "MqttCommandVerifier.h"
 
 class WebServerHandler {
 public:
-    WebServerHandler(GateController* gateController, GateMonitor* gateMonitor);
+    WebServerHandler(GateControlTask* gateControl, LoopScheduler* scheduler);
     ~WebServerHandler();
     void begin();
     void handleClient();
+    
+    // Wi-Fi (re)connected: warm up outbound connections. Called from the Wi-Fi event task,
+    // the work is done by the next handleClient()
+    void onNetworkUp();
+    
+    // ms before handleClient() is needed again (HTTP timeouts, MQTT, gate commands)
+    unsigned long getNextDeadline(unsigned long now);
 
 private:
-    WebServer _server;
-    GateController* _gateController;
-    GateMonitor* _gateMonitor;
+    AsyncHttpServer _server;
+    GateEventStream _eventStream;       // /gate/events subscribers
+    uint32_t _publishedVersion[GATE_COUNT];
+    uint32_t _bootId;                   // Keeps ETags from matching across reboots
+    char _jsonBuffer[HTTP_JSON_BUFFER_SIZE]; // Response being serialized (network task only)
+    
+    // Serialized status per gate, rebuilt when the version (or a raw sensor level) changes
+    struct StatusCache {
+        bool valid;
+        uint32_t version;
+        bool sensorClosed;
+        bool sensorOpen;
+        size_t length;
+        char json[STATUS_JSON_CACHE_SIZE]; // Without the countdowns and the closing brace
+    };
+    StatusCache _statusCache[GATE_COUNT];
+    
+    // Parked ?since= requests
+    struct StatusWaiter {
+        HttpResponseHandle response;    // 0: free slot
+        uint8_t gate;
+        uint32_t since;
+        unsigned long parkedAt;
+    };
+    StatusWaiter _statusWaiters[STATUS_MAX_WAITERS];
+    
+    // MQTT state topic: fields last published per gate
+    GateStatus _stateGates[GATE_COUNT];
+    uint32_t _stateConnection;          // EmqxLogger connection that got the last full snapshot
+    bool _stateSnapshotPending;         // Deltas sent since the retained snapshot
+    unsigned long _stateChangedAt;
+    
+    std::atomic<bool> _networkUpPending; // Set by the Wi-Fi event task, handled on the network task
+    
+    GateControlTask* _gateControl;
+    LoopScheduler* _scheduler;          // Network loop, woken by the async command worker
     AuthConfig* _authConfig;
     AuthMiddleware* _authMiddleware;
     EmqxConfig* _emqxConfig;
     EmqxLogger* _emqxLogger;
+    MqttCommandVerifier* _commandVerifier; // nullptr: MQTT command channel disabled
+    uint32_t _mqttForged;               // Unsigned or forged commands dropped without a trace
+    unsigned long _mqttForgedLoggedAt;
+    uint32_t _mqttRefused;              // Signed commands refused (replay, clock), answered at a bounded rate
+    unsigned long _mqttRefusedAt;       // Last refusal audited and answered
+    GuestCodes* _guestCodes;            // nullptr: guest codes disabled
+    ClientThrottle _guestThrottle;      // Code guessing (GUEST_* limits), network task only
+    
+    // Gate commands: auth runs on a worker task, actuation in the main loop
+    GateCommandQueue _commands;
+    SemaphoreHandle_t _commandsMutex;
+    QueueHandle_t _commandQueue;        // AuthJob
+    TaskHandle_t _commandWorker;
+    
+    // Work for the auth worker: a gate command to authorize or a session token exchange
+    enum AuthJobKind : uint8_t {
+        AUTH_JOB_COMMAND,
+        AUTH_JOB_SESSION
+    };
+    struct AuthJob {
+        AuthJobKind kind;
+        uint32_t id;                    // Command id, or index in _sessionExchanges
+    };
+    
+    // /auth/session requests waiting for (or done with) Keycloak validation, under _commandsMutex
+    struct SessionExchange {
+        HttpResponseHandle replyTo;     // 0: free slot
+        String token;
+        String clientIP;
+        ValidationResult result;
+        bool done;                      // Validated by the worker, reply from the main loop
+    };
+    SessionExchange _sessionExchanges[AUTH_SESSION_SLOTS];
     
     // Route handlers
     void handleRoot();
     void handleHealth();
     void handleAuthInfo();
-    void handleGateOpen();
-    void handleGateClose();
-    void handleGateStatus();
+    void handleGateCommandRoute(OperationState action);
+    void handleGateStatusRoute();
+    void handleGateList();
+    void handleOperationStatus();
+    void handleSystemStats();
+    void handleGateEvents();
+    void handleSessionExchange();
+    void handleGuestOpen();
     
     // Helper methods
-    String buildStatusJson();
+    JsonWriter jsonWriter();             // Over _jsonBuffer, one document at a time
+    void sendJson(int code, const JsonWriter& json);
+    void writeStatusJson(JsonWriter& json, const char* key, int gate, const GateSnapshot& gates);
+    void writeOperationJson(JsonWriter& json, const GateCommand& command);
+    void formatStatusETag(char* etag, size_t size, uint32_t version);
+    void sendGateStatus(int gate);
+    bool parkStatusRequest(int gate, uint32_t since);
     void setupRoutes();
     
+    // Gate command helpers
+    int resolveGate();  // {id} path segment -> GATES index, 404 sent and -1 when unknown
+    int resolveGate(const String& id);
+    void handleGateCommand(OperationState action, int gate);
+    bool wantsAsyncCommand();
+    void enqueueGateCommand(OperationState action, int gate, bool replyWhenDone);
+    bool submitGateRequest(OperationState action, int gate, uint32_t commandId);
+    void handleGateEvent(const GateEvent& event);
+    void authorizeCommand(uint32_t id);
+    void authorizeSessionExchange(uint32_t index);
+    void replySessionExchanges();
+    void processCommands();
+    void updateCommands();
+    void replyMqttCommands();
+    void publishGateChanges();
+    void publishMqttState();
+    bool publishStateSnapshot(const GateSnapshot& snapshot);
+    void writeStateFields(JsonWriter& json, int gate, const GateSnapshot& gates, const GateStatus* previous);
+    static void commandWorkerEntry(void* arg);
+    
     // Authentication helpers
-    bool requireAuthentication();
     void initializeAuth();
     
     // EMQX logging helpers
     void initializeEmqx();
-    void logGateAction(const String& action, bool authorized);
+    void handleNetworkUp();
+    void handleMqttCommand(const uint8_t* payload, unsigned int length);
+    void refuseMqttCommand(const MqttCommand& request, const char* error);
+    void sendCommandReply(const char* nonce, const GateCommand* command, const char* status, const char* error);
+    void logGateAction(const String& action, int gate, bool authorized, const ValidationResult& result,
+                       const String& token);
 };
 
 #endif // WEB_SERVER_HANDLER_H
\ No newline at end of file
@@ -1,13 +1,19 @@
 #include "WiFiManager.h"
+#include "Config.h"
 #include <Arduino.h>
 #include <ESPmDNS.h>
 #include <time.h>
 
 WiFiManager::WiFiManager(const char* ssid, const char* password) 
-    : _ssid(ssid), _password(password) {
+    : _ssid(ssid), _password(password), _linkUpListenerCount(0) {
 }
 
 void WiFiManager::begin() {
+    WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t info) {
+        notifyLinkUp();
+    }, ARDUINO_EVENT_WIFI_STA_GOT_IP);
+    WiFi.setAutoReconnect(true);
+    
     WiFi.begin(_ssid, _password);
     Serial.print("WiFi connecting");
     
@@ -32,7 +38,7 @@ void WiFiManager::begin() {
     // Wait for time to be set (max 10 seconds)
     int retry = 0;
     const int retry_count = 20;
-    while (time(nullptr) < 24 * 3600 && retry < retry_count) {
+    while (time(nullptr) < CLOCK_SYNCED_MIN_EPOCH && retry < retry_count) {
         Serial.print(".");
         delay(500);
         retry++;
@@ -40,7 +46,7 @@ void WiFiManager::begin() {
     Serial.println("");
     
     time_t now = time(nullptr);
-    if (now > 24 * 3600) {
+    if (now >= CLOCK_SYNCED_MIN_EPOCH) {
         struct tm timeinfo;
         gmtime_r(&now, &timeinfo);
         char timeStr[64];
@@ -55,6 +61,20 @@ void WiFiManager::begin() {
     }
 }
 
+bool WiFiManager::addLinkUpListener(LinkUpCallback callback, void* context) {
+    if (_linkUpListenerCount >= MAX_LINK_UP_LISTENERS) {
+        return false;
+    }
+    _linkUpListeners[_linkUpListenerCount++] = {callback, context};
+    return true;
+}
+
+void WiFiManager::notifyLinkUp() {
+    for (int i = 0; i < _linkUpListenerCount; i++) {
+        _linkUpListeners[i].callback(_linkUpListeners[i].context);
+    }
+}
+
 bool WiFiManager::isConnected() {
     return WiFi.status() == WL_CONNECTED;
 }
@@ -3,17 +3,33 @@
 
 #include <WiFi.h>
 
+typedef void (*LinkUpCallback)(void* context);
+
 class WiFiManager {
 public:
     WiFiManager(const char* ssid, const char* password);
     void begin();
     bool isConnected();
     String getLocalIP();
+    
+    // Called (from the Wi-Fi event task) each time the station gets an IP, including reconnects
+    bool addLinkUpListener(LinkUpCallback callback, void* context);
 
 private:
+    static const int MAX_LINK_UP_LISTENERS = 4;
+    
+    struct LinkUpListener {
+        LinkUpCallback callback;
+        void* context;
+    };
+    
     const char* _ssid;
     const char* _password;
+    LinkUpListener _linkUpListeners[MAX_LINK_UP_LISTENERS];
+    int _linkUpListenerCount;
+    
     void printConnectionStatus();
+    void notifyLinkUp();
 };
 
 #endif // WIFI_MANAGER_H
\ No newline at end of file
@@ -3,7 +3,9 @@
 #include "components/WiFiManager.h"
 #include "components/GateController.h"
 #include "components/GateMonitor.h"
+#include "components/GateControlTask.h"
 #include "components/WebServerHandler.h"
+#include "components/LoopScheduler.h"
 
 #ifndef WIFI_SSID
 #define WIFI_SSID "REPLACE_ME"
@@ -17,27 +19,46 @@
 WiFiManager wifiManager(WIFI_SSID, WIFI_PASSWORD);
 GateController gateController;
 GateMonitor gateMonitor(&gateController);
-WebServerHandler webServer(&gateController, &gateMonitor);
+GateControlTask gateControl(&gateController, &gateMonitor);
+LoopScheduler networkScheduler;
+WebServerHandler webServer(&gateControl, &networkScheduler);
+
+// Network event loop: HTTP, MQTT, Keycloak upkeep (core 0)
+void networkTask(void* arg) {
+    networkScheduler.begin();
+    networkScheduler.addDeadlineSource([](void* context, unsigned long now) {
+        return static_cast<WebServerHandler*>(context)->getNextDeadline(now);
+    }, &webServer);
+    
+    for (;;) {
+        // Handle web server requests
+        webServer.handleClient();
+        
+        // Sleep until the earliest deadline or a wake-up (gate event, async command)
+        networkScheduler.sleepUntilNextDeadline();
+    }
+}
 
 void setup() {
     Serial.begin(SERIAL_BAUD_RATE);
     
     // Initialize components
     gateController.begin();
+    wifiManager.addLinkUpListener([](void* context) {
+        static_cast<WebServerHandler*>(context)->onNetworkUp();
+    }, &webServer);
     wifiManager.begin();
     gateMonitor.begin();
     webServer.begin();
     
+    // Gate control gets its own real-time task (core 1), the network loop runs on core 0
+    gateControl.begin(&networkScheduler);
+    xTaskCreatePinnedToCore(networkTask, "network", 8192, nullptr, NETWORK_TASK_PRIORITY, nullptr, NETWORK_TASK_CORE);
+    
     Serial.println("System initialization complete");
 }
 
 void loop() {
-    // Handle web server requests
-    webServer.handleClient();
-    
-    // Update gate monitoring
-    gateMonitor.update();
-    
-    // Small delay to avoid excessive CPU usage
-    delay(MAIN_LOOP_DELAY);
-}
\ No newline at end of file
+    // Everything runs in the gate control and network tasks
+    vTaskDelete(NULL);
+}
@@ -37,6 +37,10 @@ unsigned long millis() {
     return mockMillis;
 }
 
+unsigned long micros() {
+    return mockMillis * 1000UL;
+}
+
 // Serial mock implementation
 void SerialMock::begin(unsigned long baud) {
     std::cout << "[Serial] Begin with baud: " << baud << std::endl;
@@ -6,17 +6,34 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <string.h>
 
 // Mock Arduino types and constants
 typedef bool boolean;
 typedef unsigned char byte;
-typedef std::string String;
+
+// std::string with the Arduino numeric constructors (String(millis()), String(1000/1000), ...)
+class String : public std::string {
+public:
+    String() {}
+    String(const char* str) : std::string(str) {}
+    String(const char* str, size_t length) : std::string(str, length) {}
+    String(const std::string& str) : std::string(str) {}
+    explicit String(int value) : std::string(std::to_string(value)) {}
+    explicit String(unsigned int value) : std::string(std::to_string(value)) {}
+    explicit String(long value) : std::string(std::to_string(value)) {}
+    explicit String(unsigned long value) : std::string(std::to_string(value)) {}
+    bool isEmpty() const { return empty(); }
+    bool concat(const char* str, size_t length) { append(str, length); return true; }
+    bool startsWith(const char* prefix) const { return compare(0, strlen(prefix), prefix) == 0; }
+};
 
 #define HIGH 0x1
 #define LOW 0x0
 #define INPUT 0x0
 #define OUTPUT 0x1
 #define INPUT_PULLUP 0x2
+#define IRAM_ATTR
 
 // Mock functions
 void pinMode(int pin, int mode);
@@ -24,6 +41,7 @@ void digitalWrite(int pin, int value);
 int digitalRead(int pin);
 void delay(unsigned long ms);
 unsigned long millis();
+unsigned long micros();   // Follows the mock millis clock (mockMillis * 1000)
 
 // Mock Serial
 class SerialMock {
@@ -0,0 +1,110 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/AccessPolicy.h"
+
+#include <unity.h>
+
+AccessPolicy* policy;
+
+// Mask of a token carrying the given claims, as JwtValidator builds it
+uint32_t tokenRoles(const char* first, const char* second = nullptr) {
+    uint32_t roles = AccessPolicy::ROLE_AUTHENTICATED | policy->roleBit(first);
+    if (second) {
+        roles |= policy->roleBit(second);
+    }
+    return roles;
+}
+
+void setUp(void) {
+    resetMockState();
+    policy = new AccessPolicy();
+}
+
+void tearDown(void) {
+    delete policy;
+    policy = nullptr;
+}
+
+// Test without rules any valid token is allowed, and nothing else
+void test_access_policy_unrestricted() {
+    TEST_ASSERT_FALSE(policy->isRestricted());
+    TEST_ASSERT_TRUE(policy->allows(AccessPolicy::ROLE_AUTHENTICATED, 0, OPENING));
+    TEST_ASSERT_TRUE(policy->allows(AccessPolicy::ROLE_AUTHENTICATED, 0, CLOSING));
+    TEST_ASSERT_FALSE(policy->allows(0, 0, OPENING));
+    TEST_ASSERT_EQUAL(0, policy->roleBit("garage-admin"));
+}
+
+// Test roles get one bit each and only the listed actions are granted
+void test_access_policy_roles() {
+    TEST_ASSERT_EQUAL(3, policy->load("garage-admin:*:*;/family:main:open;delivery:main:close;"
+                                      "bad:main;typo:main:lock;other:garage9:open"));
+    TEST_ASSERT_TRUE(policy->isRestricted());
+    TEST_ASSERT_EQUAL(4, policy->roleCount());
+    TEST_ASSERT_EQUAL_STRING("/family", policy->roleName(2));
+    TEST_ASSERT_EQUAL(0, policy->roleBit("typo"));
+
+    TEST_ASSERT_TRUE(policy->allows(tokenRoles("garage-admin"), 0, CLOSING));
+    TEST_ASSERT_TRUE(policy->allows(tokenRoles("/family"), 0, OPENING));
+    TEST_ASSERT_FALSE(policy->allows(tokenRoles("/family"), 0, CLOSING));
+    TEST_ASSERT_TRUE(policy->allows(tokenRoles("/family", "delivery"), 0, CLOSING));
+
+    // Valid token without any listed role
+    TEST_ASSERT_FALSE(policy->allows(tokenRoles("offline_access"), 0, OPENING));
+
+    // "*" grants every valid token
+    policy->load("*:main:open");
+    TEST_ASSERT_TRUE(policy->allows(tokenRoles("offline_access"), 0, OPENING));
+    TEST_ASSERT_FALSE(policy->allows(tokenRoles("offline_access"), 0, CLOSING));
+}
+
+// Test time-of-day windows, including one wrapping past midnight
+void test_access_policy_windows() {
+    policy->load("cleaner:main:open:0800-1800;night:main:*:2200-0600;admin:main:*");
+    uint32_t cleaner = tokenRoles("cleaner");
+    uint32_t night = tokenRoles("night");
+
+    // Clock unknown: windowed rules don't apply, the others do
+    TEST_ASSERT_FALSE(policy->allows(cleaner, 0, OPENING));
+    TEST_ASSERT_TRUE(policy->allows(tokenRoles("admin"), 0, OPENING));
+
+    policy->setTimeOfDay(8 * 60);
+    TEST_ASSERT_TRUE(policy->allows(cleaner, 0, OPENING));
+    TEST_ASSERT_FALSE(policy->allows(night, 0, OPENING));
+    policy->setTimeOfDay(18 * 60);
+    TEST_ASSERT_FALSE(policy->allows(cleaner, 0, OPENING));
+
+    policy->setTimeOfDay(23 * 60 + 30);
+    TEST_ASSERT_TRUE(policy->allows(night, 0, CLOSING));
+    policy->setTimeOfDay(5 * 60 + 59);
+    TEST_ASSERT_TRUE(policy->allows(night, 0, OPENING));
+    policy->setTimeOfDay(6 * 60);
+    TEST_ASSERT_FALSE(policy->allows(night, 0, OPENING));
+}
+
+// Test malformed windows are refused and 2400 closes a window at midnight
+void test_access_policy_window_parsing() {
+    TEST_ASSERT_EQUAL(0, policy->load("a:main:open:0800-0800;b:main:open:2500-0100;c:main:open:8-18;"
+                                      "d:main:open:2400-0100;e:main:open:0860-1000"));
+    TEST_ASSERT_EQUAL(1, policy->roleCount());
+
+    TEST_ASSERT_EQUAL(1, policy->load("late:main:open:1800-2400"));
+    policy->setTimeOfDay(23 * 60 + 59);
+    TEST_ASSERT_TRUE(policy->allows(tokenRoles("late"), 0, OPENING));
+    policy->setTimeOfDay(0);
+    TEST_ASSERT_FALSE(policy->allows(tokenRoles("late"), 0, OPENING));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_access_policy_unrestricted);
+    RUN_TEST(test_access_policy_roles);
+    RUN_TEST(test_access_policy_windows);
+    RUN_TEST(test_access_policy_window_parsing);
+
+    return UNITY_END();
+}
@@ -0,0 +1,423 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/AsyncHttpServer.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <unity.h>
+
+// Loopback tests against real sockets: the server is polled from the test thread
+AsyncHttpServer* server;
+HttpResponseHandle parked;
+
+int connectClient() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server->port());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+void sendText(int fd, const std::string& text) {
+    size_t sent = 0;
+    while (sent < text.size()) {
+        ssize_t n = send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            sent += n;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            server->poll(1); // Socket buffer full: let the server read
+        } else {
+            return;
+        }
+    }
+}
+
+// Split complete responses out of a byte stream, returns their bodies prefixed with the status code
+size_t extractResponses(std::string& stream, std::vector<std::string>& responses) {
+    for (;;) {
+        size_t headerEnd = stream.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            return responses.size();
+        }
+        size_t lengthAt = stream.find("Content-Length: ");
+        size_t length = strtoul(stream.c_str() + lengthAt + 16, nullptr, 10);
+        if (stream.size() < headerEnd + 4 + length) {
+            return responses.size();
+        }
+        responses.push_back(stream.substr(9, 3) + " " + stream.substr(headerEnd + 4, length));
+        stream.erase(0, headerEnd + 4 + length);
+    }
+}
+
+// Poll the server until count responses arrived on fd (or nothing moves anymore)
+std::vector<std::string> readResponses(int fd, size_t count, std::string* rawHeaders = nullptr) {
+    std::vector<std::string> responses;
+    std::string stream;
+    for (int i = 0; i < 2000 && responses.size() < count; i++) {
+        server->poll(1);
+        char buffer[4096];
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            stream.append(buffer, n);
+            if (rawHeaders) {
+                rawHeaders->append(buffer, n);
+            }
+            extractResponses(stream, responses);
+        }
+    }
+    return responses;
+}
+
+bool isClosedByServer(int fd) {
+    for (int i = 0; i < 200; i++) {
+        server->poll(1);
+        char buffer[256];
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::string get(const char* path, const char* extraHeaders = "") {
+    return std::string("GET ") + path + " HTTP/1.1\r\nHost: esp32\r\n" + extraHeaders + "\r\n";
+}
+
+void setUp(void) {
+    resetMockState();
+    parked = 0;
+    server = new AsyncHttpServer(0);
+    server->on("/status", []() { server->send(200, "application/json", "{\"ok\":true}"); });
+    server->on("/gate/{}/open", []() {
+        server->send(200, "text/plain", server->pathArg(0) + "|" + server->arg("async") + "|" +
+                     server->header("Prefer") + "|" + server->header("X-Ignored"));
+    });
+    server->on("/slow", []() { parked = server->deferResponse(); });
+    server->on("/large", []() { server->send(200, "text/plain", String(std::string(8 << 20, 'x').c_str())); });
+    server->on("/cached", []() {
+        server->sendHeader("ETag", "\"v1\"");
+        server->send(304, nullptr, "");
+    });
+    const char* headers[] = {"Prefer"};
+    server->collectHeaders(headers, 1);
+    TEST_ASSERT_TRUE(server->begin());
+}
+
+void tearDown(void) {
+    delete server;
+    server = nullptr;
+}
+
+// Test two requests are served on the same kept-alive connection
+void test_http_keep_alive() {
+    int client = connectClient();
+    sendText(client, get("/status"));
+    std::vector<std::string> first = readResponses(client, 1);
+    sendText(client, get("/status"));
+    std::vector<std::string> second = readResponses(client, 1);
+
+    TEST_ASSERT_EQUAL(1, first.size());
+    TEST_ASSERT_EQUAL(1, second.size());
+    TEST_ASSERT_EQUAL_STRING("200 {\"ok\":true}", second[0].c_str());
+    TEST_ASSERT_EQUAL(1, server->getStats().accepted);
+    TEST_ASSERT_EQUAL(1, server->getStats().reused);
+    close(client);
+}
+
+// Test pipelined requests are answered in order
+void test_http_pipelining() {
+    int client = connectClient();
+    sendText(client, get("/gate/main/open") + get("/status") + get("/missing"));
+    std::vector<std::string> responses = readResponses(client, 3);
+
+    TEST_ASSERT_EQUAL(3, responses.size());
+    TEST_ASSERT_EQUAL_STRING("200 main|||", responses[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("200 {\"ok\":true}", responses[1].c_str());
+    TEST_ASSERT_EQUAL_STRING("404 {\"error\":\"Not found\"}", responses[2].c_str());
+    TEST_ASSERT_EQUAL(2, server->getStats().pipelined);
+    close(client);
+}
+
+// Test path, query and collected headers (case-insensitive), other headers are not kept
+void test_http_request_accessors() {
+    int client = connectClient();
+    sendText(client, get("/gate/garage%202/open?x=1&async=1", "prefer: respond-async\r\nX-Ignored: yes\r\n"));
+    std::vector<std::string> responses = readResponses(client, 1);
+
+    TEST_ASSERT_EQUAL(1, responses.size());
+    TEST_ASSERT_EQUAL_STRING("200 garage 2|1|respond-async|", responses[0].c_str());
+    close(client);
+}
+
+// Test a half-received request does not hold back another connection
+void test_http_concurrent_connections() {
+    int slow = connectClient();
+    int fast = connectClient();
+    sendText(slow, "GET /status HTTP/1.1\r\nHost: es");
+    sendText(fast, get("/status"));
+
+    TEST_ASSERT_EQUAL(1, readResponses(fast, 1).size());
+
+    sendText(slow, "p32\r\n\r\n");
+    TEST_ASSERT_EQUAL(1, readResponses(slow, 1).size());
+    TEST_ASSERT_EQUAL(2, server->activeConnections());
+    close(slow);
+    close(fast);
+}
+
+// Test a deferred response is sent later, and holds back the requests pipelined behind it
+void test_http_deferred_response() {
+    int client = connectClient();
+    int other = connectClient();
+    sendText(client, get("/slow") + get("/status"));
+    TEST_ASSERT_EQUAL(0, readResponses(client, 1).size());
+    TEST_ASSERT_NOT_EQUAL(0, parked);
+
+    sendText(other, get("/status"));
+    TEST_ASSERT_EQUAL(1, readResponses(other, 1).size());
+
+    TEST_ASSERT_TRUE(server->sendDeferred(parked, 202, "application/json", "{\"done\":true}"));
+    TEST_ASSERT_EQUAL(0, server->getNextDeadline(millis()));
+    std::vector<std::string> responses = readResponses(client, 2);
+    TEST_ASSERT_EQUAL(2, responses.size());
+    TEST_ASSERT_EQUAL_STRING("202 {\"done\":true}", responses[0].c_str());
+    TEST_ASSERT_EQUAL_STRING("200 {\"ok\":true}", responses[1].c_str());
+
+    // Answered once only
+    TEST_ASSERT_FALSE(server->sendDeferred(parked, 200, "text/plain", ""));
+    close(client);
+    close(other);
+}
+
+// Test the socket watcher reports a request sent right after a deferred reply at once: the
+// connection re-enters its read set then, not at the next HTTP_WATCH_INTERVAL refresh
+void test_http_watch_after_deferred_reply() {
+    int client = connectClient();
+    sendText(client, get("/slow"));
+    TEST_ASSERT_EQUAL(0, readResponses(client, 1).size());
+    TEST_ASSERT_NOT_EQUAL(0, parked);
+    server->waitForActivity(0);
+    TEST_ASSERT_EQUAL(0, server->waitForActivity(0));
+
+    // Written out by sendDeferred() itself, no poll() in between
+    TEST_ASSERT_TRUE(server->sendDeferred(parked, 202, "application/json", "{\"done\":true}"));
+    std::string stream;
+    std::vector<std::string> responses;
+    char buffer[256];
+    for (int i = 0; i < 100 && extractResponses(stream, responses) == 0; i++) {
+        ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            stream.append(buffer, n);
+        } else {
+            usleep(1000);
+        }
+    }
+    TEST_ASSERT_EQUAL_STRING("202 {\"done\":true}", responses[0].c_str());
+    sendText(client, get("/status"));
+
+    const auto start = std::chrono::steady_clock::now();
+    int ready = 0;
+    for (int i = 0; i < 3 && ready == 0; i++) {
+        ready = server->waitForActivity(HTTP_WATCH_INTERVAL);
+    }
+    const long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT_TRUE(ready > 0);
+    TEST_ASSERT_TRUE(elapsed < static_cast<long>(HTTP_WATCH_INTERVAL / 2));
+
+    responses = readResponses(client, 1);
+    TEST_ASSERT_EQUAL(1, responses.size());
+    TEST_ASSERT_EQUAL_STRING("200 {\"ok\":true}", responses[0].c_str());
+    close(client);
+}
+
+// Test a 304 carries no body framing and the next pipelined response follows it directly
+void test_http_not_modified() {
+    int client = connectClient();
+    sendText(client, get("/cached") + get("/status"));
+
+    std::string stream;
+    for (int i = 0; i < 500 && stream.find("{\"ok\":true}") == std::string::npos; i++) {
+        server->poll(1);
+        char buffer[1024];
+        ssize_t n = recv(client, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            stream.append(buffer, n);
+        }
+    }
+
+    size_t second = stream.find("HTTP/1.1 200");
+    TEST_ASSERT_TRUE(stream.find("HTTP/1.1 304 Not Modified\r\n") == 0);
+    TEST_ASSERT_TRUE(second != std::string::npos);
+    std::string notModified = stream.substr(0, second);
+    TEST_ASSERT_TRUE(notModified.find("ETag: \"v1\"\r\n") != std::string::npos);
+    TEST_ASSERT_TRUE(notModified.find("Content-Length") == std::string::npos);
+    TEST_ASSERT_TRUE(notModified.find("\r\n\r\n") == notModified.size() - 4);
+    close(client);
+}
+
+// Test Connection: close and HTTP/1.0 requests end the connection after the response
+void test_http_connection_close() {
+    int client = connectClient();
+    std::string headers;
+    sendText(client, get("/status", "Connection: close\r\n"));
+    TEST_ASSERT_EQUAL(1, readResponses(client, 1, &headers).size());
+    TEST_ASSERT_TRUE(headers.find("Connection: close") != std::string::npos);
+    TEST_ASSERT_TRUE(isClosedByServer(client));
+    close(client);
+
+    client = connectClient();
+    sendText(client, "GET /status HTTP/1.0\r\n\r\n");
+    TEST_ASSERT_EQUAL(1, readResponses(client, 1).size());
+    TEST_ASSERT_TRUE(isClosedByServer(client));
+    close(client);
+}
+
+// Test idle keep-alive connections are closed after HTTP_KEEPALIVE_TIMEOUT
+void test_http_keep_alive_timeout() {
+    int client = connectClient();
+    sendText(client, get("/status"));
+    TEST_ASSERT_EQUAL(1, readResponses(client, 1).size());
+    TEST_ASSERT_EQUAL(HTTP_KEEPALIVE_TIMEOUT, server->getNextDeadline(millis()));
+
+    setMockMillis(millis() + HTTP_KEEPALIVE_TIMEOUT);
+    TEST_ASSERT_TRUE(isClosedByServer(client));
+    TEST_ASSERT_EQUAL(0, server->activeConnections());
+    close(client);
+}
+
+// Test a client that never reads its responses loses its slot once the send stops progressing
+void test_http_write_stall_timeout() {
+    int client = socket(AF_INET, SOCK_STREAM, 0);
+    int window = 1024;
+    setsockopt(client, SOL_SOCKET, SO_RCVBUF, &window, sizeof(window)); // Before connect: small advertised window
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server->port());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(client, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+    sendText(client, get("/large"));
+    for (int i = 0; i < 50; i++) {
+        server->poll(1);
+    }
+    TEST_ASSERT_EQUAL(1, server->activeConnections());
+    TEST_ASSERT_EQUAL(HTTP_WRITE_STALL_TIMEOUT, server->getNextDeadline(millis()));
+
+    // Well past the keep-alive timeout, not yet the stall timeout: still open
+    setMockMillis(millis() + HTTP_KEEPALIVE_TIMEOUT);
+    server->poll(1);
+    TEST_ASSERT_EQUAL(1, server->activeConnections());
+
+    setMockMillis(millis() + HTTP_WRITE_STALL_TIMEOUT - HTTP_KEEPALIVE_TIMEOUT);
+    server->poll(1);
+    TEST_ASSERT_EQUAL(0, server->activeConnections());
+    TEST_ASSERT_EQUAL(1, server->getStats().stalled);
+    close(client);
+}
+
+// Test malformed and oversized requests are answered with an error and closed
+void test_http_bad_requests() {
+    int client = connectClient();
+    sendText(client, "NONSENSE\r\n\r\n");
+    std::vector<std::string> responses = readResponses(client, 1);
+    TEST_ASSERT_EQUAL(1, responses.size());
+    TEST_ASSERT_EQUAL_STRING("400", responses[0].substr(0, 3).c_str());
+    TEST_ASSERT_TRUE(isClosedByServer(client));
+    close(client);
+
+    // Fills the buffer without ending the headers
+    client = connectClient();
+    std::string request = "GET /status HTTP/1.1\r\nAuthorization: Bearer ";
+    sendText(client, request + std::string(HTTP_REQUEST_BUFFER_SIZE - request.size(), 'x'));
+    responses = readResponses(client, 1);
+    TEST_ASSERT_EQUAL(1, responses.size());
+    TEST_ASSERT_EQUAL_STRING("431", responses[0].substr(0, 3).c_str());
+    close(client);
+}
+
+// Test connections beyond HTTP_MAX_CONNECTIONS are refused with 503
+void test_http_connection_limit() {
+    int clients[HTTP_MAX_CONNECTIONS + 1];
+    for (int i = 0; i <= HTTP_MAX_CONNECTIONS; i++) {
+        clients[i] = connectClient();
+        server->poll(5);
+    }
+    std::vector<std::string> responses = readResponses(clients[HTTP_MAX_CONNECTIONS], 1);
+    TEST_ASSERT_EQUAL(1, responses.size());
+    TEST_ASSERT_EQUAL_STRING("503", responses[0].substr(0, 3).c_str());
+    TEST_ASSERT_EQUAL(HTTP_MAX_CONNECTIONS, server->activeConnections());
+    TEST_ASSERT_EQUAL(1, server->getStats().rejected);
+    for (int i = 0; i <= HTTP_MAX_CONNECTIONS; i++) {
+        close(clients[i]);
+    }
+}
+
+// Load test: every connection slot busy with pipelined batches, up to the per-connection request limit
+void test_http_load() {
+    const int batch = 4;
+    const int rounds = HTTP_KEEPALIVE_MAX_REQUESTS / batch;
+    int clients[HTTP_MAX_CONNECTIONS];
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        clients[i] = connectClient();
+    }
+
+    size_t answered = 0;
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            std::string requests;
+            for (int j = 0; j < batch; j++) {
+                requests += get("/status");
+            }
+            sendText(clients[i], requests);
+        }
+        for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+            answered += readResponses(clients[i], batch).size();
+        }
+    }
+
+    TEST_ASSERT_EQUAL(rounds * batch * HTTP_MAX_CONNECTIONS, answered);
+    TEST_ASSERT_EQUAL(HTTP_MAX_CONNECTIONS, server->getStats().accepted);
+    TEST_ASSERT_EQUAL(0, server->getStats().errors);
+    for (int i = 0; i < HTTP_MAX_CONNECTIONS; i++) {
+        close(clients[i]);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_http_keep_alive);
+    RUN_TEST(test_http_pipelining);
+    RUN_TEST(test_http_request_accessors);
+    RUN_TEST(test_http_concurrent_connections);
+    RUN_TEST(test_http_deferred_response);
+    RUN_TEST(test_http_watch_after_deferred_reply);
+    RUN_TEST(test_http_not_modified);
+    RUN_TEST(test_http_connection_close);
+    RUN_TEST(test_http_keep_alive_timeout);
+    RUN_TEST(test_http_write_stall_timeout);
+    RUN_TEST(test_http_bad_requests);
+    RUN_TEST(test_http_connection_limit);
+    RUN_TEST(test_http_load);
+
+    return UNITY_END();
+}
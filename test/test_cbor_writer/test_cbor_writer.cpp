@@ -0,0 +1,124 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/CborWriter.h"
+#include "../src/components/JsonWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+uint8_t buffer[512];
+
+// Hex dump of the written bytes, compared as a string to keep failures readable
+static const char* hex(const CborWriter& cbor) {
+    static char text[2 * sizeof(buffer) + 1];
+    for (size_t i = 0; i < cbor.length(); i++) {
+        snprintf(text + 2 * i, 3, "%02x", cbor.data()[i]);
+    }
+    text[2 * cbor.length()] = '\0';
+    return text;
+}
+
+void setUp(void) {
+    memset(buffer, 0, sizeof(buffer));
+}
+
+void tearDown(void) {
+}
+
+// Test integers take the shortest head (RFC 8949 appendix A)
+void test_cbor_writer_integers() {
+    CborWriter cbor(buffer, sizeof(buffer));
+    const struct {
+        long value;
+        const char* expected;
+    } vectors[] = {
+        {0, "00"}, {23, "17"}, {24, "1818"}, {100, "1864"}, {1000, "1903e8"},
+        {1000000, "1a000f4240"}, {-1, "20"}, {-100, "3863"}, {-1000, "3903e7"},
+    };
+    for (const auto& vector : vectors) {
+        cbor.reset();
+        cbor.field(nullptr, vector.value);
+        TEST_ASSERT_EQUAL_STRING(vector.expected, hex(cbor));
+    }
+
+    cbor.reset();
+    cbor.field(nullptr, 4294967295UL);
+    TEST_ASSERT_EQUAL_STRING("1affffffff", hex(cbor));
+}
+
+// Test maps, arrays, strings, booleans and null
+void test_cbor_writer_nesting() {
+    CborWriter cbor(buffer, sizeof(buffer));
+    cbor.beginObject();
+    cbor.field("a", 1);
+    cbor.beginArray("b").value("IETF").value(String("")).endArray();
+    cbor.field("c", true).field("d", false);
+    cbor.field("e", static_cast<const char*>(nullptr));
+    cbor.endObject();
+
+    TEST_ASSERT_FALSE(cbor.overflowed());
+    TEST_ASSERT_EQUAL_STRING("bf" "6161" "01" "6162" "9f" "6449455446" "60" "ff"
+                             "6163" "f5" "6164" "f4" "6165" "f6" "ff", hex(cbor));
+}
+
+// Test an undersized buffer flags the overflow without writing past it
+void test_cbor_writer_overflow() {
+    uint8_t small[8];
+    CborWriter cbor(small, sizeof(small));
+    cbor.beginObject().field("status", "opening").endObject();
+
+    TEST_ASSERT_TRUE(cbor.overflowed());
+    TEST_ASSERT_TRUE(cbor.length() <= sizeof(small));
+
+    cbor.reset();
+    TEST_ASSERT_FALSE(cbor.overflowed());
+    cbor.beginObject().endObject();
+    TEST_ASSERT_EQUAL_STRING("bfff", hex(cbor));
+}
+
+// Same record as EmqxLogger publishes, written with either writer
+template <typename Writer>
+static void writeRecord(Writer& writer, uint32_t sequence) {
+    writer.beginObject();
+    writer.field("seq", sequence);
+    writer.field("boot_id", 2876543210UL);
+    writer.field("timestamp", 86400123UL);
+    writer.field("action", "open");
+    writer.field("gate_id", "main");
+    writer.field("authorized", true);
+    writer.field("device_id", "ESP32_A1B2C3D4E5F6");
+    writer.field("sub", "5f2b8c3e-1d4a-4e6f-9a7b-0c1d2e3f4a5b");
+    writer.field("name", "Jean Dupont");
+    writer.endObject();
+}
+
+// Test the CBOR record is smaller than the JSON one with the same fields
+void test_cbor_writer_size_vs_json() {
+    char json[512];
+    JsonWriter jsonWriter(json, sizeof(json));
+    writeRecord(jsonWriter, 1234);
+    CborWriter cbor(buffer, sizeof(buffer));
+    writeRecord(cbor, 1234);
+
+    printf("[Size] authorized action record: JSON %u bytes, CBOR %u bytes\n",
+           static_cast<unsigned>(jsonWriter.length()), static_cast<unsigned>(cbor.length()));
+    TEST_ASSERT_FALSE(cbor.overflowed());
+    TEST_ASSERT_TRUE(cbor.length() < jsonWriter.length());
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_cbor_writer_integers);
+    RUN_TEST(test_cbor_writer_nesting);
+    RUN_TEST(test_cbor_writer_overflow);
+    RUN_TEST(test_cbor_writer_size_vs_json);
+
+    return UNITY_END();
+}
@@ -0,0 +1,137 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/CircuitBreaker.h"
+
+#include <unity.h>
+
+const unsigned long SLOW = 1000;
+const unsigned long OPEN_TIME = 30000;
+
+CircuitBreaker* breaker;
+
+void setUp(void) {
+    breaker = new CircuitBreaker(SLOW, OPEN_TIME);
+}
+
+void tearDown(void) {
+    delete breaker;
+    breaker = nullptr;
+}
+
+// Test the circuit stays closed below the minimum call count and the failure rate
+void test_circuit_breaker_stays_closed() {
+    for (int i = 0; i < KEYCLOAK_BREAKER_MIN_CALLS - 1; i++) {
+        breaker->recordFailure(0);
+    }
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_CLOSED, breaker->getState());
+    TEST_ASSERT_EQUAL(100, breaker->failurePercent());
+
+    // One call in three failing stays under the threshold
+    delete breaker;
+    breaker = new CircuitBreaker(SLOW, OPEN_TIME);
+    for (int i = 0; i < 100; i++) {
+        if (i % 3 == 2) {
+            breaker->recordFailure(0);
+        } else {
+            breaker->recordSuccess(10, 0);
+        }
+    }
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_CLOSED, breaker->getState());
+    TEST_ASSERT_TRUE(breaker->allowRequest());
+}
+
+// Test failures and slow calls open the circuit, calls then fail fast
+void test_circuit_breaker_trips() {
+    breaker->recordSuccess(10, 0);
+    breaker->recordSuccess(SLOW + 1, 0);
+    breaker->recordFailure(0);
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_CLOSED, breaker->getState());
+    breaker->recordSuccess(SLOW + 1, 100);
+
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_OPEN, breaker->getState());
+    TEST_ASSERT_FALSE(breaker->allowRequest());
+    TEST_ASSERT_FALSE(breaker->allowRequest());
+    TEST_ASSERT_EQUAL(2, breaker->getStats().rejected);
+    TEST_ASSERT_EQUAL(1, breaker->getStats().opened);
+
+    // A call allowed before the trip doesn't close it
+    breaker->recordSuccess(10, 200);
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_OPEN, breaker->getState());
+}
+
+// Test a single probe after the open time, its success closes the circuit with a clean window
+void test_circuit_breaker_probe_success() {
+    for (int i = 0; i < KEYCLOAK_BREAKER_MIN_CALLS; i++) {
+        breaker->recordFailure(1000);
+    }
+    TEST_ASSERT_FALSE(breaker->isProbeDue(1000 + OPEN_TIME - 1));
+    TEST_ASSERT_FALSE(breaker->startProbe(1000 + OPEN_TIME - 1));
+    TEST_ASSERT_TRUE(breaker->startProbe(1000 + OPEN_TIME));
+    TEST_ASSERT_FALSE(breaker->startProbe(1000 + OPEN_TIME));
+
+    // Half-open: regular calls still fail fast while the probe runs
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_HALF_OPEN, breaker->getState());
+    TEST_ASSERT_FALSE(breaker->allowRequest());
+
+    breaker->recordSuccess(10, 1000 + OPEN_TIME + 10);
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_CLOSED, breaker->getState());
+    TEST_ASSERT_EQUAL(0, breaker->failurePercent());
+    TEST_ASSERT_TRUE(breaker->allowRequest());
+
+    // One failure is not enough to trip again
+    breaker->recordFailure(1000 + OPEN_TIME + 20);
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_CLOSED, breaker->getState());
+}
+
+// Test a failed or slow probe opens the circuit for another open time
+void test_circuit_breaker_probe_failure() {
+    for (int i = 0; i < KEYCLOAK_BREAKER_MIN_CALLS; i++) {
+        breaker->recordFailure(0);
+    }
+    TEST_ASSERT_TRUE(breaker->startProbe(OPEN_TIME));
+    breaker->recordSuccess(SLOW + 1, OPEN_TIME + SLOW + 1);
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_OPEN, breaker->getState());
+    TEST_ASSERT_EQUAL(2, breaker->getStats().opened);
+
+    // Open time counted from the failed probe, wrapping millis() included
+    TEST_ASSERT_FALSE(breaker->isProbeDue(2 * OPEN_TIME));
+    TEST_ASSERT_TRUE(breaker->startProbe(2 * OPEN_TIME + SLOW + 1));
+    breaker->recordFailure(0xFFFFFF00UL);
+    TEST_ASSERT_FALSE(breaker->isProbeDue(0xFFFFFF00UL + OPEN_TIME - 1));
+    TEST_ASSERT_TRUE(breaker->isProbeDue(0xFFFFFF00UL + OPEN_TIME));
+    TEST_ASSERT_EQUAL(2, breaker->getStats().probes);
+}
+
+// Test a probe that never reached the service leaves the circuit open and the next one due
+void test_circuit_breaker_probe_cancelled() {
+    for (int i = 0; i < KEYCLOAK_BREAKER_MIN_CALLS; i++) {
+        breaker->recordFailure(0);
+    }
+    TEST_ASSERT_TRUE(breaker->startProbe(OPEN_TIME));
+    breaker->cancelProbe();
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_OPEN, breaker->getState());
+    TEST_ASSERT_EQUAL(1, breaker->getStats().opened);
+    TEST_ASSERT_FALSE(breaker->allowRequest());
+    TEST_ASSERT_TRUE(breaker->startProbe(OPEN_TIME + 1));
+
+    // No effect outside a probe
+    breaker->recordSuccess(10, OPEN_TIME + 10);
+    breaker->cancelProbe();
+    TEST_ASSERT_EQUAL(CircuitBreaker::BREAKER_CLOSED, breaker->getState());
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_circuit_breaker_stays_closed);
+    RUN_TEST(test_circuit_breaker_trips);
+    RUN_TEST(test_circuit_breaker_probe_success);
+    RUN_TEST(test_circuit_breaker_probe_failure);
+    RUN_TEST(test_circuit_breaker_probe_cancelled);
+
+    return UNITY_END();
+}
@@ -0,0 +1,133 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/ClientThrottle.h"
+
+#include <stdio.h>
+#include <unity.h>
+
+ClientThrottle* throttle;
+
+ClientThrottle::Verdict check(const char* client, unsigned long now) {
+    unsigned long retryAfter = 0;
+    return throttle->check(client, now, retryAfter);
+}
+
+void setUp(void) {
+    throttle = new ClientThrottle();
+}
+
+void tearDown(void) {
+    delete throttle;
+    throttle = nullptr;
+}
+
+// Test a few failures are tolerated, then one attempt per interval
+void test_client_throttle_throttles() {
+    for (int i = 0; i < CLIENT_THROTTLE_FAILURES - 1; i++) {
+        throttle->recordFailure("10.0.0.5", 1000);
+    }
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_ALLOWED, check("10.0.0.5", 1000));
+    throttle->recordFailure("10.0.0.5", 1000);
+
+    unsigned long retryAfter = 0;
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_THROTTLED, throttle->check("10.0.0.5", 1500, retryAfter));
+    TEST_ASSERT_EQUAL(CLIENT_THROTTLE_INTERVAL - 500, retryAfter);
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_ALLOWED, check("10.0.0.5", 1000 + CLIENT_THROTTLE_INTERVAL));
+    TEST_ASSERT_EQUAL(1, throttle->getStats().throttled);
+
+    // Other clients are not affected
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_ALLOWED, check("10.0.0.6", 1500));
+}
+
+// Test repeated failures ban the client, which comes back throttled once the ban is over
+void test_client_throttle_ban() {
+    unsigned long now = 0;
+    bool banned = false;
+    for (int i = 0; i < CLIENT_BAN_FAILURES; i++) {
+        now += CLIENT_THROTTLE_INTERVAL;
+        TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_ALLOWED, check("10.0.0.5", now));
+        banned = throttle->recordFailure("10.0.0.5", now);
+    }
+    TEST_ASSERT_TRUE(banned);
+    TEST_ASSERT_EQUAL(1, throttle->getStats().bans);
+    TEST_ASSERT_EQUAL(1, throttle->bannedCount(now));
+
+    unsigned long retryAfter = 0;
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_BANNED, throttle->check("10.0.0.5", now + 1000, retryAfter));
+    TEST_ASSERT_EQUAL(CLIENT_BAN_DURATION - 1000, retryAfter);
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_BANNED, check("10.0.0.5", now + CLIENT_BAN_DURATION - 1));
+    TEST_ASSERT_EQUAL(2, throttle->getStats().blocked);
+
+    now += CLIENT_BAN_DURATION;
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_ALLOWED, check("10.0.0.5", now));
+    TEST_ASSERT_FALSE(throttle->recordFailure("10.0.0.5", now));
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_THROTTLED, check("10.0.0.5", now + 1));
+}
+
+// Test a success or a quiet failure window clears the record
+void test_client_throttle_forgets() {
+    for (int i = 0; i < CLIENT_THROTTLE_FAILURES; i++) {
+        throttle->recordFailure("10.0.0.5", 0);
+        throttle->recordFailure("10.0.0.6", 0);
+    }
+    throttle->recordSuccess("10.0.0.5");
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_ALLOWED, check("10.0.0.5", 1));
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_THROTTLED, check("10.0.0.6", 1));
+    TEST_ASSERT_EQUAL(1, throttle->trackedCount(1));
+
+    // One failure long after the others counts as the first
+    throttle->recordFailure("10.0.0.6", CLIENT_FAILURE_WINDOW);
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_ALLOWED, check("10.0.0.6", CLIENT_FAILURE_WINDOW + 1));
+}
+
+// Test a full table drops the oldest failure first and keeps banned clients
+void test_client_throttle_full_table() {
+    for (int i = 0; i < CLIENT_BAN_FAILURES; i++) {
+        throttle->recordFailure("10.0.0.1", 0);
+    }
+    char client[16];
+    for (int i = 0; i < CLIENT_THROTTLE_SLOTS * 2; i++) {
+        snprintf(client, sizeof(client), "10.0.1.%d", i);
+        throttle->recordFailure(client, 100 + i);
+    }
+    TEST_ASSERT_EQUAL(CLIENT_THROTTLE_SLOTS, throttle->trackedCount(200));
+    TEST_ASSERT_EQUAL(CLIENT_THROTTLE_SLOTS + 1, throttle->getStats().evictions);
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_BANNED, check("10.0.0.1", 200));
+}
+
+// Test custom limits, as used for guest codes
+void test_client_throttle_custom_limits() {
+    delete throttle;
+    throttle = new ClientThrottle(GUEST_THROTTLE_FAILURES, GUEST_THROTTLE_INTERVAL, GUEST_BAN_FAILURES,
+                                  GUEST_BAN_DURATION, GUEST_FAILURE_WINDOW);
+    unsigned long now = 1000;
+    throttle->recordFailure("10.0.0.7", now);
+    unsigned long retryAfter = 0;
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_THROTTLED, throttle->check("10.0.0.7", now + 1, retryAfter));
+    TEST_ASSERT_EQUAL(GUEST_THROTTLE_INTERVAL - 1, retryAfter);
+
+    for (int i = 1; i < GUEST_BAN_FAILURES; i++) {
+        now += GUEST_THROTTLE_INTERVAL;
+        TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_ALLOWED, check("10.0.0.7", now));
+        TEST_ASSERT_EQUAL(i == GUEST_BAN_FAILURES - 1, throttle->recordFailure("10.0.0.7", now));
+    }
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_BANNED, throttle->check("10.0.0.7", now + CLIENT_BAN_DURATION, retryAfter));
+    TEST_ASSERT_EQUAL(GUEST_BAN_DURATION - CLIENT_BAN_DURATION, retryAfter);
+    TEST_ASSERT_EQUAL(ClientThrottle::CLIENT_ALLOWED, check("10.0.0.7", now + GUEST_BAN_DURATION));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_client_throttle_throttles);
+    RUN_TEST(test_client_throttle_ban);
+    RUN_TEST(test_client_throttle_forgets);
+    RUN_TEST(test_client_throttle_full_table);
+    RUN_TEST(test_client_throttle_custom_limits);
+
+    return UNITY_END();
+}
@@ -0,0 +1,113 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/Config.h"
+#include "../src/components/GateCommandQueue.h"
+
+#include <string.h>
+#include <unity.h>
+
+GateCommandQueue* commands;
+
+void setUp(void) {
+#ifdef UNIT_TEST
+    resetMockState();
+#endif
+    commands = new GateCommandQueue();
+}
+
+void tearDown(void) {
+    delete commands;
+    commands = nullptr;
+}
+
+// Test a new command is queued with a unique, findable ID
+void test_command_create_and_find() {
+    GateCommand* open = commands->create(OPENING, 1000);
+    GateCommand* close = commands->create(CLOSING, 1000);
+
+    TEST_ASSERT_NOT_NULL(open);
+    TEST_ASSERT_NOT_NULL(close);
+    TEST_ASSERT_NOT_EQUAL(0, open->id);
+    TEST_ASSERT_NOT_EQUAL(open->id, close->id);
+    TEST_ASSERT_EQUAL(COMMAND_QUEUED, open->status);
+    TEST_ASSERT_EQUAL(OPEN, open->expectedState);
+    TEST_ASSERT_EQUAL(CLOSED, close->expectedState);
+    TEST_ASSERT_EQUAL_PTR(open, commands->find(open->id));
+    TEST_ASSERT_NULL(commands->find(0));
+    TEST_ASSERT_NULL(commands->find(9999));
+    TEST_ASSERT_EQUAL(2, commands->inFlightCount());
+}
+
+// Test status transitions and failure messages
+void test_command_status_transitions() {
+    GateCommand* command = commands->create(OPENING, 1000);
+
+    commands->setStatus(*command, COMMAND_IN_PROGRESS, 2000);
+    TEST_ASSERT_EQUAL(COMMAND_IN_PROGRESS, command->status);
+    TEST_ASSERT_EQUAL(2000, command->updatedAt);
+    TEST_ASSERT_EQUAL_STRING("in_progress", GateCommandQueue::statusName(command->status));
+
+    commands->fail(*command, COMMAND_FAILED, "Superseded by another operation", 3000);
+    TEST_ASSERT_EQUAL(COMMAND_FAILED, command->status);
+    TEST_ASSERT_EQUAL_STRING("Superseded by another operation", command->error);
+    TEST_ASSERT_EQUAL(0, commands->inFlightCount());
+}
+
+// Test in-flight commands are never evicted: the table reports full instead
+void test_command_table_full() {
+    for (int i = 0; i < GATE_COMMAND_SLOTS; i++) {
+        TEST_ASSERT_NOT_NULL(commands->create(OPENING, 1000 + i));
+    }
+
+    TEST_ASSERT_NULL(commands->create(CLOSING, 5000));
+    TEST_ASSERT_EQUAL(GATE_COMMAND_SLOTS, commands->inFlightCount());
+}
+
+// Test the oldest finished command is recycled first
+void test_command_recycles_oldest_finished() {
+    uint32_t ids[GATE_COMMAND_SLOTS];
+    for (int i = 0; i < GATE_COMMAND_SLOTS; i++) {
+        ids[i] = commands->create(OPENING, 1000)->id;
+    }
+
+    commands->setStatus(*commands->find(ids[3]), COMMAND_COMPLETED, 4000);
+    commands->setStatus(*commands->find(ids[5]), COMMAND_REJECTED, 2000);
+
+    GateCommand* recycled = commands->create(CLOSING, 5000);
+    TEST_ASSERT_NOT_NULL(recycled);
+    TEST_ASSERT_NULL(commands->find(ids[5]));
+    TEST_ASSERT_NOT_NULL(commands->find(ids[3]));
+    TEST_ASSERT_EQUAL(COMMAND_QUEUED, recycled->status);
+    TEST_ASSERT_EQUAL_STRING("", recycled->error);
+}
+
+// Test a finished command awaiting dispatch is not recycled
+void test_command_pending_dispatch_kept() {
+    for (int i = 0; i < GATE_COMMAND_SLOTS; i++) {
+        commands->create(OPENING, 1000);
+    }
+    GateCommand* rejected = commands->slot(0);
+    commands->fail(*rejected, COMMAND_REJECTED, "Token expired", 2000);
+    rejected->pendingDispatch = true;
+
+    TEST_ASSERT_NULL(commands->create(CLOSING, 3000));
+
+    rejected->pendingDispatch = false;
+    TEST_ASSERT_NOT_NULL(commands->create(CLOSING, 3000));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_command_create_and_find);
+    RUN_TEST(test_command_status_transitions);
+    RUN_TEST(test_command_table_full);
+    RUN_TEST(test_command_recycles_oldest_finished);
+    RUN_TEST(test_command_pending_dispatch_kept);
+
+    return UNITY_END();
+}
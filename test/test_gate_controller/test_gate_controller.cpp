@@ -96,7 +96,7 @@ void test_gate_controller_read_state_unknown() {
 #endif
 }
 
-// Test relay trigger
+// Test relay trigger: the pulse runs in the background and ends on update()
 void test_gate_controller_trigger_relay() {
 #ifdef UNIT_TEST
     gateController->begin();
@@ -105,11 +105,92 @@ void test_gate_controller_trigger_relay() {
     TEST_ASSERT_EQUAL(LOW, pinValues[RELAY_1_PIN]);
     
     unsigned long initialMillis = mockMillis;
-    gateController->triggerRelay();
+    TEST_ASSERT_TRUE(gateController->triggerRelay());
+    
+    // Trigger returns immediately with the relay energized
+    TEST_ASSERT_EQUAL(HIGH, pinValues[RELAY_1_PIN]);
+    TEST_ASSERT_EQUAL(initialMillis, mockMillis);
+    TEST_ASSERT_TRUE(gateController->isPulseActive());
     
-    // After trigger, time should have advanced and relay should be back to LOW
+    setMockMillis(initialMillis + RELAY_PULSE_WIDTH - 1);
+    gateController->update();
+    TEST_ASSERT_EQUAL(HIGH, pinValues[RELAY_1_PIN]);
+    
+    setMockMillis(initialMillis + RELAY_PULSE_WIDTH);
+    gateController->update();
     TEST_ASSERT_EQUAL(LOW, pinValues[RELAY_1_PIN]);
-    TEST_ASSERT_EQUAL(initialMillis + 1000, mockMillis);
+    TEST_ASSERT_FALSE(gateController->isPulseActive());
+#endif
+}
+
+// Test a second pulse waits for the minimum gap and a third one is refused
+void test_gate_controller_relay_min_gap() {
+#ifdef UNIT_TEST
+    gateController->begin();
+    setMockMillis(1000);
+    
+    TEST_ASSERT_TRUE(gateController->triggerRelay());
+    TEST_ASSERT_TRUE(gateController->triggerRelay());
+    TEST_ASSERT_TRUE(gateController->isPulsePending());
+    TEST_ASSERT_FALSE(gateController->triggerRelay());
+    
+    // First pulse ends, the second one must wait for the gap
+    setMockMillis(1000 + RELAY_PULSE_WIDTH);
+    gateController->update();
+    TEST_ASSERT_EQUAL(LOW, pinValues[RELAY_1_PIN]);
+    
+    setMockMillis(1000 + RELAY_PULSE_WIDTH + RELAY_MIN_GAP - 1);
+    gateController->update();
+    TEST_ASSERT_EQUAL(LOW, pinValues[RELAY_1_PIN]);
+    
+    setMockMillis(1000 + RELAY_PULSE_WIDTH + RELAY_MIN_GAP);
+    gateController->update();
+    TEST_ASSERT_EQUAL(HIGH, pinValues[RELAY_1_PIN]);
+    TEST_ASSERT_FALSE(gateController->isPulsePending());
+#endif
+}
+
+// Test pulse start/end events carry their timestamps (micros)
+void test_gate_controller_relay_events() {
+#ifdef UNIT_TEST
+    gateController->begin();
+    RelayEvent event;
+    TEST_ASSERT_FALSE(gateController->pollRelayEvent(event));
+    
+    setMockMillis(2000);
+    gateController->triggerRelay();
+    setMockMillis(2000 + RELAY_PULSE_WIDTH + 50);
+    gateController->update();
+    
+    TEST_ASSERT_TRUE(gateController->pollRelayEvent(event));
+    TEST_ASSERT_EQUAL(RELAY_PULSE_STARTED, event.type);
+    TEST_ASSERT_EQUAL(2000 * 1000UL, event.timestamp);
+    
+    TEST_ASSERT_TRUE(gateController->pollRelayEvent(event));
+    TEST_ASSERT_EQUAL(RELAY_PULSE_ENDED, event.type);
+    TEST_ASSERT_EQUAL((2000 + RELAY_PULSE_WIDTH + 50) * 1000UL, event.timestamp);
+    
+    TEST_ASSERT_FALSE(gateController->pollRelayEvent(event));
+#endif
+}
+
+// Test the batched read reports every gate of the pin table
+void test_gate_controller_read_states() {
+#ifdef UNIT_TEST
+    gateController->begin();
+    
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        setMockPinValue(GATES[gate].closedSensorPin, (gate % 2) ? HIGH : LOW);
+        setMockPinValue(GATES[gate].openSensorPin, (gate % 2) ? LOW : HIGH);
+    }
+    
+    GateState states[GATE_COUNT];
+    gateController->readStates(states);
+    for (int gate = 0; gate < GATE_COUNT; gate++) {
+        TEST_ASSERT_EQUAL((gate % 2) ? OPEN : CLOSED, states[gate]);
+        TEST_ASSERT_EQUAL(states[gate], gateController->readState(gate));
+    }
+    TEST_ASSERT_EQUAL(CLOSED, gateController->readState());
 #endif
 }
 
@@ -121,6 +202,9 @@ int main() {
     RUN_TEST(test_gate_controller_read_state_open);
     RUN_TEST(test_gate_controller_read_state_unknown);
     RUN_TEST(test_gate_controller_trigger_relay);
+    RUN_TEST(test_gate_controller_relay_min_gap);
+    RUN_TEST(test_gate_controller_relay_events);
+    RUN_TEST(test_gate_controller_read_states);
     
     return UNITY_END();
 }
\ No newline at end of file
@@ -0,0 +1,214 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/AsyncHttpServer.h"
+#include "../src/components/GateEventStream.h"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <string>
+
+#include <unity.h>
+
+// Loopback tests: /gate/events served as in WebServerHandler, frames published by the test
+AsyncHttpServer* server;
+GateEventStream* events;
+
+int connectClient() {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(server->port());
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(fd, reinterpret_cast<struct sockaddr*>(&address), sizeof(address));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+// Poll the server until the stream of fd contains needle (or nothing moves anymore)
+bool readUntil(int fd, std::string& stream, const std::string& needle) {
+    for (int i = 0; i < 500; i++) {
+        server->poll(1);
+        char buffer[1024];
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            stream.append(buffer, n);
+        }
+        if (stream.find(needle) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int subscribe(const char* lastEventId, std::string& stream) {
+    int fd = connectClient();
+    std::string request = "GET /gate/events HTTP/1.1\r\nAccept: text/event-stream\r\n";
+    if (lastEventId) {
+        request += std::string("Last-Event-ID: ") + lastEventId + "\r\n";
+    }
+    request += "\r\n";
+    send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    readUntil(fd, stream, "\r\n\r\n");
+    return fd;
+}
+
+void setUp(void) {
+    resetMockState();
+    server = new AsyncHttpServer(0);
+    events = new GateEventStream(server);
+    server->on("/gate/events", []() {
+        HttpResponseHandle subscriber = events->subscribe();
+        if (!subscriber) {
+            return;
+        }
+        String lastEventId = server->header("Last-Event-ID");
+        if (lastEventId.isEmpty() || !events->replay(subscriber, strtoul(lastEventId.c_str(), nullptr, 10))) {
+            events->sendState(subscriber, "{\"state\":true}");
+        }
+    });
+    const char* headers[] = {"Last-Event-ID"};
+    server->collectHeaders(headers, 1);
+    TEST_ASSERT_TRUE(server->begin());
+}
+
+void tearDown(void) {
+    delete events;
+    delete server;
+    events = nullptr;
+    server = nullptr;
+}
+
+// Test every subscriber gets the stream headers, the current state and published frames
+void test_gate_event_stream_publish() {
+    std::string first;
+    std::string second;
+    int a = subscribe(nullptr, first);
+    int b = subscribe(nullptr, second);
+
+    TEST_ASSERT_TRUE(first.find("Content-Type: text/event-stream") != std::string::npos);
+    TEST_ASSERT_TRUE(first.find("Content-Length") == std::string::npos);
+    TEST_ASSERT_TRUE(readUntil(a, first, "retry: 3000\n\nid: 0\nevent: status\ndata: {\"state\":true}\n\n"));
+    TEST_ASSERT_EQUAL(2, events->subscriberCount());
+
+    TEST_ASSERT_EQUAL(1, events->publish("{\"gate\":1}"));
+    TEST_ASSERT_TRUE(readUntil(a, first, "id: 1\nevent: status\ndata: {\"gate\":1}\n\n"));
+    TEST_ASSERT_TRUE(readUntil(b, second, "id: 1\nevent: status\ndata: {\"gate\":1}\n\n"));
+
+    // Streams are not subject to the keep-alive timeout
+    setMockMillis(HTTP_KEEPALIVE_TIMEOUT * 2);
+    server->poll(1);
+    TEST_ASSERT_EQUAL(2, server->activeConnections());
+    close(a);
+    close(b);
+}
+
+// Test a client reconnecting with Last-Event-ID only gets the frames it missed
+void test_gate_event_stream_resume() {
+    events->publish("{\"n\":1}");
+    events->publish("{\"n\":2}");
+    events->publish("{\"n\":3}");
+
+    std::string stream;
+    int client = subscribe("1", stream);
+    TEST_ASSERT_TRUE(readUntil(client, stream, "id: 3\nevent: status\ndata: {\"n\":3}\n\n"));
+    TEST_ASSERT_TRUE(stream.find("id: 2\nevent: status\ndata: {\"n\":2}\n\n") != std::string::npos);
+    TEST_ASSERT_TRUE(stream.find("{\"n\":1}") == std::string::npos);
+    TEST_ASSERT_TRUE(stream.find("{\"state\":true}") == std::string::npos);
+    close(client);
+
+    // Already up to date: nothing replayed
+    std::string current;
+    client = subscribe("3", current);
+    TEST_ASSERT_FALSE(readUntil(client, current, "data:"));
+    close(client);
+}
+
+// Test an id older than the history (or from a previous boot) falls back to the current state
+void test_gate_event_stream_resume_too_old() {
+    for (int i = 0; i < GATE_EVENTS_HISTORY + 2; i++) {
+        events->publish("{\"n\":" + String(i) + "}");
+    }
+
+    std::string stream;
+    int client = subscribe("1", stream);
+    String expected = "id: " + String(GATE_EVENTS_HISTORY + 2) + "\nevent: status\ndata: {\"state\":true}\n\n";
+    TEST_ASSERT_TRUE(readUntil(client, stream, expected.c_str()));
+    close(client);
+
+    std::string future;
+    client = subscribe("4000000000", future);
+    TEST_ASSERT_TRUE(readUntil(client, future, "{\"state\":true}"));
+    close(client);
+}
+
+// Test subscribers beyond the limit get a 503, the slot is reused once a client leaves
+void test_gate_event_stream_subscriber_limit() {
+    int clients[GATE_EVENTS_MAX_SUBSCRIBERS];
+    for (int i = 0; i < GATE_EVENTS_MAX_SUBSCRIBERS; i++) {
+        std::string stream;
+        clients[i] = subscribe(nullptr, stream);
+    }
+
+    std::string refused;
+    int extra = subscribe(nullptr, refused);
+    TEST_ASSERT_TRUE(refused.find("HTTP/1.1 503") == 0);
+    TEST_ASSERT_TRUE(refused.find("Retry-After: 3") != std::string::npos);
+    close(extra);
+
+    // Server notices the close, the next subscriber takes the slot
+    close(clients[0]);
+    for (int i = 0; i < 20; i++) {
+        server->poll(1);
+    }
+    TEST_ASSERT_EQUAL(GATE_EVENTS_MAX_SUBSCRIBERS - 1, events->subscriberCount());
+    std::string accepted;
+    clients[0] = subscribe(nullptr, accepted);
+    TEST_ASSERT_TRUE(accepted.find("HTTP/1.1 200") == 0);
+
+    for (int i = 0; i < GATE_EVENTS_MAX_SUBSCRIBERS; i++) {
+        close(clients[i]);
+    }
+}
+
+// Test idle streams receive a heartbeat comment
+void test_gate_event_stream_heartbeat() {
+    TEST_ASSERT_EQUAL(ULONG_MAX, events->getNextDeadline(millis()));
+
+    std::string stream;
+    int client = subscribe(nullptr, stream);
+    readUntil(client, stream, "{\"state\":true}");
+    TEST_ASSERT_EQUAL(GATE_EVENTS_HEARTBEAT_INTERVAL, events->getNextDeadline(millis()));
+
+    setMockMillis(GATE_EVENTS_HEARTBEAT_INTERVAL - 1);
+    events->loop(millis());
+    TEST_ASSERT_FALSE(readUntil(client, stream, ":\n\n"));
+
+    setMockMillis(GATE_EVENTS_HEARTBEAT_INTERVAL);
+    TEST_ASSERT_EQUAL(0, events->getNextDeadline(millis()));
+    events->loop(millis());
+    TEST_ASSERT_TRUE(readUntil(client, stream, "}\n\n:\n\n"));
+    TEST_ASSERT_EQUAL(GATE_EVENTS_HEARTBEAT_INTERVAL, events->getNextDeadline(millis()));
+    close(client);
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_gate_event_stream_publish);
+    RUN_TEST(test_gate_event_stream_resume);
+    RUN_TEST(test_gate_event_stream_resume_too_old);
+    RUN_TEST(test_gate_event_stream_subscriber_limit);
+    RUN_TEST(test_gate_event_stream_heartbeat);
+
+    return UNITY_END();
+}
@@ -110,14 +110,18 @@ void test_gate_monitor_auto_close_activation() {
 // Test auto-close trigger
 void test_gate_monitor_auto_close_trigger() {
 #ifdef UNIT_TEST
-    setMockMillis(1000);
-    
-    // Enable auto-close
-    gateMonitor->enableAutoClose();
+    // Gate closed first: the fixture leaves both sensors released (UNKNOWN)
+    setMockMillis(500);
+    setMockPinValue(SENSOR_CLOSED_PIN, LOW);
+    setMockPinValue(SENSOR_OPEN_PIN, HIGH);
+    gateMonitor->update();
     
-    // Simulate gate is open
+    // Gate opens: auto-close armed on the transition
+    setMockMillis(1000);
     setMockPinValue(SENSOR_CLOSED_PIN, HIGH);
     setMockPinValue(SENSOR_OPEN_PIN, LOW);
+    gateMonitor->update();
+    TEST_ASSERT_TRUE(gateMonitor->isAutoCloseEnabled());
     
     // Advance time beyond auto-close delay
     setMockMillis(1000 + AUTO_CLOSE_DELAY + 1000);
@@ -148,6 +152,90 @@ void test_gate_monitor_remaining_times() {
 #endif
 }
 
+// Test an edge captured before the timeout completes the operation even if the loop sees it late
+void test_gate_monitor_edge_capture_completion() {
+#ifdef UNIT_TEST
+    // Gate closed, interrupt capture running
+    setMockPinValue(SENSOR_CLOSED_PIN, LOW);
+    setMockPinValue(SENSOR_OPEN_PIN, HIGH);
+    SensorEdgeCapture& capture = gateController->getSensorCapture();
+    capture.begin();
+    setMockMillis(1000);
+    gateMonitor->update();
+    
+    gateMonitor->startOperation(OPENING, OPEN);
+    
+    // Gate reaches the open sensor just before the timeout...
+    unsigned long edgeAt = (1000 + OPENING_TIMEOUT - 100) * 1000UL;
+    capture.pushEdge(SensorEdgeCapture::SENSOR_CLOSED, HIGH, edgeAt - 2000000UL);
+    capture.pushEdge(SensorEdgeCapture::SENSOR_OPEN, LOW, edgeAt);
+    
+    // ...but the loop only runs well after it
+    setMockMillis(1000 + OPENING_TIMEOUT + 500);
+    gateMonitor->update();
+    
+    TEST_ASSERT_FALSE(gateMonitor->isOperationInProgress());
+    TEST_ASSERT_FALSE(gateMonitor->isAlertActive());
+    TEST_ASSERT_TRUE(gateMonitor->isAutoCloseEnabled());
+#endif
+}
+
+// Test the loop deadline follows sensor polling, the operation timeout and auto-close
+void test_gate_monitor_next_deadline() {
+#ifdef UNIT_TEST
+    setMockMillis(1000);
+    
+    // No edge capture: sensors are polled
+    TEST_ASSERT_EQUAL(SENSOR_POLL_INTERVAL, gateMonitor->getNextDeadline(millis()));
+    
+    // With edge capture, a running operation wakes the loop at its timeout
+    setMockPinValue(SENSOR_CLOSED_PIN, LOW);
+    setMockPinValue(SENSOR_OPEN_PIN, HIGH);
+    gateController->getSensorCapture().begin();
+    gateMonitor->update();
+    gateMonitor->startOperation(OPENING, OPEN);
+    setMockMillis(3000);
+    TEST_ASSERT_EQUAL(OPENING_TIMEOUT - 2000, gateMonitor->getNextDeadline(millis()));
+    
+    // Gate opened: next deadline is auto-close
+    gateController->getSensorCapture().pushEdge(SensorEdgeCapture::SENSOR_CLOSED, HIGH, millis() * 1000UL);
+    gateController->getSensorCapture().pushEdge(SensorEdgeCapture::SENSOR_OPEN, LOW, millis() * 1000UL);
+    TEST_ASSERT_EQUAL(0, gateMonitor->getNextDeadline(millis()));
+    setMockMillis(3000 + SENSOR_DEBOUNCE_US / 1000);
+    gateMonitor->update();
+    TEST_ASSERT_FALSE(gateMonitor->isOperationInProgress());
+    TEST_ASSERT_EQUAL(AUTO_CLOSE_DELAY, gateMonitor->getNextDeadline(millis()));
+#endif
+}
+
+// Test every change an event stream client would see bumps the version
+void test_gate_monitor_version() {
+#ifdef UNIT_TEST
+    setMockMillis(1000);
+    uint32_t version = gateMonitor->getVersion();
+    
+    // Nothing changed
+    gateMonitor->update();
+    TEST_ASSERT_EQUAL(version, gateMonitor->getVersion());
+    
+    gateMonitor->startOperation(OPENING, OPEN);
+    TEST_ASSERT_TRUE(gateMonitor->getVersion() > version);
+    version = gateMonitor->getVersion();
+    
+    // Gate opens: operation completes and the auto-close countdown starts
+    setMockPinValue(SENSOR_CLOSED_PIN, HIGH);
+    setMockPinValue(SENSOR_OPEN_PIN, LOW);
+    gateMonitor->update();
+    TEST_ASSERT_TRUE(gateMonitor->isAutoCloseEnabled());
+    TEST_ASSERT_TRUE(gateMonitor->getVersion() > version);
+    version = gateMonitor->getVersion();
+    
+    setMockMillis(2000);
+    gateMonitor->update();
+    TEST_ASSERT_EQUAL(version, gateMonitor->getVersion());
+#endif
+}
+
 int main() {
     UNITY_BEGIN();
     
@@ -158,6 +246,9 @@ int main() {
     RUN_TEST(test_gate_monitor_auto_close_activation);
     RUN_TEST(test_gate_monitor_auto_close_trigger);
     RUN_TEST(test_gate_monitor_remaining_times);
+    RUN_TEST(test_gate_monitor_edge_capture_completion);
+    RUN_TEST(test_gate_monitor_next_deadline);
+    RUN_TEST(test_gate_monitor_version);
     
     return UNITY_END();
 }
\ No newline at end of file
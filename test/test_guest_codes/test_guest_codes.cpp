@@ -0,0 +1,246 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/GuestCodes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+// 2026-10-17 12:00:00 UTC, at the start of a TOTP step
+const int64_t NOW = 1792238400;
+const int64_t STEP = NOW / GUEST_TOTP_STEP;
+
+// HMAC-SHA1 is mbedtls on the board: a plain reference implementation (FIPS 180-4, RFC 2104),
+// so hotp() is checked end to end against the RFC vectors
+int hmacCalls = 0;
+
+void sha1(const uint8_t* data, size_t length, uint8_t* digest) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    const size_t padded = ((length + 8) / 64 + 1) * 64;
+    for (size_t block = 0; block < padded; block += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            w[i] = 0;
+            for (int j = 0; j < 4; j++) {
+                const size_t at = block + i * 4 + j;
+                uint8_t byte = 0;
+                if (at < length) {
+                    byte = data[at];
+                } else if (at == length) {
+                    byte = 0x80;
+                } else if (at >= padded - 8) {
+                    byte = static_cast<uint8_t>((static_cast<uint64_t>(length) * 8) >> ((padded - 1 - at) * 8));
+                }
+                w[i] = (w[i] << 8) | byte;
+            }
+        }
+        for (int i = 16; i < 80; i++) {
+            const uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+            w[i] = (x << 1) | (x >> 31);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            } else if (i < 40) {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            } else if (i < 60) {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            } else {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            const uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = (b << 30) | (b >> 2);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+    for (int i = 0; i < 20; i++) {
+        digest[i] = static_cast<uint8_t>(h[i / 4] >> (24 - (i % 4) * 8));
+    }
+}
+
+bool GuestCodes::hmacSha1(const uint8_t* key, size_t keyLength, const uint8_t* message, size_t length,
+                          uint8_t* mac) {
+    hmacCalls++;
+    // Keys longer than a block are never used here (GUEST_SECRET_MAX)
+    uint8_t inner[64 + 64];
+    uint8_t outer[64 + 20];
+    for (size_t i = 0; i < 64; i++) {
+        const uint8_t byte = i < keyLength ? key[i] : 0;
+        inner[i] = byte ^ 0x36;
+        outer[i] = byte ^ 0x5C;
+    }
+    memcpy(inner + 64, message, length);
+    sha1(inner, 64 + length, outer + 64);
+    sha1(outer, sizeof(outer), mac);
+    return true;
+}
+
+GuestCodes* guests;
+
+// Code of guest index for the given step, as an authenticator app would show it
+String codeFor(int index, int64_t step) {
+    const GuestCodes::Guest& guest = guests->guest(index);
+    char code[12];
+    snprintf(code, sizeof(code), "%06lu",
+             static_cast<unsigned long>(GuestCodes::hotp(guest.secret, guest.secretLength, step)));
+    return String(code);
+}
+
+void setUp(void) {
+    resetMockState();
+    hmacCalls = 0;
+    guests = new GuestCodes();
+}
+
+void tearDown(void) {
+    delete guests;
+    guests = nullptr;
+}
+
+// Test entries are parsed, base32 decoded and malformed ones skipped
+void test_guest_codes_load() {
+    TEST_ASSERT_EQUAL(3, guests->load("plumber:JBSWY3DPEHPK3PXP;nanny:gezdgnbv gy3tqojq:1792000000:1793000000:10;"
+                                      "bad entry;nosecret:;dog-sitter:MFRGGZDF::1800000000"));
+    TEST_ASSERT_EQUAL_STRING("plumber", guests->guest(0).label);
+    TEST_ASSERT_EQUAL(10, guests->guest(0).secretLength);
+    TEST_ASSERT_EQUAL_UINT8('H', guests->guest(0).secret[0]);
+    TEST_ASSERT_EQUAL(0, guests->guest(0).maxUses);
+
+    TEST_ASSERT_EQUAL_STRING("nanny", guests->guest(1).label);
+    TEST_ASSERT_EQUAL_UINT8('1', guests->guest(1).secret[0]);
+    TEST_ASSERT_EQUAL(1792000000, guests->guest(1).validFrom);
+    TEST_ASSERT_EQUAL(1793000000, guests->guest(1).validUntil);
+    TEST_ASSERT_EQUAL(10, guests->guest(1).maxUses);
+
+    TEST_ASSERT_EQUAL(0, guests->guest(2).validFrom);
+    TEST_ASSERT_EQUAL(1800000000, guests->guest(2).validUntil);
+
+    TEST_ASSERT_EQUAL(0, guests->load(nullptr));
+}
+
+// Test the current code and its neighbours are accepted once, then refused as replays
+void test_guest_codes_accept_once() {
+    guests->load("plumber:JBSWY3DPEHPK3PXP;nanny:GEZDGNBVGY3TQOJQ");
+    int index;
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_INVALID_CODE, guests->verify("000000", NOW, index));
+    TEST_ASSERT_FALSE(guests->hasUnsavedUsage());
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_ACCEPTED, guests->verify(codeFor(1, STEP).c_str(), NOW, index));
+    TEST_ASSERT_EQUAL(1, index);
+    // Saved later by the network loop, not on the request path
+    TEST_ASSERT_TRUE(guests->hasUnsavedUsage());
+    TEST_ASSERT_TRUE(guests->guest(1).unsaved);
+    TEST_ASSERT_FALSE(guests->guest(0).unsaved);
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_REPLAYED, guests->verify(codeFor(1, STEP).c_str(), NOW + 5, index));
+    TEST_ASSERT_EQUAL(1, index);
+    // Older than the last accepted one: refused too
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_REPLAYED, guests->verify(codeFor(1, STEP - 1).c_str(), NOW + 5, index));
+
+    // Clock drift: one step ahead is fine, two are not
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_ACCEPTED, guests->verify(codeFor(0, STEP + 1).c_str(), NOW, index));
+    TEST_ASSERT_EQUAL(0, index);
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_INVALID_CODE, guests->verify(codeFor(0, STEP + 3).c_str(), NOW, index));
+    TEST_ASSERT_EQUAL(-1, index);
+
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_INVALID_CODE, guests->verify("12345", NOW, index));
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_INVALID_CODE, guests->verify("12a456", NOW, index));
+    TEST_ASSERT_EQUAL(2, guests->getStats().accepted);
+    TEST_ASSERT_EQUAL(6, guests->getStats().rejected);
+}
+
+// Test the validity window and the usage limit
+void test_guest_codes_limits() {
+    char spec[96];
+    snprintf(spec, sizeof(spec), "early:JBSWY3DP:%lld:0;late:GEZDGNBV:0:%lld;once:MFRGGZDF:::1",
+             static_cast<long long>(NOW + 3600), static_cast<long long>(NOW));
+    guests->load(spec);
+    int index;
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_NOT_YET_VALID, guests->verify(codeFor(0, STEP).c_str(), NOW, index));
+    TEST_ASSERT_EQUAL(0, index);
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_EXPIRED, guests->verify(codeFor(1, STEP).c_str(), NOW, index));
+    TEST_ASSERT_EQUAL(1, index);
+
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_ACCEPTED, guests->verify(codeFor(2, STEP).c_str(), NOW, index));
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_USED_UP,
+                      guests->verify(codeFor(2, STEP + 2).c_str(), NOW + 2 * GUEST_TOTP_STEP, index));
+    TEST_ASSERT_EQUAL_STRING("Guest access used up", GuestCodes::describe(GuestCodes::GUEST_USED_UP));
+
+    // Counters restored after a reboot
+    guests->load(spec);
+    guests->restoreUsage(2, 1, STEP);
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_USED_UP, guests->verify(codeFor(2, STEP + 1).c_str(), NOW, index));
+}
+
+// Test codes are only recomputed when the step changes, and then only the new one
+void test_guest_codes_cached_steps() {
+    guests->load("plumber:JBSWY3DPEHPK3PXP;nanny:GEZDGNBVGY3TQOJQ");
+    int index;
+    guests->verify("000000", NOW, index);
+    const int window = 2 * GUEST_TOTP_DRIFT + 1;
+    TEST_ASSERT_EQUAL(2 * window, hmacCalls);
+
+    // Same step: compares only
+    guests->verify("000000", NOW + GUEST_TOTP_STEP - 1, index);
+    TEST_ASSERT_EQUAL(2 * window, hmacCalls);
+
+    // Next step: one new code per guest, the shifted ones still match
+    guests->verify("000000", NOW + GUEST_TOTP_STEP, index);
+    TEST_ASSERT_EQUAL(2 * window + 2, hmacCalls);
+    hmacCalls = 0;
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_ACCEPTED,
+                      guests->verify(codeFor(0, STEP).c_str(), NOW + GUEST_TOTP_STEP, index));
+
+    // Long silence: everything recomputed
+    hmacCalls = 0;
+    guests->verify("000000", NOW + 3600, index);
+    TEST_ASSERT_EQUAL(2 * window, hmacCalls);
+}
+
+// Test RFC 4226 Appendix D: secret "12345678901234567890", counters 0 to 9
+void test_guest_codes_rfc4226_vectors() {
+    const uint8_t* secret = reinterpret_cast<const uint8_t*>("12345678901234567890");
+    const uint32_t expected[] = {755224, 287082, 359152, 969429, 338314, 254676, 287922, 162583, 399871, 520489};
+    for (uint64_t counter = 0; counter < 10; counter++) {
+        TEST_ASSERT_EQUAL_UINT32(expected[counter], GuestCodes::hotp(secret, 20, counter));
+    }
+
+    // RFC 6238 Appendix B (SHA-1, T0 = 0, 30 s steps), last six digits: same secret in base32
+    guests->load("rfc:GEZDGNBVGY3TQOJQGEZDGNBVGY3TQOJQ");
+    TEST_ASSERT_EQUAL(20, guests->guest(0).secretLength);
+    int index;
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_ACCEPTED, guests->verify("287082", 59, index));
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_ACCEPTED, guests->verify("081804", 1111111109, index));
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_ACCEPTED, guests->verify("050471", 1111111111, index));
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_ACCEPTED, guests->verify("005924", 1234567890, index));
+    TEST_ASSERT_EQUAL(GuestCodes::GUEST_ACCEPTED, guests->verify("279037", 2000000000, index));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_guest_codes_load);
+    RUN_TEST(test_guest_codes_accept_once);
+    RUN_TEST(test_guest_codes_limits);
+    RUN_TEST(test_guest_codes_cached_steps);
+    RUN_TEST(test_guest_codes_rfc4226_vectors);
+
+    return UNITY_END();
+}
@@ -0,0 +1,191 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/JsonWriter.h"
+
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unity.h>
+
+// Every heap allocation of the test binary goes through here
+static unsigned long allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* pointer = malloc(size ? size : 1);
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+char buffer[512];
+
+void setUp(void) {
+    memset(buffer, 0, sizeof(buffer));
+}
+
+void tearDown(void) {
+}
+
+// Test nested objects and arrays get their commas and braces
+void test_json_writer_nesting() {
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.field("id", "main").field("version", 12).field("open", true);
+    json.beginArray("routes").value("/a").value("/b").endArray();
+    json.beginObject("http").field("requests", 3UL).field("delta", -4L).endObject();
+    json.beginArray("gates");
+    json.beginObject().field("n", 1).endObject();
+    json.beginObject().field("n", 2).endObject();
+    json.endArray();
+    json.field("missing", static_cast<const char*>(nullptr));
+    json.endObject();
+
+    TEST_ASSERT_FALSE(json.overflowed());
+    TEST_ASSERT_EQUAL_STRING("{\"id\":\"main\",\"version\":12,\"open\":true,\"routes\":[\"/a\",\"/b\"],"
+                             "\"http\":{\"requests\":3,\"delta\":-4},\"gates\":[{\"n\":1},{\"n\":2}],"
+                             "\"missing\":null}", json.c_str());
+    TEST_ASSERT_EQUAL(strlen(json.c_str()), json.length());
+}
+
+// Test quotes, backslashes and control characters are escaped, UTF-8 passes through
+void test_json_writer_escaping() {
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.field("message", "Invalid \"kid\" in C:\\keys\n\tnext\x01");
+    json.field("name", String("Zoé"));
+    json.field("quo\"te", false);
+    json.endObject();
+
+    TEST_ASSERT_EQUAL_STRING("{\"message\":\"Invalid \\\"kid\\\" in C:\\\\keys\\n\\tnext\\u0001\","
+                             "\"name\":\"Zoé\",\"quo\\\"te\":false}", json.c_str());
+}
+
+// Test a cached prefix can be resumed and raw documents embedded
+void test_json_writer_resume_and_raw() {
+    char cache[64];
+    JsonWriter prefix(cache, sizeof(cache));
+    prefix.beginObject().field("status", "open");
+
+    JsonWriter json(buffer, sizeof(buffer));
+    json.beginObject();
+    json.resumeObject("gate", cache, prefix.length());
+    json.field("auto_close_remaining", 1500);
+    json.endObject();
+    json.rawField("raw", "[1,2]", 5);
+    json.endObject();
+
+    TEST_ASSERT_EQUAL_STRING("{\"gate\":{\"status\":\"open\",\"auto_close_remaining\":1500},\"raw\":[1,2]}",
+                             json.c_str());
+}
+
+// Test an undersized buffer flags the overflow and stays a valid C string
+void test_json_writer_overflow() {
+    char small[16];
+    JsonWriter json(small, sizeof(small));
+    json.beginObject().field("status", "opening").endObject();
+
+    TEST_ASSERT_TRUE(json.overflowed());
+    TEST_ASSERT_TRUE(json.length() < sizeof(small));
+    TEST_ASSERT_EQUAL(json.length(), strlen(json.c_str()));
+
+    json.reset();
+    TEST_ASSERT_FALSE(json.overflowed());
+    json.beginObject().endObject();
+    TEST_ASSERT_EQUAL_STRING("{}", json.c_str());
+}
+
+// A gate status built the way buildStatusJson used to
+static String statusWithString(unsigned long version, unsigned long remaining) {
+    String json = "{";
+    json += "\"gate_id\":\"" + String("main") + "\",";
+    json += "\"version\":" + String(version) + ",";
+    json += "\"status\":\"open\",";
+    json += "\"sensor_closed\":" + String(false ? "true" : "false") + ",";
+    json += "\"sensor_open\":" + String(true ? "true" : "false") + ",";
+    json += "\"alert_active\":" + String(false ? "true" : "false") + ",";
+    json += "\"auto_close_enabled\":" + String(true ? "true" : "false");
+    json += ",\"auto_close_remaining\":" + String(remaining);
+    json += "}";
+    return json;
+}
+
+static size_t statusWithWriter(char* output, size_t size, unsigned long version, unsigned long remaining) {
+    JsonWriter json(output, size);
+    json.beginObject();
+    json.field("gate_id", "main");
+    json.field("version", version);
+    json.field("status", "open");
+    json.field("sensor_closed", false);
+    json.field("sensor_open", true);
+    json.field("alert_active", false);
+    json.field("auto_close_enabled", true);
+    json.field("auto_close_remaining", remaining);
+    json.endObject();
+    return json.length();
+}
+
+// Micro-benchmark: heap allocations and time per status document, String vs JsonWriter
+void test_json_writer_allocations() {
+    const int iterations = 20000;
+
+    // Same document either way
+    String reference = statusWithString(42, 1500);
+    char document[256];
+    size_t length = statusWithWriter(document, sizeof(document), 42, 1500);
+    TEST_ASSERT_EQUAL_STRING(reference.c_str(), document);
+    TEST_ASSERT_EQUAL(reference.length(), length);
+
+    unsigned long before = allocations;
+    auto start = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int i = 0; i < iterations; i++) {
+        total += statusWithString(i, 1500).length();
+    }
+    double stringNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    unsigned long stringAllocations = allocations - before;
+
+    before = allocations;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        total += statusWithWriter(document, sizeof(document), i, 1500);
+    }
+    double writerNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    unsigned long writerAllocations = allocations - before;
+
+    printf("[Bench] status JSON, %d documents: String %.1f allocations %.0f ns each, JsonWriter %.1f allocations %.0f ns each (%lu bytes)\n",
+           iterations, static_cast<double>(stringAllocations) / iterations, stringNs / iterations,
+           static_cast<double>(writerAllocations) / iterations, writerNs / iterations,
+           static_cast<unsigned long>(total));
+
+    TEST_ASSERT_TRUE(stringAllocations >= static_cast<unsigned long>(iterations));
+    TEST_ASSERT_EQUAL(0, writerAllocations);
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_json_writer_nesting);
+    RUN_TEST(test_json_writer_escaping);
+    RUN_TEST(test_json_writer_resume_and_raw);
+    RUN_TEST(test_json_writer_overflow);
+    RUN_TEST(test_json_writer_allocations);
+
+    return UNITY_END();
+}
@@ -0,0 +1,103 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/MqttBatch.h"
+
+#include <limits.h>
+#include <string.h>
+
+#include <unity.h>
+
+MqttBatch* batch;
+
+void setUp(void) {
+    batch = new MqttBatch();
+}
+
+void tearDown(void) {
+    delete batch;
+    batch = nullptr;
+}
+
+// Test JSON records are published as one array, numbered after the newest record
+void test_mqtt_batch_json_array() {
+    batch->configure(MqttBatch::ENCODING_JSON, 2000);
+    TEST_ASSERT_TRUE(batch->isEmpty());
+    TEST_ASSERT_TRUE(batch->add(7, "{\"seq\":7}", 9, 1000));
+    TEST_ASSERT_TRUE(batch->add(8, "{\"seq\":8}", 9, 1500));
+
+    TEST_ASSERT_EQUAL(2, batch->count());
+    TEST_ASSERT_EQUAL(8, batch->lastSequence());
+    size_t length = batch->finish();
+    TEST_ASSERT_EQUAL(21, length);
+    TEST_ASSERT_EQUAL_MEMORY("[{\"seq\":7},{\"seq\":8}]", batch->payload(), length);
+
+    batch->clear();
+    TEST_ASSERT_TRUE(batch->isEmpty());
+    TEST_ASSERT_EQUAL(0, batch->finish());
+}
+
+// Test CBOR records go into an indefinite-length array
+void test_mqtt_batch_cbor_array() {
+    batch->configure(MqttBatch::ENCODING_CBOR, 2000);
+    const char first[] = "\xbf\x61\x61\x01\xff";  // {"a":1}
+    const char second[] = "\xbf\x61\x61\x02\xff"; // {"a":2}
+    TEST_ASSERT_TRUE(batch->add(1, first, 5, 0));
+    TEST_ASSERT_TRUE(batch->add(2, second, 5, 0));
+
+    size_t length = batch->finish();
+    TEST_ASSERT_EQUAL(12, length);
+    TEST_ASSERT_EQUAL_MEMORY("\x9f\xbf\x61\x61\x01\xff\xbf\x61\x61\x02\xff\xff", batch->payload(), length);
+}
+
+// Test the window starts with the first record, across a millis() wrap
+void test_mqtt_batch_window() {
+    batch->configure(MqttBatch::ENCODING_JSON, 2000);
+    TEST_ASSERT_FALSE(batch->isDue(0));
+    TEST_ASSERT_EQUAL(ULONG_MAX, batch->timeUntilDue(0));
+
+    unsigned long start = ULONG_MAX - 500;
+    batch->add(1, "{}", 2, start);
+    batch->add(2, "{}", 2, start + 1000);
+    TEST_ASSERT_FALSE(batch->isDue(start + 1999));
+    TEST_ASSERT_EQUAL(500, batch->timeUntilDue(start + 1500));
+    TEST_ASSERT_TRUE(batch->isDue(start + 2000));
+    TEST_ASSERT_EQUAL(0, batch->timeUntilDue(start + 2500));
+}
+
+// Test a record that would overflow the batch is refused, the batch stays publishable
+void test_mqtt_batch_full() {
+    batch->configure(MqttBatch::ENCODING_JSON, 2000);
+    char record[EMQX_MESSAGE_BUFFER_SIZE];
+    memset(record, 'x', sizeof(record));
+
+    int added = 0;
+    while (batch->add(added + 1, record, sizeof(record), 0)) {
+        added++;
+    }
+    TEST_ASSERT_EQUAL(MQTT_BATCH_MAX_SIZE / (EMQX_MESSAGE_BUFFER_SIZE + 1), added);
+    TEST_ASSERT_EQUAL(added, batch->count());
+
+    size_t length = batch->finish();
+    TEST_ASSERT_TRUE(length <= MQTT_BATCH_MAX_SIZE);
+    TEST_ASSERT_EQUAL('[', batch->payload()[0]);
+    TEST_ASSERT_EQUAL(']', batch->payload()[length - 1]);
+
+    // A single record always fits in an empty batch
+    batch->clear();
+    TEST_ASSERT_TRUE(batch->add(1, record, sizeof(record), 0));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_mqtt_batch_json_array);
+    RUN_TEST(test_mqtt_batch_cbor_array);
+    RUN_TEST(test_mqtt_batch_window);
+    RUN_TEST(test_mqtt_batch_full);
+
+    return UNITY_END();
+}
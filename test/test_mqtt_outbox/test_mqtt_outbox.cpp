@@ -0,0 +1,176 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/MqttOutbox.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <unity.h>
+
+// Spill file in the working directory (LittleFS on the board)
+const char* SPILL_PATH = "test_mqtt_outbox.bin";
+
+MqttOutbox* outbox;
+
+bool pushMessage(uint8_t topic = 0) {
+    char payload[32];
+    uint32_t sequence = outbox->nextSequence();
+    int length = snprintf(payload, sizeof(payload), "{\"seq\":%lu}", static_cast<unsigned long>(sequence));
+    return outbox->push(sequence, topic, payload, length);
+}
+
+// Pops messages while their sequence numbers and payloads follow on from first, returns how many
+uint32_t drain(uint32_t first) {
+    uint32_t expected = first;
+    const MqttOutbox::Entry* entry;
+    while ((entry = outbox->front()) != nullptr) {
+        char payload[32];
+        int length = snprintf(payload, sizeof(payload), "{\"seq\":%lu}", static_cast<unsigned long>(expected));
+        if (entry->sequence != expected || entry->length != length || memcmp(payload, entry->payload, length) != 0) {
+            break;
+        }
+        outbox->pop();
+        expected++;
+    }
+    return expected - first;
+}
+
+void setUp(void) {
+    resetMockState();
+    remove(SPILL_PATH);
+    outbox = new MqttOutbox();
+    outbox->begin(SPILL_PATH);
+}
+
+void tearDown(void) {
+    delete outbox;
+    outbox = nullptr;
+    remove(SPILL_PATH);
+}
+
+// Test messages stay queued until popped and come out in order
+void test_mqtt_outbox_fifo() {
+    TEST_ASSERT_NULL(outbox->front());
+    TEST_ASSERT_TRUE(pushMessage(0));
+    TEST_ASSERT_TRUE(pushMessage(1));
+
+    const MqttOutbox::Entry* entry = outbox->front();
+    TEST_ASSERT_NOT_NULL(entry);
+    TEST_ASSERT_EQUAL(1, entry->sequence);
+    TEST_ASSERT_EQUAL(0, entry->topic);
+    // Not published: still first in line
+    TEST_ASSERT_EQUAL(1, outbox->front()->sequence);
+
+    outbox->pop();
+    TEST_ASSERT_EQUAL(2, outbox->front()->sequence);
+    TEST_ASSERT_EQUAL(1, outbox->front()->topic);
+    outbox->pop();
+    TEST_ASSERT_TRUE(outbox->isEmpty());
+    TEST_ASSERT_EQUAL(2, outbox->getStats().sent);
+    TEST_ASSERT_EQUAL(0, outbox->getStats().spilled);
+}
+
+// Test a full RAM ring spills to the file, replay keeps the order and messages pushed meanwhile
+void test_mqtt_outbox_spill_order() {
+    const int total = MQTT_OUTBOX_RAM_ENTRIES * 3 + 2;
+    for (int i = 0; i < total; i++) {
+        TEST_ASSERT_TRUE(pushMessage());
+    }
+    TEST_ASSERT_EQUAL(total, outbox->depth());
+    TEST_ASSERT_EQUAL(total - MQTT_OUTBOX_RAM_ENTRIES, outbox->spilledDepth());
+    TEST_ASSERT_EQUAL(0, access(SPILL_PATH, F_OK));
+
+    // Partly replayed, then more messages while the file is still being read back
+    for (int i = 0; i < MQTT_OUTBOX_RAM_ENTRIES + 3; i++) {
+        TEST_ASSERT_EQUAL(i + 1, outbox->front()->sequence);
+        outbox->pop();
+    }
+    TEST_ASSERT_TRUE(pushMessage());
+    TEST_ASSERT_TRUE(pushMessage());
+
+    TEST_ASSERT_EQUAL(total + 2 - (MQTT_OUTBOX_RAM_ENTRIES + 3), drain(MQTT_OUTBOX_RAM_ENTRIES + 4));
+    TEST_ASSERT_TRUE(outbox->isEmpty());
+    TEST_ASSERT_EQUAL(0, outbox->getStats().dropped);
+
+    // Drained: the file is gone, new messages go to RAM again
+    TEST_ASSERT_EQUAL(-1, access(SPILL_PATH, F_OK));
+    TEST_ASSERT_TRUE(pushMessage());
+    TEST_ASSERT_EQUAL(0, outbox->spilledDepth());
+}
+
+// Test the spill file survives a reboot, numbering continues after it
+void test_mqtt_outbox_replay_after_reboot() {
+    for (int i = 0; i < MQTT_OUTBOX_RAM_ENTRIES + 5; i++) {
+        pushMessage();
+    }
+    // RAM content is lost with the reboot, the spilled messages are not
+    delete outbox;
+    outbox = new MqttOutbox();
+    outbox->begin(SPILL_PATH);
+
+    TEST_ASSERT_EQUAL(5, outbox->depth());
+    TEST_ASSERT_EQUAL(MQTT_OUTBOX_RAM_ENTRIES + 6, outbox->nextSequence());
+    TEST_ASSERT_EQUAL(5, drain(MQTT_OUTBOX_RAM_ENTRIES + 1));
+}
+
+// Test a record cut by a power loss is discarded, the ones before it are kept
+void test_mqtt_outbox_partial_record() {
+    for (int i = 0; i < MQTT_OUTBOX_RAM_ENTRIES + 3; i++) {
+        pushMessage();
+    }
+    delete outbox;
+    FILE* file = fopen(SPILL_PATH, "ab");
+    const char partial[] = "\x20\x00\x00";
+    fwrite(partial, 3, 1, file);
+    fclose(file);
+
+    outbox = new MqttOutbox();
+    outbox->begin(SPILL_PATH);
+    TEST_ASSERT_EQUAL(3, outbox->depth());
+
+    // Appending behind the repaired file still reads back
+    TEST_ASSERT_TRUE(pushMessage());
+    TEST_ASSERT_EQUAL(4, drain(MQTT_OUTBOX_RAM_ENTRIES + 1));
+}
+
+// Test messages are dropped and counted once RAM and the spill file are full
+void test_mqtt_outbox_full() {
+    delete outbox;
+    remove(SPILL_PATH);
+    outbox = new MqttOutbox(40); // Room for two spilled records (8-byte header + {"seq":N})
+    outbox->begin(SPILL_PATH);
+
+    for (int i = 0; i < MQTT_OUTBOX_RAM_ENTRIES + 2; i++) {
+        TEST_ASSERT_TRUE(pushMessage());
+    }
+    TEST_ASSERT_FALSE(pushMessage());
+    TEST_ASSERT_EQUAL(1, outbox->getStats().dropped);
+    TEST_ASSERT_EQUAL(MQTT_OUTBOX_RAM_ENTRIES + 2, outbox->depth());
+
+    // RAM only: nothing beyond the ring
+    delete outbox;
+    outbox = new MqttOutbox();
+    outbox->begin(nullptr);
+    for (int i = 0; i < MQTT_OUTBOX_RAM_ENTRIES; i++) {
+        TEST_ASSERT_TRUE(pushMessage());
+    }
+    TEST_ASSERT_FALSE(pushMessage());
+    TEST_ASSERT_EQUAL(MQTT_OUTBOX_RAM_ENTRIES, drain(1));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_mqtt_outbox_fifo);
+    RUN_TEST(test_mqtt_outbox_spill_order);
+    RUN_TEST(test_mqtt_outbox_replay_after_reboot);
+    RUN_TEST(test_mqtt_outbox_partial_record);
+    RUN_TEST(test_mqtt_outbox_full);
+
+    return UNITY_END();
+}
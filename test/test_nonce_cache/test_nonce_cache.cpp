@@ -0,0 +1,83 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/NonceCache.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <unity.h>
+
+const int64_t NOW = 1760695200;
+
+NonceCache* cache;
+
+void setUp(void) {
+    cache = new NonceCache(30);
+}
+
+void tearDown(void) {
+    delete cache;
+    cache = nullptr;
+}
+
+// Test a nonce is accepted once, a replay within the window is refused
+void test_nonce_cache_replay() {
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_ACCEPTED, cache->check("a1b2c3", NOW, NOW));
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_REPLAYED, cache->check("a1b2c3", NOW, NOW + 5));
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_ACCEPTED, cache->check("a1b2c4", NOW, NOW + 5));
+}
+
+// Test timestamps too far in the past or the future are refused, bounds included
+void test_nonce_cache_window() {
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_EXPIRED, cache->check("old", NOW - 31, NOW));
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_EXPIRED, cache->check("future", NOW + 31, NOW));
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_ACCEPTED, cache->check("edge1", NOW - 30, NOW));
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_ACCEPTED, cache->check("edge2", NOW + 30, NOW));
+
+    // Once its timestamp has left the window, a replay is refused as expired
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_EXPIRED, cache->check("edge1", NOW - 30, NOW + 1));
+}
+
+// Test empty and oversized nonces
+void test_nonce_cache_invalid() {
+    char longNonce[MQTT_COMMAND_NONCE_MAX + 2];
+    memset(longNonce, 'n', sizeof(longNonce) - 1);
+    longNonce[sizeof(longNonce) - 1] = '\0';
+
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_INVALID, cache->check("", NOW, NOW));
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_INVALID, cache->check(nullptr, NOW, NOW));
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_INVALID, cache->check(longNonce, NOW, NOW));
+    longNonce[MQTT_COMMAND_NONCE_MAX] = '\0';
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_ACCEPTED, cache->check(longNonce, NOW, NOW));
+}
+
+// Test live nonces are never evicted: a full table refuses, slots free up as the window moves
+void test_nonce_cache_full() {
+    char nonce[16];
+    for (int i = 0; i < MQTT_COMMAND_NONCE_SLOTS; i++) {
+        snprintf(nonce, sizeof(nonce), "n%d", i);
+        TEST_ASSERT_EQUAL(NonceCache::NONCE_ACCEPTED, cache->check(nonce, NOW + i, NOW));
+    }
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_FULL, cache->check("extra", NOW, NOW));
+    // Every stored nonce is still detected
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_REPLAYED, cache->check("n0", NOW, NOW));
+
+    // n0 (timestamp NOW) expires first
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_ACCEPTED, cache->check("extra", NOW + 31, NOW + 31));
+    TEST_ASSERT_EQUAL(NonceCache::NONCE_FULL, cache->check("extra2", NOW + 31, NOW + 31));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_nonce_cache_replay);
+    RUN_TEST(test_nonce_cache_window);
+    RUN_TEST(test_nonce_cache_invalid);
+    RUN_TEST(test_nonce_cache_full);
+
+    return UNITY_END();
+}
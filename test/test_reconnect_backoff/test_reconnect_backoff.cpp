@@ -0,0 +1,73 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/ReconnectBackoff.h"
+
+#include <unity.h>
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+// Test the ceiling doubles with each failure, bounded by the cap
+void test_reconnect_backoff_growth() {
+    ReconnectBackoff backoff(1000, 10000);
+
+    // Largest random value: the delay is the ceiling itself
+    TEST_ASSERT_EQUAL(1000, backoff.nextDelay(1000 - 500));
+    TEST_ASSERT_EQUAL(2000, backoff.nextDelay(2000 - 1000));
+    TEST_ASSERT_EQUAL(4000, backoff.nextDelay(4000 - 2000));
+    TEST_ASSERT_EQUAL(8000, backoff.nextDelay(8000 - 4000));
+    TEST_ASSERT_EQUAL(10000, backoff.nextDelay(10000 - 5000));
+    TEST_ASSERT_EQUAL(5, backoff.failures());
+
+    // Stays at the cap, however many failures
+    for (int i = 0; i < 100; i++) {
+        backoff.nextDelay(0);
+    }
+    TEST_ASSERT_EQUAL(10000, backoff.nextDelay(5000));
+}
+
+// Test the jitter stays between half the ceiling and the ceiling
+void test_reconnect_backoff_jitter() {
+    ReconnectBackoff backoff(1000, 60000);
+    for (int failures = 0; failures < 10; failures++) {
+        unsigned long ceiling = 1000UL << failures;
+        if (ceiling > 60000) {
+            ceiling = 60000;
+        }
+        uint32_t random = 2654435761U * (failures + 1);
+        unsigned long delay = backoff.nextDelay(random);
+        TEST_ASSERT_TRUE(delay >= ceiling / 2);
+        TEST_ASSERT_TRUE(delay <= ceiling);
+    }
+    TEST_ASSERT_EQUAL(500, ReconnectBackoff(1000, 60000).nextDelay(0));
+}
+
+// Test reset() starts over from the base delay
+void test_reconnect_backoff_reset() {
+    ReconnectBackoff backoff(1000, 60000);
+    backoff.nextDelay(0);
+    backoff.nextDelay(0);
+    backoff.nextDelay(0);
+    TEST_ASSERT_EQUAL(4000, backoff.nextDelay(0));
+
+    backoff.reset();
+    TEST_ASSERT_EQUAL(0, backoff.failures());
+    TEST_ASSERT_EQUAL(500, backoff.nextDelay(0));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_reconnect_backoff_growth);
+    RUN_TEST(test_reconnect_backoff_jitter);
+    RUN_TEST(test_reconnect_backoff_reset);
+
+    return UNITY_END();
+}
@@ -0,0 +1,86 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/RejectedTokenCache.h"
+
+#include <string.h>
+#include <unity.h>
+
+RejectedTokenCache* cache;
+
+TokenFingerprint makeFingerprint(uint8_t seed) {
+    TokenFingerprint fingerprint;
+    memset(fingerprint.bytes, seed, sizeof(fingerprint.bytes));
+    return fingerprint;
+}
+
+void setUp(void) {
+#ifdef UNIT_TEST
+    resetMockState();
+#endif
+    cache = new RejectedTokenCache(60000);
+}
+
+void tearDown(void) {
+    delete cache;
+    cache = nullptr;
+}
+
+// Test a rejection is returned with its reason until the TTL elapses
+void test_rejected_token_cache_hit_and_expiry() {
+    String error;
+    TEST_ASSERT_FALSE(cache->lookup(makeFingerprint(1), error));
+
+    cache->store(makeFingerprint(1), ValidationResult::rejected("Token is expired"));
+    TEST_ASSERT_TRUE(cache->lookup(makeFingerprint(1), error));
+    TEST_ASSERT_EQUAL_STRING("Token is expired", error.c_str());
+    TEST_ASSERT_FALSE(cache->lookup(makeFingerprint(2), error));
+    TEST_ASSERT_EQUAL(1, cache->getStats().hits);
+
+    mockMillis += 60000;
+    TEST_ASSERT_FALSE(cache->lookup(makeFingerprint(1), error));
+    TEST_ASSERT_EQUAL(0, cache->size());
+}
+
+// Test the oldest rejection makes room, long reasons are truncated
+void test_rejected_token_cache_ring() {
+    for (int i = 0; i <= REJECTED_TOKEN_CACHE_SIZE; i++) {
+        cache->store(makeFingerprint(i), ValidationResult::rejected("Invalid token signature"));
+    }
+    String error;
+    TEST_ASSERT_FALSE(cache->lookup(makeFingerprint(0), error));
+    TEST_ASSERT_TRUE(cache->lookup(makeFingerprint(REJECTED_TOKEN_CACHE_SIZE), error));
+    TEST_ASSERT_EQUAL(REJECTED_TOKEN_CACHE_SIZE, cache->size());
+
+    cache->store(makeFingerprint(1),
+                 ValidationResult::rejected("Token audience does not include a-very-long-audience-name-for-this-test"));
+    TEST_ASSERT_TRUE(cache->lookup(makeFingerprint(1), error));
+    TEST_ASSERT_EQUAL(47, error.length());
+}
+
+// Test only definite rejections are kept: a token that couldn't be checked is retried next time
+void test_rejected_token_cache_skips_unavailable() {
+    ValidationResult undecided = ValidationResult::rejected("Unknown signing key: k1");
+    undecided.unavailable = true;
+    TEST_ASSERT_FALSE(cache->store(makeFingerprint(1), undecided));
+    TEST_ASSERT_FALSE(cache->store(makeFingerprint(2), ValidationResult::valid()));
+
+    String error;
+    TEST_ASSERT_FALSE(cache->lookup(makeFingerprint(1), error));
+    TEST_ASSERT_FALSE(cache->lookup(makeFingerprint(2), error));
+    TEST_ASSERT_EQUAL(0, cache->getStats().stored);
+    TEST_ASSERT_TRUE(cache->store(makeFingerprint(1), ValidationResult::rejected("Invalid token signature")));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_rejected_token_cache_hit_and_expiry);
+    RUN_TEST(test_rejected_token_cache_ring);
+    RUN_TEST(test_rejected_token_cache_skips_unavailable);
+
+    return UNITY_END();
+}
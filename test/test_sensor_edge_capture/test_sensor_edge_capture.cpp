@@ -0,0 +1,107 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/Config.h"
+#include "../src/components/SensorEdgeCapture.h"
+
+#include <unity.h>
+
+const uint8_t CLOSED_SENSOR = SensorEdgeCapture::SENSOR_CLOSED;
+const uint8_t OPEN_SENSOR = SensorEdgeCapture::SENSOR_OPEN;
+
+SensorEdgeCapture* capture;
+
+void setUp(void) {
+#ifdef UNIT_TEST
+    resetMockState();
+    // Gate closed at startup
+    setMockPinValue(SENSOR_CLOSED_PIN, LOW);
+    setMockPinValue(SENSOR_OPEN_PIN, HIGH);
+#endif
+    capture = new SensorEdgeCapture();
+    capture->begin();
+}
+
+void tearDown(void) {
+    delete capture;
+    capture = nullptr;
+}
+
+// Test the initial pin levels become the stable state
+void test_edge_capture_initial_state() {
+    SensorChange change;
+    TEST_ASSERT_EQUAL(CLOSED, capture->getStableState());
+    TEST_ASSERT_FALSE(capture->poll(1000000, change));
+}
+
+// Test a clean edge is reported once the debounce window has elapsed, with the edge time
+void test_edge_capture_debounced_change() {
+    SensorChange change;
+    capture->pushEdge(CLOSED_SENSOR, HIGH, 1000000);
+
+    TEST_ASSERT_FALSE(capture->poll(1000000 + SENSOR_DEBOUNCE_US - 1, change));
+    TEST_ASSERT_TRUE(capture->poll(1000000 + SENSOR_DEBOUNCE_US, change));
+    TEST_ASSERT_EQUAL(UNKNOWN, change.state);
+    TEST_ASSERT_EQUAL(1000000, change.timestamp);
+    TEST_ASSERT_FALSE(capture->poll(5000000, change));
+}
+
+// Test contact bounce keeps the first edge time and settles on the final level
+void test_edge_capture_bounce() {
+    SensorChange change;
+    capture->pushEdge(CLOSED_SENSOR, HIGH, 1000000);
+    TEST_ASSERT_TRUE(capture->poll(1000000 + SENSOR_DEBOUNCE_US, change));
+
+    capture->pushEdge(OPEN_SENSOR, LOW, 2000000);
+    capture->pushEdge(OPEN_SENSOR, HIGH, 2000300);
+    capture->pushEdge(OPEN_SENSOR, LOW, 2000900);
+
+    TEST_ASSERT_FALSE(capture->poll(2000900 + SENSOR_DEBOUNCE_US - 1, change));
+    TEST_ASSERT_TRUE(capture->poll(2000900 + SENSOR_DEBOUNCE_US, change));
+    TEST_ASSERT_EQUAL(OPEN, change.state);
+    TEST_ASSERT_EQUAL(2000000, change.timestamp);
+}
+
+// Test a glitch that returns to the stable level is not reported
+void test_edge_capture_glitch_filtered() {
+    SensorChange change;
+    capture->pushEdge(CLOSED_SENSOR, HIGH, 3000000);
+    capture->pushEdge(CLOSED_SENSOR, LOW, 3000200);
+
+    TEST_ASSERT_FALSE(capture->poll(3000200 + SENSOR_DEBOUNCE_US, change));
+    TEST_ASSERT_EQUAL(CLOSED, capture->getStableState());
+}
+
+// Test a full ring drops edges, then resynchronizes from the pins
+void test_edge_capture_overflow_resync() {
+    SensorChange change;
+    for (int i = 0; i < SENSOR_EDGE_RING_SIZE; i++) {
+        TEST_ASSERT_TRUE(capture->pushEdge(CLOSED_SENSOR, (i % 2) ? LOW : HIGH, 1000 + i));
+    }
+    TEST_ASSERT_FALSE(capture->pushEdge(OPEN_SENSOR, LOW, 2000));
+    TEST_ASSERT_EQUAL(1, capture->getDroppedEdges());
+
+#ifdef UNIT_TEST
+    // The lost edges left the gate open
+    setMockPinValue(SENSOR_CLOSED_PIN, HIGH);
+    setMockPinValue(SENSOR_OPEN_PIN, LOW);
+#endif
+    TEST_ASSERT_FALSE(capture->poll(10000, change));
+    TEST_ASSERT_TRUE(capture->poll(10000 + SENSOR_DEBOUNCE_US, change));
+    TEST_ASSERT_EQUAL(OPEN, change.state);
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_edge_capture_initial_state);
+    RUN_TEST(test_edge_capture_debounced_change);
+    RUN_TEST(test_edge_capture_bounce);
+    RUN_TEST(test_edge_capture_glitch_filtered);
+    RUN_TEST(test_edge_capture_overflow_resync);
+
+    return UNITY_END();
+}
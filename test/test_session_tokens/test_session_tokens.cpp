@@ -0,0 +1,173 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/SessionTokens.h"
+
+#include <string.h>
+#include <time.h>
+
+#include <unity.h>
+
+// esp_timer, esp_random and mbedtls are board-only: a settable clock, a fixed key and a
+// stand-in MAC that still depends on every key and data byte
+uint64_t uptime = 1000000;
+uint64_t SessionTokens::uptimeMs() {
+    return uptime;
+}
+
+void SessionTokens::begin() {
+    for (size_t i = 0; i < KEY_SIZE; i++) {
+        _key[i] = static_cast<uint8_t>(i * 7 + 1);
+    }
+    _ready = true;
+}
+
+bool SessionTokens::sign(const char* data, size_t length, uint8_t* mac) const {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < MAC_SIZE; i++) {
+        hash = (hash ^ _key[i]) * 16777619u;
+        for (size_t j = 0; j < length; j++) {
+            hash = (hash ^ static_cast<uint8_t>(data[j])) * 16777619u;
+        }
+        mac[i] = static_cast<uint8_t>(hash >> 24);
+    }
+    return true;
+}
+
+SessionTokens* tokens;
+
+ValidationResult makeIdentity(const String& userId, const String& username) {
+    ValidationResult identity = ValidationResult::valid();
+    identity.userId = userId;
+    identity.username = username;
+    identity.roles = 0x13;
+    return identity;
+}
+
+void setUp(void) {
+    resetMockState();
+    uptime = 1000000;
+    tokens = new SessionTokens();
+    tokens->begin();
+}
+
+void tearDown(void) {
+    delete tokens;
+    tokens = nullptr;
+}
+
+// Test an issued token verifies back to the same identity and roles
+void test_session_tokens_round_trip() {
+    String token;
+    unsigned long lifetime;
+    TEST_ASSERT_TRUE(tokens->issue(makeIdentity("0b1c2d3e-4f50-6172-8394-a5b6c7d8e9f0", "alice"), token, lifetime));
+    TEST_ASSERT_EQUAL(SESSION_TOKEN_TTL, lifetime);
+    TEST_ASSERT_TRUE(SessionTokens::isSessionToken(token));
+
+    ValidationResult result = tokens->verify(token);
+    TEST_ASSERT_TRUE(result.isValid);
+    TEST_ASSERT_EQUAL_STRING("0b1c2d3e-4f50-6172-8394-a5b6c7d8e9f0", result.userId.c_str());
+    TEST_ASSERT_EQUAL_STRING("alice", result.username.c_str());
+    TEST_ASSERT_EQUAL(0x13, result.roles);
+
+    // Not before begin(), nor for a rejected identity
+    SessionTokens unkeyed;
+    TEST_ASSERT_FALSE(unkeyed.issue(makeIdentity("sub", "bob"), token, lifetime));
+    TEST_ASSERT_FALSE(unkeyed.verify(token).isValid);
+    TEST_ASSERT_FALSE(tokens->issue(ValidationResult::rejected("Token expired"), token, lifetime));
+}
+
+// Test the lifetime never goes past the Keycloak token's exp
+void test_session_tokens_keycloak_exp() {
+    ValidationResult identity = makeIdentity("sub", "alice");
+    identity.expiresAt = time(nullptr) + 60;
+    String token;
+    unsigned long lifetime;
+    TEST_ASSERT_TRUE(tokens->issue(identity, token, lifetime));
+    TEST_ASSERT_TRUE(lifetime <= 60000 && lifetime >= 59000);
+
+    identity.expiresAt = time(nullptr) - 1;
+    TEST_ASSERT_FALSE(tokens->issue(identity, token, lifetime));
+}
+
+// Test any changed byte, a foreign key or a truncated MAC is refused
+void test_session_tokens_tampered() {
+    String token;
+    unsigned long lifetime;
+    tokens->issue(makeIdentity("sub", "alice"), token, lifetime);
+
+    // Claiming more roles: 13 -> 33
+    String forged = token;
+    const size_t roles = forged.find('.', 4) + 1;
+    TEST_ASSERT_EQUAL('1', forged[roles]);
+    forged[roles] = '3';
+    ValidationResult result = tokens->verify(forged);
+    TEST_ASSERT_FALSE(result.isValid);
+    TEST_ASSERT_EQUAL_STRING("Invalid session token", result.error.c_str());
+
+    forged = token;
+    forged[forged.length() - 1] = forged[forged.length() - 1] == 'A' ? 'B' : 'A';
+    TEST_ASSERT_FALSE(tokens->verify(forged).isValid);
+    TEST_ASSERT_FALSE(tokens->verify(String(token.c_str(), token.length() - 4)).isValid);
+    TEST_ASSERT_FALSE(tokens->verify("gs1.").isValid);
+}
+
+// Test a token dies at its expiry, measured on the uptime clock
+void test_session_tokens_expiry() {
+    String token;
+    unsigned long lifetime;
+    tokens->issue(makeIdentity("sub", "alice"), token, lifetime);
+
+    uptime += SESSION_TOKEN_TTL - 1;
+    TEST_ASSERT_TRUE(tokens->verify(token).isValid);
+    uptime += 1;
+    ValidationResult result = tokens->verify(token);
+    TEST_ASSERT_FALSE(result.isValid);
+    TEST_ASSERT_EQUAL_STRING("Session token expired", result.error.c_str());
+}
+
+// Test the longest sub and username issue() accepts still verify, one byte more is not issued
+void test_session_tokens_max_length() {
+    // Federated identity: f:<provider id>:<external id>
+    String sub = "f:8f2a4c1e-93b7-4d0a-b5e6-0c1d2e3f4a5b:";
+    while (static_cast<int>(sub.length()) < SESSION_TOKEN_SUB_MAX) {
+        sub += '9';
+    }
+    String username;
+    while (static_cast<int>(username.length()) < SESSION_TOKEN_USERNAME_MAX) {
+        username += 'u';
+    }
+    ValidationResult identity = makeIdentity(sub, username);
+    identity.roles = 0xFFFFFFFF;
+    String token;
+    unsigned long lifetime;
+    uptime = 0x7FFFFFFFFFFFULL;
+    TEST_ASSERT_TRUE(tokens->issue(identity, token, lifetime));
+    TEST_ASSERT_TRUE(static_cast<int>(token.length()) <= SESSION_TOKEN_MAX_LENGTH);
+    ValidationResult result = tokens->verify(token);
+    TEST_ASSERT_TRUE(result.isValid);
+    TEST_ASSERT_EQUAL_STRING(sub.c_str(), result.userId.c_str());
+    TEST_ASSERT_EQUAL_STRING(username.c_str(), result.username.c_str());
+    TEST_ASSERT_EQUAL(0xFFFFFFFF, result.roles);
+
+    identity.userId += '9';
+    TEST_ASSERT_FALSE(tokens->issue(identity, token, lifetime));
+    identity.userId = sub;
+    identity.username += 'u';
+    TEST_ASSERT_FALSE(tokens->issue(identity, token, lifetime));
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_session_tokens_round_trip);
+    RUN_TEST(test_session_tokens_keycloak_exp);
+    RUN_TEST(test_session_tokens_tampered);
+    RUN_TEST(test_session_tokens_expiry);
+    RUN_TEST(test_session_tokens_max_length);
+
+    return UNITY_END();
+}
@@ -0,0 +1,90 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/SpscQueue.h"
+
+#include <unity.h>
+
+struct Sample {
+    uint32_t id;
+    int value;
+};
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+// Test items come out in FIFO order
+void test_spsc_queue_fifo() {
+    SpscQueue<Sample, 4> queue;
+    Sample item;
+
+    TEST_ASSERT_TRUE(queue.isEmpty());
+    TEST_ASSERT_FALSE(queue.pop(item));
+
+    TEST_ASSERT_TRUE(queue.push({1, 10}));
+    TEST_ASSERT_TRUE(queue.push({2, 20}));
+    TEST_ASSERT_EQUAL(2, queue.size());
+
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL(1, item.id);
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL(20, item.value);
+    TEST_ASSERT_TRUE(queue.isEmpty());
+}
+
+// Test a full queue refuses new items without overwriting
+void test_spsc_queue_full() {
+    SpscQueue<Sample, 4> queue;
+    for (uint32_t i = 0; i < 4; i++) {
+        TEST_ASSERT_TRUE(queue.push({i, 0}));
+    }
+    TEST_ASSERT_FALSE(queue.push({99, 0}));
+
+    Sample item;
+    TEST_ASSERT_TRUE(queue.pop(item));
+    TEST_ASSERT_EQUAL(0, item.id);
+    TEST_ASSERT_TRUE(queue.push({4, 0}));
+}
+
+// Test indexes keep working after wrapping around the buffer many times
+void test_spsc_queue_wraparound() {
+    SpscQueue<Sample, 4> queue;
+    Sample item;
+    for (uint32_t i = 0; i < 1000; i++) {
+        TEST_ASSERT_TRUE(queue.push({i, 0}));
+        TEST_ASSERT_TRUE(queue.pop(item));
+        TEST_ASSERT_EQUAL(i, item.id);
+    }
+    TEST_ASSERT_TRUE(queue.isEmpty());
+}
+
+// Test the snapshot cell returns the last written value and counts versions
+void test_seqlock_snapshot() {
+    SeqLock<Sample> snapshot;
+    TEST_ASSERT_EQUAL(0, snapshot.version());
+
+    snapshot.write({1, 42});
+    snapshot.write({2, 43});
+
+    Sample value = snapshot.read();
+    TEST_ASSERT_EQUAL(2, value.id);
+    TEST_ASSERT_EQUAL(43, value.value);
+    TEST_ASSERT_EQUAL(2, snapshot.version());
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_spsc_queue_fifo);
+    RUN_TEST(test_spsc_queue_full);
+    RUN_TEST(test_spsc_queue_wraparound);
+    RUN_TEST(test_seqlock_snapshot);
+
+    return UNITY_END();
+}
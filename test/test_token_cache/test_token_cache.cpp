@@ -0,0 +1,153 @@
+#ifdef UNIT_TEST
+#include "../mocks/ArduinoMock.h"
+#else
+#include <Arduino.h>
+#endif
+
+#include "../src/components/Config.h"
+#include "../src/components/TokenCache.h"
+
+#include <string.h>
+#include <unity.h>
+
+// Arbitrary epoch well after the "clock synchronized" threshold
+const time_t NOW = 1700000000;
+
+TokenCache* cache;
+
+TokenFingerprint makeFingerprint(uint8_t seed) {
+    TokenFingerprint fingerprint;
+    memset(fingerprint.bytes, seed, sizeof(fingerprint.bytes));
+    return fingerprint;
+}
+
+ValidationResult makeResult(const char* username, time_t expiresAt) {
+    ValidationResult result = ValidationResult::valid();
+    result.userId = "sub-1234";
+    result.username = username;
+    result.realm = "https://kc/realms/garage";
+    result.expiresAt = expiresAt;
+    return result;
+}
+
+void setUp(void) {
+#ifdef UNIT_TEST
+    resetMockState();
+#endif
+    cache = new TokenCache(60000);
+}
+
+void tearDown(void) {
+    delete cache;
+    cache = nullptr;
+}
+
+// Test a stored result is returned for the same fingerprint
+void test_token_cache_hit() {
+    TokenFingerprint fingerprint = makeFingerprint(1);
+    ValidationResult stored = makeResult("alice", NOW + 600);
+    stored.roles = 0x5;
+    TEST_ASSERT_TRUE(cache->store(fingerprint, stored, NOW));
+
+    ValidationResult result;
+    TEST_ASSERT_TRUE(cache->lookup(fingerprint, result));
+    TEST_ASSERT_TRUE(result.isValid);
+    TEST_ASSERT_EQUAL_STRING("alice", result.username.c_str());
+    TEST_ASSERT_EQUAL_STRING("sub-1234", result.userId.c_str());
+    TEST_ASSERT_EQUAL(0x5, result.roles);
+    TEST_ASSERT_EQUAL(1, cache->getStats().hits);
+}
+
+// Test an unknown fingerprint is a miss
+void test_token_cache_miss() {
+    ValidationResult result;
+    TEST_ASSERT_FALSE(cache->lookup(makeFingerprint(2), result));
+    TEST_ASSERT_FALSE(result.isValid);
+    TEST_ASSERT_EQUAL(1, cache->getStats().misses);
+}
+
+// Test invalid results and results without exp are never cached
+void test_token_cache_rejects_uncacheable_results() {
+    ValidationResult invalid = makeResult("bob", NOW + 600);
+    invalid.isValid = false;
+    TEST_ASSERT_FALSE(cache->store(makeFingerprint(3), invalid, NOW));
+    TEST_ASSERT_FALSE(cache->store(makeFingerprint(3), makeResult("bob", 0), NOW));
+    TEST_ASSERT_FALSE(cache->store(makeFingerprint(3), makeResult("bob", NOW - 1), NOW));
+    // Clock not synchronized
+    TEST_ASSERT_FALSE(cache->store(makeFingerprint(3), makeResult("bob", NOW + 600), 1000));
+    TEST_ASSERT_EQUAL(0, cache->size());
+}
+
+// Test the TTL is capped by the configured max age
+void test_token_cache_max_age() {
+#ifdef UNIT_TEST
+    setMockMillis(1000);
+    TokenFingerprint fingerprint = makeFingerprint(4);
+    cache->store(fingerprint, makeResult("carol", NOW + 3600), NOW);
+
+    ValidationResult result;
+    setMockMillis(1000 + 59999);
+    TEST_ASSERT_TRUE(cache->lookup(fingerprint, result));
+
+    setMockMillis(1000 + 60000);
+    TEST_ASSERT_FALSE(cache->lookup(fingerprint, result));
+    TEST_ASSERT_EQUAL(1, cache->getStats().expirations);
+#endif
+}
+
+// Test the TTL is capped by the token expiry
+void test_token_cache_ttl_capped_by_exp() {
+#ifdef UNIT_TEST
+    setMockMillis(1000);
+    TokenFingerprint fingerprint = makeFingerprint(5);
+    cache->store(fingerprint, makeResult("dave", NOW + 10), NOW);
+
+    ValidationResult result;
+    setMockMillis(1000 + 9999);
+    TEST_ASSERT_TRUE(cache->lookup(fingerprint, result));
+
+    setMockMillis(1000 + 10000);
+    TEST_ASSERT_FALSE(cache->lookup(fingerprint, result));
+#endif
+}
+
+// Test the least recently used entry is evicted when the cache is full
+void test_token_cache_lru_eviction() {
+    for (int i = 0; i < TOKEN_CACHE_SIZE; i++) {
+        cache->store(makeFingerprint(10 + i), makeResult("user", NOW + 600), NOW);
+    }
+    TEST_ASSERT_EQUAL(TOKEN_CACHE_SIZE, cache->size());
+
+    // Touch the oldest entry so that the second one becomes the LRU
+    ValidationResult result;
+    TEST_ASSERT_TRUE(cache->lookup(makeFingerprint(10), result));
+
+    cache->store(makeFingerprint(99), makeResult("newcomer", NOW + 600), NOW);
+
+    TEST_ASSERT_EQUAL(1, cache->getStats().evictions);
+    TEST_ASSERT_EQUAL(TOKEN_CACHE_SIZE, cache->size());
+    TEST_ASSERT_TRUE(cache->lookup(makeFingerprint(10), result));
+    TEST_ASSERT_FALSE(cache->lookup(makeFingerprint(11), result));
+    TEST_ASSERT_TRUE(cache->lookup(makeFingerprint(99), result));
+}
+
+// Test fields that don't fit the fixed-size entry are not cached (no truncation)
+void test_token_cache_oversized_fields() {
+    std::string longName(200, 'x');
+    TEST_ASSERT_FALSE(cache->store(makeFingerprint(6), makeResult(longName.c_str(), NOW + 600), NOW));
+    TEST_ASSERT_EQUAL(0, cache->size());
+}
+
+int main() {
+    UNITY_BEGIN();
+
+    RUN_TEST(test_token_cache_hit);
+    RUN_TEST(test_token_cache_miss);
+    RUN_TEST(test_token_cache_rejects_uncacheable_results);
+    RUN_TEST(test_token_cache_max_age);
+    RUN_TEST(test_token_cache_ttl_capped_by_exp);
+    RUN_TEST(test_token_cache_lru_eviction);
+    RUN_TEST(test_token_cache_oversized_fields);
+
+    return UNITY_END();
+}